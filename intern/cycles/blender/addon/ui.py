@@ -2065,6 +2065,7 @@ class CYCLES_RENDER_PT_simplify_viewport(CyclesButtonsPanel, Panel):
         col.prop(rd, "simplify_child_particles", text="Child Particles")
         col.prop(cscene, "texture_limit", text="Texture Limit")
         col.prop(rd, "simplify_volumes", text="Volume Resolution")
+        col.prop(rd, "use_compact_curves_caches", text="Compact Curves Caches")
 
 
 class CYCLES_RENDER_PT_simplify_render(CyclesButtonsPanel, Panel):
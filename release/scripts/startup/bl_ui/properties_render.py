@@ -783,6 +783,9 @@ class RENDER_PT_simplify_viewport(RenderButtonsPanel, Panel):
         col = flow.column()
         col.prop(rd, "simplify_volumes", text="Volume Resolution")
 
+        col = flow.column()
+        col.prop(rd, "use_compact_curves_caches", text="Compact Curves Caches")
+
 
 class RENDER_PT_simplify_render(RenderButtonsPanel, Panel):
     bl_label = "Render"
@@ -9,8 +9,10 @@
  * \brief Low-level operations for curves.
  */
 
-#include <mutex>
+#include <memory>
 
+#include "BLI_bit_vector.hh"
+#include "BLI_cache_mutex.hh"
 #include "BLI_float3x3.hh"
 #include "BLI_float4x4.hh"
 #include "BLI_generic_virtual_array.hh"
@@ -24,6 +26,8 @@
 #include "BKE_attribute.hh"
 #include "BKE_attribute_math.hh"
 
+struct BVHTree;
+
 namespace blender::bke {
 
 template<typename T, BLI_ENABLE_IF(std::is_integral_v<T>)>
@@ -59,6 +63,22 @@ struct BasisCache {
   bool invalid = false;
 };
 
+/**
+ * The properties that fully define the #BasisCache of a NURBS curve. Since knots are generated
+ * from the knots mode, all curves with the same key have the same basis, so the cache can be
+ * shared between them, even across different geometries.
+ */
+struct BasisCacheKey {
+  int points_num;
+  int resolution;
+  int8_t order;
+  bool cyclic;
+  KnotsMode knots_mode;
+
+  uint64_t hash() const;
+  friend bool operator==(const BasisCacheKey &a, const BasisCacheKey &b);
+};
+
 }  // namespace curves::nurbs
 
 /**
@@ -80,17 +100,32 @@ class CurvesGeometryRuntime {
    */
   mutable Vector<int> evaluated_offsets_cache;
   mutable Vector<int> bezier_evaluated_offsets;
-  mutable std::mutex offsets_cache_mutex;
-  mutable bool offsets_cache_dirty = true;
+  /**
+   * The resolution used for each curve when a #CurvesGeometry::resolution_tolerance is used,
+   * otherwise empty. Computed together with the evaluated offsets.
+   */
+  mutable Vector<int> evaluated_resolution_cache;
+  mutable CacheMutex offsets_cache_mutex;
 
-  mutable Vector<curves::nurbs::BasisCache> nurbs_basis_cache;
-  mutable std::mutex nurbs_basis_cache_mutex;
-  mutable bool nurbs_basis_cache_dirty = true;
+  /**
+   * The basis cache for each curve, only set for NURBS curves. Curves with the same
+   * #curves::nurbs::BasisCacheKey point to the same cache, which is owned by
+   * #nurbs_basis_cache_users.
+   */
+  mutable Vector<const curves::nurbs::BasisCache *> nurbs_basis_cache;
+  /** Ownership of the unique basis caches used by this geometry. */
+  mutable Vector<std::shared_ptr<const curves::nurbs::BasisCache>> nurbs_basis_cache_users;
+  mutable CacheMutex nurbs_basis_cache_mutex;
 
   /** Cache of evaluated positions. */
   mutable Vector<float3> evaluated_position_cache;
-  mutable std::mutex position_cache_mutex;
-  mutable bool position_cache_dirty = true;
+  mutable CacheMutex position_cache_mutex;
+  /**
+   * When only some curves changed since the cache was calculated, the curves that must be
+   * evaluated again. Empty when the whole cache must be recalculated (if it is dirty at all).
+   * The other evaluated caches track their dirty curves in the same way.
+   */
+  mutable BitVector<> position_cache_dirty_curves;
   /**
    * The evaluated positions result, using a separate span in case all curves are poly curves,
    * in which case a separate array of evaluated positions is unnecessary.
@@ -103,18 +138,65 @@ class CurvesGeometryRuntime {
    * make slicing this array for a curve fast, an extra float is stored for every curve.
    */
   mutable Vector<float> evaluated_length_cache;
-  mutable std::mutex length_cache_mutex;
-  mutable bool length_cache_dirty = true;
+  mutable CacheMutex length_cache_mutex;
+  mutable BitVector<> length_cache_dirty_curves;
+
+  /**
+   * Cache of lengths measured along the exact curve, with the same layout as
+   * #evaluated_length_cache. See #CurvesGeometry::evaluated_lengths_precise_for_curve.
+   */
+  mutable Vector<float> evaluated_length_precise_cache;
+  mutable CacheMutex length_precise_cache_mutex;
+  mutable BitVector<> length_precise_cache_dirty_curves;
 
   /** Direction of the curve at each evaluated point. */
   mutable Vector<float3> evaluated_tangent_cache;
-  mutable std::mutex tangent_cache_mutex;
-  mutable bool tangent_cache_dirty = true;
+  mutable CacheMutex tangent_cache_mutex;
+  mutable BitVector<> tangent_cache_dirty_curves;
 
   /** Normal direction vectors for each evaluated point. */
   mutable Vector<float3> evaluated_normal_cache;
-  mutable std::mutex normal_cache_mutex;
-  mutable bool normal_cache_dirty = true;
+  mutable CacheMutex normal_cache_mutex;
+  mutable BitVector<> normal_cache_dirty_curves;
+
+  /**
+   * Lower precision copies of the position, tangent, normal and length caches, see
+   * #CurvesGeometry::compact_evaluated_caches. The full precision caches are freed and tagged
+   * dirty. The compact data is only read afterwards, and freed when the data it was created from
+   * changes. Positions are stored as a fraction of the bounds of each curve, which contain the
+   * minimum and the maximum for every curve. Directions are encoded with an octahedral mapping,
+   * and lengths are stored as a fraction of the total length of each curve, with the layout of
+   * #evaluated_length_cache.
+   */
+  mutable Vector<ushort3> evaluated_position_cache_compact;
+  mutable Vector<float3> evaluated_position_bounds_compact;
+  mutable Vector<short2> evaluated_tangent_cache_compact;
+  mutable Vector<short2> evaluated_normal_cache_compact;
+  mutable Vector<uint16_t> evaluated_length_cache_compact;
+  mutable Vector<float> evaluated_length_totals_compact;
+
+  /**
+   * BVH tree of the evaluated segments, see #CurvesGeometry::evaluated_segments_bvh.
+   * The tree is freed when it is recalculated and with the runtime data.
+   */
+  mutable BVHTree *evaluated_segments_bvh = nullptr;
+  mutable CacheMutex evaluated_segments_bvh_mutex;
+
+  /**
+   * Record of the changes that invalidate the evaluated caches, so that the depsgraph's copy of
+   * original curves can keep its caches when only some curves changed, see
+   * #curves_runtime_backup_restore. Every change gets a stamp that is unique in the session.
+   * #changed_curves contains the curves changed since #changed_curves_start_stamp, or is empty
+   * if there were no changes since then.
+   */
+  int64_t change_stamp;
+  int64_t changed_curves_start_stamp;
+  BitVector<> changed_curves;
+  /** The #change_stamp of the geometry this was copied from, or zero. */
+  int64_t copied_change_stamp = 0;
+
+  CurvesGeometryRuntime();
+  ~CurvesGeometryRuntime();
 };
 
 /**
@@ -224,6 +306,17 @@ class CurvesGeometry : public ::CurvesGeometry {
   /** Mutable access to curve resolution. Call #tag_topology_changed after changes. */
   MutableSpan<int> resolution_for_write();
 
+  /**
+   * The largest allowed distance between the evaluated edges and the exact curve, on the curve
+   * domain. When this is larger than zero, #resolution is the maximum number of evaluated edges
+   * for each segment, and fewer are used where the curve is flat enough. Zero (the default) uses
+   * the resolution everywhere. Call #tag_topology_changed after changes.
+   *
+   * \note When this attribute exists, changing positions changes the number of evaluated points.
+   */
+  VArray<float> resolution_tolerance() const;
+  MutableSpan<float> resolution_tolerance_for_write();
+
   /**
    * The angle used to rotate evaluated normals around the tangents after their calculation.
    * Call #tag_normals_changed after changes.
@@ -331,10 +424,26 @@ class CurvesGeometry : public ::CurvesGeometry {
    */
   Span<int> bezier_evaluated_offsets_for_curve(int curve_index) const;
 
+  /**
+   * The number of evaluated edges for every segment of Catmull Rom and NURBS curves. This is the
+   * same as #resolution unless the #resolution_tolerance lowers it. Bezier curves can use a
+   * different number of edges for every segment, see #bezier_evaluated_offsets_for_curve.
+   */
+  VArray<int> evaluated_resolution() const;
+
   Span<float3> evaluated_positions() const;
   Span<float3> evaluated_tangents() const;
   Span<float3> evaluated_normals() const;
 
+  /**
+   * Same as the functions above, but data that was stored with lower precision by
+   * #compact_evaluated_caches is decoded into the buffer instead of the cache, so that the memory
+   * stays saved. The returned span is only valid as long as the buffer.
+   */
+  Span<float3> evaluated_positions(Vector<float3> &r_buffer) const;
+  Span<float3> evaluated_tangents(Vector<float3> &r_buffer) const;
+  Span<float3> evaluated_normals(Vector<float3> &r_buffer) const;
+
   /**
    * Return a cache of accumulated lengths along the curve. Each item is the length of the
    * subsequent segment (the first value is the length of the first segment rather than 0).
@@ -350,6 +459,59 @@ class CurvesGeometry : public ::CurvesGeometry {
   /** Calculates the data described by #evaluated_lengths_for_curve if necessary. */
   void ensure_evaluated_lengths() const;
 
+  /**
+   * The lengths described by #evaluated_lengths_for_curve for all curves, see
+   * #lengths_range_for_curve. Compact lengths are decoded into the buffer like for
+   * #evaluated_positions with a buffer, otherwise the cache is calculated if necessary.
+   */
+  Span<float> evaluated_lengths(Vector<float> &r_buffer) const;
+  /** Return the slice of #evaluated_lengths that corresponds to this curve index. */
+  IndexRange lengths_range_for_curve(int curve_index, bool cyclic) const;
+
+  /**
+   * Return accumulated lengths with the same layout as #evaluated_lengths_for_curve, but measured
+   * along the exact curve instead of along the straight edges between evaluated points. For Bezier
+   * and NURBS curves the lengths are integrated from the curve's derivative, so increasing the
+   * resolution isn't necessary to measure lengths accurately. Poly and Catmull Rom curves use the
+   * lengths of the evaluated edges.
+   *
+   * Since every value still corresponds to an evaluated edge, this works as an inverse lookup
+   * table from a length to an evaluated edge and a factor within it, with the same functions from
+   * #length_parameterize that are used for the evaluated lengths.
+   */
+  Span<float> evaluated_lengths_precise_for_curve(int curve_index, bool cyclic) const;
+  float evaluated_length_precise_total_for_curve(int curve_index, bool cyclic) const;
+
+  /** Calculates the data described by #evaluated_lengths_precise_for_curve if necessary. */
+  void ensure_evaluated_lengths_precise() const;
+
+  /**
+   * Replace the evaluated position, tangent, normal and length caches that are calculated with
+   * lower precision versions, for geometry that is only displayed in the viewport. Directions use
+   * a third of the memory, positions and lengths about half. The error is about 1e-4 for
+   * directions, 1e-5 times the size of the curve's bounds for positions and 2e-5 times the curve
+   * length for lengths. The accessors that take a buffer decode the data into the buffer, the
+   * other accessors decode it into the caches again, which uses the full memory again.
+   *
+   * \warning The caches must not be accessed from other threads at the same time, so this must
+   * only be used on geometry that isn't shared with other evaluations.
+   * \return The number of bytes saved.
+   */
+  int64_t compact_evaluated_caches() const;
+
+  /**
+   * The number of bytes that the compact caches currently save compared to the full precision
+   * caches they replace, for memory statistics. Zero when the caches have been decoded again.
+   */
+  int64_t compact_evaluated_caches_bytes_saved() const;
+
+  /**
+   * A BVH tree of the edges between evaluated points, used for the queries in BKE_curves_bvh.hh.
+   * The index of every item is the index of the evaluated point at the start of the edge. Curves
+   * with a single evaluated point are added as a point instead. Null when there are no points.
+   */
+  BVHTree *evaluated_segments_bvh() const;
+
   void ensure_can_interpolate_to_evaluated() const;
 
   /**
@@ -371,9 +533,6 @@ class CurvesGeometry : public ::CurvesGeometry {
    */
   void ensure_nurbs_basis_cache() const;
 
-  /** Return the slice of #evaluated_length_cache that corresponds to this curve index. */
-  IndexRange lengths_range_for_curve(int curve_index, bool cyclic) const;
-
   /* --------------------------------------------------------------------
    * Operations.
    */
@@ -387,6 +546,16 @@ class CurvesGeometry : public ::CurvesGeometry {
 
   /** Call after deforming the position attribute. */
   void tag_positions_changed();
+  /**
+   * Call after deforming the positions of only some curves. The evaluated data of the other curves
+   * is kept, and only the changed curves are evaluated again when the data is accessed, unless
+   * other changes require recalculating everything.
+   *
+   * \note When called on original data, the depsgraph's copy keeps its evaluated caches
+   * and only evaluates the changed curves again. That requires that all changes to the
+   * original since its last update are tagged, see #curves_runtime_backup_restore.
+   */
+  void tag_positions_changed(IndexMask changed_curves);
   /**
    * Call after any operation that changes the topology
    * (number of points, evaluated points, or the total count).
@@ -477,6 +646,21 @@ inline int segments_num(const int points_num, const bool cyclic)
   return (cyclic && points_num > 1) ? points_num : points_num - 1;
 }
 
+/**
+ * The number of evenly spaced evaluated edges needed so that a segment parameterized from zero to
+ * one stays within #tolerance of its evaluated edges, clamped to the maximum #resolution. The
+ * distance between a curve and its chord is at most an eighth of the largest magnitude of its
+ * second derivative, which is given by #second_derivative_max.
+ */
+inline int resolution_for_tolerance(const float second_derivative_max,
+                                    const int resolution,
+                                    const float tolerance)
+{
+  BLI_assert(tolerance > 0.0f);
+  const float edges_num = std::sqrt(second_derivative_max / (8.0f * tolerance));
+  return std::clamp(int(std::ceil(std::min(edges_num, float(resolution)))), 1, resolution);
+}
+
 inline float2 encode_surface_bary_coord(const float3 &v)
 {
   BLI_assert(std::abs(v.x + v.y + v.z - 1.0f) < 0.00001f);
@@ -575,6 +759,32 @@ void calculate_evaluated_offsets(Span<int8_t> handle_types_left,
                                  int resolution,
                                  MutableSpan<int> evaluated_offsets);
 
+/**
+ * The number of edges needed for a single segment to stay within #tolerance of the curve, at most
+ * #resolution.
+ */
+int segment_resolution_for_tolerance(const float3 &point_prev,
+                                     const float3 &handle_prev,
+                                     const float3 &handle_next,
+                                     const float3 &point_next,
+                                     int resolution,
+                                     float tolerance);
+
+/**
+ * Calculate offsets like #calculate_evaluated_offsets, but choose the number of edges for every
+ * segment so that the evaluated edges stay within #tolerance of the curve. #resolution is the
+ * maximum number of edges for each segment. Flat segments generate a single edge.
+ */
+void calculate_evaluated_offsets_adaptive(Span<float3> positions,
+                                          Span<float3> handles_left,
+                                          Span<float3> handles_right,
+                                          Span<int8_t> handle_types_left,
+                                          Span<int8_t> handle_types_right,
+                                          bool cyclic,
+                                          int resolution,
+                                          float tolerance,
+                                          MutableSpan<int> evaluated_offsets);
+
 /** Knot insertion result, see #insert. */
 struct Insertion {
   float3 handle_prev;
@@ -670,6 +880,22 @@ void calculate_evaluated_positions(Span<float3> positions,
                                    Span<int> evaluated_offsets,
                                    MutableSpan<float3> evaluated_positions);
 
+/**
+ * Calculate the length along the curve at the end of every evaluated edge, like
+ * #CurvesGeometry::evaluated_lengths_for_curve. Unlike the lengths of the straight edges between
+ * the evaluated points, the lengths are integrated from the derivative of each segment, so their
+ * accuracy doesn't depend on the resolution.
+ *
+ * \param evaluated_offsets: Offsets from #calculate_evaluated_offsets, defining the parameter
+ * range of every evaluated edge.
+ */
+void calculate_evaluated_lengths_precise(Span<float3> positions,
+                                         Span<float3> handles_left,
+                                         Span<float3> handles_right,
+                                         Span<int> evaluated_offsets,
+                                         bool cyclic,
+                                         MutableSpan<float> lengths);
+
 /**
  * Evaluate generic data to the evaluated points, with counts for each segment described by
  * #evaluated_offsets. Unlike other curve types, for Bezier curves generic data and positions
@@ -694,6 +920,16 @@ namespace catmull_rom {
  */
 int calculate_evaluated_num(int points_num, bool cyclic, int resolution);
 
+/**
+ * Find the smallest resolution up to #resolution for which the evaluated edges of every segment
+ * stay within #tolerance of the curve. The resolution is the same for all segments, so that the
+ * curve can still be evaluated with #interpolate_to_evaluated.
+ */
+int calculate_resolution_for_tolerance(Span<float3> positions,
+                                       bool cyclic,
+                                       int resolution,
+                                       float tolerance);
+
 /**
  * Evaluate the Catmull Rom curve. The length of the #dst span should be calculated with
  * #calculate_evaluated_num and is expected to divide evenly by the #src span's segment size.
@@ -758,6 +994,19 @@ bool check_valid_num_and_order(int points_num, int8_t order, bool cyclic, KnotsM
 int calculate_evaluated_num(
     int points_num, int8_t order, bool cyclic, int resolution, KnotsMode knots_mode);
 
+/**
+ * Estimate the smallest resolution up to #resolution for which the evaluated edges stay within
+ * #tolerance of the curve. The second derivative is bounded with the control polygon, which is
+ * exact for uniform knots and an approximation for other knot modes and weighted control points.
+ * Using the same resolution for all segments means that the basis cache can still be shared
+ * between curves.
+ */
+int calculate_resolution_for_tolerance(Span<float3> positions,
+                                       int8_t order,
+                                       bool cyclic,
+                                       int resolution,
+                                       float tolerance);
+
 /**
  * Calculate the length of the knot vector for a NURBS curve with the given properties.
  * The knots must be longer for a cyclic curve, for example, in order to provide weights for the
@@ -789,6 +1038,15 @@ void calculate_basis_cache(int points_num,
                            Span<float> knots,
                            BasisCache &basis_cache);
 
+/**
+ * Retrieve the basis cache for NURBS curves with the given properties, calculating it if no other
+ * curve with the same properties has requested it recently. The result is shared with all other
+ * users, so it must not be modified. Calculated caches are kept in a global registry even after
+ * they become unused, so that re-evaluating the same curves later (i.e. on the next frame) can
+ * reuse them.
+ */
+std::shared_ptr<const BasisCache> get_shared_basis_cache(const BasisCacheKey &key);
+
 /**
  * Using a "basis cache" generated by #BasisCache, interpolate attribute values to the evaluated
  * points. The number of evaluated points is determined by the #basis_cache argument.
@@ -803,6 +1061,58 @@ void interpolate_to_evaluated(const BasisCache &basis_cache,
                               GSpan src,
                               GMutableSpan dst);
 
+/**
+ * Interpolate attribute values to the evaluated points of all selected curves at once, like
+ * #interpolate_to_evaluated for every curve. This is much faster when there are many small curves,
+ * since the work is divided between threads by curve, and the attribute type is only resolved
+ * once.
+ *
+ * \param points_offsets: Offsets of the control points of every curve in #src.
+ * \param evaluated_offsets: Offsets of the evaluated points of every curve in #dst.
+ */
+void interpolate_to_evaluated(Span<const BasisCache *> basis_caches,
+                              const VArray<int8_t> &orders,
+                              Span<float> control_weights,
+                              Span<int> points_offsets,
+                              Span<int> evaluated_offsets,
+                              IndexMask selection,
+                              GSpan src,
+                              GMutableSpan dst);
+
+/**
+ * Calculate the length along the curve at the end of every evaluated edge, like
+ * #CurvesGeometry::evaluated_lengths_for_curve. The lengths are integrated from the derivative of
+ * the (rational) basis functions, splitting edges at knots where the derivative may be
+ * discontinuous, so their accuracy doesn't depend on the resolution.
+ *
+ * \param control_weights: Optional weights for every control point, as for
+ * #interpolate_to_evaluated.
+ */
+void calculate_evaluated_lengths_precise(Span<float3> positions,
+                                         Span<float> control_weights,
+                                         int8_t order,
+                                         bool cyclic,
+                                         int resolution,
+                                         KnotsMode knots_mode,
+                                         MutableSpan<float> lengths);
+
+/**
+ * Calculate the position on the exact curve at a fractional evaluated point index, which matches
+ * the evaluated points at whole numbers, and the derivative of the position with respect to it.
+ * The curve must be valid, see #check_valid_num_and_order.
+ *
+ * \param knots: The knots calculated by #calculate_knots.
+ */
+void evaluate_at_evaluated_parameter(Span<float3> positions,
+                                     Span<float> control_weights,
+                                     int8_t order,
+                                     bool cyclic,
+                                     int evaluated_num,
+                                     Span<float> knots,
+                                     float evaluated_parameter,
+                                     float3 &r_position,
+                                     float3 &r_derivative);
+
 }  // namespace nurbs
 
 /** \} */
@@ -823,6 +1133,23 @@ Curves *curves_new_nomain_single(int points_num, CurveType type);
  */
 void curves_copy_parameters(const Curves &src, Curves &dst);
 
+/**
+ * Move the runtime data with the evaluated caches out of the depsgraph's copy of curves before it
+ * is freed to be updated from the original data. The curves get empty runtime data instead.
+ */
+CurvesGeometryRuntime *curves_runtime_backup(CurvesGeometry &curves);
+/**
+ * Take over the evaluated caches of runtime data from #curves_runtime_backup after the curves
+ * were copied from the original again, and free the backup. The caches are only kept when every
+ * change of the original since the previous copy was tagged with
+ * #CurvesGeometry::tag_positions_changed for some curves, then only those curves are evaluated
+ * again. Other updates, e.g. when the original was changed without tagging the curves, start
+ * with empty caches.
+ */
+void curves_runtime_backup_restore(CurvesGeometry &curves,
+                                   const CurvesGeometry &curves_orig,
+                                   CurvesGeometryRuntime *backup);
+
 std::array<int, CURVE_TYPES_NUM> calculate_type_counts(const VArray<int8_t> &types);
 
 /* -------------------------------------------------------------------- */
@@ -907,13 +1234,13 @@ inline int CurvesGeometry::evaluated_points_num() const
 
 inline IndexRange CurvesGeometry::evaluated_points_for_curve(int index) const
 {
-  BLI_assert(!this->runtime->offsets_cache_dirty);
+  BLI_assert(this->runtime->offsets_cache_mutex.is_cached());
   return offsets_to_range(this->runtime->evaluated_offsets_cache.as_span(), index);
 }
 
 inline IndexRange CurvesGeometry::evaluated_points_for_curves(const IndexRange curves) const
 {
-  BLI_assert(!this->runtime->offsets_cache_dirty);
+  BLI_assert(this->runtime->offsets_cache_mutex.is_cached());
   BLI_assert(this->curve_num > 0);
   const int offset = this->runtime->evaluated_offsets_cache[curves.start()];
   const int offset_next = this->runtime->evaluated_offsets_cache[curves.one_after_last()];
@@ -938,7 +1265,7 @@ inline IndexRange CurvesGeometry::lengths_range_for_curve(const int curve_index,
 inline Span<float> CurvesGeometry::evaluated_lengths_for_curve(const int curve_index,
                                                                const bool cyclic) const
 {
-  BLI_assert(!this->runtime->length_cache_dirty);
+  BLI_assert(this->runtime->length_cache_mutex.is_cached());
   const IndexRange range = this->lengths_range_for_curve(curve_index, cyclic);
   return this->runtime->evaluated_length_cache.as_span().slice(range);
 }
@@ -953,6 +1280,24 @@ inline float CurvesGeometry::evaluated_length_total_for_curve(const int curve_in
   return lengths.last();
 }
 
+inline Span<float> CurvesGeometry::evaluated_lengths_precise_for_curve(const int curve_index,
+                                                                       const bool cyclic) const
+{
+  BLI_assert(this->runtime->length_precise_cache_mutex.is_cached());
+  const IndexRange range = this->lengths_range_for_curve(curve_index, cyclic);
+  return this->runtime->evaluated_length_precise_cache.as_span().slice(range);
+}
+
+inline float CurvesGeometry::evaluated_length_precise_total_for_curve(const int curve_index,
+                                                                      const bool cyclic) const
+{
+  const Span<float> lengths = this->evaluated_lengths_precise_for_curve(curve_index, cyclic);
+  if (lengths.is_empty()) {
+    return 0.0f;
+  }
+  return lengths.last();
+}
+
 /** \} */
 
 namespace curves {
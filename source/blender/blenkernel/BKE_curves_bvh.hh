@@ -0,0 +1,77 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#pragma once
+
+/** \file
+ * \ingroup bke
+ * \brief Nearest point and ray queries on curves, using the BVH tree of their evaluated segments
+ * cached by #CurvesGeometry::evaluated_segments_bvh.
+ */
+
+#include "BLI_math_vec_types.hh"
+
+#include "BKE_curves.hh"
+
+namespace blender::bke::curves {
+
+/** A location on the evaluated curves, found by #find_nearest or #raycast. */
+struct CurvesSample {
+  /** The index of the curve, or -1 if nothing was found. */
+  int curve_index = -1;
+  /** The index of the evaluated segment in the curve, starting at its first evaluated point. */
+  int segment_index = 0;
+  /** The position between the two evaluated points of the segment, from 0 to 1. */
+  float segment_factor = 0.0f;
+  /**
+   * The portion of the curve's evaluated length before the location, from 0 to 1, like the
+   * "Factor" mode of the Sample Curve node.
+   */
+  float parameter = 0.0f;
+  float3 position;
+};
+
+struct CurvesNearest : public CurvesSample {
+  /** The squared distance from the query position. */
+  float distance_sq = FLT_MAX;
+};
+
+struct CurvesRayHit : public CurvesSample {
+  /** The distance along the ray to the location closest to the curve. */
+  float distance = FLT_MAX;
+  /** The perpendicular distance from the ray to the curve, smaller than the ray radius. */
+  float radius = 0.0f;
+};
+
+/**
+ * Find the closest location on the evaluated curves to a position.
+ *
+ * \param max_distance_sq: Locations further away are ignored. #r_nearest is only changed when a
+ * closer location is found, so passing the previous result speeds up many similar queries.
+ * \param refine: Move the result from the evaluated polyline to the closest position on the exact
+ * Bezier, Catmull Rom or NURBS curve near it, with a few Newton iterations.
+ * \return Whether a location closer than #max_distance_sq was found.
+ */
+bool find_nearest(const CurvesGeometry &curves,
+                  const float3 &position,
+                  float max_distance_sq,
+                  bool refine,
+                  CurvesNearest &r_nearest);
+
+/**
+ * Find the first location along a ray where the curves are closer than #radius to it, treating
+ * the evaluated curves as tubes with that radius.
+ *
+ * \param direction: Normalized direction of the ray.
+ * \param refine: Move the result to the closest location of the exact curve to the ray, as for
+ * #find_nearest. The polyline result is kept if the exact curve is further than #radius away.
+ * \return Whether a hit closer than #ray_length was found.
+ */
+bool raycast(const CurvesGeometry &curves,
+             const float3 &origin,
+             const float3 &direction,
+             float ray_length,
+             float radius,
+             bool refine,
+             CurvesRayHit &r_hit);
+
+}  // namespace blender::bke::curves
@@ -66,6 +66,13 @@ typedef enum eCDAllocType {
    * if all layer values will be set by the caller after creating the layer.
    */
   CD_CONSTRUCT = 5,
+  /**
+   * Share the data of the source layers instead of copying it. The data is only copied once one of
+   * the owners requests write access with #CustomData_duplicate_referenced_layer. Layers that
+   * don't own their data are copied like with #CD_DUPLICATE. Only supported when copying layers
+   * from another #CustomData.
+   */
+  CD_SHARE = 6,
 } eCDAllocType;
 
 #define CD_TYPE_AS_MASK(_type) (eCustomDataMask)((eCustomDataMask)1 << (eCustomDataMask)(_type))
@@ -106,7 +113,7 @@ bool CustomData_has_interp(const struct CustomData *data);
 bool CustomData_bmesh_has_free(const struct CustomData *data);
 
 /**
- * Checks if any of the custom-data layers is referenced.
+ * Checks if any of the custom-data layers is referenced or shared with other layers.
  */
 bool CustomData_has_referenced(const struct CustomData *data);
 
@@ -232,6 +239,17 @@ void *CustomData_add_layer_named(struct CustomData *data,
                                  void *layer,
                                  int totelem,
                                  const char *name);
+/**
+ * Add a layer that uses data owned by something else, e.g. a memory mapped file. The layer adds a
+ * user to the owner, which is removed again when no layer uses the data anymore. The data is
+ * never changed, it is copied before the layer is modified.
+ */
+void *CustomData_add_layer_named_with_owner(struct CustomData *data,
+                                            int type,
+                                            void *layer,
+                                            int totelem,
+                                            const char *name,
+                                            const ImplicitSharingInfoHandle *owner);
 void *CustomData_add_layer_anonymous(struct CustomData *data,
                                      int type,
                                      eCDAllocType alloctype,
@@ -273,7 +291,8 @@ int CustomData_number_of_layers(const struct CustomData *data, int type);
 int CustomData_number_of_layers_typemask(const struct CustomData *data, eCustomDataMask mask);
 
 /**
- * Duplicate data of a layer with flag NOFREE, and remove that flag.
+ * Duplicate data of a layer with flag NOFREE, and remove that flag. Data that is shared with other
+ * layers is copied as well, unless this layer is its only remaining owner.
  * \return the layer data.
  */
 void *CustomData_duplicate_referenced_layer(struct CustomData *data, int type, int totelem);
@@ -0,0 +1,40 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#pragma once
+
+/** \file
+ * \ingroup bke
+ *
+ * Geometry sets can be baked to files that are loaded again much faster than the geometry can be
+ * computed. The files use a flat binary format, in which every attribute is stored as one array
+ * with a fixed alignment. When a file is loaded, it is mapped into memory and the attributes of
+ * meshes, point clouds and curves reference the mapped memory directly, so only the pages that
+ * are actually accessed are read from disk. Like other referenced custom data layers, the
+ * attributes are copied before they are modified.
+ *
+ * Only data that does not contain pointers can be baked. Volumes, vertex groups, materials and
+ * anonymous attributes are not stored. Object and collection instances are converted to
+ * geometry instances.
+ */
+
+#include <optional>
+
+#include "BKE_geometry_set.hh"
+
+namespace blender::bke {
+
+/**
+ * Write the geometry to a new file, replacing an existing file atomically, so that geometry
+ * that was loaded from it before remains valid.
+ * \return False if the file could not be written.
+ */
+bool geometry_bake_write(const GeometrySet &geometry, const char *filepath);
+
+/**
+ * Load geometry written by #geometry_bake_write. The file stays mapped until no geometry uses its
+ * memory anymore.
+ * \return None if the file does not exist or is not a valid bake file.
+ */
+std::optional<GeometrySet> geometry_bake_read(const char *filepath);
+
+}  // namespace blender::bke
@@ -295,8 +295,12 @@ class AnonymousAttributeFieldInput : public GeometryFieldInput {
 };
 
 class CurveLengthFieldInput final : public CurvesFieldInput {
+ private:
+  /** Use #CurvesGeometry::evaluated_lengths_precise_for_curve instead of the evaluated lengths. */
+  bool precise_;
+
  public:
-  CurveLengthFieldInput();
+  CurveLengthFieldInput(bool precise = false);
   GVArray get_varray_for_context(const CurvesGeometry &curves,
                                  eAttrDomain domain,
                                  IndexMask mask) const final;
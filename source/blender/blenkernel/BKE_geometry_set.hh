@@ -10,6 +10,7 @@
 #include <iostream>
 #include <mutex>
 
+#include "BLI_array.hh"
 #include "BLI_float4x4.hh"
 #include "BLI_function_ref.hh"
 #include "BLI_hash.hh"
@@ -640,6 +641,41 @@ class InstanceReference {
   }
 };
 
+/**
+ * All instances of an #InstancesComponent with nested geometry instances expanded, grouped by the
+ * data that is instanced. See #InstancesComponent::flattened_instances.
+ */
+struct FlattenedInstances {
+  struct Group {
+    /**
+     * The instanced data, which never contains instances itself. Object and collection
+     * references are not expanded, because their geometry depends on the evaluated objects.
+     */
+    InstanceReference reference;
+    /** Identifies the instanced data when groups of nested components are merged. */
+    const void *key = nullptr;
+    /** Transforms relative to the component. Empty when compact transforms are used. */
+    blender::Array<blender::float4x4> transforms;
+    /**
+     * Compact transforms with a quaternion rotation, a translation and a uniform scale, which
+     * take half the memory of full matrices. Only used when all instances of the group can be
+     * represented that way.
+     */
+    blender::Array<blender::float4> rotations;
+    blender::Array<blender::float3> translations;
+    blender::Array<float> scales;
+
+    int64_t size() const;
+    bool is_compact() const;
+    blender::float4x4 transform(int64_t index) const;
+  };
+
+  blender::Vector<Group> groups;
+
+  int64_t instances_num() const;
+  int64_t size_in_bytes() const;
+};
+
 /**
  * A geometry component that stores instances. The instance data can be any type described by
  * #InstanceReference. Geometry instances can even contain instances themselves, for nested
@@ -673,6 +709,11 @@ class InstancesComponent : public GeometryComponent {
   mutable std::mutex almost_unique_ids_mutex_;
   mutable blender::Array<int> almost_unique_ids_;
 
+  /* Nested instances are expanded lazily and cached until the component is changed. */
+  mutable std::mutex flattened_instances_mutex_;
+  mutable std::unique_ptr<FlattenedInstances> flattened_instances_;
+  mutable std::unique_ptr<FlattenedInstances> compact_flattened_instances_;
+
   blender::bke::CustomDataAttributes attributes_;
 
  public:
@@ -736,6 +777,20 @@ class InstancesComponent : public GeometryComponent {
 
   blender::Span<int> almost_unique_ids() const;
 
+  /**
+   * Expand nested geometry instances into one transform array per instanced data, which is
+   * cached until the component is changed. Sub-hierarchies that are instanced multiple times are
+   * only expanded once. Only this component keeps its result, nested components don't cache
+   * theirs.
+   *
+   * \param use_compact_transforms: Store transforms as rotation, translation and uniform scale
+   * for groups where that is possible, which halves their memory usage. The transforms are
+   * rebuilt from a quaternion then, so they differ from the full precision transforms used by
+   * other code (e.g. the dupli iterator used for rendering) by a relative error of about 1e-6.
+   * Both variants are cached separately.
+   */
+  const FlattenedInstances &flattened_instances(bool use_compact_transforms = false) const;
+
   blender::bke::CustomDataAttributes &instance_attributes();
   const blender::bke::CustomDataAttributes &instance_attributes() const;
 
@@ -753,6 +808,8 @@ class InstancesComponent : public GeometryComponent {
   static constexpr inline GeometryComponentType static_type = GEO_COMPONENT_TYPE_INSTANCES;
 
  private:
+  /** Free caches that depend on the instances, called before the instances are changed. */
+  void tag_instances_changed();
 };
 
 /**
@@ -169,6 +169,27 @@ static void bvhtree_balance(BVHTree *tree, const bool isolate)
   }
 }
 
+static void bvhtree_balance_sah_isolated(void *userdata)
+{
+  BLI_bvhtree_balance_sah((BVHTree *)userdata);
+}
+
+/**
+ * Trees in the mesh cache are never updated after they are built, and are often queried many
+ * times, so they are worth the more expensive SAH build.
+ */
+static void bvhtree_balance_sah(BVHTree *tree, const bool isolate)
+{
+  if (tree) {
+    if (isolate) {
+      BLI_task_isolate(bvhtree_balance_sah_isolated, tree);
+    }
+    else {
+      BLI_bvhtree_balance_sah(tree);
+    }
+  }
+}
+
 /** \} */
 
 /* -------------------------------------------------------------------- */
@@ -1325,7 +1346,7 @@ BVHTree *BKE_bvhtree_from_mesh_get(struct BVHTreeFromMesh *data,
     MEM_freeN(mask);
   }
 
-  bvhtree_balance(data->tree, lock_started);
+  bvhtree_balance_sah(data->tree, lock_started);
 
   /* Save on cache for later use */
   // printf("BVHTree built and saved on cache\n");
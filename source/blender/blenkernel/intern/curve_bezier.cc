@@ -6,6 +6,9 @@
 
 #include <algorithm>
 
+#include "BLI_length_parameterize.hh"
+#include "BLI_math_geom.h"
+
 #include "BKE_attribute_math.hh"
 #include "BKE_curves.hh"
 
@@ -58,6 +61,87 @@ void calculate_evaluated_offsets(const Span<int8_t> handle_types_left,
   evaluated_offsets.last() = offset;
 }
 
+int segment_resolution_for_tolerance(const float3 &point_prev,
+                                     const float3 &handle_prev,
+                                     const float3 &handle_next,
+                                     const float3 &point_next,
+                                     const int resolution,
+                                     const float tolerance)
+{
+  /* The segment is inside the convex hull of its control points, so when the handles are close
+   * to the straight line between the points, a single edge is enough. This isn't detected by the
+   * bound below when the handles are spaced unevenly along that line. */
+  if (dist_squared_to_line_segment_v3(handle_prev, point_prev, point_next) <=
+          tolerance * tolerance &&
+      dist_squared_to_line_segment_v3(handle_next, point_prev, point_next) <=
+          tolerance * tolerance) {
+    return 1;
+  }
+  /* The second derivative of a cubic Bezier segment interpolates linearly between six times
+   * the second differences of its control points, so its maximum is at one of the ends. */
+  const float second_derivative_max = 6.0f *
+                                      std::max(math::length(point_prev - 2.0f * handle_prev +
+                                                            handle_next),
+                                               math::length(handle_prev - 2.0f * handle_next +
+                                                            point_next));
+  return resolution_for_tolerance(second_derivative_max, resolution, tolerance);
+}
+
+void calculate_evaluated_offsets_adaptive(const Span<float3> positions,
+                                          const Span<float3> handles_left,
+                                          const Span<float3> handles_right,
+                                          const Span<int8_t> handle_types_left,
+                                          const Span<int8_t> handle_types_right,
+                                          const bool cyclic,
+                                          const int resolution,
+                                          const float tolerance,
+                                          MutableSpan<int> evaluated_offsets)
+{
+  const int size = positions.size();
+  BLI_assert(evaluated_offsets.size() == size);
+
+  if (size == 1) {
+    evaluated_offsets.first() = 1;
+    return;
+  }
+
+  int offset = 0;
+
+  for (const int i : IndexRange(size - 1)) {
+    if (segment_is_vector(handle_types_left, handle_types_right, i)) {
+      offset++;
+    }
+    else {
+      offset += segment_resolution_for_tolerance(positions[i],
+                                                 handles_right[i],
+                                                 handles_left[i + 1],
+                                                 positions[i + 1],
+                                                 resolution,
+                                                 tolerance);
+    }
+    evaluated_offsets[i] = offset;
+  }
+
+  if (cyclic) {
+    if (last_cyclic_segment_is_vector(handle_types_left, handle_types_right)) {
+      offset++;
+    }
+    else {
+      offset += segment_resolution_for_tolerance(positions.last(),
+                                                 handles_right.last(),
+                                                 handles_left.first(),
+                                                 positions.first(),
+                                                 resolution,
+                                                 tolerance);
+    }
+  }
+  else {
+    offset++;
+  }
+
+  evaluated_offsets.last() = offset;
+}
+
 Insertion insert(const float3 &point_prev,
                  const float3 &handle_prev,
                  const float3 &handle_next,
@@ -230,6 +314,124 @@ void evaluate_segment(const float3 &point_0,
   }
 }
 
+/**
+ * The range of evaluated points for the segment starting at the control point with the given
+ * index. The last segment of a non-cyclic curve only contains the last evaluated point.
+ */
+static IndexRange segment_evaluated_range(const Span<int> evaluated_offsets, const int index)
+{
+  const int start = index == 0 ? 0 : evaluated_offsets[index - 1];
+  return IndexRange(start, evaluated_offsets[index] - start);
+}
+
+/**
+ * Evaluate multiple segments with the same number of evaluated points at the same time, with the
+ * same "forward differencing" method as #evaluate_segment. The state of every segment is stored in
+ * a separate lane of each array ("structure of arrays" layout), so that the loops over the lanes
+ * can be compiled to SIMD instructions.
+ *
+ * The arithmetic is done in the same order as for a single segment, so the results are the same as
+ * evaluating every segment separately with #evaluate_segment. They can only differ by a few ULPs
+ * if the compiler contracts operations into fused multiply-adds differently for both versions.
+ */
+template<int LanesNum>
+static void evaluate_segments_batch(const Span<float3> positions,
+                                    const Span<float3> handles_left,
+                                    const Span<float3> handles_right,
+                                    const Span<int> evaluated_offsets,
+                                    const Span<int> segments,
+                                    MutableSpan<float3> evaluated_positions)
+{
+  BLI_assert(segments.size() == LanesNum);
+  const int evaluated_num = segment_evaluated_range(evaluated_offsets, segments.first()).size();
+  const float inv_len = 1.0f / static_cast<float>(evaluated_num);
+  const float inv_len_squared = inv_len * inv_len;
+  const float inv_len_cubed = inv_len_squared * inv_len;
+
+  std::array<float3 *, LanesNum> dst;
+  float p0[3][LanesNum], p1[3][LanesNum], p2[3][LanesNum], p3[3][LanesNum];
+  for (const int lane : IndexRange(LanesNum)) {
+    const int point = segments[lane];
+    const int next_point = point == positions.size() - 1 ? 0 : point + 1;
+    BLI_assert(segment_evaluated_range(evaluated_offsets, point).size() == evaluated_num);
+    dst[lane] = &evaluated_positions[segment_evaluated_range(evaluated_offsets, point).first()];
+    for (const int axis : IndexRange(3)) {
+      p0[axis][lane] = positions[point][axis];
+      p1[axis][lane] = handles_right[point][axis];
+      p2[axis][lane] = handles_left[next_point][axis];
+      p3[axis][lane] = positions[next_point][axis];
+    }
+  }
+
+  float q0[3][LanesNum], q1[3][LanesNum], q2[3][LanesNum], q3[3][LanesNum];
+  for (const int axis : IndexRange(3)) {
+    for (const int lane : IndexRange(LanesNum)) {
+      const float rt1 = 3.0f * (p1[axis][lane] - p0[axis][lane]) * inv_len;
+      const float rt2 = 3.0f * (p0[axis][lane] - 2.0f * p1[axis][lane] + p2[axis][lane]) *
+                        inv_len_squared;
+      const float rt3 = (p3[axis][lane] - p0[axis][lane] +
+                         3.0f * (p1[axis][lane] - p2[axis][lane])) *
+                        inv_len_cubed;
+      q0[axis][lane] = p0[axis][lane];
+      q1[axis][lane] = rt1 + rt2 + rt3;
+      q2[axis][lane] = 2.0f * rt2 + 6.0f * rt3;
+      q3[axis][lane] = 6.0f * rt3;
+    }
+  }
+
+  for (const int i : IndexRange(evaluated_num)) {
+    for (const int lane : IndexRange(LanesNum)) {
+      dst[lane][i] = float3(q0[0][lane], q0[1][lane], q0[2][lane]);
+    }
+    for (const int axis : IndexRange(3)) {
+      for (const int lane : IndexRange(LanesNum)) {
+        q0[axis][lane] += q1[axis][lane];
+        q1[axis][lane] += q2[axis][lane];
+        q2[axis][lane] += q3[axis][lane];
+      }
+    }
+  }
+}
+
+/**
+ * Evaluate a group of segments that all have the same number of evaluated points, using the
+ * widest batch size possible, and a scalar fallback for the remaining segments.
+ */
+static void evaluate_segments(const Span<float3> positions,
+                              const Span<float3> handles_left,
+                              const Span<float3> handles_right,
+                              const Span<int> evaluated_offsets,
+                              Span<int> segments,
+                              MutableSpan<float3> evaluated_positions)
+{
+  while (segments.size() >= 8) {
+    evaluate_segments_batch<8>(positions,
+                               handles_left,
+                               handles_right,
+                               evaluated_offsets,
+                               segments.take_front(8),
+                               evaluated_positions);
+    segments = segments.drop_front(8);
+  }
+  if (segments.size() >= 4) {
+    evaluate_segments_batch<4>(positions,
+                               handles_left,
+                               handles_right,
+                               evaluated_offsets,
+                               segments.take_front(4),
+                               evaluated_positions);
+    segments = segments.drop_front(4);
+  }
+  for (const int point : segments) {
+    const int next_point = point == positions.size() - 1 ? 0 : point + 1;
+    evaluate_segment(positions[point],
+                     handles_right[point],
+                     handles_left[next_point],
+                     positions[next_point],
+                     evaluated_positions.slice(segment_evaluated_range(evaluated_offsets, point)));
+  }
+}
+
 void calculate_evaluated_positions(const Span<float3> positions,
                                    const Span<float3> handles_left,
                                    const Span<float3> handles_right,
@@ -243,43 +445,66 @@ void calculate_evaluated_positions(const Span<float3> positions,
     return;
   }
 
-  /* Evaluate the first segment. */
-  evaluate_segment(positions.first(),
-                   handles_right.first(),
-                   handles_left[1],
-                   positions[1],
-                   evaluated_positions.take_front(evaluated_offsets.first()));
-
   /* Give each task fewer segments as the resolution gets larger. */
   const int grain_size = std::max<int>(evaluated_positions.size() / positions.size() * 32, 1);
-  threading::parallel_for(
-      positions.index_range().drop_back(1).drop_front(1), grain_size, [&](IndexRange range) {
-        for (const int i : range) {
-          const IndexRange evaluated_range = offsets_to_range(evaluated_offsets, i - 1);
-          if (evaluated_range.size() == 1) {
-            evaluated_positions[evaluated_range.first()] = positions[i];
-          }
-          else {
-            evaluate_segment(positions[i],
-                             handles_right[i],
-                             handles_left[i + 1],
-                             positions[i + 1],
-                             evaluated_positions.slice(evaluated_range));
-          }
-        }
-      });
+  threading::parallel_for(positions.index_range(), grain_size, [&](IndexRange range) {
+    /* Segments with the same number of evaluated points are gathered to be evaluated together.
+     * Typically that is all segments except for vector segments, which only have one point. */
+    Vector<int, 8> batch;
+    int batch_evaluated_num = 0;
+    for (const int i : range) {
+      const IndexRange evaluated_range = segment_evaluated_range(evaluated_offsets, i);
+      if (evaluated_range.size() == 1) {
+        /* Vector segments and the last point of non-cyclic curves. */
+        evaluated_positions[evaluated_range.first()] = positions[i];
+        continue;
+      }
+      if (batch.size() == 8 || evaluated_range.size() != batch_evaluated_num) {
+        evaluate_segments(
+            positions, handles_left, handles_right, evaluated_offsets, batch, evaluated_positions);
+        batch.clear();
+        batch_evaluated_num = evaluated_range.size();
+      }
+      batch.append(i);
+    }
+    evaluate_segments(
+        positions, handles_left, handles_right, evaluated_offsets, batch, evaluated_positions);
+  });
+}
 
-  /* Evaluate the final cyclic segment if necessary. */
-  const IndexRange last_segment_points = offsets_to_range(evaluated_offsets, positions.size() - 2);
-  if (last_segment_points.size() == 1) {
-    evaluated_positions.last() = positions.last();
+void calculate_evaluated_lengths_precise(const Span<float3> positions,
+                                         const Span<float3> handles_left,
+                                         const Span<float3> handles_right,
+                                         const Span<int> evaluated_offsets,
+                                         const bool cyclic,
+                                         MutableSpan<float> lengths)
+{
+  BLI_assert(lengths.size() == segments_num(evaluated_offsets.last(), cyclic));
+  if (evaluated_offsets.last() == 1) {
+    lengths.fill(0.0f);
+    return;
   }
-  else {
-    evaluate_segment(positions.last(),
-                     handles_right.last(),
-                     handles_left.first(),
-                     positions.first(),
-                     evaluated_positions.slice(last_segment_points));
+
+  float length = 0.0f;
+  for (const int i : IndexRange(segments_num(positions.size(), cyclic))) {
+    const int next = i == positions.size() - 1 ? 0 : i + 1;
+    /* Coefficients of the segment's derivative, a quadratic polynomial. */
+    const float3 &point_0 = positions[i];
+    const float3 &point_1 = handles_right[i];
+    const float3 &point_2 = handles_left[next];
+    const float3 &point_3 = positions[next];
+    const float3 c0 = 3.0f * (point_1 - point_0);
+    const float3 c1 = 6.0f * (point_0 - 2.0f * point_1 + point_2);
+    const float3 c2 = 3.0f * (point_3 - point_0 + 3.0f * (point_1 - point_2));
+    auto derivative_fn = [&](const float t) { return c0 + t * (c1 + t * c2); };
+
+    /* Each evaluated edge covers an equal part of the segment's parameter range. */
+    const IndexRange evaluated_range = segment_evaluated_range(evaluated_offsets, i);
+    const float step = 1.0f / float(evaluated_range.size());
+    for (const int j : IndexRange(evaluated_range.size())) {
+      length += length_parameterize::integrate_length(derivative_fn, j * step, (j + 1) * step);
+      lengths[evaluated_range[j]] = length;
+    }
   }
 }
 
@@ -0,0 +1,244 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/** \file
+ * \ingroup bke
+ */
+
+#include "BLI_length_parameterize.hh"
+
+#include "BKE_curves.hh"
+
+#include "testing/testing.h"
+
+namespace blender::bke::curves::bezier::tests {
+
+static void create_test_curve(const int points_num,
+                              MutableSpan<float3> positions,
+                              MutableSpan<float3> handles_left,
+                              MutableSpan<float3> handles_right)
+{
+  for (const int i : IndexRange(points_num)) {
+    const float angle = float(i) * 0.7f;
+    positions[i] = float3(std::cos(angle) * (1.0f + i), std::sin(angle) * 2.0f, float(i) * 0.3f);
+    handles_left[i] = positions[i] + float3(-0.5f, std::sin(angle * 3.0f), 0.25f * i);
+    handles_right[i] = positions[i] + float3(0.75f, std::cos(angle * 5.0f), -0.1f * i);
+  }
+}
+
+/**
+ * The batched evaluation does the same arithmetic as #evaluate_segment, so the results can only
+ * differ by fused multiply-adds, which skip roundings. Every rounding is at most one ULP of the
+ * largest control point coordinate, because the forward differences are smaller than that. Each
+ * evaluated point adds a few operations to the accumulated value, so allow four ULPs of the
+ * largest coordinate per evaluated point of the segment. An absolute tolerance would be smaller
+ * than one ULP for larger coordinates.
+ */
+static float segment_tolerance(const float3 &point_0,
+                               const float3 &point_1,
+                               const float3 &point_2,
+                               const float3 &point_3,
+                               const int evaluated_num)
+{
+  float max_coordinate = 0.0f;
+  for (const float3 &point : {point_0, point_1, point_2, point_3}) {
+    for (const int axis : IndexRange(3)) {
+      max_coordinate = std::max(max_coordinate, std::abs(point[axis]));
+    }
+  }
+  return max_coordinate * FLT_EPSILON * 4.0f * float(evaluated_num);
+}
+
+/**
+ * Evaluating whole curves processes segments in batches. Check that the results are the same as
+ * evaluating every segment separately, for different numbers of segments (to cover full batches
+ * and the scalar fallback) and with vector segments that break up batches.
+ */
+TEST(curves_bezier, EvaluatedPositionsMatchSingleSegments)
+{
+  for (const int points_num : IndexRange(2, 20)) {
+    for (const bool cyclic : {false, true}) {
+      Array<float3> positions(points_num);
+      Array<float3> handles_left(points_num);
+      Array<float3> handles_right(points_num);
+      create_test_curve(points_num, positions, handles_left, handles_right);
+
+      Array<int8_t> types_left(points_num, BEZIER_HANDLE_FREE);
+      Array<int8_t> types_right(points_num, BEZIER_HANDLE_FREE);
+      if (points_num > 6) {
+        types_right[5] = BEZIER_HANDLE_VECTOR;
+        types_left[6] = BEZIER_HANDLE_VECTOR;
+      }
+
+      const int resolution = 7;
+      Array<int> evaluated_offsets(points_num);
+      calculate_evaluated_offsets(types_left, types_right, cyclic, resolution, evaluated_offsets);
+
+      Array<float3> evaluated_positions(evaluated_offsets.last());
+      calculate_evaluated_positions(
+          positions, handles_left, handles_right, evaluated_offsets, evaluated_positions);
+
+      const int segments_num = curves::segments_num(points_num, cyclic);
+      for (const int i : IndexRange(segments_num)) {
+        const int start = i == 0 ? 0 : evaluated_offsets[i - 1];
+        const IndexRange range(start, evaluated_offsets[i] - start);
+        if (range.size() == 1) {
+          EXPECT_EQ(evaluated_positions[range.first()], positions[i]);
+          continue;
+        }
+        const int next = (i + 1) % points_num;
+        Array<float3> expected(range.size());
+        evaluate_segment(
+            positions[i], handles_right[i], handles_left[next], positions[next], expected);
+        const float tolerance = segment_tolerance(
+            positions[i], handles_right[i], handles_left[next], positions[next], range.size());
+        for (const int j : expected.index_range()) {
+          EXPECT_V3_NEAR(evaluated_positions[range[j]], expected[j], tolerance);
+        }
+      }
+      if (!cyclic) {
+        EXPECT_EQ(evaluated_positions.last(), positions.last());
+      }
+    }
+  }
+}
+
+TEST(curves_bezier, EvaluatedPositionsManySegments)
+{
+  /* Enough segments to be split into multiple tasks. */
+  const int points_num = 1000;
+  Array<float3> positions(points_num);
+  Array<float3> handles_left(points_num);
+  Array<float3> handles_right(points_num);
+  create_test_curve(points_num, positions, handles_left, handles_right);
+
+  Array<int8_t> types(points_num, BEZIER_HANDLE_ALIGN);
+  Array<int> evaluated_offsets(points_num);
+  calculate_evaluated_offsets(types, types, true, 12, evaluated_offsets);
+  EXPECT_EQ(evaluated_offsets.last(), points_num * 12);
+
+  Array<float3> evaluated_positions(evaluated_offsets.last());
+  calculate_evaluated_positions(
+      positions, handles_left, handles_right, evaluated_offsets, evaluated_positions);
+
+  Array<float3> expected(12);
+  for (const int i : IndexRange(points_num)) {
+    const int next = (i + 1) % points_num;
+    evaluate_segment(
+        positions[i], handles_right[i], handles_left[next], positions[next], expected);
+    const float tolerance = segment_tolerance(
+        positions[i], handles_right[i], handles_left[next], positions[next], 12);
+    for (const int j : expected.index_range()) {
+      EXPECT_V3_NEAR(evaluated_positions[i * 12 + j], expected[j], tolerance);
+    }
+  }
+}
+
+/**
+ * The precise lengths shouldn't depend on the resolution, so compare them to the lengths of a
+ * curve with a much higher resolution, at the evaluated points that both curves have in common.
+ * The accumulated lengths of the dense curve have a small relative error because of the many
+ * edges.
+ */
+TEST(curves_bezier, EvaluatedLengthsPrecise)
+{
+  const int points_num = 6;
+  for (const bool cyclic : {false, true}) {
+    Array<float3> positions(points_num);
+    Array<float3> handles_left(points_num);
+    Array<float3> handles_right(points_num);
+    create_test_curve(points_num, positions, handles_left, handles_right);
+
+    Array<int8_t> types_left(points_num, BEZIER_HANDLE_FREE);
+    Array<int8_t> types_right(points_num, BEZIER_HANDLE_FREE);
+    types_right[2] = BEZIER_HANDLE_VECTOR;
+    types_left[3] = BEZIER_HANDLE_VECTOR;
+    handles_right[2] = calculate_vector_handle(positions[2], positions[3]);
+    handles_left[3] = calculate_vector_handle(positions[3], positions[2]);
+
+    const int resolution = 3;
+    Array<int> evaluated_offsets(points_num);
+    calculate_evaluated_offsets(types_left, types_right, cyclic, resolution, evaluated_offsets);
+    Array<float> lengths(curves::segments_num(evaluated_offsets.last(), cyclic));
+    calculate_evaluated_lengths_precise(
+        positions, handles_left, handles_right, evaluated_offsets, cyclic, lengths);
+
+    const int dense_factor = 1000;
+    Array<int> dense_offsets(points_num);
+    calculate_evaluated_offsets(
+        types_left, types_right, cyclic, resolution * dense_factor, dense_offsets);
+    Array<float3> dense_positions(dense_offsets.last());
+    calculate_evaluated_positions(
+        positions, handles_left, handles_right, dense_offsets, dense_positions);
+    Array<float> dense_lengths(curves::segments_num(dense_offsets.last(), cyclic));
+    length_parameterize::accumulate_lengths<float3>(dense_positions, cyclic, dense_lengths);
+
+    for (const int i : IndexRange(curves::segments_num(points_num, cyclic))) {
+      const int start = i == 0 ? 0 : evaluated_offsets[i - 1];
+      const int dense_start = i == 0 ? 0 : dense_offsets[i - 1];
+      const int size = evaluated_offsets[i] - start;
+      const int dense_size = dense_offsets[i] - dense_start;
+      for (const int j : IndexRange(size)) {
+        const int dense_index = dense_start + (j + 1) * dense_size / size - 1;
+        const float dense_length = dense_lengths[dense_index];
+        EXPECT_NEAR(lengths[start + j], dense_length, dense_length * 5e-5f);
+      }
+    }
+  }
+}
+
+TEST(curves_bezier, EvaluatedOffsetsAdaptive)
+{
+  /* The first segment is a straight line, the second is curved. */
+  const Array<float3> positions{{{0, 0, 0}, {3, 0, 0}, {3, 3, 0}}};
+  const Array<float3> handles_left{{{-1, 0, 0}, {2, 0, 0}, {3, 2, 0}}};
+  const Array<float3> handles_right{{{1, 0, 0}, {4, 0, 0}, {3, 4, 0}}};
+  const Array<int8_t> handle_types(3, BEZIER_HANDLE_FREE);
+
+  Array<int> offsets(3);
+  calculate_evaluated_offsets_adaptive(positions,
+                                       handles_left,
+                                       handles_right,
+                                       handle_types,
+                                       handle_types,
+                                       false,
+                                       64,
+                                       0.01f,
+                                       offsets);
+  EXPECT_EQ(offsets[0], 1);
+  EXPECT_GT(offsets[1] - offsets[0], 1);
+  EXPECT_LT(offsets[1] - offsets[0], 64);
+  EXPECT_EQ(offsets[2], offsets[1] + 1);
+
+  /* A larger tolerance never needs more points. */
+  Array<int> offsets_coarse(3);
+  calculate_evaluated_offsets_adaptive(positions,
+                                       handles_left,
+                                       handles_right,
+                                       handle_types,
+                                       handle_types,
+                                       false,
+                                       64,
+                                       0.1f,
+                                       offsets_coarse);
+  EXPECT_LE(offsets_coarse[1], offsets[1]);
+
+  /* The evaluated positions stay within the tolerance of a dense evaluation. */
+  Array<float3> evaluated_positions(offsets.last());
+  calculate_evaluated_positions(
+      positions, handles_left, handles_right, offsets, evaluated_positions);
+  const int edges_num = offsets[1] - offsets[0];
+  const int dense_factor = 16;
+  Array<float3> dense_positions(edges_num * dense_factor);
+  evaluate_segment(
+      positions[1], handles_right[1], handles_left[2], positions[2], dense_positions);
+  for (const int i : dense_positions.index_range()) {
+    const int edge = i / dense_factor;
+    const float factor = float(i % dense_factor) / dense_factor;
+    const float3 linear = math::interpolate(evaluated_positions[offsets[0] + edge],
+                                            evaluated_positions[offsets[0] + edge + 1],
+                                            factor);
+    EXPECT_LT(math::distance(dense_positions[i], linear), 0.01f);
+  }
+}
+
+}  // namespace blender::bke::curves::bezier::tests
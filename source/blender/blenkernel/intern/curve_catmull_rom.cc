@@ -16,6 +16,42 @@ int calculate_evaluated_num(const int points_num, const bool cyclic, const int r
   return cyclic ? eval_num : eval_num + 1;
 }
 
+int calculate_resolution_for_tolerance(const Span<float3> positions,
+                                       const bool cyclic,
+                                       const int resolution,
+                                       const float tolerance)
+{
+  /* Curves with one or two points are evaluated as a point or straight lines. */
+  if (positions.size() <= 2) {
+    return 1;
+  }
+  const int last_index = positions.size() - 1;
+  const auto point = [&](const int index) -> const float3 & {
+    if (cyclic) {
+      return positions[(index + positions.size()) % positions.size()];
+    }
+    return positions[std::clamp(index, 0, last_index)];
+  };
+
+  int result = 1;
+  for (const int i : IndexRange(segments_num(positions.size(), cyclic))) {
+    /* Each segment is a cubic Bezier segment with these control points. */
+    const float3 &a = point(i - 1);
+    const float3 &b = point(i);
+    const float3 &c = point(i + 1);
+    const float3 &d = point(i + 2);
+    const float3 handle_b = b + (c - a) / 6.0f;
+    const float3 handle_c = c - (d - b) / 6.0f;
+    result = std::max(result,
+                      bezier::segment_resolution_for_tolerance(
+                          b, handle_b, handle_c, c, resolution, tolerance));
+    if (result == resolution) {
+      break;
+    }
+  }
+  return result;
+}
+
 /* Adapted from Cycles #catmull_rom_basis_eval function. */
 void calculate_basis(const float parameter, float4 &r_weights)
 {
@@ -4,6 +4,11 @@
  * \ingroup bke
  */
 
+#include <algorithm>
+#include <mutex>
+
+#include "BLI_length_parameterize.hh"
+#include "BLI_map.hh"
 #include "BLI_task.hh"
 
 #include "BKE_attribute_math.hh"
@@ -42,6 +47,31 @@ int calculate_evaluated_num(const int points_num,
   return resolution * segments_num(points_num, cyclic);
 }
 
+int calculate_resolution_for_tolerance(const Span<float3> positions,
+                                       const int8_t order,
+                                       const bool cyclic,
+                                       const int resolution,
+                                       const float tolerance)
+{
+  const int degree = order - 1;
+  if (degree < 2 || positions.size() < 3) {
+    /* Linear curves are evaluated exactly by their control polygon. */
+    return 1;
+  }
+  /* With unit knot spacing, the second derivative is a B-spline of lower degree whose control
+   * points are the second differences of the control points, so it is bounded by them. */
+  const int size = positions.size();
+  const int differences_num = cyclic ? size : size - 2;
+  float second_derivative_max = 0.0f;
+  for (const int i : IndexRange(differences_num)) {
+    const float3 &a = positions[i];
+    const float3 &b = positions[(i + 1) % size];
+    const float3 &c = positions[(i + 2) % size];
+    second_derivative_max = std::max(second_derivative_max, math::length(a - 2.0f * b + c));
+  }
+  return resolution_for_tolerance(second_derivative_max, resolution, tolerance);
+}
+
 int knots_num(const int points_num, const int8_t order, const bool cyclic)
 {
   if (cyclic) {
@@ -185,6 +215,82 @@ void calculate_basis_cache(const int points_num,
   }
 }
 
+uint64_t BasisCacheKey::hash() const
+{
+  return get_default_hash_4(points_num, resolution, order, get_default_hash_2(cyclic, knots_mode));
+}
+
+bool operator==(const BasisCacheKey &a, const BasisCacheKey &b)
+{
+  return a.points_num == b.points_num && a.resolution == b.resolution && a.order == b.order &&
+         a.cyclic == b.cyclic && a.knots_mode == b.knots_mode;
+}
+
+static void calculate_basis_cache_for_key(const BasisCacheKey &key, BasisCache &basis_cache)
+{
+  if (!check_valid_num_and_order(key.points_num, key.order, key.cyclic, key.knots_mode)) {
+    basis_cache.invalid = true;
+    return;
+  }
+  const int evaluated_num = calculate_evaluated_num(
+      key.points_num, key.order, key.cyclic, key.resolution, key.knots_mode);
+  Array<float> knots(knots_num(key.points_num, key.order, key.cyclic));
+  calculate_knots(key.points_num, key.knots_mode, key.order, key.cyclic, knots);
+  calculate_basis_cache(key.points_num, evaluated_num, key.order, key.cyclic, knots, basis_cache);
+}
+
+/**
+ * Process-wide storage of basis caches, shared by all curves geometries. Caches that aren't used
+ * by any geometry anymore are only freed when the registry grows beyond a threshold, in order to
+ * allow reuse when the same curves are evaluated again.
+ */
+struct BasisCacheRegistry {
+  std::mutex mutex;
+  Map<BasisCacheKey, std::shared_ptr<const BasisCache>> caches;
+  int64_t trim_threshold = 256;
+
+  void remove_unused()
+  {
+    for (auto it = caches.items().begin(); it != caches.items().end(); ++it) {
+      if ((*it).value.use_count() == 1) {
+        caches.remove(it);
+      }
+    }
+  }
+};
+
+static BasisCacheRegistry &get_basis_cache_registry()
+{
+  static BasisCacheRegistry registry;
+  return registry;
+}
+
+std::shared_ptr<const BasisCache> get_shared_basis_cache(const BasisCacheKey &key)
+{
+  BasisCacheRegistry &registry = get_basis_cache_registry();
+  {
+    std::scoped_lock lock{registry.mutex};
+    if (const std::shared_ptr<const BasisCache> *cache = registry.caches.lookup_ptr(key)) {
+      return *cache;
+    }
+  }
+
+  /* Calculate the cache without holding the lock, so that other threads can still retrieve
+   * existing caches in the mean time. */
+  std::shared_ptr<BasisCache> new_cache = std::make_shared<BasisCache>();
+  calculate_basis_cache_for_key(key, *new_cache);
+
+  std::scoped_lock lock{registry.mutex};
+  /* Another thread may have added a cache for the same key already. */
+  std::shared_ptr<const BasisCache> cache = registry.caches.lookup_or_add(key,
+                                                                          std::move(new_cache));
+  if (registry.caches.size() > registry.trim_threshold) {
+    registry.remove_unused();
+    registry.trim_threshold = std::max<int64_t>(256, registry.caches.size() * 2);
+  }
+  return cache;
+}
+
 template<typename T>
 static void interpolate_to_evaluated(const BasisCache &basis_cache,
                                      const int8_t order,
@@ -193,7 +299,9 @@ static void interpolate_to_evaluated(const BasisCache &basis_cache,
 {
   attribute_math::DefaultMixer<T> mixer{dst};
 
-  threading::parallel_for(dst.index_range(), 128, [&](const IndexRange range) {
+  /* The cost per point depends on the order and the type. */
+  static threading::AdaptiveGrainSize grain_size;
+  threading::parallel_for_adaptive(dst.index_range(), grain_size, [&](const IndexRange range) {
     for (const int i : range) {
       Span<float> point_weights = basis_cache.weights.as_span().slice(i * order, order);
       for (const int j : point_weights.index_range()) {
@@ -214,7 +322,8 @@ static void interpolate_to_evaluated_rational(const BasisCache &basis_cache,
 {
   attribute_math::DefaultMixer<T> mixer{dst};
 
-  threading::parallel_for(dst.index_range(), 128, [&](const IndexRange range) {
+  static threading::AdaptiveGrainSize grain_size;
+  threading::parallel_for_adaptive(dst.index_range(), grain_size, [&](const IndexRange range) {
     for (const int i : range) {
       Span<float> point_weights = basis_cache.weights.as_span().slice(i * order, order);
 
@@ -228,30 +337,417 @@ static void interpolate_to_evaluated_rational(const BasisCache &basis_cache,
   });
 }
 
+/**
+ * A version of #interpolate_to_evaluated for floating point types that writes the result directly
+ * instead of using a mixer. When #Order isn't zero, it is the order of the curve known at compile
+ * time, so that the loop over the control points can be unrolled. The control point indices only
+ * have to wrap around for cyclic curves.
+ */
+template<typename T, int Order, bool Rational, bool Wrap>
+static void interpolate_to_evaluated_float(const BasisCache &basis_cache,
+                                           const int8_t order,
+                                           const Span<float> control_weights,
+                                           const Span<T> src,
+                                           MutableSpan<T> dst)
+{
+  const int order_num = Order == 0 ? order : Order;
+  const Span<float> basis_weights = basis_cache.weights;
+  const Span<int> start_indices = basis_cache.start_indices;
+  const int src_size = src.size();
+
+  static threading::AdaptiveGrainSize grain_size;
+  threading::parallel_for_adaptive(dst.index_range(), grain_size, [&](const IndexRange range) {
+    for (const int i : range) {
+      const float *point_weights = &basis_weights[i * order_num];
+      const int start = start_indices[i];
+      T value(0.0f);
+      float total_weight = 0.0f;
+      for (int j = 0; j < order_num; j++) {
+        const int point_index = Wrap ? (start + j) % src_size : start + j;
+        if constexpr (Rational) {
+          const float weight = point_weights[j] * control_weights[point_index];
+          value += src[point_index] * weight;
+          total_weight += weight;
+        }
+        else {
+          value += src[point_index] * point_weights[j];
+        }
+      }
+      if constexpr (Rational) {
+        if (total_weight > 0.0f) {
+          value *= 1.0f / total_weight;
+        }
+      }
+      dst[i] = value;
+    }
+  });
+}
+
+template<typename T, int Order>
+static void interpolate_to_evaluated_float(const BasisCache &basis_cache,
+                                           const int8_t order,
+                                           const Span<float> control_weights,
+                                           const Span<T> src,
+                                           MutableSpan<T> dst)
+{
+  /* The start indices are sorted, so only the last evaluated point has to be checked. */
+  const bool wrap = basis_cache.start_indices.last() + order > src.size();
+  if (control_weights.is_empty()) {
+    if (wrap) {
+      interpolate_to_evaluated_float<T, Order, false, true>(
+          basis_cache, order, control_weights, src, dst);
+    }
+    else {
+      interpolate_to_evaluated_float<T, Order, false, false>(
+          basis_cache, order, control_weights, src, dst);
+    }
+  }
+  else {
+    if (wrap) {
+      interpolate_to_evaluated_float<T, Order, true, true>(
+          basis_cache, order, control_weights, src, dst);
+    }
+    else {
+      interpolate_to_evaluated_float<T, Order, true, false>(
+          basis_cache, order, control_weights, src, dst);
+    }
+  }
+}
+
+template<typename T>
+static void interpolate_to_evaluated_typed(const BasisCache &basis_cache,
+                                           const int8_t order,
+                                           const Span<float> control_weights,
+                                           const Span<T> src,
+                                           MutableSpan<T> dst)
+{
+  if (basis_cache.invalid) {
+    dst.copy_from(src);
+    return;
+  }
+  BLI_assert(dst.size() == basis_cache.start_indices.size());
+  if (dst.is_empty()) {
+    return;
+  }
+
+  if constexpr (is_same_any_v<T, float, float2, float3>) {
+    switch (order) {
+      case 2:
+        interpolate_to_evaluated_float<T, 2>(basis_cache, order, control_weights, src, dst);
+        break;
+      case 3:
+        interpolate_to_evaluated_float<T, 3>(basis_cache, order, control_weights, src, dst);
+        break;
+      case 4:
+        interpolate_to_evaluated_float<T, 4>(basis_cache, order, control_weights, src, dst);
+        break;
+      case 5:
+        interpolate_to_evaluated_float<T, 5>(basis_cache, order, control_weights, src, dst);
+        break;
+      case 6:
+        interpolate_to_evaluated_float<T, 6>(basis_cache, order, control_weights, src, dst);
+        break;
+      default:
+        interpolate_to_evaluated_float<T, 0>(basis_cache, order, control_weights, src, dst);
+        break;
+    }
+  }
+  else if constexpr (!std::is_void_v<attribute_math::DefaultMixer<T>>) {
+    if (control_weights.is_empty()) {
+      interpolate_to_evaluated(basis_cache, order, src, dst);
+    }
+    else {
+      interpolate_to_evaluated_rational(basis_cache, order, control_weights, src, dst);
+    }
+  }
+}
+
 void interpolate_to_evaluated(const BasisCache &basis_cache,
                               const int8_t order,
                               const Span<float> control_weights,
                               const GSpan src,
                               GMutableSpan dst)
 {
-  if (basis_cache.invalid) {
-    dst.copy_from(src);
-    return;
-  }
+  attribute_math::convert_to_static_type(src.type(), [&](auto dummy) {
+    using T = decltype(dummy);
+    interpolate_to_evaluated_typed(
+        basis_cache, order, control_weights, src.typed<T>(), dst.typed<T>());
+  });
+}
 
-  BLI_assert(dst.size() == basis_cache.start_indices.size());
+void interpolate_to_evaluated(const Span<const BasisCache *> basis_caches,
+                              const VArray<int8_t> &orders,
+                              const Span<float> control_weights,
+                              const Span<int> points_offsets,
+                              const Span<int> evaluated_offsets,
+                              const IndexMask selection,
+                              const GSpan src,
+                              GMutableSpan dst)
+{
   attribute_math::convert_to_static_type(src.type(), [&](auto dummy) {
     using T = decltype(dummy);
-    if constexpr (!std::is_void_v<attribute_math::DefaultMixer<T>>) {
-      if (control_weights.is_empty()) {
-        interpolate_to_evaluated(basis_cache, order, src.typed<T>(), dst.typed<T>());
+    const Span<T> src_typed = src.typed<T>();
+    MutableSpan<T> dst_typed = dst.typed<T>();
+    /* Long curves are still split between threads by the loop for a single curve. */
+    threading::parallel_for(selection.index_range(), 128, [&](const IndexRange range) {
+      for (const int curve_index : selection.slice(range)) {
+        const IndexRange points = offsets_to_range(points_offsets, curve_index);
+        const IndexRange evaluated_points = offsets_to_range(evaluated_offsets, curve_index);
+        interpolate_to_evaluated_typed(
+            *basis_caches[curve_index],
+            orders[curve_index],
+            control_weights.is_empty() ? control_weights : control_weights.slice(points),
+            src_typed.slice(points),
+            dst_typed.slice(evaluated_points));
       }
-      else {
-        interpolate_to_evaluated_rational(
-            basis_cache, order, control_weights, src.typed<T>(), dst.typed<T>());
+    });
+  });
+}
+
+/**
+ * Find the knot span that contains the parameter, meaning `knots[span] <= parameter <
+ * knots[span + 1]`. Empty spans are skipped, and the last span is used for the end of the curve.
+ */
+static int find_knot_span(const Span<float> knots,
+                          const int degree,
+                          const int last_control_point_index,
+                          const float parameter)
+{
+  const float *knots_end = knots.data() + last_control_point_index;
+  int span = std::upper_bound(knots.data() + degree, knots_end, parameter) - knots.data() - 1;
+  span = std::clamp(span, degree, last_control_point_index - 1);
+  while (span > degree && knots[span] == knots[span + 1]) {
+    span--;
+  }
+  return span;
+}
+
+/**
+ * Calculate the values and the first derivatives of the `degree + 1` basis functions that are
+ * non-zero in the knot span, based on algorithms A2.2 and A2.3 from "The NURBS Book".
+ */
+static void calculate_basis_and_derivatives(const float parameter,
+                                            const int span,
+                                            const int degree,
+                                            const Span<float> knots,
+                                            MutableSpan<float> r_basis,
+                                            MutableSpan<float> r_derivatives)
+{
+  const int order = degree + 1;
+  Array<float, 12> left(order);
+  Array<float, 12> right(order);
+  /* The basis functions of one degree lower, which define the derivatives. */
+  Array<float, 12> lower(order, 0.0f);
+
+  r_basis.first() = 1.0f;
+  for (const int j : IndexRange(1, degree)) {
+    if (j == degree) {
+      lower.as_mutable_span().take_front(degree).copy_from(r_basis.take_front(degree));
+    }
+    left[j] = parameter - knots[span + 1 - j];
+    right[j] = knots[span + j] - parameter;
+    float saved = 0.0f;
+    for (const int r : IndexRange(j)) {
+      const float temp = r_basis[r] / (right[r + 1] + left[j - r]);
+      r_basis[r] = saved + right[r + 1] * temp;
+      saved = left[j - r] * temp;
+    }
+    r_basis[j] = saved;
+  }
+
+  const int start = span - degree;
+  for (const int r : IndexRange(order)) {
+    float derivative = 0.0f;
+    if (r > 0) {
+      const float knots_delta = knots[start + r + degree] - knots[start + r];
+      if (knots_delta > 0.0f) {
+        derivative += lower[r - 1] / knots_delta;
       }
     }
-  });
+    if (r < degree) {
+      const float knots_delta = knots[start + r + 1 + degree] - knots[start + r + 1];
+      if (knots_delta > 0.0f) {
+        derivative -= lower[r] / knots_delta;
+      }
+    }
+    r_derivatives[r] = degree * derivative;
+  }
+}
+
+/**
+ * Calculate the curve's position and its derivative at the parameter, which must be in the span.
+ */
+static void calculate_position_and_derivative(const Span<float3> positions,
+                                              const Span<float> control_weights,
+                                              const int degree,
+                                              const Span<float> knots,
+                                              const int span,
+                                              const float parameter,
+                                              MutableSpan<float> basis,
+                                              MutableSpan<float> derivatives,
+                                              float3 &r_position,
+                                              float3 &r_derivative)
+{
+  calculate_basis_and_derivatives(parameter, span, degree, knots, basis, derivatives);
+  const int start = span - degree;
+
+  float3 position(0.0f);
+  float3 position_derivative(0.0f);
+  if (control_weights.is_empty()) {
+    for (const int i : basis.index_range()) {
+      const float3 &point = positions[(start + i) % positions.size()];
+      position += basis[i] * point;
+      position_derivative += derivatives[i] * point;
+    }
+    r_position = position;
+    r_derivative = position_derivative;
+    return;
+  }
+
+  /* Quotient rule for the rational curve. */
+  float weight = 0.0f;
+  float weight_derivative = 0.0f;
+  for (const int i : basis.index_range()) {
+    const int point = (start + i) % positions.size();
+    const float control_weight = control_weights[point];
+    position += basis[i] * control_weight * positions[point];
+    position_derivative += derivatives[i] * control_weight * positions[point];
+    weight += basis[i] * control_weight;
+    weight_derivative += derivatives[i] * control_weight;
+  }
+  if (weight == 0.0f) {
+    r_position = float3(0.0f);
+    r_derivative = float3(0.0f);
+    return;
+  }
+  r_position = position / weight;
+  r_derivative = (position_derivative - position * (weight_derivative / weight)) / weight;
+}
+
+/**
+ * Calculate the derivative of the curve's position at the parameter, which must be in the span.
+ */
+static float3 calculate_derivative(const Span<float3> positions,
+                                   const Span<float> control_weights,
+                                   const int degree,
+                                   const Span<float> knots,
+                                   const int span,
+                                   const float parameter,
+                                   MutableSpan<float> basis,
+                                   MutableSpan<float> derivatives)
+{
+  float3 position;
+  float3 derivative;
+  calculate_position_and_derivative(positions,
+                                    control_weights,
+                                    degree,
+                                    knots,
+                                    span,
+                                    parameter,
+                                    basis,
+                                    derivatives,
+                                    position,
+                                    derivative);
+  return derivative;
+}
+
+void evaluate_at_evaluated_parameter(const Span<float3> positions,
+                                     const Span<float> control_weights,
+                                     const int8_t order,
+                                     const bool cyclic,
+                                     const int evaluated_num,
+                                     const Span<float> knots,
+                                     const float evaluated_parameter,
+                                     float3 &r_position,
+                                     float3 &r_derivative)
+{
+  const int degree = order - 1;
+  const int last_control_point_index = cyclic ? positions.size() + degree : positions.size();
+  const float start = knots[degree];
+  const float end = knots[last_control_point_index];
+  /* The same evenly spaced parameters as #calculate_basis_cache. */
+  const float step = (end - start) / segments_num(evaluated_num, cyclic);
+  const float parameter = std::clamp(start + step * evaluated_parameter, start, end);
+
+  Array<float, 12> basis(order);
+  Array<float, 12> derivatives(order);
+  const int span = find_knot_span(knots, degree, last_control_point_index, parameter);
+  calculate_position_and_derivative(positions,
+                                    control_weights,
+                                    degree,
+                                    knots,
+                                    span,
+                                    parameter,
+                                    basis,
+                                    derivatives,
+                                    r_position,
+                                    r_derivative);
+  r_derivative *= step;
+}
+
+void calculate_evaluated_lengths_precise(const Span<float3> positions,
+                                         const Span<float> control_weights,
+                                         const int8_t order,
+                                         const bool cyclic,
+                                         const int resolution,
+                                         const KnotsMode knots_mode,
+                                         MutableSpan<float> lengths)
+{
+  const int points_num = positions.size();
+  if (!check_valid_num_and_order(points_num, order, cyclic, knots_mode)) {
+    /* The evaluated points are just the control points in this case. */
+    length_parameterize::accumulate_lengths<float3>(positions, cyclic, lengths);
+    return;
+  }
+  const int evaluated_num = calculate_evaluated_num(
+      points_num, order, cyclic, resolution, knots_mode);
+  BLI_assert(lengths.size() == segments_num(evaluated_num, cyclic));
+  UNUSED_VARS_NDEBUG(evaluated_num);
+  if (lengths.is_empty()) {
+    return;
+  }
+
+  Array<float> knots(knots_num(points_num, order, cyclic));
+  calculate_knots(points_num, knots_mode, order, cyclic, knots);
+
+  const int degree = order - 1;
+  const int last_control_point_index = cyclic ? points_num + degree : points_num;
+  const float start = knots[degree];
+  const float end = knots[last_control_point_index];
+  /* Use the same evenly spaced parameters for the evaluated points as #calculate_basis_cache. */
+  const float step = (end - start) / lengths.size();
+
+  Array<float, 12> basis(order);
+  Array<float, 12> derivatives(order);
+
+  float length = 0.0f;
+  for (const int i : lengths.index_range()) {
+    const float edge_start = start + step * i;
+    const float edge_end = i == lengths.size() - 1 ? end : start + step * (i + 1);
+
+    /* The derivative may be discontinuous at knots, so integrate each knot span separately. */
+    int span = find_knot_span(knots, degree, last_control_point_index, edge_start);
+    float span_start = edge_start;
+    while (true) {
+      const float span_end = std::min(edge_end, knots[span + 1]);
+      if (span_end > span_start) {
+        length += length_parameterize::integrate_length(
+            [&](const float parameter) {
+              return calculate_derivative(
+                  positions, control_weights, degree, knots, span, parameter, basis, derivatives);
+            },
+            span_start,
+            span_end);
+      }
+      if (span_end >= edge_end || span + 1 >= last_control_point_index) {
+        break;
+      }
+      span_start = span_end;
+      span++;
+    }
+
+    lengths[i] = length;
+  }
 }
 
 }  // namespace blender::bke::curves::nurbs
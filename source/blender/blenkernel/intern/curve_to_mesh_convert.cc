@@ -1,8 +1,7 @@
 /* SPDX-License-Identifier: GPL-2.0-or-later */
 
 #include "BLI_array.hh"
-#include "BLI_devirtualize_parameters.hh"
-#include "BLI_set.hh"
+#include "BLI_enumerable_thread_specific.hh"
 #include "BLI_task.hh"
 
 #include "DNA_mesh_types.h"
@@ -349,20 +348,6 @@ static bool should_add_attribute_to_mesh(const AttributeAccessor &curve_attribut
   return true;
 }
 
-static GSpan evaluated_attribute_if_necessary(const GVArray &src,
-                                              const CurvesGeometry &curves,
-                                              const std::array<int, CURVE_TYPES_NUM> &type_counts,
-                                              Vector<std::byte> &buffer)
-{
-  if (type_counts[CURVE_TYPE_POLY] == curves.curves_num() && src.is_span()) {
-    return src.get_internal_span();
-  }
-  buffer.reinitialize(curves.evaluated_points_num() * src.type().size());
-  GMutableSpan eval{src.type(), buffer.data(), curves.evaluated_points_num()};
-  curves.interpolate_to_evaluated(src.get_internal_span(), eval);
-  return eval;
-}
-
 /** Information at a specific combination of main and profile curves. */
 struct CombinationInfo {
   int i_main;
@@ -382,26 +367,21 @@ struct CombinationInfo {
   IndexRange poly_range;
   IndexRange loop_range;
 };
-template<typename Fn>
-static void foreach_curve_combination(const CurvesInfo &info,
-                                      const ResultOffsets &offsets,
-                                      const Fn &fn)
+static CombinationInfo get_combination_info(const CurvesInfo &info,
+                                            const ResultOffsets &offsets,
+                                            const int i)
 {
-  threading::parallel_for(IndexRange(offsets.total), 512, [&](IndexRange range) {
-    for (const int i : range) {
-      const int i_main = offsets.main_indices[i];
-      const int i_profile = offsets.profile_indices[i];
+  const int i_main = offsets.main_indices[i];
+  const int i_profile = offsets.profile_indices[i];
 
-      const IndexRange main_points = info.main.evaluated_points_for_curve(i_main);
-      const IndexRange profile_points = info.profile.evaluated_points_for_curve(i_profile);
+  const IndexRange main_points = info.main.evaluated_points_for_curve(i_main);
+  const IndexRange profile_points = info.profile.evaluated_points_for_curve(i_profile);
 
-      const bool main_cyclic = info.main_cyclic[i_main];
-      const bool profile_cyclic = info.profile_cyclic[i_profile];
+  const bool main_cyclic = info.main_cyclic[i_main];
+  const bool profile_cyclic = info.profile_cyclic[i_profile];
 
-      /* Pass all information in a struct to avoid repeating arguments in many lambdas.
-       * The idea is that inlining `fn` will help avoid accessing unnecessary information,
-       * though that may or may not happen in practice. */
-      fn(CombinationInfo{i_main,
+  /* Pass all information in a struct to avoid repeating arguments in many functions. */
+  return CombinationInfo{i_main,
                          i_profile,
                          main_points,
                          profile_points,
@@ -412,9 +392,72 @@ static void foreach_curve_combination(const CurvesInfo &info,
                          offsets_to_range(offsets.vert.as_span(), i),
                          offsets_to_range(offsets.edge.as_span(), i),
                          offsets_to_range(offsets.poly.as_span(), i),
-                         offsets_to_range(offsets.loop.as_span(), i)});
-    }
-  });
+                         offsets_to_range(offsets.loop.as_span(), i)};
+}
+
+/**
+ * Run the function for blocks of curve combinations in parallel. The blocks are small enough that
+ * the result data of a block stays in the CPU cache while it is filled by all of the steps.
+ */
+template<typename Fn>
+static void foreach_curve_combination_block(const ResultOffsets &offsets, const Fn &fn)
+{
+  /* Aim for a few thousand vertices in each block. */
+  const int average_vert_num = std::max(offsets.vert.last() / std::max(offsets.total, 1), 1);
+  const int grain_size = std::clamp(4096 / average_vert_num, 1, 512);
+  threading::parallel_for(IndexRange(offsets.total), grain_size, fn);
+}
+
+/**
+ * An attribute on the main or profile curves that is copied to the result mesh.
+ */
+struct AttributeTransfer {
+  /** True when the attribute comes from the main curves, false for the profile curves. */
+  bool from_main;
+  eAttrDomain src_domain;
+  eAttrDomain dst_domain;
+  /** Values on the original curves. For the point domain, these are control point values. */
+  GVArraySpan src;
+  GSpanAttributeWriter dst;
+};
+
+/**
+ * The evaluated values of a point domain attribute on a single curve. Neighboring combinations
+ * usually share the same main or profile curve, so the values of the last curve are reused. The
+ * buffer is only as large as the largest curve, and is reused for all blocks on the same thread.
+ */
+struct EvaluatedCurveBuffer {
+  int curve_index = -1;
+  Vector<std::byte> buffer;
+};
+
+/** Per-thread state, reused for all blocks processed by a thread. */
+struct SweepThreadData {
+  Vector<CombinationInfo> combinations;
+  /** One buffer for every attribute transfer, and one for the radius. */
+  Array<EvaluatedCurveBuffer> evaluated_buffers;
+};
+
+static GSpan evaluated_point_data_for_curve(const CurvesGeometry &curves,
+                                            const GSpan src,
+                                            const bool all_poly,
+                                            const int curve_index,
+                                            EvaluatedCurveBuffer &r_buffer)
+{
+  const IndexRange evaluated_points = curves.evaluated_points_for_curve(curve_index);
+  if (all_poly) {
+    return src.slice(evaluated_points);
+  }
+  const CPPType &type = src.type();
+  if (r_buffer.curve_index != curve_index) {
+    r_buffer.buffer.resize(evaluated_points.size() * type.size());
+    curves.interpolate_to_evaluated(
+        curve_index,
+        src.slice(curves.points_for_curve(curve_index)),
+        GMutableSpan(type, r_buffer.buffer.data(), evaluated_points.size()));
+    r_buffer.curve_index = curve_index;
+  }
+  return GSpan(type, r_buffer.buffer.data(), evaluated_points.size());
 }
 
 template<typename T>
@@ -454,48 +497,35 @@ static void copy_main_point_data_to_mesh_faces(const Span<T> src,
   }
 }
 
-static void copy_main_point_domain_attribute_to_mesh(const CurvesInfo &curves_info,
-                                                     const ResultOffsets &offsets,
+template<typename T>
+static void copy_main_point_domain_attribute_to_mesh(const CombinationInfo &info,
                                                      const eAttrDomain dst_domain,
-                                                     const GSpan src_all,
-                                                     GMutableSpan dst_all)
+                                                     const Span<T> src,
+                                                     MutableSpan<T> dst)
 {
-  attribute_math::convert_to_static_type(src_all.type(), [&](auto dummy) {
-    using T = decltype(dummy);
-    const Span<T> src = src_all.typed<T>();
-    MutableSpan<T> dst = dst_all.typed<T>();
-    switch (dst_domain) {
-      case ATTR_DOMAIN_POINT:
-        foreach_curve_combination(curves_info, offsets, [&](const CombinationInfo &info) {
-          copy_main_point_data_to_mesh_verts(
-              src.slice(info.main_points), info.profile_points.size(), dst.slice(info.vert_range));
-        });
-        break;
-      case ATTR_DOMAIN_EDGE:
-        foreach_curve_combination(curves_info, offsets, [&](const CombinationInfo &info) {
-          copy_main_point_data_to_mesh_edges(src.slice(info.main_points),
-                                             info.profile_points.size(),
-                                             info.main_segment_num,
-                                             info.profile_segment_num,
-                                             dst.slice(info.edge_range));
-        });
-        break;
-      case ATTR_DOMAIN_FACE:
-        foreach_curve_combination(curves_info, offsets, [&](const CombinationInfo &info) {
-          copy_main_point_data_to_mesh_faces(src.slice(info.main_points),
-                                             info.main_segment_num,
-                                             info.profile_segment_num,
-                                             dst.slice(info.poly_range));
-        });
-        break;
-      case ATTR_DOMAIN_CORNER:
-        /* Unsupported for now, since there are no builtin attributes to convert into. */
-        break;
-      default:
-        BLI_assert_unreachable();
-        break;
-    }
-  });
+  switch (dst_domain) {
+    case ATTR_DOMAIN_POINT:
+      copy_main_point_data_to_mesh_verts(
+          src, info.profile_points.size(), dst.slice(info.vert_range));
+      break;
+    case ATTR_DOMAIN_EDGE:
+      copy_main_point_data_to_mesh_edges(src,
+                                         info.profile_points.size(),
+                                         info.main_segment_num,
+                                         info.profile_segment_num,
+                                         dst.slice(info.edge_range));
+      break;
+    case ATTR_DOMAIN_FACE:
+      copy_main_point_data_to_mesh_faces(
+          src, info.main_segment_num, info.profile_segment_num, dst.slice(info.poly_range));
+      break;
+    case ATTR_DOMAIN_CORNER:
+      /* Unsupported for now, since there are no builtin attributes to convert into. */
+      break;
+    default:
+      BLI_assert_unreachable();
+      break;
+  }
 }
 
 template<typename T>
@@ -536,95 +566,131 @@ static void copy_profile_point_data_to_mesh_faces(const Span<T> src,
   }
 }
 
-static void copy_profile_point_domain_attribute_to_mesh(const CurvesInfo &curves_info,
-                                                        const ResultOffsets &offsets,
+template<typename T>
+static void copy_profile_point_domain_attribute_to_mesh(const CombinationInfo &info,
                                                         const eAttrDomain dst_domain,
-                                                        const GSpan src_all,
-                                                        GMutableSpan dst_all)
+                                                        const Span<T> src,
+                                                        MutableSpan<T> dst)
 {
-  attribute_math::convert_to_static_type(src_all.type(), [&](auto dummy) {
-    using T = decltype(dummy);
-    const Span<T> src = src_all.typed<T>();
-    MutableSpan<T> dst = dst_all.typed<T>();
-    switch (dst_domain) {
-      case ATTR_DOMAIN_POINT:
-        foreach_curve_combination(curves_info, offsets, [&](const CombinationInfo &info) {
-          copy_profile_point_data_to_mesh_verts(
-              src.slice(info.profile_points), info.main_points.size(), dst.slice(info.vert_range));
-        });
-        break;
-      case ATTR_DOMAIN_EDGE:
-        foreach_curve_combination(curves_info, offsets, [&](const CombinationInfo &info) {
-          copy_profile_point_data_to_mesh_edges(
-              src.slice(info.profile_points), info.main_segment_num, dst.slice(info.edge_range));
-        });
-        break;
-      case ATTR_DOMAIN_FACE:
-        foreach_curve_combination(curves_info, offsets, [&](const CombinationInfo &info) {
-          copy_profile_point_data_to_mesh_faces(src.slice(info.profile_points),
-                                                info.main_segment_num,
-                                                info.profile_segment_num,
-                                                dst.slice(info.poly_range));
-        });
-        break;
-      case ATTR_DOMAIN_CORNER:
-        /* Unsupported for now, since there are no builtin attributes to convert into. */
-        break;
-      default:
-        BLI_assert_unreachable();
-        break;
-    }
-  });
+  switch (dst_domain) {
+    case ATTR_DOMAIN_POINT:
+      copy_profile_point_data_to_mesh_verts(
+          src, info.main_points.size(), dst.slice(info.vert_range));
+      break;
+    case ATTR_DOMAIN_EDGE:
+      copy_profile_point_data_to_mesh_edges(
+          src, info.main_segment_num, dst.slice(info.edge_range));
+      break;
+    case ATTR_DOMAIN_FACE:
+      copy_profile_point_data_to_mesh_faces(
+          src, info.main_segment_num, info.profile_segment_num, dst.slice(info.poly_range));
+      break;
+    case ATTR_DOMAIN_CORNER:
+      /* Unsupported for now, since there are no builtin attributes to convert into. */
+      break;
+    default:
+      BLI_assert_unreachable();
+      break;
+  }
 }
 
 template<typename T>
-static void copy_indices_to_offset_ranges(const VArray<T> &src,
-                                          const Span<int> curve_indices,
-                                          const Span<int> mesh_offsets,
-                                          MutableSpan<T> dst)
-{
-  /* This unnecessarily instantiates the "is single" case (which should be handled elsewhere if
-   * it's ever used for attributes), but the alternative is duplicating the function for spans and
-   * other virtual arrays. */
-  devirtualize_varray(src, [&](const auto &src) {
-    threading::parallel_for(curve_indices.index_range(), 512, [&](IndexRange range) {
-      for (const int i : range) {
-        dst.slice(offsets_to_range(mesh_offsets, i)).fill(src[curve_indices[i]]);
-      }
-    });
-  });
-}
-
-static void copy_curve_domain_attribute_to_mesh(const ResultOffsets &mesh_offsets,
-                                                const Span<int> curve_indices,
+static void copy_curve_domain_attribute_to_mesh(const CombinationInfo &info,
                                                 const eAttrDomain dst_domain,
-                                                const GVArray &src,
-                                                GMutableSpan dst)
+                                                const T &src,
+                                                MutableSpan<T> dst)
 {
-  Span<int> offsets;
   switch (dst_domain) {
     case ATTR_DOMAIN_POINT:
-      offsets = mesh_offsets.vert;
+      dst.slice(info.vert_range).fill(src);
       break;
     case ATTR_DOMAIN_EDGE:
-      offsets = mesh_offsets.edge;
+      dst.slice(info.edge_range).fill(src);
       break;
     case ATTR_DOMAIN_FACE:
-      offsets = mesh_offsets.poly;
+      dst.slice(info.poly_range).fill(src);
       break;
     case ATTR_DOMAIN_CORNER:
-      offsets = mesh_offsets.loop;
+      dst.slice(info.loop_range).fill(src);
       break;
     default:
       BLI_assert_unreachable();
-      return;
+      break;
   }
-  attribute_math::convert_to_static_type(src.type(), [&](auto dummy) {
+}
+
+static void copy_attribute_to_mesh(const CurvesInfo &curves_info,
+                                   const Span<CombinationInfo> combinations,
+                                   const bool all_poly,
+                                   AttributeTransfer &transfer,
+                                   EvaluatedCurveBuffer &buffer)
+{
+  const CurvesGeometry &curves = transfer.from_main ? curves_info.main : curves_info.profile;
+  attribute_math::convert_to_static_type(transfer.src.type(), [&](auto dummy) {
     using T = decltype(dummy);
-    copy_indices_to_offset_ranges(src.typed<T>(), curve_indices, offsets, dst.typed<T>());
+    const Span<T> src = transfer.src.typed<T>();
+    MutableSpan<T> dst = transfer.dst.span.typed<T>();
+    for (const CombinationInfo &info : combinations) {
+      const int curve_index = transfer.from_main ? info.i_main : info.i_profile;
+      if (transfer.src_domain == ATTR_DOMAIN_CURVE) {
+        copy_curve_domain_attribute_to_mesh(info, transfer.dst_domain, src[curve_index], dst);
+        continue;
+      }
+      const Span<T> evaluated = evaluated_point_data_for_curve(
+                                    curves, transfer.src, all_poly, curve_index, buffer)
+                                    .typed<T>();
+      if (transfer.from_main) {
+        copy_main_point_domain_attribute_to_mesh(info, transfer.dst_domain, evaluated, dst);
+      }
+      else {
+        copy_profile_point_domain_attribute_to_mesh(info, transfer.dst_domain, evaluated, dst);
+      }
+    }
   });
 }
 
+/**
+ * Find the attributes to copy to the mesh and create them, so that they can all be filled in a
+ * single pass together with the topology and positions.
+ */
+static Vector<AttributeTransfer> create_attribute_transfers(
+    const AttributeAccessor &main_attributes,
+    const AttributeAccessor &profile_attributes,
+    MutableAttributeAccessor &mesh_attributes)
+{
+  Vector<AttributeTransfer> transfers;
+  const auto add_transfers = [&](const AttributeAccessor &src_attributes, const bool from_main) {
+    src_attributes.for_all([&](const AttributeIDRef &id, const AttributeMetaData meta_data) {
+      if (!from_main && main_attributes.contains(id)) {
+        return true;
+      }
+      if (!should_add_attribute_to_mesh(src_attributes, mesh_attributes, id)) {
+        return true;
+      }
+      const eAttrDomain src_domain = meta_data.domain;
+      if (!ELEM(src_domain, ATTR_DOMAIN_POINT, ATTR_DOMAIN_CURVE)) {
+        return true;
+      }
+      const eCustomDataType type = meta_data.data_type;
+      const eAttrDomain dst_domain = get_attribute_domain_for_mesh(mesh_attributes, id);
+      GSpanAttributeWriter dst = mesh_attributes.lookup_or_add_for_write_only_span(
+          id, dst_domain, type);
+      if (!dst) {
+        return true;
+      }
+      transfers.append({from_main,
+                        src_domain,
+                        dst_domain,
+                        GVArraySpan(src_attributes.lookup(id, src_domain, type)),
+                        std::move(dst)});
+      return true;
+    });
+  };
+  add_transfers(main_attributes, true);
+  add_transfers(profile_attributes, false);
+  return transfers;
+}
+
 Mesh *curve_to_mesh_sweep(const CurvesGeometry &main,
                           const CurvesGeometry &profile,
                           const bool fill_caps)
@@ -640,148 +706,125 @@ Mesh *curve_to_mesh_sweep(const CurvesGeometry &main,
       offsets.vert.last(), offsets.edge.last(), 0, offsets.loop.last(), offsets.poly.last());
   mesh->flag |= ME_AUTOSMOOTH;
   mesh->smoothresh = DEG2RADF(180.0f);
+
+  const AttributeAccessor main_attributes = main.attributes();
+  const AttributeAccessor profile_attributes = profile.attributes();
+  MutableAttributeAccessor mesh_attributes = mesh->attributes_for_write();
+  Vector<AttributeTransfer> transfers = create_attribute_transfers(
+      main_attributes, profile_attributes, mesh_attributes);
+
   MutableSpan<MVert> verts = mesh->verts_for_write();
   MutableSpan<MEdge> edges = mesh->edges_for_write();
   MutableSpan<MPoly> polys = mesh->polys_for_write();
   MutableSpan<MLoop> loops = mesh->loops_for_write();
 
-  foreach_curve_combination(curves_info, offsets, [&](const CombinationInfo &info) {
-    fill_mesh_topology(info.vert_range.start(),
-                       info.edge_range.start(),
-                       info.poly_range.start(),
-                       info.loop_range.start(),
-                       info.main_points.size(),
-                       info.profile_points.size(),
-                       info.main_cyclic,
-                       info.profile_cyclic,
-                       fill_caps,
-                       edges,
-                       loops,
-                       polys);
-  });
-
-  const Span<float3> main_positions = main.evaluated_positions();
-  const Span<float3> tangents = main.evaluated_tangents();
-  const Span<float3> normals = main.evaluated_normals();
-  const Span<float3> profile_positions = profile.evaluated_positions();
-
-  Vector<std::byte> eval_buffer;
-
-  const AttributeAccessor main_attributes = main.attributes();
-  const AttributeAccessor profile_attributes = profile.attributes();
-
-  Span<float> radii = {};
+  Vector<float3> main_positions_buffer;
+  Vector<float3> tangents_buffer;
+  Vector<float3> normals_buffer;
+  Vector<float3> profile_positions_buffer;
+  const Span<float3> main_positions = main.evaluated_positions(main_positions_buffer);
+  const Span<float3> tangents = main.evaluated_tangents(tangents_buffer);
+  const Span<float3> normals = main.evaluated_normals(normals_buffer);
+  const Span<float3> profile_positions = profile.evaluated_positions(profile_positions_buffer);
+  main.ensure_can_interpolate_to_evaluated();
+  profile.ensure_can_interpolate_to_evaluated();
+
+  /* Evaluated point data is used directly when all curves are poly curves. */
+  const bool main_all_poly = main.is_single_type(CURVE_TYPE_POLY);
+  const bool profile_all_poly = profile.is_single_type(CURVE_TYPE_POLY);
+
+  GVArraySpan radii;
   if (main_attributes.contains("radius")) {
-    radii = evaluated_attribute_if_necessary(
-                main_attributes.lookup_or_default<float>("radius", ATTR_DOMAIN_POINT, 1.0f),
-                main,
-                main.curve_type_counts(),
-                eval_buffer)
-                .typed<float>();
+    radii = GVArraySpan(
+        main_attributes.lookup_or_default<float>("radius", ATTR_DOMAIN_POINT, 1.0f));
   }
 
-  foreach_curve_combination(curves_info, offsets, [&](const CombinationInfo &info) {
-    fill_mesh_positions(info.main_points.size(),
-                        info.profile_points.size(),
-                        main_positions.slice(info.main_points),
-                        profile_positions.slice(info.profile_points),
-                        tangents.slice(info.main_points),
-                        normals.slice(info.main_points),
-                        radii.is_empty() ? radii : radii.slice(info.main_points),
-                        verts.slice(info.vert_range));
-  });
-
-  if (profile.curve_type_counts()[CURVE_TYPE_BEZIER] > 0) {
-    const VArray<int8_t> curve_types = profile.curve_types();
-    const VArraySpan<int8_t> handle_types_left{profile.handle_types_left()};
-    const VArraySpan<int8_t> handle_types_right{profile.handle_types_right()};
-
-    foreach_curve_combination(curves_info, offsets, [&](const CombinationInfo &info) {
-      if (curve_types[info.i_profile] == CURVE_TYPE_BEZIER) {
-        const IndexRange points = profile.points_for_curve(info.i_profile);
-        mark_bezier_vector_edges_sharp(points.size(),
-                                       info.main_segment_num,
-                                       profile.bezier_evaluated_offsets_for_curve(info.i_profile),
-                                       handle_types_left.slice(points),
-                                       handle_types_right.slice(points),
-                                       edges.slice(info.edge_range));
-      }
-    });
+  const bool has_bezier_profile = profile.curve_type_counts()[CURVE_TYPE_BEZIER] > 0;
+  const VArray<int8_t> profile_types = profile.curve_types();
+  VArraySpan<int8_t> handle_types_left;
+  VArraySpan<int8_t> handle_types_right;
+  if (has_bezier_profile) {
+    handle_types_left = profile.handle_types_left();
+    handle_types_right = profile.handle_types_right();
   }
 
-  Set<AttributeIDRef> main_attributes_set;
-
-  MutableAttributeAccessor mesh_attributes = mesh->attributes_for_write();
+  threading::EnumerableThreadSpecific<SweepThreadData> thread_data([&]() {
+    SweepThreadData data;
+    data.evaluated_buffers.reinitialize(transfers.size() + 1);
+    return data;
+  });
 
-  main_attributes.for_all([&](const AttributeIDRef &id, const AttributeMetaData meta_data) {
-    if (!should_add_attribute_to_mesh(main_attributes, mesh_attributes, id)) {
-      return true;
+  /* Fill all data of each block of combinations at once, rather than going over the whole mesh
+   * for the topology, the positions and every attribute separately. */
+  foreach_curve_combination_block(offsets, [&](const IndexRange range) {
+    SweepThreadData &data = thread_data.local();
+    data.combinations.clear();
+    for (const int i : range) {
+      data.combinations.append(get_combination_info(curves_info, offsets, i));
     }
-    main_attributes_set.add_new(id);
 
-    const eAttrDomain src_domain = meta_data.domain;
-    const eCustomDataType type = meta_data.data_type;
-    GVArray src = main_attributes.lookup(id, src_domain, type);
-
-    const eAttrDomain dst_domain = get_attribute_domain_for_mesh(mesh_attributes, id);
-    GSpanAttributeWriter dst = mesh_attributes.lookup_or_add_for_write_only_span(
-        id, dst_domain, type);
-    if (!dst) {
-      return true;
+    for (const CombinationInfo &info : data.combinations) {
+      fill_mesh_topology(info.vert_range.start(),
+                         info.edge_range.start(),
+                         info.poly_range.start(),
+                         info.loop_range.start(),
+                         info.main_points.size(),
+                         info.profile_points.size(),
+                         info.main_cyclic,
+                         info.profile_cyclic,
+                         fill_caps,
+                         edges,
+                         loops,
+                         polys);
     }
 
-    if (src_domain == ATTR_DOMAIN_POINT) {
-      copy_main_point_domain_attribute_to_mesh(
-          curves_info,
-          offsets,
-          dst_domain,
-          evaluated_attribute_if_necessary(src, main, main.curve_type_counts(), eval_buffer),
-          dst.span);
-    }
-    else if (src_domain == ATTR_DOMAIN_CURVE) {
-      copy_curve_domain_attribute_to_mesh(
-          offsets, offsets.main_indices, dst_domain, src, dst.span);
+    EvaluatedCurveBuffer &radius_buffer = data.evaluated_buffers.last();
+    for (const CombinationInfo &info : data.combinations) {
+      Span<float> evaluated_radii;
+      if (!radii.is_empty()) {
+        evaluated_radii = evaluated_point_data_for_curve(
+                              main, radii, main_all_poly, info.i_main, radius_buffer)
+                              .typed<float>();
+      }
+      fill_mesh_positions(info.main_points.size(),
+                          info.profile_points.size(),
+                          main_positions.slice(info.main_points),
+                          profile_positions.slice(info.profile_points),
+                          tangents.slice(info.main_points),
+                          normals.slice(info.main_points),
+                          evaluated_radii,
+                          verts.slice(info.vert_range));
     }
 
-    dst.finish();
-    return true;
-  });
-
-  profile_attributes.for_all([&](const AttributeIDRef &id, const AttributeMetaData meta_data) {
-    if (main_attributes.contains(id)) {
-      return true;
-    }
-    if (!should_add_attribute_to_mesh(profile_attributes, mesh_attributes, id)) {
-      return true;
-    }
-    const eAttrDomain src_domain = meta_data.domain;
-    const eCustomDataType type = meta_data.data_type;
-    GVArray src = profile_attributes.lookup(id, src_domain, type);
-
-    const eAttrDomain dst_domain = get_attribute_domain_for_mesh(mesh_attributes, id);
-    GSpanAttributeWriter dst = mesh_attributes.lookup_or_add_for_write_only_span(
-        id, dst_domain, type);
-    if (!dst) {
-      return true;
+    if (has_bezier_profile) {
+      for (const CombinationInfo &info : data.combinations) {
+        if (profile_types[info.i_profile] == CURVE_TYPE_BEZIER) {
+          const IndexRange points = profile.points_for_curve(info.i_profile);
+          mark_bezier_vector_edges_sharp(
+              points.size(),
+              info.main_segment_num,
+              profile.bezier_evaluated_offsets_for_curve(info.i_profile),
+              handle_types_left.slice(points),
+              handle_types_right.slice(points),
+              edges.slice(info.edge_range));
+        }
+      }
     }
 
-    if (src_domain == ATTR_DOMAIN_POINT) {
-      copy_profile_point_domain_attribute_to_mesh(
-          curves_info,
-          offsets,
-          dst_domain,
-          evaluated_attribute_if_necessary(src, profile, profile.curve_type_counts(), eval_buffer),
-          dst.span);
-    }
-    else if (src_domain == ATTR_DOMAIN_CURVE) {
-      copy_curve_domain_attribute_to_mesh(
-          offsets, offsets.profile_indices, dst_domain, src, dst.span);
+    for (const int i : transfers.index_range()) {
+      AttributeTransfer &transfer = transfers[i];
+      copy_attribute_to_mesh(curves_info,
+                             data.combinations,
+                             transfer.from_main ? main_all_poly : profile_all_poly,
+                             transfer,
+                             data.evaluated_buffers[i]);
     }
-
-    dst.finish();
-    return true;
   });
 
+  for (AttributeTransfer &transfer : transfers) {
+    transfer.dst.finish();
+  }
+
   return mesh;
 }
 
@@ -0,0 +1,151 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/** \file
+ * \ingroup bke
+ */
+
+#include "BLI_math_rotation.h"
+
+#include "DNA_mesh_types.h"
+#include "DNA_meshdata_types.h"
+
+#include "BKE_curves.hh"
+#include "BKE_idtype.h"
+#include "BKE_lib_id.h"
+#include "BKE_mesh.h"
+
+#include "BKE_curve_to_mesh.hh"
+
+#include "testing/testing.h"
+
+namespace blender::bke::tests {
+
+class curve_to_mesh : public testing::Test {
+ public:
+  static void SetUpTestSuite()
+  {
+    BKE_idtype_init();
+  }
+};
+
+/** Main curves with the given number of points each, along the Z axis. */
+static CurvesGeometry create_main_curves(const int curves_num,
+                                         const int points_per_curve,
+                                         const CurveType type)
+{
+  CurvesGeometry curves(curves_num * points_per_curve, curves_num);
+  MutableSpan<int> offsets = curves.offsets_for_write();
+  for (const int i : offsets.index_range()) {
+    offsets[i] = i * points_per_curve;
+  }
+  MutableSpan<float3> positions = curves.positions_for_write();
+  for (const int i : curves.points_range()) {
+    positions[i] = {float(i / points_per_curve), float(i % 2), float(i % points_per_curve)};
+  }
+  curves.fill_curve_types(type);
+  return curves;
+}
+
+/** A single cyclic poly curve in the shape of a circle. */
+static CurvesGeometry create_circle_profile(const int points_num)
+{
+  CurvesGeometry curves(points_num, 1);
+  curves.offsets_for_write().last() = points_num;
+  MutableSpan<float3> positions = curves.positions_for_write();
+  for (const int i : positions.index_range()) {
+    const float angle = 2.0f * float(M_PI) * i / points_num;
+    positions[i] = {std::cos(angle), std::sin(angle), 0.0f};
+  }
+  curves.fill_curve_types(CURVE_TYPE_POLY);
+  curves.cyclic_for_write().fill(true);
+  return curves;
+}
+
+TEST_F(curve_to_mesh, PolyAttributes)
+{
+  CurvesGeometry main = create_main_curves(2, 3, CURVE_TYPE_POLY);
+  CurvesGeometry profile = create_circle_profile(4);
+  {
+    MutableAttributeAccessor attributes = main.attributes_for_write();
+    SpanAttributeWriter<float> point_attribute =
+        attributes.lookup_or_add_for_write_only_span<float>("main_point", ATTR_DOMAIN_POINT);
+    for (const int i : point_attribute.span.index_range()) {
+      point_attribute.span[i] = float(i);
+    }
+    point_attribute.finish();
+  }
+  {
+    MutableAttributeAccessor attributes = profile.attributes_for_write();
+    SpanAttributeWriter<int> curve_attribute = attributes.lookup_or_add_for_write_only_span<int>(
+        "profile_curve", ATTR_DOMAIN_CURVE);
+    curve_attribute.span.fill(7);
+    curve_attribute.finish();
+  }
+
+  Mesh *mesh = curve_to_mesh_sweep(main, profile, true);
+  ASSERT_NE(mesh, nullptr);
+  EXPECT_EQ(mesh->totvert, 2 * 3 * 4);
+  EXPECT_EQ(mesh->totedge, 2 * (3 * 4 + 2 * 4));
+  /* Two rings of quads and two caps for every main curve. */
+  EXPECT_EQ(mesh->totpoly, 2 * (2 * 4 + 2));
+
+  const AttributeAccessor attributes = mesh->attributes();
+  const VArray<float> main_point = attributes.lookup<float>("main_point", ATTR_DOMAIN_POINT);
+  const VArray<int> profile_curve = attributes.lookup<int>("profile_curve", ATTR_DOMAIN_POINT);
+  for (const int i : IndexRange(mesh->totvert)) {
+    /* Every ring of the profile has the value of a single main curve point. */
+    EXPECT_EQ(main_point[i], float(i / 4));
+    EXPECT_EQ(profile_curve[i], 7);
+  }
+
+  /* The center of every ring is at the main curve point. */
+  const Span<MVert> verts = mesh->verts();
+  const Span<float3> main_positions = main.positions();
+  for (const int i_ring : main_positions.index_range()) {
+    float3 center(0.0f);
+    for (const int i : IndexRange(i_ring * 4, 4)) {
+      center += float3(verts[i].co) / 4.0f;
+    }
+    EXPECT_V3_NEAR(center, main_positions[i_ring], 1e-6f);
+  }
+
+  BKE_id_free(nullptr, mesh);
+}
+
+TEST_F(curve_to_mesh, EvaluatedAttributes)
+{
+  CurvesGeometry main = create_main_curves(3, 4, CURVE_TYPE_CATMULL_ROM);
+  main.resolution_for_write().fill(5);
+  CurvesGeometry profile = create_circle_profile(3);
+  Array<float> values(main.points_num());
+  {
+    MutableAttributeAccessor attributes = main.attributes_for_write();
+    SpanAttributeWriter<float> value_attribute =
+        attributes.lookup_or_add_for_write_only_span<float>("value", ATTR_DOMAIN_POINT);
+    for (const int i : values.index_range()) {
+      values[i] = 1.0f + i * i;
+    }
+    value_attribute.span.copy_from(values);
+    value_attribute.finish();
+  }
+
+  Mesh *mesh = curve_to_mesh_sweep(main, profile, false);
+  ASSERT_NE(mesh, nullptr);
+  ASSERT_EQ(mesh->totvert, main.evaluated_points_num() * 3);
+
+  /* The attribute is interpolated for every curve separately, which should give the same result
+   * as interpolating all curves at once. */
+  main.ensure_can_interpolate_to_evaluated();
+  Array<float> evaluated_values(main.evaluated_points_num());
+  main.interpolate_to_evaluated(values.as_span(), evaluated_values.as_mutable_span());
+  const VArray<float> mesh_values = mesh->attributes().lookup<float>("value", ATTR_DOMAIN_POINT);
+  for (const int i : evaluated_values.index_range()) {
+    for (const int i_profile : IndexRange(3)) {
+      EXPECT_EQ(mesh_values[i * 3 + i_profile], evaluated_values[i]);
+    }
+  }
+
+  BKE_id_free(nullptr, mesh);
+}
+
+}  // namespace blender::bke::tests
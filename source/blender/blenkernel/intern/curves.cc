@@ -13,6 +13,7 @@
 #include "DNA_defaults.h"
 #include "DNA_material_types.h"
 #include "DNA_object_types.h"
+#include "DNA_scene_types.h"
 
 #include "BLI_bounds.hh"
 #include "BLI_index_range.hh"
@@ -81,7 +82,13 @@ static void curves_copy_data(Main *UNUSED(bmain), ID *id_dst, const ID *id_src,
   dst.point_num = src.point_num;
   dst.curve_num = src.curve_num;
 
-  const eCDAllocType alloc_type = (flag & LIB_ID_COPY_CD_REFERENCE) ? CD_REFERENCE : CD_DUPLICATE;
+  eCDAllocType alloc_type = CD_DUPLICATE;
+  if (flag & LIB_ID_COPY_CD_REFERENCE) {
+    alloc_type = CD_REFERENCE;
+  }
+  else if (flag & LIB_ID_COPY_CD_SHARE) {
+    alloc_type = CD_SHARE;
+  }
   CustomData_copy(&src.point_data, &dst.point_data, CD_MASK_ALL, alloc_type, dst.point_num);
   CustomData_copy(&src.curve_data, &dst.curve_data, CD_MASK_ALL, alloc_type, dst.curve_num);
 
@@ -94,6 +101,8 @@ static void curves_copy_data(Main *UNUSED(bmain), ID *id_dst, const ID *id_src,
   dst.runtime = MEM_new<bke::CurvesGeometryRuntime>(__func__);
 
   dst.runtime->type_counts = src.runtime->type_counts;
+  /* Used to keep the evaluated caches of the depsgraph's copy when it is updated. */
+  dst.runtime->copied_change_stamp = src.runtime->change_stamp;
 
   curves_dst->batch_cache = nullptr;
 }
@@ -338,6 +347,16 @@ void BKE_curves_data_update(struct Depsgraph *depsgraph, struct Scene *scene, Ob
     BKE_object_eval_assign_data(object, &curves_eval->id, true);
   }
   else {
+    if (DEG_get_mode(depsgraph) != DAG_EVAL_RENDER && (scene->r.mode & R_SIMPLIFY) &&
+        (scene->r.perf_flag & SCE_PERF_COMPACT_CURVES_CACHES)) {
+      /* Caches created by modifiers are kept with lower precision until they are used again.
+       * Compacting modifies the caches, so only curves created by this evaluation are changed,
+       * not the copy-on-write data-block or geometry that is shared with other evaluations. */
+      const CurveComponent &component = *geometry_set.get_component_for_read<CurveComponent>();
+      if (curves_eval != curves && component.owns_direct_data() && component.is_mutable()) {
+        blender::bke::CurvesGeometry::wrap(curves_eval->geometry).compact_evaluated_caches();
+      }
+    }
     BKE_object_eval_assign_data(object, &curves_eval->id, false);
   }
   object->runtime.geometry_set_eval = new GeometrySet(std::move(geometry_set));
@@ -0,0 +1,487 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/** \file
+ * \ingroup bke
+ */
+
+#include <algorithm>
+
+#include "BLI_kdopbvh.h"
+#include "BLI_math_geom.h"
+
+#include "BKE_curves.hh"
+#include "BKE_curves_bvh.hh"
+
+namespace blender::bke::curves {
+
+/** Data necessary to find the edge for an item of #CurvesGeometry::evaluated_segments_bvh. */
+struct SegmentsData {
+  Span<float3> positions;
+  Span<int> evaluated_offsets;
+
+  SegmentsData(const CurvesGeometry &curves)
+      : positions(curves.evaluated_positions()), evaluated_offsets(curves.evaluated_offsets())
+  {
+  }
+
+  int curve_for_point(const int index) const
+  {
+    return std::upper_bound(evaluated_offsets.begin(), evaluated_offsets.end(), index) -
+           evaluated_offsets.begin() - 1;
+  }
+
+  /**
+   * The second point of the edge starting at the evaluated point. Only the last point of cyclic
+   * curves has an edge back to the first point, and single points have no edge at all, in which
+   * case the point itself is returned.
+   */
+  int edge_end(const int index) const
+  {
+    const int curve_index = this->curve_for_point(index);
+    if (index + 1 < evaluated_offsets[curve_index + 1]) {
+      return index + 1;
+    }
+    return evaluated_offsets[curve_index];
+  }
+};
+
+static void nearest_callback(void *userdata,
+                             const int index,
+                             const float co[3],
+                             BVHTreeNearest *nearest)
+{
+  const SegmentsData &data = *static_cast<const SegmentsData *>(userdata);
+  const float3 &start = data.positions[index];
+  const float3 &end = data.positions[data.edge_end(index)];
+  float3 closest;
+  closest_to_line_segment_v3(closest, co, start, end);
+  const float dist_sq = math::distance_squared(closest, float3(co));
+  if (dist_sq < nearest->dist_sq) {
+    nearest->index = index;
+    nearest->dist_sq = dist_sq;
+    copy_v3_v3(nearest->co, closest);
+  }
+}
+
+static void raycast_callback(void *userdata,
+                             const int index,
+                             const BVHTreeRay *ray,
+                             BVHTreeRayHit *hit)
+{
+  const SegmentsData &data = *static_cast<const SegmentsData *>(userdata);
+  const float3 &start = data.positions[index];
+  const float3 &end = data.positions[data.edge_end(index)];
+  float3 closest;
+  float depth;
+  const float dist_sq = dist_squared_ray_to_seg_v3(
+      ray->origin, ray->direction, start, end, closest, &depth);
+  if (dist_sq <= ray->radius * ray->radius && depth >= 0.0f && depth < hit->dist) {
+    hit->index = index;
+    hit->dist = depth;
+    copy_v3_v3(hit->co, closest);
+  }
+}
+
+/**
+ * The exact curve of a Bezier, Catmull Rom or NURBS curve, parameterized with fractional
+ * evaluated point indices.
+ */
+class ExactCurve {
+ private:
+  CurveType type_;
+  bool cyclic_;
+  int evaluated_num_;
+  Span<float3> positions_;
+  /* Bezier curves. */
+  Span<float3> handles_left_;
+  Span<float3> handles_right_;
+  Span<int> bezier_evaluated_offsets_;
+  /* Catmull Rom curves. */
+  int resolution_;
+  /* NURBS curves. */
+  Span<float> nurbs_weights_;
+  int8_t order_;
+  Array<float> knots_;
+
+ public:
+  /** Return false when the evaluated points of the curve already describe it exactly. */
+  bool init(const CurvesGeometry &curves, const int curve_index)
+  {
+    const IndexRange points = curves.points_for_curve(curve_index);
+    type_ = CurveType(curves.curve_types()[curve_index]);
+    cyclic_ = curves.cyclic()[curve_index];
+    evaluated_num_ = curves.evaluated_points_for_curve(curve_index).size();
+    positions_ = curves.positions().slice(points);
+    if (evaluated_num_ < 2) {
+      return false;
+    }
+    switch (type_) {
+      case CURVE_TYPE_POLY:
+        return false;
+      case CURVE_TYPE_BEZIER:
+        handles_left_ = curves.handle_positions_left().slice(points);
+        handles_right_ = curves.handle_positions_right().slice(points);
+        bezier_evaluated_offsets_ = curves.bezier_evaluated_offsets_for_curve(curve_index);
+        return true;
+      case CURVE_TYPE_CATMULL_ROM:
+        resolution_ = curves.evaluated_resolution()[curve_index];
+        return true;
+      case CURVE_TYPE_NURBS: {
+        order_ = curves.nurbs_orders()[curve_index];
+        const KnotsMode knots_mode = KnotsMode(curves.nurbs_knots_modes()[curve_index]);
+        if (!nurbs::check_valid_num_and_order(points.size(), order_, cyclic_, knots_mode)) {
+          return false;
+        }
+        const Span<float> weights = curves.nurbs_weights();
+        nurbs_weights_ = weights.is_empty() ? weights : weights.slice(points);
+        knots_.reinitialize(nurbs::knots_num(points.size(), order_, cyclic_));
+        nurbs::calculate_knots(points.size(), knots_mode, order_, cyclic_, knots_);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /** The largest parameter, at the last evaluated point or back at the first for cyclic curves. */
+  float parameter_max() const
+  {
+    return float(segments_num(evaluated_num_, cyclic_));
+  }
+
+  /** Wrap the parameter of a cyclic curve to the valid range, or clamp it otherwise. */
+  float wrap_parameter(const float parameter) const
+  {
+    const float max = this->parameter_max();
+    if (cyclic_) {
+      const float wrapped = std::fmod(parameter, max);
+      return wrapped < 0.0f ? wrapped + max : wrapped;
+    }
+    return std::clamp(parameter, 0.0f, max);
+  }
+
+  /** The derivative is with respect to the parameter, not the curve's own parameterization. */
+  void evaluate(const float parameter, float3 &r_position, float3 &r_derivative) const
+  {
+    switch (type_) {
+      case CURVE_TYPE_BEZIER:
+        this->evaluate_bezier(parameter, r_position, r_derivative);
+        break;
+      case CURVE_TYPE_CATMULL_ROM:
+        this->evaluate_catmull_rom(parameter, r_position, r_derivative);
+        break;
+      case CURVE_TYPE_NURBS:
+        nurbs::evaluate_at_evaluated_parameter(positions_,
+                                               nurbs_weights_,
+                                               order_,
+                                               cyclic_,
+                                               evaluated_num_,
+                                               knots_,
+                                               parameter,
+                                               r_position,
+                                               r_derivative);
+        break;
+      case CURVE_TYPE_POLY:
+        BLI_assert_unreachable();
+        break;
+    }
+  }
+
+ private:
+  static void evaluate_cubic(const float3 &point_0,
+                             const float3 &point_1,
+                             const float3 &point_2,
+                             const float3 &point_3,
+                             const float t,
+                             float3 &r_position,
+                             float3 &r_derivative)
+  {
+    const float s = 1.0f - t;
+    r_position = s * s * s * point_0 + 3.0f * s * s * t * point_1 + 3.0f * s * t * t * point_2 +
+                 t * t * t * point_3;
+    r_derivative = 3.0f * (s * s * (point_1 - point_0) + 2.0f * s * t * (point_2 - point_1) +
+                           t * t * (point_3 - point_2));
+  }
+
+  /** Find the control point segment and the factor in it for a parameter. */
+  void find_segment(const float parameter, int &r_segment, float &r_factor, float &r_size) const
+  {
+    const int points_num = positions_.size();
+    if (!cyclic_ && parameter >= float(evaluated_num_ - 1)) {
+      /* The end of the last segment rather than the start of the segment after the last point. */
+      r_segment = points_num - 2;
+      r_factor = 1.0f;
+    }
+    else if (type_ == CURVE_TYPE_BEZIER) {
+      const Span<int> offsets = bezier_evaluated_offsets_;
+      r_segment = std::upper_bound(offsets.begin(), offsets.end(), int(parameter)) -
+                  offsets.begin();
+      r_segment = std::min(r_segment, points_num - 1);
+      const int start = r_segment == 0 ? 0 : offsets[r_segment - 1];
+      r_factor = (parameter - start) / float(offsets[r_segment] - start);
+    }
+    else {
+      r_segment = std::min(int(parameter) / resolution_, points_num - 1);
+      r_factor = (parameter - float(r_segment * resolution_)) / float(resolution_);
+    }
+
+    if (type_ == CURVE_TYPE_BEZIER) {
+      const int start = r_segment == 0 ? 0 : bezier_evaluated_offsets_[r_segment - 1];
+      r_size = float(bezier_evaluated_offsets_[r_segment] - start);
+    }
+    else {
+      r_size = float(resolution_);
+    }
+  }
+
+  void evaluate_bezier(const float parameter, float3 &r_position, float3 &r_derivative) const
+  {
+    int segment;
+    float factor;
+    float size;
+    this->find_segment(parameter, segment, factor, size);
+    const int next = segment == positions_.size() - 1 ? 0 : segment + 1;
+    evaluate_cubic(positions_[segment],
+                   handles_right_[segment],
+                   handles_left_[next],
+                   positions_[next],
+                   factor,
+                   r_position,
+                   r_derivative);
+    r_derivative /= size;
+  }
+
+  void evaluate_catmull_rom(const float parameter, float3 &r_position, float3 &r_derivative) const
+  {
+    int segment;
+    float factor;
+    float size;
+    this->find_segment(parameter, segment, factor, size);
+    const int points_num = positions_.size();
+    auto point = [&](const int index) -> const float3 & {
+      if (points_num == 2) {
+        /* Two point curves don't wrap around to the other point, see #interpolate_to_evaluated. */
+        return positions_[std::clamp(index, segment, segment + 1) % points_num];
+      }
+      if (cyclic_) {
+        return positions_[(index + points_num) % points_num];
+      }
+      return positions_[std::clamp(index, 0, points_num - 1)];
+    };
+    const float3 &a = point(segment - 1);
+    const float3 &b = point(segment);
+    const float3 &c = point(segment + 1);
+    const float3 &d = point(segment + 2);
+    /* The same segment as a cubic Bezier curve. */
+    evaluate_cubic(b, b + (c - a) / 6.0f, c - (d - b) / 6.0f, c, factor, r_position, r_derivative);
+    r_derivative /= size;
+  }
+};
+
+/**
+ * Minimize the squared length of a residual vector depending on the exact curve's position with
+ * the Gauss-Newton method, starting at a parameter on the evaluated edge with the given index.
+ * Steps are halved until they decrease the residual, since the method ignores the curvature and
+ * can overshoot when the residual is large. The result stays within the neighboring edges, so
+ * that it can't jump to a different part of the curve.
+ *
+ * \param residual_fn: Returns the residual and its derivative for a position and its derivative.
+ */
+template<typename ResidualFn>
+static float refine_parameter(const ExactCurve &curve,
+                              const int segment_index,
+                              const float start_parameter,
+                              const bool cyclic,
+                              const ResidualFn &residual_fn)
+{
+  const float min = cyclic ? float(segment_index - 1) : std::max(float(segment_index - 1), 0.0f);
+  const float max = cyclic ? float(segment_index + 2) :
+                             std::min(float(segment_index + 2), curve.parameter_max());
+
+  auto evaluate = [&](const float parameter, float3 &r_residual, float3 &r_residual_derivative) {
+    float3 position;
+    float3 derivative;
+    curve.evaluate(curve.wrap_parameter(parameter), position, derivative);
+    residual_fn(position, derivative, r_residual, r_residual_derivative);
+  };
+
+  float parameter = start_parameter;
+  float3 residual;
+  float3 residual_derivative;
+  evaluate(parameter, residual, residual_derivative);
+  for ([[maybe_unused]] const int iteration : IndexRange(16)) {
+    const float denominator = math::length_squared(residual_derivative);
+    if (denominator == 0.0f) {
+      break;
+    }
+    float step = -math::dot(residual, residual_derivative) / denominator;
+    bool improved = false;
+    for ([[maybe_unused]] const int halving : IndexRange(8)) {
+      const float new_parameter = std::clamp(parameter + step, min, max);
+      float3 new_residual;
+      float3 new_residual_derivative;
+      evaluate(new_parameter, new_residual, new_residual_derivative);
+      if (math::length_squared(new_residual) < math::length_squared(residual)) {
+        step = new_parameter - parameter;
+        parameter = new_parameter;
+        residual = new_residual;
+        residual_derivative = new_residual_derivative;
+        improved = true;
+        break;
+      }
+      step *= 0.5f;
+    }
+    if (!improved || std::abs(step) < 1e-5f) {
+      break;
+    }
+  }
+  return curve.wrap_parameter(parameter);
+}
+
+/** Fill the location on the curve from a fractional evaluated point index in the curve. */
+static void fill_sample(const CurvesGeometry &curves,
+                        const int curve_index,
+                        const bool cyclic,
+                        const float parameter,
+                        CurvesSample &r_sample)
+{
+  const Span<float> lengths = curves.evaluated_lengths_for_curve(curve_index, cyclic);
+  r_sample.curve_index = curve_index;
+  if (lengths.is_empty()) {
+    r_sample.segment_index = 0;
+    r_sample.segment_factor = 0.0f;
+    r_sample.parameter = 0.0f;
+    return;
+  }
+  const int segment = std::min(int(parameter), int(lengths.size() - 1));
+  const float factor = std::clamp(parameter - float(segment), 0.0f, 1.0f);
+  const float length_start = segment == 0 ? 0.0f : lengths[segment - 1];
+  const float length = length_start + factor * (lengths[segment] - length_start);
+  r_sample.segment_index = segment;
+  r_sample.segment_factor = factor;
+  r_sample.parameter = math::safe_divide(length, lengths.last());
+}
+
+bool find_nearest(const CurvesGeometry &curves,
+                  const float3 &position,
+                  const float max_distance_sq,
+                  const bool refine,
+                  CurvesNearest &r_nearest)
+{
+  BVHTree *tree = curves.evaluated_segments_bvh();
+  if (tree == nullptr) {
+    return false;
+  }
+  SegmentsData data(curves);
+  BVHTreeNearest nearest;
+  nearest.index = -1;
+  nearest.dist_sq = max_distance_sq;
+  BLI_bvhtree_find_nearest(tree, position, &nearest, nearest_callback, &data);
+  if (nearest.index == -1) {
+    return false;
+  }
+
+  curves.ensure_evaluated_lengths();
+  const int curve_index = data.curve_for_point(nearest.index);
+  const bool cyclic = curves.cyclic()[curve_index];
+  const int first_point = data.evaluated_offsets[curve_index];
+  const int segment_index = nearest.index - first_point;
+  const float factor = line_point_factor_v3(
+      nearest.co, data.positions[nearest.index], data.positions[data.edge_end(nearest.index)]);
+  float parameter = float(segment_index) + std::clamp(factor, 0.0f, 1.0f);
+  float3 nearest_position = nearest.co;
+
+  ExactCurve exact_curve;
+  if (refine && exact_curve.init(curves, curve_index)) {
+    parameter = refine_parameter(
+        exact_curve,
+        segment_index,
+        parameter,
+        cyclic,
+        [&](const float3 &curve_position,
+            const float3 &derivative,
+            float3 &r_residual,
+            float3 &r_residual_derivative) {
+          r_residual = curve_position - position;
+          r_residual_derivative = derivative;
+        });
+    float3 derivative;
+    exact_curve.evaluate(parameter, nearest_position, derivative);
+  }
+
+  const float distance_sq = math::distance_squared(nearest_position, position);
+  if (distance_sq >= max_distance_sq) {
+    return false;
+  }
+  fill_sample(curves, curve_index, cyclic, parameter, r_nearest);
+  r_nearest.position = nearest_position;
+  r_nearest.distance_sq = distance_sq;
+  return true;
+}
+
+bool raycast(const CurvesGeometry &curves,
+             const float3 &origin,
+             const float3 &direction,
+             const float ray_length,
+             const float radius,
+             const bool refine,
+             CurvesRayHit &r_hit)
+{
+  BVHTree *tree = curves.evaluated_segments_bvh();
+  if (tree == nullptr) {
+    return false;
+  }
+  SegmentsData data(curves);
+  BVHTreeRayHit hit;
+  hit.index = -1;
+  hit.dist = ray_length;
+  BLI_bvhtree_ray_cast_ex(
+      tree, origin, direction, radius, &hit, raycast_callback, &data, BVH_RAYCAST_DEFAULT);
+  if (hit.index == -1) {
+    return false;
+  }
+
+  curves.ensure_evaluated_lengths();
+  const int curve_index = data.curve_for_point(hit.index);
+  const bool cyclic = curves.cyclic()[curve_index];
+  const int first_point = data.evaluated_offsets[curve_index];
+  const int segment_index = hit.index - first_point;
+  const float factor = line_point_factor_v3(
+      hit.co, data.positions[hit.index], data.positions[data.edge_end(hit.index)]);
+  float parameter = float(segment_index) + std::clamp(factor, 0.0f, 1.0f);
+  float3 hit_position = hit.co;
+  float hit_distance = hit.dist;
+
+  ExactCurve exact_curve;
+  if (refine && exact_curve.init(curves, curve_index)) {
+    /* The component of the offset from the ray's origin that is perpendicular to the ray. */
+    auto residual_fn = [&](const float3 &curve_position,
+                           const float3 &derivative,
+                           float3 &r_residual,
+                           float3 &r_residual_derivative) {
+      const float3 offset = curve_position - origin;
+      r_residual = offset - direction * math::dot(offset, direction);
+      r_residual_derivative = derivative - direction * math::dot(derivative, direction);
+    };
+    const float refined_parameter = refine_parameter(
+        exact_curve, segment_index, parameter, cyclic, residual_fn);
+    float3 refined_position;
+    float3 derivative;
+    exact_curve.evaluate(refined_parameter, refined_position, derivative);
+    const float depth = math::dot(refined_position - origin, direction);
+    const float3 ray_position = origin + direction * depth;
+    if (depth >= 0.0f && depth < ray_length &&
+        math::distance_squared(refined_position, ray_position) <= radius * radius) {
+      parameter = refined_parameter;
+      hit_position = refined_position;
+      hit_distance = depth;
+    }
+  }
+
+  fill_sample(curves, curve_index, cyclic, parameter, r_hit);
+  r_hit.position = hit_position;
+  r_hit.distance = hit_distance;
+  r_hit.radius = math::distance(hit_position, origin + direction * hit_distance);
+  return true;
+}
+
+}  // namespace blender::bke::curves
@@ -0,0 +1,179 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/** \file
+ * \ingroup bke
+ */
+
+#include "BKE_curves.hh"
+#include "BKE_curves_bvh.hh"
+
+#include "testing/testing.h"
+
+namespace blender::bke::curves::tests {
+
+/** Two poly curves along the X axis, the second one is cyclic. */
+static CurvesGeometry create_poly_curves()
+{
+  CurvesGeometry curves(7, 2);
+  curves.offsets_for_write().copy_from({0, 3, 7});
+  curves.positions_for_write().copy_from({{0, 0, 0},
+                                          {1, 0, 0},
+                                          {2, 0, 0},
+                                          {0, 2, 0},
+                                          {2, 2, 0},
+                                          {2, 4, 0},
+                                          {0, 4, 0}});
+  curves.fill_curve_types(CURVE_TYPE_POLY);
+  curves.cyclic_for_write().last() = true;
+  return curves;
+}
+
+/** A quarter of a unit circle in the XY plane, as a single Bezier segment. */
+static CurvesGeometry create_bezier_arc(const int resolution)
+{
+  CurvesGeometry curves(2, 1);
+  curves.offsets_for_write().last() = 2;
+  curves.fill_curve_types(CURVE_TYPE_BEZIER);
+  curves.resolution_for_write().fill(resolution);
+  /* The handle length for an approximation of a circle. */
+  const float handle = 0.5522847f;
+  curves.positions_for_write().copy_from({{1, 0, 0}, {0, 1, 0}});
+  curves.handle_positions_left_for_write().copy_from({{1, -handle, 0}, {handle, 1, 0}});
+  curves.handle_positions_right_for_write().copy_from({{1, handle, 0}, {-handle, 1, 0}});
+  curves.handle_types_left_for_write().fill(BEZIER_HANDLE_ALIGN);
+  curves.handle_types_right_for_write().fill(BEZIER_HANDLE_ALIGN);
+  return curves;
+}
+
+TEST(curves_bvh, Empty)
+{
+  CurvesGeometry curves(0, 0);
+  EXPECT_EQ(curves.evaluated_segments_bvh(), nullptr);
+  CurvesNearest nearest;
+  EXPECT_FALSE(find_nearest(curves, float3(0), FLT_MAX, false, nearest));
+  EXPECT_EQ(nearest.curve_index, -1);
+}
+
+TEST(curves_bvh, NearestPoly)
+{
+  CurvesGeometry curves = create_poly_curves();
+
+  CurvesNearest nearest;
+  EXPECT_TRUE(find_nearest(curves, {1.5f, 0.5f, 0.0f}, FLT_MAX, false, nearest));
+  EXPECT_EQ(nearest.curve_index, 0);
+  EXPECT_EQ(nearest.segment_index, 1);
+  EXPECT_NEAR(nearest.segment_factor, 0.5f, 1e-6f);
+  EXPECT_NEAR(nearest.parameter, 0.75f, 1e-6f);
+  EXPECT_V3_NEAR(nearest.position, float3(1.5f, 0.0f, 0.0f), 1e-6f);
+  EXPECT_NEAR(nearest.distance_sq, 0.25f, 1e-6f);
+
+  /* The last edge of a cyclic curve. */
+  EXPECT_TRUE(find_nearest(curves, {-0.5f, 3.5f, 0.0f}, FLT_MAX, false, nearest));
+  EXPECT_EQ(nearest.curve_index, 1);
+  EXPECT_EQ(nearest.segment_index, 3);
+  EXPECT_NEAR(nearest.segment_factor, 0.25f, 1e-6f);
+  EXPECT_NEAR(nearest.parameter, 6.5f / 8.0f, 1e-6f);
+  EXPECT_V3_NEAR(nearest.position, float3(0.0f, 3.5f, 0.0f), 1e-6f);
+
+  /* Positions further away than the maximum distance are ignored. */
+  CurvesNearest ignored;
+  EXPECT_FALSE(find_nearest(curves, {1.0f, -2.0f, 0.0f}, 1.0f, false, ignored));
+  EXPECT_EQ(ignored.curve_index, -1);
+}
+
+TEST(curves_bvh, PositionsChanged)
+{
+  CurvesGeometry curves = create_poly_curves();
+  CurvesNearest nearest;
+  EXPECT_TRUE(find_nearest(curves, {1.0f, -1.0f, 0.0f}, FLT_MAX, false, nearest));
+  EXPECT_EQ(nearest.curve_index, 0);
+
+  curves.positions_for_write().take_front(3).fill(float3(0.0f, 10.0f, 0.0f));
+  curves.tag_positions_changed(IndexRange(1));
+  EXPECT_TRUE(find_nearest(curves, {1.0f, -1.0f, 0.0f}, FLT_MAX, false, nearest));
+  EXPECT_EQ(nearest.curve_index, 1);
+  EXPECT_V3_NEAR(nearest.position, float3(1.0f, 2.0f, 0.0f), 1e-6f);
+}
+
+TEST(curves_bvh, NearestBezierRefine)
+{
+  CurvesGeometry curves = create_bezier_arc(3);
+  const float3 position(2.0f, 2.0f, 0.0f);
+  const float expected_distance = math::length(position) - 1.0f;
+
+  CurvesNearest nearest;
+  EXPECT_TRUE(find_nearest(curves, position, FLT_MAX, false, nearest));
+  /* The evaluated edges cut through the inside of the arc. */
+  EXPECT_GT(std::sqrt(nearest.distance_sq), expected_distance + 0.02f);
+
+  CurvesNearest refined;
+  EXPECT_TRUE(find_nearest(curves, position, FLT_MAX, true, refined));
+  EXPECT_NEAR(std::sqrt(refined.distance_sq), expected_distance, 1e-3f);
+  EXPECT_V3_NEAR(refined.position, float3(M_SQRT1_2, M_SQRT1_2, 0.0f), 1e-3f);
+  EXPECT_EQ(refined.segment_index, 1);
+  EXPECT_NEAR(refined.segment_factor, 0.5f, 1e-3f);
+  EXPECT_NEAR(refined.parameter, 0.5f, 1e-3f);
+}
+
+TEST(curves_bvh, NearestNURBSRefine)
+{
+  CurvesGeometry curves(5, 1);
+  curves.offsets_for_write().last() = 5;
+  curves.fill_curve_types(CURVE_TYPE_NURBS);
+  curves.nurbs_orders_for_write().fill(4);
+  curves.nurbs_knots_modes_for_write().fill(NURBS_KNOT_MODE_ENDPOINT);
+  curves.positions_for_write().copy_from(
+      {{0, 0, 0}, {1, 2, 0}, {2, -1, 0}, {3, 2, 0}, {4, 0, 0}});
+  CurvesGeometry dense = curves;
+  curves.resolution_for_write().fill(2);
+  dense.resolution_for_write().fill(512);
+
+  for (const float3 &position : {float3(1.0f, 2.0f, 0.0f), float3(2.5f, -1.0f, 1.0f)}) {
+    CurvesNearest expected;
+    EXPECT_TRUE(find_nearest(dense, position, FLT_MAX, false, expected));
+    CurvesNearest refined;
+    EXPECT_TRUE(find_nearest(curves, position, FLT_MAX, true, refined));
+    EXPECT_NEAR(std::sqrt(refined.distance_sq), std::sqrt(expected.distance_sq), 1e-4f);
+    EXPECT_V3_NEAR(refined.position, expected.position, 1e-3f);
+  }
+}
+
+TEST(curves_bvh, Raycast)
+{
+  CurvesGeometry curves = create_poly_curves();
+
+  CurvesRayHit hit;
+  EXPECT_TRUE(raycast(curves, {0.5f, -1.0f, 0.05f}, {0, 1, 0}, FLT_MAX, 0.1f, false, hit));
+  EXPECT_EQ(hit.curve_index, 0);
+  EXPECT_EQ(hit.segment_index, 0);
+  EXPECT_NEAR(hit.segment_factor, 0.5f, 1e-6f);
+  EXPECT_NEAR(hit.distance, 1.0f, 1e-6f);
+  EXPECT_NEAR(hit.radius, 0.05f, 1e-6f);
+  EXPECT_V3_NEAR(hit.position, float3(0.5f, 0.0f, 0.0f), 1e-6f);
+
+  /* Rays pass curves further away than the radius and stop at the ray length. */
+  CurvesRayHit miss;
+  EXPECT_FALSE(raycast(curves, {0.5f, -1.0f, 0.2f}, {0, 1, 0}, FLT_MAX, 0.1f, false, miss));
+  EXPECT_FALSE(raycast(curves, {0.5f, -1.0f, 0.0f}, {0, 1, 0}, 0.5f, 0.1f, false, miss));
+  EXPECT_EQ(miss.curve_index, -1);
+
+  /* Starting between the curves hits the second one. */
+  EXPECT_TRUE(raycast(curves, {1.0f, 1.0f, 0.0f}, {0, 1, 0}, FLT_MAX, 0.1f, false, hit));
+  EXPECT_EQ(hit.curve_index, 1);
+  EXPECT_NEAR(hit.distance, 1.0f, 1e-6f);
+}
+
+TEST(curves_bvh, RaycastBezierRefine)
+{
+  CurvesGeometry curves = create_bezier_arc(3);
+  const float3 origin(2.0f, 2.0f, 0.0f);
+  const float3 direction = math::normalize(float3(-1.0f, -1.0f, 0.0f));
+
+  CurvesRayHit hit;
+  EXPECT_TRUE(raycast(curves, origin, direction, FLT_MAX, 0.01f, true, hit));
+  EXPECT_NEAR(hit.distance, math::length(origin) - 1.0f, 1e-3f);
+  EXPECT_V3_NEAR(hit.position, float3(M_SQRT1_2, M_SQRT1_2, 0.0f), 1e-3f);
+  EXPECT_LT(hit.radius, 1e-4f);
+}
+
+}  // namespace blender::bke::curves::tests
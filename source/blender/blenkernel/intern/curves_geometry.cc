@@ -4,16 +4,21 @@
  * \ingroup bke
  */
 
-#include <mutex>
+#include <atomic>
 #include <utility>
 
 #include "MEM_guardedalloc.h"
 
 #include "BLI_bounds.hh"
+#include "BLI_enumerable_thread_specific.hh"
 #include "BLI_index_mask_ops.hh"
+#include "BLI_kdopbvh.h"
 #include "BLI_length_parameterize.hh"
+#include "BLI_map.hh"
 #include "BLI_math_rotation.hh"
+#include "BLI_set.hh"
 #include "BLI_task.hh"
+#include "BLI_tracing.hh"
 
 #include "DNA_curves_types.h"
 
@@ -29,6 +34,7 @@ static const std::string ATTR_TILT = "tilt";
 static const std::string ATTR_CURVE_TYPE = "curve_type";
 static const std::string ATTR_CYCLIC = "cyclic";
 static const std::string ATTR_RESOLUTION = "resolution";
+static const std::string ATTR_RESOLUTION_TOLERANCE = "resolution_tolerance";
 static const std::string ATTR_NORMAL_MODE = "normal_mode";
 static const std::string ATTR_HANDLE_TYPE_LEFT = "handle_type_left";
 static const std::string ATTR_HANDLE_TYPE_RIGHT = "handle_type_right";
@@ -83,6 +89,8 @@ static void copy_curves_geometry(CurvesGeometry &dst, const CurvesGeometry &src)
   CustomData_free(&dst.curve_data, dst.curve_num);
   dst.point_num = src.point_num;
   dst.curve_num = src.curve_num;
+  /* The source may be original data that legacy code writes to directly, so attributes are only
+   * shared through #LIB_ID_COPY_CD_SHARE when copying owned geometry components. */
   CustomData_copy(&src.point_data, &dst.point_data, CD_MASK_ALL, CD_DUPLICATE, dst.point_num);
   CustomData_copy(&src.curve_data, &dst.curve_data, CD_MASK_ALL, CD_DUPLICATE, dst.curve_num);
 
@@ -91,9 +99,19 @@ static void copy_curves_geometry(CurvesGeometry &dst, const CurvesGeometry &src)
   dst.offsets_for_write().copy_from(src.offsets());
 
   dst.tag_topology_changed();
+  dst.runtime->copied_change_stamp = src.runtime->change_stamp;
 
   /* Though type counts are a cache, they must be copied because they are calculated eagerly. */
   dst.runtime->type_counts = src.runtime->type_counts;
+
+  /* The NURBS basis caches only depend on the data copied above and are never modified after they
+   * are created, so they can be shared with the copy. */
+  if (src.runtime->nurbs_basis_cache_mutex.is_cached()) {
+    dst.runtime->nurbs_basis_cache_mutex.ensure([&]() {
+      dst.runtime->nurbs_basis_cache = src.runtime->nurbs_basis_cache;
+      dst.runtime->nurbs_basis_cache_users = src.runtime->nurbs_basis_cache_users;
+    });
+  }
 }
 
 CurvesGeometry::CurvesGeometry(const CurvesGeometry &other)
@@ -152,6 +170,24 @@ CurvesGeometry::~CurvesGeometry()
   this->runtime = nullptr;
 }
 
+static int64_t next_change_stamp()
+{
+  static std::atomic<int64_t> stamp = 0;
+  return ++stamp;
+}
+
+CurvesGeometryRuntime::CurvesGeometryRuntime()
+    : change_stamp(next_change_stamp()), changed_curves_start_stamp(change_stamp)
+{
+}
+
+CurvesGeometryRuntime::~CurvesGeometryRuntime()
+{
+  if (this->evaluated_segments_bvh != nullptr) {
+    BLI_bvhtree_free(this->evaluated_segments_bvh);
+  }
+}
+
 /** \} */
 
 /* -------------------------------------------------------------------- */
@@ -340,6 +376,25 @@ MutableSpan<int> CurvesGeometry::resolution_for_write()
   return get_mutable_attribute<int>(*this, ATTR_DOMAIN_CURVE, ATTR_RESOLUTION, 12);
 }
 
+VArray<float> CurvesGeometry::resolution_tolerance() const
+{
+  return get_varray_attribute<float>(*this, ATTR_DOMAIN_CURVE, ATTR_RESOLUTION_TOLERANCE, 0.0f);
+}
+MutableSpan<float> CurvesGeometry::resolution_tolerance_for_write()
+{
+  return get_mutable_attribute<float>(*this, ATTR_DOMAIN_CURVE, ATTR_RESOLUTION_TOLERANCE);
+}
+
+/**
+ * With a resolution tolerance, the number of evaluated points depends on the positions, so more
+ * caches have to be invalidated when they change.
+ */
+static bool has_resolution_tolerance(const CurvesGeometry &curves)
+{
+  return !get_span_attribute<float>(curves, ATTR_DOMAIN_CURVE, ATTR_RESOLUTION_TOLERANCE)
+              .is_empty();
+}
+
 VArray<int8_t> CurvesGeometry::normal_mode() const
 {
   return get_varray_attribute<int8_t>(*this, ATTR_DOMAIN_CURVE, ATTR_NORMAL_MODE, 0);
@@ -467,16 +522,65 @@ template<typename CountFn> void build_offsets(MutableSpan<int> offsets, const Co
   offsets.last() = offset;
 }
 
+/**
+ * Choose the resolution of Catmull Rom and NURBS curves with a resolution tolerance. This is done
+ * separately from building the offsets so that it can be multi-threaded.
+ */
+static void calculate_evaluated_resolution(const CurvesGeometry &curves,
+                                           MutableSpan<int> evaluated_resolution)
+{
+  VArray<int8_t> types = curves.curve_types();
+  VArray<int> resolution = curves.resolution();
+  VArray<float> tolerance = curves.resolution_tolerance();
+  VArray<bool> cyclic = curves.cyclic();
+  VArray<int8_t> nurbs_orders = curves.nurbs_orders();
+  Span<float3> positions = curves.positions();
+
+  threading::parallel_for(curves.curves_range(), 256, [&](IndexRange range) {
+    for (const int curve_index : range) {
+      const IndexRange points = curves.points_for_curve(curve_index);
+      if (tolerance[curve_index] <= 0.0f) {
+        evaluated_resolution[curve_index] = resolution[curve_index];
+        continue;
+      }
+      switch (types[curve_index]) {
+        case CURVE_TYPE_CATMULL_ROM:
+          evaluated_resolution[curve_index] =
+              curves::catmull_rom::calculate_resolution_for_tolerance(positions.slice(points),
+                                                                      cyclic[curve_index],
+                                                                      resolution[curve_index],
+                                                                      tolerance[curve_index]);
+          break;
+        case CURVE_TYPE_NURBS:
+          evaluated_resolution[curve_index] = curves::nurbs::calculate_resolution_for_tolerance(
+              positions.slice(points),
+              nurbs_orders[curve_index],
+              cyclic[curve_index],
+              resolution[curve_index],
+              tolerance[curve_index]);
+          break;
+        default:
+          evaluated_resolution[curve_index] = resolution[curve_index];
+          break;
+      }
+    }
+  });
+}
+
 static void calculate_evaluated_offsets(const CurvesGeometry &curves,
+                                        const VArray<int> &resolution,
                                         MutableSpan<int> offsets,
                                         MutableSpan<int> bezier_evaluated_offsets)
 {
   VArray<int8_t> types = curves.curve_types();
-  VArray<int> resolution = curves.resolution();
   VArray<bool> cyclic = curves.cyclic();
+  VArray<float> tolerance = curves.resolution_tolerance();
 
   VArraySpan<int8_t> handle_types_left{curves.handle_types_left()};
   VArraySpan<int8_t> handle_types_right{curves.handle_types_right()};
+  Span<float3> positions = curves.positions();
+  Span<float3> handle_positions_left = curves.handle_positions_left();
+  Span<float3> handle_positions_right = curves.handle_positions_right();
 
   VArray<int8_t> nurbs_orders = curves.nurbs_orders();
   VArray<int8_t> nurbs_knots_modes = curves.nurbs_knots_modes();
@@ -490,11 +594,25 @@ static void calculate_evaluated_offsets(const CurvesGeometry &curves,
       case CURVE_TYPE_POLY:
         return points.size();
       case CURVE_TYPE_BEZIER:
-        curves::bezier::calculate_evaluated_offsets(handle_types_left.slice(points),
-                                                    handle_types_right.slice(points),
-                                                    cyclic[curve_index],
-                                                    resolution[curve_index],
-                                                    bezier_evaluated_offsets.slice(points));
+        if (tolerance[curve_index] > 0.0f) {
+          curves::bezier::calculate_evaluated_offsets_adaptive(
+              positions.slice(points),
+              handle_positions_left.slice(points),
+              handle_positions_right.slice(points),
+              handle_types_left.slice(points),
+              handle_types_right.slice(points),
+              cyclic[curve_index],
+              resolution[curve_index],
+              tolerance[curve_index],
+              bezier_evaluated_offsets.slice(points));
+        }
+        else {
+          curves::bezier::calculate_evaluated_offsets(handle_types_left.slice(points),
+                                                      handle_types_right.slice(points),
+                                                      cyclic[curve_index],
+                                                      resolution[curve_index],
+                                                      bezier_evaluated_offsets.slice(points));
+        }
         return bezier_evaluated_offsets[points.last()];
       case CURVE_TYPE_NURBS:
         return curves::nurbs::calculate_evaluated_num(points.size(),
@@ -510,17 +628,8 @@ static void calculate_evaluated_offsets(const CurvesGeometry &curves,
 
 void CurvesGeometry::ensure_evaluated_offsets() const
 {
-  if (!this->runtime->offsets_cache_dirty) {
-    return;
-  }
-
-  /* A double checked lock. */
-  std::scoped_lock lock{this->runtime->offsets_cache_mutex};
-  if (!this->runtime->offsets_cache_dirty) {
-    return;
-  }
-
-  threading::isolate_task([&]() {
+  this->runtime->offsets_cache_mutex.ensure([&]() {
+    SCOPED_TRACE_EVENT("cache", "Curves Evaluated Offsets");
     this->runtime->evaluated_offsets_cache.resize(this->curves_num() + 1);
 
     if (this->has_curve_with_type(CURVE_TYPE_BEZIER)) {
@@ -530,11 +639,32 @@ void CurvesGeometry::ensure_evaluated_offsets() const
       this->runtime->bezier_evaluated_offsets.clear_and_make_inline();
     }
 
-    calculate_evaluated_offsets(
-        *this, this->runtime->evaluated_offsets_cache, this->runtime->bezier_evaluated_offsets);
+    /* Can't use #evaluated_resolution() here, since it depends on this cache. */
+    VArray<int> resolution;
+    if (has_resolution_tolerance(*this)) {
+      this->runtime->evaluated_resolution_cache.resize(this->curves_num());
+      calculate_evaluated_resolution(*this, this->runtime->evaluated_resolution_cache);
+      resolution = VArray<int>::ForSpan(this->runtime->evaluated_resolution_cache);
+    }
+    else {
+      this->runtime->evaluated_resolution_cache.clear_and_make_inline();
+      resolution = this->resolution();
+    }
+
+    calculate_evaluated_offsets(*this,
+                                resolution,
+                                this->runtime->evaluated_offsets_cache,
+                                this->runtime->bezier_evaluated_offsets);
   });
+}
 
-  this->runtime->offsets_cache_dirty = false;
+VArray<int> CurvesGeometry::evaluated_resolution() const
+{
+  this->ensure_evaluated_offsets();
+  if (this->runtime->evaluated_resolution_cache.is_empty()) {
+    return this->resolution();
+  }
+  return VArray<int>::ForSpan(this->runtime->evaluated_resolution_cache);
 }
 
 Span<int> CurvesGeometry::evaluated_offsets() const
@@ -559,76 +689,362 @@ IndexMask CurvesGeometry::indices_for_curve_type(const CurveType type,
 
 void CurvesGeometry::ensure_nurbs_basis_cache() const
 {
-  if (!this->runtime->nurbs_basis_cache_dirty) {
-    return;
-  }
-
-  /* A double checked lock. */
-  std::scoped_lock lock{this->runtime->nurbs_basis_cache_mutex};
-  if (!this->runtime->nurbs_basis_cache_dirty) {
-    return;
-  }
-
-  threading::isolate_task([&]() {
+  this->runtime->nurbs_basis_cache_mutex.ensure([&]() {
+    SCOPED_TRACE_EVENT("cache", "Curves NURBS Basis");
     Vector<int64_t> nurbs_indices;
     const IndexMask nurbs_mask = this->indices_for_curve_type(CURVE_TYPE_NURBS, nurbs_indices);
     if (nurbs_mask.is_empty()) {
+      this->runtime->nurbs_basis_cache.clear_and_make_inline();
+      this->runtime->nurbs_basis_cache_users.clear_and_make_inline();
       return;
     }
 
-    this->runtime->nurbs_basis_cache.resize(this->curves_num());
-    MutableSpan<curves::nurbs::BasisCache> basis_caches(this->runtime->nurbs_basis_cache);
+    this->runtime->nurbs_basis_cache.reinitialize(this->curves_num());
+    MutableSpan<const curves::nurbs::BasisCache *> basis_caches(
+        this->runtime->nurbs_basis_cache);
 
     VArray<bool> cyclic = this->cyclic();
+    VArray<int> resolution = this->evaluated_resolution();
     VArray<int8_t> orders = this->nurbs_orders();
     VArray<int8_t> knots_modes = this->nurbs_knots_modes();
 
-    threading::parallel_for(nurbs_mask.index_range(), 64, [&](const IndexRange range) {
+    /* Many curves usually share the same properties, so keep a local map of the caches that were
+     * already retrieved to avoid locking the global registry for every curve. */
+    using LocalCacheMap =
+        Map<curves::nurbs::BasisCacheKey, std::shared_ptr<const curves::nurbs::BasisCache>>;
+    threading::EnumerableThreadSpecific<LocalCacheMap> local_caches;
+
+    threading::parallel_for(nurbs_mask.index_range(), 512, [&](const IndexRange range) {
+      LocalCacheMap &caches = local_caches.local();
       for (const int curve_index : nurbs_mask.slice(range)) {
-        const IndexRange points = this->points_for_curve(curve_index);
-        const IndexRange evaluated_points = this->evaluated_points_for_curve(curve_index);
+        const curves::nurbs::BasisCacheKey key{this->points_num_for_curve(curve_index),
+                                               resolution[curve_index],
+                                               orders[curve_index],
+                                               cyclic[curve_index],
+                                               KnotsMode(knots_modes[curve_index])};
+        const std::shared_ptr<const curves::nurbs::BasisCache> &cache = caches.lookup_or_add_cb(
+            key, [&]() { return curves::nurbs::get_shared_basis_cache(key); });
+        basis_caches[curve_index] = cache.get();
+      }
+    });
 
-        const int8_t order = orders[curve_index];
-        const bool is_cyclic = cyclic[curve_index];
-        const KnotsMode mode = KnotsMode(knots_modes[curve_index]);
+    Set<const curves::nurbs::BasisCache *> added_caches;
+    this->runtime->nurbs_basis_cache_users.clear();
+    for (const LocalCacheMap &caches : local_caches) {
+      for (const std::shared_ptr<const curves::nurbs::BasisCache> &cache : caches.values()) {
+        if (added_caches.add(cache.get())) {
+          this->runtime->nurbs_basis_cache_users.append(cache);
+        }
+      }
+    }
+  });
+}
 
-        if (!curves::nurbs::check_valid_num_and_order(points.size(), order, is_cyclic, mode)) {
-          basis_caches[curve_index].invalid = true;
-          continue;
+/**
+ * Find the curves that have to be evaluated again for a dirty cache. When the whole cache is
+ * dirty, that is all curves.
+ */
+static IndexMask curves_to_update(const CurvesGeometry &curves,
+                                  const BitVector<> &dirty_curves,
+                                  Vector<int64_t> &r_indices)
+{
+  if (dirty_curves.size() == 0) {
+    return curves.curves_range();
+  }
+  return index_mask_ops::find_indices_based_on_predicate(
+      curves.curves_range(), 4096, r_indices, [&](const int64_t i) {
+        return dirty_curves[i].test();
+      });
+}
+
+/* -------------------------------------------------------------------- */
+/** \name Compact Evaluated Caches
+ * \{ */
+
+/** Reserved for zero length vectors, which the octahedral mapping can't represent. */
+static const short2 zero_direction_code(INT16_MIN, INT16_MIN);
+
+/**
+ * Map a normalized direction to a point on an octahedron that is unfolded to a square, which
+ * spreads the precision of the two integers evenly over the sphere.
+ */
+static short2 encode_direction(const float3 &direction)
+{
+  const float3 abs = math::abs(direction);
+  const float sum = abs.x + abs.y + abs.z;
+  if (sum == 0.0f) {
+    return zero_direction_code;
+  }
+  float2 octahedral = float2(direction.x, direction.y) / sum;
+  if (direction.z < 0.0f) {
+    /* Fold the lower half of the octahedron over the corners of the square. */
+    octahedral = float2((1.0f - std::abs(octahedral.y)) * (octahedral.x < 0.0f ? -1.0f : 1.0f),
+                        (1.0f - std::abs(octahedral.x)) * (octahedral.y < 0.0f ? -1.0f : 1.0f));
+  }
+  return short2(int16_t(std::round(octahedral.x * float(INT16_MAX))),
+                int16_t(std::round(octahedral.y * float(INT16_MAX))));
+}
+
+static float3 decode_direction(const short2 code)
+{
+  if (code == zero_direction_code) {
+    return float3(0.0f);
+  }
+  const float2 octahedral = float2(code) / float(INT16_MAX);
+  float3 direction(
+      octahedral.x, octahedral.y, 1.0f - std::abs(octahedral.x) - std::abs(octahedral.y));
+  if (direction.z < 0.0f) {
+    direction.x = (1.0f - std::abs(octahedral.y)) * (octahedral.x < 0.0f ? -1.0f : 1.0f);
+    direction.y = (1.0f - std::abs(octahedral.x)) * (octahedral.y < 0.0f ? -1.0f : 1.0f);
+  }
+  return math::normalize(direction);
+}
+
+static void encode_directions(Vector<float3> &directions, Vector<short2> &r_codes)
+{
+  r_codes.reinitialize(directions.size());
+  threading::parallel_for(directions.index_range(), 4096, [&](const IndexRange range) {
+    for (const int i : range) {
+      r_codes[i] = encode_direction(directions[i]);
+    }
+  });
+  directions.clear_and_make_inline();
+}
+
+static void decode_directions(const Span<short2> codes, Vector<float3> &r_directions)
+{
+  r_directions.reinitialize(codes.size());
+  threading::parallel_for(codes.index_range(), 4096, [&](const IndexRange range) {
+    for (const int i : range) {
+      r_directions[i] = decode_direction(codes[i]);
+    }
+  });
+}
+
+static void encode_positions(const CurvesGeometry &curves)
+{
+  CurvesGeometryRuntime &runtime = *curves.runtime;
+  const Span<float3> positions = runtime.evaluated_position_cache;
+  runtime.evaluated_position_bounds_compact.reinitialize(curves.curves_num() * 2);
+  runtime.evaluated_position_cache_compact.reinitialize(positions.size());
+  MutableSpan<float3> bounds = runtime.evaluated_position_bounds_compact;
+  MutableSpan<ushort3> codes = runtime.evaluated_position_cache_compact;
+  threading::parallel_for(curves.curves_range(), 512, [&](const IndexRange range) {
+    for (const int curve_index : range) {
+      const IndexRange points = curves.evaluated_points_for_curve(curve_index);
+      float3 min(0.0f);
+      float3 max(0.0f);
+      if (!points.is_empty()) {
+        min = max = positions[points.first()];
+        for (const int i : points) {
+          math::min_max(positions[i], min, max);
         }
+      }
+      bounds[curve_index * 2] = min;
+      bounds[curve_index * 2 + 1] = max;
+      const float3 scale = math::safe_divide(float3(float(UINT16_MAX)), max - min);
+      for (const int i : points) {
+        const float3 code = (positions[i] - min) * scale;
+        codes[i] = ushort3(uint16_t(std::round(code.x)),
+                           uint16_t(std::round(code.y)),
+                           uint16_t(std::round(code.z)));
+      }
+    }
+  });
+  runtime.evaluated_position_cache.clear_and_make_inline();
+  runtime.evaluated_positions_span = {};
+}
+
+static void decode_positions(const CurvesGeometry &curves, Vector<float3> &r_positions)
+{
+  curves.ensure_evaluated_offsets();
+  const CurvesGeometryRuntime &runtime = *curves.runtime;
+  const Span<ushort3> codes = runtime.evaluated_position_cache_compact;
+  const Span<float3> bounds = runtime.evaluated_position_bounds_compact;
+  r_positions.reinitialize(codes.size());
+  threading::parallel_for(curves.curves_range(), 512, [&](const IndexRange range) {
+    for (const int curve_index : range) {
+      const float3 &min = bounds[curve_index * 2];
+      const float3 scale = (bounds[curve_index * 2 + 1] - min) / float(UINT16_MAX);
+      for (const int i : curves.evaluated_points_for_curve(curve_index)) {
+        r_positions[i] = min + float3(codes[i]) * scale;
+      }
+    }
+  });
+}
 
-        const int knots_num = curves::nurbs::knots_num(points.size(), order, is_cyclic);
-        Array<float> knots(knots_num);
-        curves::nurbs::calculate_knots(points.size(), mode, order, is_cyclic, knots);
-        curves::nurbs::calculate_basis_cache(points.size(),
-                                             evaluated_points.size(),
-                                             order,
-                                             is_cyclic,
-                                             knots,
-                                             basis_caches[curve_index]);
+static void encode_lengths(const CurvesGeometry &curves)
+{
+  CurvesGeometryRuntime &runtime = *curves.runtime;
+  const Span<float> lengths = runtime.evaluated_length_cache;
+  const VArray<bool> cyclic = curves.cyclic();
+  runtime.evaluated_length_totals_compact.reinitialize(curves.curves_num());
+  /* Values that don't correspond to a segment are left uninitialized. */
+  runtime.evaluated_length_cache_compact.reinitialize(lengths.size());
+  MutableSpan<float> totals = runtime.evaluated_length_totals_compact;
+  MutableSpan<uint16_t> codes = runtime.evaluated_length_cache_compact;
+  threading::parallel_for(curves.curves_range(), 512, [&](const IndexRange range) {
+    for (const int curve_index : range) {
+      const Span<float> curve_lengths = curves.evaluated_lengths_for_curve(curve_index,
+                                                                           cyclic[curve_index]);
+      const float total = curve_lengths.is_empty() ? 0.0f : curve_lengths.last();
+      totals[curve_index] = total;
+      const float scale = math::safe_divide(float(UINT16_MAX), total);
+      const int start = curve_lengths.data() - lengths.data();
+      for (const int i : curve_lengths.index_range()) {
+        codes[start + i] = uint16_t(std::round(curve_lengths[i] * scale));
       }
-    });
+    }
+  });
+  runtime.evaluated_length_cache.clear_and_make_inline();
+}
+
+static void decode_lengths(const CurvesGeometry &curves, Vector<float> &r_lengths)
+{
+  curves.ensure_evaluated_offsets();
+  const CurvesGeometryRuntime &runtime = *curves.runtime;
+  const Span<uint16_t> codes = runtime.evaluated_length_cache_compact;
+  const Span<float> totals = runtime.evaluated_length_totals_compact;
+  const VArray<bool> cyclic = curves.cyclic();
+  r_lengths.reinitialize(codes.size());
+  threading::parallel_for(curves.curves_range(), 512, [&](const IndexRange range) {
+    for (const int curve_index : range) {
+      const float scale = totals[curve_index] / float(UINT16_MAX);
+      for (const int i : curves.lengths_range_for_curve(curve_index, cyclic[curve_index])) {
+        r_lengths[i] = float(codes[i]) * scale;
+      }
+    }
   });
+}
 
-  this->runtime->nurbs_basis_cache_dirty = false;
+int64_t CurvesGeometry::compact_evaluated_caches() const
+{
+  CurvesGeometryRuntime &runtime = *this->runtime;
+  int64_t bytes_saved = 0;
+  /* Poly curves use the positions directly, which are not a cache. */
+  if (runtime.position_cache_mutex.is_cached() && !runtime.evaluated_position_cache.is_empty()) {
+    bytes_saved += runtime.evaluated_position_cache.size() * (sizeof(float3) - sizeof(ushort3)) -
+                   this->curves_num() * 2 * sizeof(float3);
+    encode_positions(*this);
+    runtime.position_cache_mutex.tag_dirty();
+  }
+  if (runtime.tangent_cache_mutex.is_cached() && !runtime.evaluated_tangent_cache.is_empty()) {
+    bytes_saved += runtime.evaluated_tangent_cache.size() * (sizeof(float3) - sizeof(short2));
+    encode_directions(runtime.evaluated_tangent_cache, runtime.evaluated_tangent_cache_compact);
+    runtime.tangent_cache_mutex.tag_dirty();
+  }
+  if (runtime.normal_cache_mutex.is_cached() && !runtime.evaluated_normal_cache.is_empty()) {
+    bytes_saved += runtime.evaluated_normal_cache.size() * (sizeof(float3) - sizeof(short2));
+    encode_directions(runtime.evaluated_normal_cache, runtime.evaluated_normal_cache_compact);
+    runtime.normal_cache_mutex.tag_dirty();
+  }
+  if (runtime.length_cache_mutex.is_cached() && !runtime.evaluated_length_cache.is_empty()) {
+    bytes_saved += runtime.evaluated_length_cache.size() * (sizeof(float) - sizeof(uint16_t)) -
+                   this->curves_num() * sizeof(float);
+    encode_lengths(*this);
+    runtime.length_cache_mutex.tag_dirty();
+  }
+  return bytes_saved;
 }
 
-Span<float3> CurvesGeometry::evaluated_positions() const
+int64_t CurvesGeometry::compact_evaluated_caches_bytes_saved() const
+{
+  const CurvesGeometryRuntime &runtime = *this->runtime;
+  /* Compact data that was decoded into the cache again doesn't save memory anymore. */
+  int64_t bytes_saved = 0;
+  if (runtime.evaluated_position_cache.is_empty()) {
+    bytes_saved += runtime.evaluated_position_cache_compact.size() *
+                       (sizeof(float3) - sizeof(ushort3)) -
+                   runtime.evaluated_position_bounds_compact.size() * sizeof(float3);
+  }
+  if (runtime.evaluated_tangent_cache.is_empty()) {
+    bytes_saved += runtime.evaluated_tangent_cache_compact.size() *
+                   (sizeof(float3) - sizeof(short2));
+  }
+  if (runtime.evaluated_normal_cache.is_empty()) {
+    bytes_saved += runtime.evaluated_normal_cache_compact.size() *
+                   (sizeof(float3) - sizeof(short2));
+  }
+  if (runtime.evaluated_length_cache.is_empty()) {
+    bytes_saved += runtime.evaluated_length_cache_compact.size() *
+                       (sizeof(float) - sizeof(uint16_t)) -
+                   runtime.evaluated_length_totals_compact.size() * sizeof(float);
+  }
+  return bytes_saved;
+}
+
+/** Free the compact caches, when the data they were created from changes. */
+static void free_compact_caches(CurvesGeometryRuntime &runtime)
+{
+  runtime.evaluated_position_cache_compact.clear_and_make_inline();
+  runtime.evaluated_position_bounds_compact.clear_and_make_inline();
+  runtime.evaluated_tangent_cache_compact.clear_and_make_inline();
+  runtime.evaluated_normal_cache_compact.clear_and_make_inline();
+  runtime.evaluated_length_cache_compact.clear_and_make_inline();
+  runtime.evaluated_length_totals_compact.clear_and_make_inline();
+}
+
+static bool has_compact_caches(const CurvesGeometryRuntime &runtime)
+{
+  return !runtime.evaluated_position_cache_compact.is_empty() ||
+         !runtime.evaluated_tangent_cache_compact.is_empty() ||
+         !runtime.evaluated_normal_cache_compact.is_empty() ||
+         !runtime.evaluated_length_cache_compact.is_empty();
+}
+
+Span<float3> CurvesGeometry::evaluated_positions(Vector<float3> &r_buffer) const
+{
+  if (this->runtime->evaluated_position_cache_compact.is_empty()) {
+    return this->evaluated_positions();
+  }
+  decode_positions(*this, r_buffer);
+  return r_buffer;
+}
+
+Span<float3> CurvesGeometry::evaluated_tangents(Vector<float3> &r_buffer) const
+{
+  if (this->runtime->evaluated_tangent_cache_compact.is_empty()) {
+    return this->evaluated_tangents();
+  }
+  decode_directions(this->runtime->evaluated_tangent_cache_compact, r_buffer);
+  return r_buffer;
+}
+
+Span<float3> CurvesGeometry::evaluated_normals(Vector<float3> &r_buffer) const
 {
-  if (!this->runtime->position_cache_dirty) {
-    return this->runtime->evaluated_positions_span;
+  if (this->runtime->evaluated_normal_cache_compact.is_empty()) {
+    return this->evaluated_normals();
   }
+  decode_directions(this->runtime->evaluated_normal_cache_compact, r_buffer);
+  return r_buffer;
+}
 
-  /* A double checked lock. */
-  std::scoped_lock lock{this->runtime->position_cache_mutex};
-  if (!this->runtime->position_cache_dirty) {
-    return this->runtime->evaluated_positions_span;
+Span<float> CurvesGeometry::evaluated_lengths(Vector<float> &r_buffer) const
+{
+  if (this->runtime->evaluated_length_cache_compact.is_empty()) {
+    this->ensure_evaluated_lengths();
+    return this->runtime->evaluated_length_cache;
   }
+  decode_lengths(*this, r_buffer);
+  return r_buffer;
+}
+
+/** \} */
 
-  threading::isolate_task([&]() {
+Span<float3> CurvesGeometry::evaluated_positions() const
+{
+  this->runtime->position_cache_mutex.ensure([&]() {
+    SCOPED_TRACE_EVENT("cache", "Curves Evaluated Positions");
     if (this->is_single_type(CURVE_TYPE_POLY)) {
       this->runtime->evaluated_positions_span = this->positions();
       this->runtime->evaluated_position_cache.clear_and_make_inline();
+      this->runtime->position_cache_dirty_curves.resize(0);
+      return;
+    }
+
+    if (!this->runtime->evaluated_position_cache_compact.is_empty()) {
+      decode_positions(*this, this->runtime->evaluated_position_cache);
+      this->runtime->evaluated_positions_span = this->runtime->evaluated_position_cache;
       return;
     }
 
@@ -636,9 +1052,13 @@ Span<float3> CurvesGeometry::evaluated_positions() const
     MutableSpan<float3> evaluated_positions = this->runtime->evaluated_position_cache;
     this->runtime->evaluated_positions_span = evaluated_positions;
 
+    Vector<int64_t> curve_indices;
+    const IndexMask curves_mask = curves_to_update(
+        *this, this->runtime->position_cache_dirty_curves, curve_indices);
+
     VArray<int8_t> types = this->curve_types();
     VArray<bool> cyclic = this->cyclic();
-    VArray<int> resolution = this->resolution();
+    VArray<int> resolution = this->evaluated_resolution();
     Span<float3> positions = this->positions();
 
     Span<float3> handle_positions_left = this->handle_positions_left();
@@ -650,8 +1070,8 @@ Span<float3> CurvesGeometry::evaluated_positions() const
 
     this->ensure_nurbs_basis_cache();
 
-    threading::parallel_for(this->curves_range(), 128, [&](IndexRange curves_range) {
-      for (const int curve_index : curves_range) {
+    threading::parallel_for(curves_mask.index_range(), 128, [&](IndexRange range) {
+      for (const int curve_index : curves_mask.slice(range)) {
         const IndexRange points = this->points_for_curve(curve_index);
         const IndexRange evaluated_points = this->evaluated_points_for_curve(curve_index);
 
@@ -674,47 +1094,54 @@ Span<float3> CurvesGeometry::evaluated_positions() const
                 bezier_evaluated_offsets.slice(points),
                 evaluated_positions.slice(evaluated_points));
             break;
-          case CURVE_TYPE_NURBS: {
-            curves::nurbs::interpolate_to_evaluated(this->runtime->nurbs_basis_cache[curve_index],
-                                                    nurbs_orders[curve_index],
-                                                    nurbs_weights.slice(points),
-                                                    positions.slice(points),
-                                                    evaluated_positions.slice(evaluated_points));
+          case CURVE_TYPE_NURBS:
+            /* Evaluated for all curves at once below. */
             break;
-          }
           default:
             BLI_assert_unreachable();
             break;
         }
       }
     });
-  });
 
-  this->runtime->position_cache_dirty = false;
+    Vector<int64_t> nurbs_indices;
+    const IndexMask nurbs_mask = this->indices_for_curve_type(
+        CURVE_TYPE_NURBS, curves_mask, nurbs_indices);
+    curves::nurbs::interpolate_to_evaluated(this->runtime->nurbs_basis_cache,
+                                            nurbs_orders,
+                                            nurbs_weights,
+                                            this->offsets(),
+                                            this->runtime->evaluated_offsets_cache,
+                                            nurbs_mask,
+                                            positions,
+                                            evaluated_positions);
+
+    this->runtime->position_cache_dirty_curves.resize(0);
+  });
   return this->runtime->evaluated_positions_span;
 }
 
 Span<float3> CurvesGeometry::evaluated_tangents() const
 {
-  if (!this->runtime->tangent_cache_dirty) {
-    return this->runtime->evaluated_tangent_cache;
-  }
-
-  /* A double checked lock. */
-  std::scoped_lock lock{this->runtime->tangent_cache_mutex};
-  if (!this->runtime->tangent_cache_dirty) {
-    return this->runtime->evaluated_tangent_cache;
-  }
-
-  threading::isolate_task([&]() {
+  this->runtime->tangent_cache_mutex.ensure([&]() {
+    SCOPED_TRACE_EVENT("cache", "Curves Evaluated Tangents");
+    if (!this->runtime->evaluated_tangent_cache_compact.is_empty()) {
+      decode_directions(this->runtime->evaluated_tangent_cache_compact,
+                        this->runtime->evaluated_tangent_cache);
+      return;
+    }
     const Span<float3> evaluated_positions = this->evaluated_positions();
     const VArray<bool> cyclic = this->cyclic();
 
     this->runtime->evaluated_tangent_cache.resize(this->evaluated_points_num());
     MutableSpan<float3> tangents = this->runtime->evaluated_tangent_cache;
 
-    threading::parallel_for(this->curves_range(), 128, [&](IndexRange curves_range) {
-      for (const int curve_index : curves_range) {
+    Vector<int64_t> curve_indices;
+    const IndexMask curves_mask = curves_to_update(
+        *this, this->runtime->tangent_cache_dirty_curves, curve_indices);
+
+    threading::parallel_for(curves_mask.index_range(), 128, [&](IndexRange range) {
+      for (const int curve_index : curves_mask.slice(range)) {
         const IndexRange evaluated_points = this->evaluated_points_for_curve(curve_index);
         curves::poly::calculate_tangents(evaluated_positions.slice(evaluated_points),
                                          cyclic[curve_index],
@@ -726,7 +1153,8 @@ Span<float3> CurvesGeometry::evaluated_tangents() const
      * inner handles. This is a separate loop to avoid the cost when Bezier type curves are not
      * used. */
     Vector<int64_t> bezier_indices;
-    const IndexMask bezier_mask = this->indices_for_curve_type(CURVE_TYPE_BEZIER, bezier_indices);
+    const IndexMask bezier_mask = this->indices_for_curve_type(
+        CURVE_TYPE_BEZIER, curves_mask, bezier_indices);
     if (!bezier_mask.is_empty()) {
       const Span<float3> positions = this->positions();
       const Span<float3> handles_left = this->handle_positions_left();
@@ -754,9 +1182,9 @@ Span<float3> CurvesGeometry::evaluated_tangents() const
         }
       });
     }
-  });
 
-  this->runtime->tangent_cache_dirty = false;
+    this->runtime->tangent_cache_dirty_curves.resize(0);
+  });
   return this->runtime->evaluated_tangent_cache;
 }
 
@@ -771,17 +1199,13 @@ static void rotate_directions_around_axes(MutableSpan<float3> directions,
 
 Span<float3> CurvesGeometry::evaluated_normals() const
 {
-  if (!this->runtime->normal_cache_dirty) {
-    return this->runtime->evaluated_normal_cache;
-  }
-
-  /* A double checked lock. */
-  std::scoped_lock lock{this->runtime->normal_cache_mutex};
-  if (!this->runtime->normal_cache_dirty) {
-    return this->runtime->evaluated_normal_cache;
-  }
-
-  threading::isolate_task([&]() {
+  this->runtime->normal_cache_mutex.ensure([&]() {
+    SCOPED_TRACE_EVENT("cache", "Curves Evaluated Normals");
+    if (!this->runtime->evaluated_normal_cache_compact.is_empty()) {
+      decode_directions(this->runtime->evaluated_normal_cache_compact,
+                        this->runtime->evaluated_normal_cache);
+      return;
+    }
     const Span<float3> evaluated_tangents = this->evaluated_tangents();
     const VArray<bool> cyclic = this->cyclic();
     const VArray<int8_t> normal_mode = this->normal_mode();
@@ -791,11 +1215,15 @@ Span<float3> CurvesGeometry::evaluated_normals() const
     this->runtime->evaluated_normal_cache.resize(this->evaluated_points_num());
     MutableSpan<float3> evaluated_normals = this->runtime->evaluated_normal_cache;
 
-    threading::parallel_for(this->curves_range(), 128, [&](IndexRange curves_range) {
+    Vector<int64_t> curve_indices;
+    const IndexMask curves_mask = curves_to_update(
+        *this, this->runtime->normal_cache_dirty_curves, curve_indices);
+
+    threading::parallel_for(curves_mask.index_range(), 128, [&](IndexRange range) {
       /* Reuse a buffer for the evaluated tilts. */
       Vector<float> evaluated_tilts;
 
-      for (const int curve_index : curves_range) {
+      for (const int curve_index : curves_mask.slice(range)) {
         const IndexRange evaluated_points = this->evaluated_points_for_curve(curve_index);
         switch (normal_mode[curve_index]) {
           case NORMAL_MODE_Z_UP:
@@ -831,9 +1259,9 @@ Span<float3> CurvesGeometry::evaluated_normals() const
         }
       }
     });
-  });
 
-  this->runtime->normal_cache_dirty = false;
+    this->runtime->normal_cache_dirty_curves.resize(0);
+  });
   return this->runtime->evaluated_normal_cache;
 }
 
@@ -841,15 +1269,15 @@ void CurvesGeometry::interpolate_to_evaluated(const int curve_index,
                                               const GSpan src,
                                               GMutableSpan dst) const
 {
-  BLI_assert(!this->runtime->offsets_cache_dirty);
-  BLI_assert(!this->runtime->nurbs_basis_cache_dirty);
+  BLI_assert(this->runtime->offsets_cache_mutex.is_cached());
+  BLI_assert(this->runtime->nurbs_basis_cache_mutex.is_cached());
   const IndexRange points = this->points_for_curve(curve_index);
   BLI_assert(src.size() == points.size());
   BLI_assert(dst.size() == this->evaluated_points_for_curve(curve_index).size());
   switch (this->curve_types()[curve_index]) {
     case CURVE_TYPE_CATMULL_ROM:
       curves::catmull_rom::interpolate_to_evaluated(
-          src, this->cyclic()[curve_index], this->resolution()[curve_index], dst);
+          src, this->cyclic()[curve_index], this->evaluated_resolution()[curve_index], dst);
       return;
     case CURVE_TYPE_POLY:
       dst.type().copy_assign_n(src.data(), dst.data(), src.size());
@@ -859,7 +1287,7 @@ void CurvesGeometry::interpolate_to_evaluated(const int curve_index,
           src, this->runtime->bezier_evaluated_offsets.as_span().slice(points), dst);
       return;
     case CURVE_TYPE_NURBS:
-      curves::nurbs::interpolate_to_evaluated(this->runtime->nurbs_basis_cache[curve_index],
+      curves::nurbs::interpolate_to_evaluated(*this->runtime->nurbs_basis_cache[curve_index],
                                               this->nurbs_orders()[curve_index],
                                               this->nurbs_weights().slice(points),
                                               src,
@@ -871,10 +1299,10 @@ void CurvesGeometry::interpolate_to_evaluated(const int curve_index,
 
 void CurvesGeometry::interpolate_to_evaluated(const GSpan src, GMutableSpan dst) const
 {
-  BLI_assert(!this->runtime->offsets_cache_dirty);
-  BLI_assert(!this->runtime->nurbs_basis_cache_dirty);
+  BLI_assert(this->runtime->offsets_cache_mutex.is_cached());
+  BLI_assert(this->runtime->nurbs_basis_cache_mutex.is_cached());
   const VArray<int8_t> types = this->curve_types();
-  const VArray<int> resolution = this->resolution();
+  const VArray<int> resolution = this->evaluated_resolution();
   const VArray<bool> cyclic = this->cyclic();
   const VArray<int8_t> nurbs_orders = this->nurbs_orders();
   const Span<float> nurbs_weights = this->nurbs_weights();
@@ -900,30 +1328,32 @@ void CurvesGeometry::interpolate_to_evaluated(const GSpan src, GMutableSpan dst)
               dst.slice(evaluated_points));
           continue;
         case CURVE_TYPE_NURBS:
-          curves::nurbs::interpolate_to_evaluated(this->runtime->nurbs_basis_cache[curve_index],
-                                                  nurbs_orders[curve_index],
-                                                  nurbs_weights.slice(points),
-                                                  src.slice(points),
-                                                  dst.slice(evaluated_points));
+          /* Evaluated for all curves at once below. */
           continue;
       }
     }
   });
+
+  Vector<int64_t> nurbs_indices;
+  const IndexMask nurbs_mask = this->indices_for_curve_type(CURVE_TYPE_NURBS, nurbs_indices);
+  curves::nurbs::interpolate_to_evaluated(this->runtime->nurbs_basis_cache,
+                                          nurbs_orders,
+                                          nurbs_weights,
+                                          this->offsets(),
+                                          this->runtime->evaluated_offsets_cache,
+                                          nurbs_mask,
+                                          src,
+                                          dst);
 }
 
 void CurvesGeometry::ensure_evaluated_lengths() const
 {
-  if (!this->runtime->length_cache_dirty) {
-    return;
-  }
-
-  /* A double checked lock. */
-  std::scoped_lock lock{this->runtime->length_cache_mutex};
-  if (!this->runtime->length_cache_dirty) {
-    return;
-  }
-
-  threading::isolate_task([&]() {
+  this->runtime->length_cache_mutex.ensure([&]() {
+    SCOPED_TRACE_EVENT("cache", "Curves Evaluated Lengths");
+    if (!this->runtime->evaluated_length_cache_compact.is_empty()) {
+      decode_lengths(*this, this->runtime->evaluated_length_cache);
+      return;
+    }
     /* Use an extra length value for the final cyclic segment for a consistent size
      * (see comment on #evaluated_length_cache). */
     const int total_num = this->evaluated_points_num() + this->curves_num();
@@ -933,8 +1363,12 @@ void CurvesGeometry::ensure_evaluated_lengths() const
     Span<float3> evaluated_positions = this->evaluated_positions();
     VArray<bool> curves_cyclic = this->cyclic();
 
-    threading::parallel_for(this->curves_range(), 128, [&](IndexRange curves_range) {
-      for (const int curve_index : curves_range) {
+    Vector<int64_t> curve_indices;
+    const IndexMask curves_mask = curves_to_update(
+        *this, this->runtime->length_cache_dirty_curves, curve_indices);
+
+    threading::parallel_for(curves_mask.index_range(), 128, [&](IndexRange range) {
+      for (const int curve_index : curves_mask.slice(range)) {
         const bool cyclic = curves_cyclic[curve_index];
         const IndexRange evaluated_points = this->evaluated_points_for_curve(curve_index);
         const IndexRange lengths_range = this->lengths_range_for_curve(curve_index, cyclic);
@@ -943,9 +1377,124 @@ void CurvesGeometry::ensure_evaluated_lengths() const
                                                 evaluated_lengths.slice(lengths_range));
       }
     });
+
+    this->runtime->length_cache_dirty_curves.resize(0);
+  });
+}
+
+void CurvesGeometry::ensure_evaluated_lengths_precise() const
+{
+  this->runtime->length_precise_cache_mutex.ensure([&]() {
+    SCOPED_TRACE_EVENT("cache", "Curves Precise Evaluated Lengths");
+    /* Use the same layout as #evaluated_length_cache. */
+    const int total_num = this->evaluated_points_num() + this->curves_num();
+    this->runtime->evaluated_length_precise_cache.resize(total_num);
+    MutableSpan<float> evaluated_lengths = this->runtime->evaluated_length_precise_cache;
+
+    /* The lengths of other curve types are the same as the lengths of the evaluated edges. */
+    Span<float3> evaluated_positions;
+    if (this->has_curve_with_type({CURVE_TYPE_POLY, CURVE_TYPE_CATMULL_ROM})) {
+      evaluated_positions = this->evaluated_positions();
+    }
+
+    VArray<int8_t> types = this->curve_types();
+    VArray<bool> curves_cyclic = this->cyclic();
+    VArray<int> resolution = this->evaluated_resolution();
+    Span<float3> positions = this->positions();
+
+    Span<float3> handle_positions_left = this->handle_positions_left();
+    Span<float3> handle_positions_right = this->handle_positions_right();
+    Span<int> bezier_evaluated_offsets = this->runtime->bezier_evaluated_offsets;
+
+    VArray<int8_t> nurbs_orders = this->nurbs_orders();
+    VArray<int8_t> nurbs_knots_modes = this->nurbs_knots_modes();
+    Span<float> nurbs_weights = this->nurbs_weights();
+
+    Vector<int64_t> curve_indices;
+    const IndexMask curves_mask = curves_to_update(
+        *this, this->runtime->length_precise_cache_dirty_curves, curve_indices);
+
+    threading::parallel_for(curves_mask.index_range(), 64, [&](IndexRange range) {
+      for (const int curve_index : curves_mask.slice(range)) {
+        const bool cyclic = curves_cyclic[curve_index];
+        const IndexRange points = this->points_for_curve(curve_index);
+        const IndexRange evaluated_points = this->evaluated_points_for_curve(curve_index);
+        MutableSpan<float> lengths = evaluated_lengths.slice(
+            this->lengths_range_for_curve(curve_index, cyclic));
+
+        switch (types[curve_index]) {
+          case CURVE_TYPE_CATMULL_ROM:
+          case CURVE_TYPE_POLY:
+            length_parameterize::accumulate_lengths(
+                evaluated_positions.slice(evaluated_points), cyclic, lengths);
+            break;
+          case CURVE_TYPE_BEZIER:
+            curves::bezier::calculate_evaluated_lengths_precise(
+                positions.slice(points),
+                handle_positions_left.slice(points),
+                handle_positions_right.slice(points),
+                bezier_evaluated_offsets.slice(points),
+                cyclic,
+                lengths);
+            break;
+          case CURVE_TYPE_NURBS:
+            curves::nurbs::calculate_evaluated_lengths_precise(
+                positions.slice(points),
+                nurbs_weights.slice(points),
+                nurbs_orders[curve_index],
+                cyclic,
+                resolution[curve_index],
+                KnotsMode(nurbs_knots_modes[curve_index]),
+                lengths);
+            break;
+          default:
+            BLI_assert_unreachable();
+            break;
+        }
+      }
+    });
+
+    this->runtime->length_precise_cache_dirty_curves.resize(0);
   });
+}
+
+BVHTree *CurvesGeometry::evaluated_segments_bvh() const
+{
+  this->runtime->evaluated_segments_bvh_mutex.ensure([&]() {
+    SCOPED_TRACE_EVENT("cache", "Curves Evaluated Segments BVH");
+    BVHTree *&tree = this->runtime->evaluated_segments_bvh;
+    if (tree != nullptr) {
+      BLI_bvhtree_free(tree);
+      tree = nullptr;
+    }
+    const int evaluated_num = this->evaluated_points_num();
+    if (evaluated_num == 0) {
+      return;
+    }
+    const Span<float3> positions = this->evaluated_positions();
+    const VArray<bool> cyclic = this->cyclic();
 
-  this->runtime->length_cache_dirty = false;
+    tree = BLI_bvhtree_new(evaluated_num, 0.0f, 2, 6);
+    for (const int curve_index : this->curves_range()) {
+      const IndexRange points = this->evaluated_points_for_curve(curve_index);
+      if (points.size() <= 1) {
+        if (points.size() == 1) {
+          BLI_bvhtree_insert(tree, points.first(), positions[points.first()], 1);
+        }
+        continue;
+      }
+      /* The two points of every edge are next to each other in the evaluated positions. */
+      for (const int i : points.drop_back(1)) {
+        BLI_bvhtree_insert(tree, i, positions[i], 2);
+      }
+      if (cyclic[curve_index]) {
+        const float3 cyclic_edge[2] = {positions[points.last()], positions[points.first()]};
+        BLI_bvhtree_insert(tree, points.last(), cyclic_edge[0], 2);
+      }
+    }
+    BLI_bvhtree_balance(tree);
+  });
+  return this->runtime->evaluated_segments_bvh;
 }
 
 void CurvesGeometry::ensure_can_interpolate_to_evaluated() const
@@ -974,25 +1523,115 @@ void CurvesGeometry::resize(const int points_num, const int curves_num)
   this->tag_topology_changed();
 }
 
+/** Tag a cache to be recalculated completely. */
+static void tag_cache_dirty(CacheMutex &cache_mutex, BitVector<> &dirty_curves)
+{
+  cache_mutex.tag_dirty();
+  dirty_curves.resize(0);
+}
+
+/** Record that all curves may have changed, see #CurvesGeometryRuntime::change_stamp. */
+static void record_all_curves_changed(CurvesGeometryRuntime &runtime)
+{
+  runtime.change_stamp = next_change_stamp();
+  runtime.changed_curves_start_stamp = runtime.change_stamp;
+  runtime.changed_curves.resize(0);
+}
+
+static void record_curves_changed(CurvesGeometryRuntime &runtime,
+                                  const IndexMask changed_curves,
+                                  const int curves_num)
+{
+  runtime.change_stamp = next_change_stamp();
+  if (runtime.changed_curves.size() == 0) {
+    runtime.changed_curves.resize(curves_num, false);
+  }
+  for (const int64_t curve_index : changed_curves) {
+    runtime.changed_curves[curve_index].set();
+  }
+}
+
+/** Tag a cache to be recalculated for some curves, unless it is already completely dirty. */
+static void tag_cache_curves_dirty(CacheMutex &cache_mutex,
+                                   BitVector<> &dirty_curves,
+                                   const IndexMask changed_curves,
+                                   const int curves_num)
+{
+  if (cache_mutex.is_dirty() && dirty_curves.size() == 0) {
+    return;
+  }
+  if (dirty_curves.size() == 0) {
+    dirty_curves.resize(curves_num, false);
+  }
+  for (const int64_t curve_index : changed_curves) {
+    dirty_curves[curve_index].set();
+  }
+  cache_mutex.tag_dirty();
+}
+
 void CurvesGeometry::tag_positions_changed()
 {
-  this->runtime->position_cache_dirty = true;
-  this->runtime->tangent_cache_dirty = true;
-  this->runtime->normal_cache_dirty = true;
-  this->runtime->length_cache_dirty = true;
+  CurvesGeometryRuntime &runtime = *this->runtime;
+  record_all_curves_changed(runtime);
+  free_compact_caches(runtime);
+  tag_cache_dirty(runtime.position_cache_mutex, runtime.position_cache_dirty_curves);
+  tag_cache_dirty(runtime.tangent_cache_mutex, runtime.tangent_cache_dirty_curves);
+  tag_cache_dirty(runtime.normal_cache_mutex, runtime.normal_cache_dirty_curves);
+  tag_cache_dirty(runtime.length_cache_mutex, runtime.length_cache_dirty_curves);
+  tag_cache_dirty(runtime.length_precise_cache_mutex, runtime.length_precise_cache_dirty_curves);
+  runtime.evaluated_segments_bvh_mutex.tag_dirty();
+  if (has_resolution_tolerance(*this)) {
+    /* The number of evaluated points depends on the positions. */
+    runtime.offsets_cache_mutex.tag_dirty();
+    runtime.nurbs_basis_cache_mutex.tag_dirty();
+  }
+}
+void CurvesGeometry::tag_positions_changed(const IndexMask changed_curves)
+{
+  if (changed_curves.is_empty()) {
+    return;
+  }
+  if (has_resolution_tolerance(*this)) {
+    /* Changing the number of evaluated points of some curves moves the points of all others. */
+    this->tag_positions_changed();
+    return;
+  }
+  if (has_compact_caches(*this->runtime)) {
+    /* The compact caches can only be decoded completely. */
+    this->tag_positions_changed();
+    return;
+  }
+  CurvesGeometryRuntime &runtime = *this->runtime;
+  const int curves_num = this->curves_num();
+  record_curves_changed(runtime, changed_curves, curves_num);
+  tag_cache_curves_dirty(runtime.position_cache_mutex,
+                         runtime.position_cache_dirty_curves,
+                         changed_curves,
+                         curves_num);
+  tag_cache_curves_dirty(
+      runtime.tangent_cache_mutex, runtime.tangent_cache_dirty_curves, changed_curves, curves_num);
+  tag_cache_curves_dirty(
+      runtime.normal_cache_mutex, runtime.normal_cache_dirty_curves, changed_curves, curves_num);
+  tag_cache_curves_dirty(
+      runtime.length_cache_mutex, runtime.length_cache_dirty_curves, changed_curves, curves_num);
+  tag_cache_curves_dirty(runtime.length_precise_cache_mutex,
+                         runtime.length_precise_cache_dirty_curves,
+                         changed_curves,
+                         curves_num);
+  /* The tree is rebuilt completely, since its bounds depend on all curves. */
+  runtime.evaluated_segments_bvh_mutex.tag_dirty();
 }
 void CurvesGeometry::tag_topology_changed()
 {
-  this->runtime->position_cache_dirty = true;
-  this->runtime->tangent_cache_dirty = true;
-  this->runtime->normal_cache_dirty = true;
-  this->runtime->offsets_cache_dirty = true;
-  this->runtime->nurbs_basis_cache_dirty = true;
-  this->runtime->length_cache_dirty = true;
+  this->tag_positions_changed();
+  this->runtime->offsets_cache_mutex.tag_dirty();
+  this->runtime->nurbs_basis_cache_mutex.tag_dirty();
 }
 void CurvesGeometry::tag_normals_changed()
 {
-  this->runtime->normal_cache_dirty = true;
+  record_all_curves_changed(*this->runtime);
+  tag_cache_dirty(this->runtime->normal_cache_mutex, this->runtime->normal_cache_dirty_curves);
+  this->runtime->evaluated_normal_cache_compact.clear_and_make_inline();
 }
 
 static void translate_positions(MutableSpan<float3> positions, const float3 &translation)
@@ -1558,6 +2197,7 @@ GVArray CurvesGeometry::adapt_domain(const GVArray &varray,
   if (from == to) {
     return varray;
   }
+  SCOPED_TRACE_EVENT("attribute", "Interpolate Curve Attribute");
 
   if (from == ATTR_DOMAIN_POINT && to == ATTR_DOMAIN_CURVE) {
     return adapt_curve_domain_point_to_curve(*this, varray);
@@ -1572,4 +2212,115 @@ GVArray CurvesGeometry::adapt_domain(const GVArray &varray,
 
 /** \} */
 
+/* -------------------------------------------------------------------- */
+/** \name Runtime Backup
+ * \{ */
+
+CurvesGeometryRuntime *curves_runtime_backup(CurvesGeometry &curves)
+{
+  CurvesGeometryRuntime *backup = curves.runtime;
+  curves.runtime = MEM_new<CurvesGeometryRuntime>(__func__);
+  curves.runtime->type_counts = backup->type_counts;
+  return backup;
+}
+
+/** Move a cache that is valid or only dirty for some curves. */
+template<typename T>
+static void reuse_cache(CacheMutex &src_mutex,
+                        Vector<T> &src_cache,
+                        BitVector<> &src_dirty_curves,
+                        CacheMutex &dst_mutex,
+                        Vector<T> &dst_cache,
+                        BitVector<> &dst_dirty_curves)
+{
+  if (src_mutex.is_cached()) {
+    dst_mutex.ensure([&]() { dst_cache = std::move(src_cache); });
+  }
+  else if (src_dirty_curves.size() > 0) {
+    dst_cache = std::move(src_cache);
+    dst_dirty_curves = std::move(src_dirty_curves);
+  }
+}
+
+static void reuse_evaluated_caches(CurvesGeometryRuntime &src, CurvesGeometryRuntime &dst)
+{
+  if (!src.offsets_cache_mutex.is_cached()) {
+    /* The other caches can't be used without the evaluated offsets they were created with. */
+    return;
+  }
+  dst.offsets_cache_mutex.ensure([&]() {
+    dst.evaluated_offsets_cache = std::move(src.evaluated_offsets_cache);
+    dst.bezier_evaluated_offsets = std::move(src.bezier_evaluated_offsets);
+    dst.evaluated_resolution_cache = std::move(src.evaluated_resolution_cache);
+  });
+  if (src.nurbs_basis_cache_mutex.is_cached()) {
+    dst.nurbs_basis_cache_mutex.ensure([&]() {
+      dst.nurbs_basis_cache = std::move(src.nurbs_basis_cache);
+      dst.nurbs_basis_cache_users = std::move(src.nurbs_basis_cache_users);
+    });
+  }
+  /* Poly curves use the positions directly, which don't exist anymore. */
+  if (!src.evaluated_position_cache.is_empty()) {
+    reuse_cache(src.position_cache_mutex,
+                src.evaluated_position_cache,
+                src.position_cache_dirty_curves,
+                dst.position_cache_mutex,
+                dst.evaluated_position_cache,
+                dst.position_cache_dirty_curves);
+    dst.evaluated_positions_span = dst.evaluated_position_cache;
+  }
+  reuse_cache(src.tangent_cache_mutex,
+              src.evaluated_tangent_cache,
+              src.tangent_cache_dirty_curves,
+              dst.tangent_cache_mutex,
+              dst.evaluated_tangent_cache,
+              dst.tangent_cache_dirty_curves);
+  reuse_cache(src.normal_cache_mutex,
+              src.evaluated_normal_cache,
+              src.normal_cache_dirty_curves,
+              dst.normal_cache_mutex,
+              dst.evaluated_normal_cache,
+              dst.normal_cache_dirty_curves);
+  reuse_cache(src.length_cache_mutex,
+              src.evaluated_length_cache,
+              src.length_cache_dirty_curves,
+              dst.length_cache_mutex,
+              dst.evaluated_length_cache,
+              dst.length_cache_dirty_curves);
+  reuse_cache(src.length_precise_cache_mutex,
+              src.evaluated_length_precise_cache,
+              src.length_precise_cache_dirty_curves,
+              dst.length_precise_cache_mutex,
+              dst.evaluated_length_precise_cache,
+              dst.length_precise_cache_dirty_curves);
+}
+
+void curves_runtime_backup_restore(CurvesGeometry &curves,
+                                   const CurvesGeometry &curves_orig,
+                                   CurvesGeometryRuntime *backup)
+{
+  const CurvesGeometryRuntime &orig_runtime = *curves_orig.runtime;
+  const int64_t backup_stamp = backup->copied_change_stamp;
+  /* The original must have a record of all changes since the backup was copied from it, and
+   * there must be recorded changes, since other updates may change the original without
+   * tagging it. */
+  const bool changes_known = backup_stamp != 0 &&
+                             backup_stamp >= orig_runtime.changed_curves_start_stamp &&
+                             backup_stamp < orig_runtime.change_stamp;
+  if (changes_known && curves.runtime->copied_change_stamp == orig_runtime.change_stamp &&
+      orig_runtime.changed_curves.size() == curves.curves_num() && !has_compact_caches(*backup)) {
+    reuse_evaluated_caches(*backup, *curves.runtime);
+    /* The record can contain curves that changed before the backup was made, which is fine. */
+    Vector<int64_t> indices;
+    const IndexMask changed_curves = index_mask_ops::find_indices_based_on_predicate(
+        curves.curves_range(), 4096, indices, [&](const int64_t i) {
+          return orig_runtime.changed_curves[i].test();
+        });
+    curves.tag_positions_changed(changed_curves);
+  }
+  MEM_delete(backup);
+}
+
+/** \} */
+
 }  // namespace blender::bke
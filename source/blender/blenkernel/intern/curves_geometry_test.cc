@@ -5,6 +5,10 @@
  */
 
 #include "BKE_curves.hh"
+#include "BKE_idtype.h"
+#include "BKE_lib_id.h"
+
+#include "DNA_curves_types.h"
 
 #include "testing/testing.h"
 
@@ -63,6 +67,55 @@ TEST(curves_geometry, Move)
   EXPECT_EQ(second_other.offsets().data(), offsets_data);
 }
 
+TEST(curves_geometry, CopyAttributes)
+{
+  CurvesGeometry curves = create_basic_curves(100, 10);
+  const float3 *positions_data = curves.positions().data();
+
+  /* Plain copies may be made from original data, so they don't share attributes. */
+  CurvesGeometry copy = curves;
+  EXPECT_NE(copy.positions().data(), positions_data);
+  copy.positions_for_write().first() = float3(-1.0f);
+  EXPECT_EQ(curves.positions().first(), float3(0.0f));
+  EXPECT_EQ(copy.positions().first(), float3(-1.0f));
+}
+
+TEST(curves_geometry, CopySharesAttributes)
+{
+  BKE_idtype_init();
+  Curves *curves_id = curves_new_nomain(create_basic_curves(100, 10));
+  CurvesGeometry &curves = CurvesGeometry::wrap(curves_id->geometry);
+  const float3 *positions_data = curves.positions().data();
+
+  {
+    Curves *copy_id = (Curves *)BKE_id_copy_ex(
+        nullptr, &curves_id->id, nullptr, LIB_ID_COPY_LOCALIZE | LIB_ID_COPY_CD_SHARE);
+    CurvesGeometry &copy = CurvesGeometry::wrap(copy_id->geometry);
+    EXPECT_EQ(copy.positions().data(), positions_data);
+
+    /* Writing to the copy must not change the original. */
+    copy.positions_for_write().first() = float3(-1.0f);
+    EXPECT_NE(copy.positions().data(), positions_data);
+    EXPECT_EQ(curves.positions().first(), float3(0.0f));
+    EXPECT_EQ(copy.positions().first(), float3(-1.0f));
+    BKE_id_free(nullptr, copy_id);
+  }
+
+  /* The copy is gone, so the original can write to the data again without copying it. */
+  curves.positions_for_write().first() = float3(1.0f);
+  EXPECT_EQ(curves.positions().data(), positions_data);
+
+  /* Resizing a shared attribute must not change the other curves either. */
+  Curves *copy_id = (Curves *)BKE_id_copy_ex(
+      nullptr, &curves_id->id, nullptr, LIB_ID_COPY_LOCALIZE | LIB_ID_COPY_CD_SHARE);
+  CurvesGeometry::wrap(copy_id->geometry).resize(200, 20);
+  EXPECT_EQ(curves.positions().data(), positions_data);
+  EXPECT_EQ(curves.positions().first(), float3(1.0f));
+
+  BKE_id_free(nullptr, copy_id);
+  BKE_id_free(nullptr, curves_id);
+}
+
 TEST(curves_geometry, TypeCount)
 {
   CurvesGeometry curves = create_basic_curves(100, 10);
@@ -405,6 +458,313 @@ TEST(curves_geometry, NURBSEvaluation)
   }
 }
 
+TEST(curves_geometry, NURBSBasisCacheSharing)
+{
+  CurvesGeometry curves = create_basic_curves(12, 3);
+  curves.fill_curve_types(CURVE_TYPE_NURBS);
+  curves.resolution_for_write().fill(8);
+  curves.resolution_for_write()[2] = 4;
+  curves.ensure_can_interpolate_to_evaluated();
+
+  /* Curves with the same properties use the same cache. */
+  Span<const curves::nurbs::BasisCache *> caches = curves.runtime->nurbs_basis_cache;
+  EXPECT_EQ(caches[0], caches[1]);
+  EXPECT_NE(caches[0], caches[2]);
+  EXPECT_EQ(curves.runtime->nurbs_basis_cache_users.size(), 2);
+
+  /* The caches are shared with copies and with other geometries with the same curves. */
+  CurvesGeometry copy = curves;
+  copy.ensure_can_interpolate_to_evaluated();
+  EXPECT_EQ(copy.runtime->nurbs_basis_cache[0], caches[0]);
+  CurvesGeometry other = create_basic_curves(8, 2);
+  other.fill_curve_types(CURVE_TYPE_NURBS);
+  other.resolution_for_write().fill(4);
+  other.ensure_can_interpolate_to_evaluated();
+  EXPECT_EQ(other.runtime->nurbs_basis_cache[1], caches[2]);
+
+  /* Check that evaluating with shared caches gives the same results as separate curves. */
+  Span<float3> evaluated_positions = curves.evaluated_positions();
+  CurvesGeometry single = create_basic_curves(4, 1);
+  single.fill_curve_types(CURVE_TYPE_NURBS);
+  single.resolution_for_write().fill(8);
+  single.positions_for_write().copy_from(curves.positions().slice(4, 4));
+  Span<float3> single_evaluated_positions = single.evaluated_positions();
+  Span<float3> curve_evaluated_positions = evaluated_positions.slice(
+      curves.evaluated_points_for_curve(1));
+  ASSERT_EQ(single_evaluated_positions.size(), curve_evaluated_positions.size());
+  for (const int i : single_evaluated_positions.index_range()) {
+    EXPECT_V3_NEAR(single_evaluated_positions[i], curve_evaluated_positions[i], 1e-6f);
+  }
+}
+
+TEST(curves_geometry, NURBSInterpolateManyCurves)
+{
+  /* Mix orders with and without a specialized kernel, cyclic curves and control point weights. */
+  CurvesGeometry curves = create_basic_curves(64, 8);
+  curves.fill_curve_types(CURVE_TYPE_NURBS);
+  curves.resolution_for_write().fill(6);
+  MutableSpan<int8_t> orders = curves.nurbs_orders_for_write();
+  MutableSpan<bool> cyclic = curves.cyclic_for_write();
+  for (const int i : curves.curves_range()) {
+    orders[i] = 2 + i;
+    cyclic[i] = i % 2;
+  }
+  MutableSpan<float> weights = curves.nurbs_weights_for_write();
+  for (const int i : weights.index_range()) {
+    weights[i] = 1.0f + (i % 3) * 0.5f;
+  }
+  curves.ensure_can_interpolate_to_evaluated();
+
+  Array<float2> src(curves.points_num());
+  Array<ColorGeometry4f> src_color(curves.points_num());
+  for (const int i : src.index_range()) {
+    src[i] = {float(i % 5), float(i % 7)};
+    src_color[i] = {src[i].x, src[i].y, 0.0f, 1.0f};
+  }
+
+  /* The specialized kernel for all curves at once matches the generic one used for colors. */
+  Array<float2> dst(curves.evaluated_points_num());
+  Array<ColorGeometry4f> dst_color(curves.evaluated_points_num());
+  curves.interpolate_to_evaluated(src.as_span(), dst.as_mutable_span());
+  for (const int i : curves.curves_range()) {
+    const IndexRange points = curves.points_for_curve(i);
+    const IndexRange evaluated_points = curves.evaluated_points_for_curve(i);
+    curves.interpolate_to_evaluated(i,
+                                    src_color.as_span().slice(points),
+                                    dst_color.as_mutable_span().slice(evaluated_points));
+  }
+  for (const int i : dst.index_range()) {
+    EXPECT_NEAR(dst[i].x, dst_color[i].r, 1e-5f);
+    EXPECT_NEAR(dst[i].y, dst_color[i].g, 1e-5f);
+  }
+}
+
+TEST(curves_geometry, NURBSEvaluatedLengthsPrecise)
+{
+  /* A rational quadratic NURBS circle with four arcs. */
+  CurvesGeometry curves(9, 1);
+  curves.fill_curve_types(CURVE_TYPE_NURBS);
+  curves.offsets_for_write().last() = 9;
+  curves.nurbs_orders_for_write().fill(3);
+  curves.nurbs_knots_modes_for_write().fill(NURBS_KNOT_MODE_ENDPOINT_BEZIER);
+  curves.positions_for_write().copy_from({{1, 0, 0},
+                                          {1, 1, 0},
+                                          {0, 1, 0},
+                                          {-1, 1, 0},
+                                          {-1, 0, 0},
+                                          {-1, -1, 0},
+                                          {0, -1, 0},
+                                          {1, -1, 0},
+                                          {1, 0, 0}});
+  MutableSpan<float> weights = curves.nurbs_weights_for_write();
+  for (const int i : weights.index_range()) {
+    weights[i] = i % 2 == 0 ? 1.0f : float(M_SQRT1_2);
+  }
+
+  for (const int resolution : {1, 3, 12}) {
+    curves.resolution_for_write().fill(resolution);
+    curves.tag_topology_changed();
+    curves.ensure_evaluated_lengths();
+    curves.ensure_evaluated_lengths_precise();
+
+    /* The precise length doesn't depend on the resolution, unlike the evaluated length. */
+    EXPECT_NEAR(curves.evaluated_length_precise_total_for_curve(0, false), 2.0f * M_PI, 1e-5f);
+    EXPECT_LT(curves.evaluated_length_total_for_curve(0, false), 2.0f * M_PI - 1e-4f);
+    const Span<float> lengths = curves.evaluated_lengths_precise_for_curve(0, false);
+    EXPECT_EQ(lengths.size(), curves.evaluated_points_for_curve(0).size() - 1);
+  }
+}
+
+TEST(curves_geometry, PartialPositionsUpdate)
+{
+  CurvesGeometry curves = create_basic_curves(12, 3);
+  curves.fill_curve_types(CURVE_TYPE_CATMULL_ROM);
+  curves.resolution_for_write().fill(4);
+  curves.positions_for_write()[0] = {0.0f, 0.0f, 1.0f};
+  const Array<float3> old_evaluated_positions(curves.evaluated_positions());
+  curves.ensure_evaluated_lengths();
+  const float old_length_0 = curves.evaluated_length_total_for_curve(0, false);
+
+  /* Change both the first and the second curve, but only tag the second curve as changed. */
+  curves.positions_for_write()[0] = {0.0f, 0.0f, 2.0f};
+  curves.positions_for_write()[5] = {1.0f, 2.0f, 3.0f};
+  curves.tag_positions_changed({1});
+
+  /* Only the evaluated data of the tagged curve is recalculated. */
+  Array<float3> evaluated_positions(curves.evaluated_positions());
+  curves.ensure_evaluated_lengths();
+  const IndexRange evaluated_points_0 = curves.evaluated_points_for_curve(0);
+  const IndexRange evaluated_points_1 = curves.evaluated_points_for_curve(1);
+  const IndexRange evaluated_points_2 = curves.evaluated_points_for_curve(2);
+  EXPECT_EQ(evaluated_positions.as_span().slice(evaluated_points_0),
+            old_evaluated_positions.as_span().slice(evaluated_points_0));
+  EXPECT_NE(evaluated_positions.as_span().slice(evaluated_points_1),
+            old_evaluated_positions.as_span().slice(evaluated_points_1));
+  EXPECT_EQ(evaluated_positions.as_span().slice(evaluated_points_2),
+            old_evaluated_positions.as_span().slice(evaluated_points_2));
+  EXPECT_EQ(curves.evaluated_length_total_for_curve(0, false), old_length_0);
+
+  /* Tagging all curves recalculates everything, and gives the same result for the second curve. */
+  curves.tag_positions_changed();
+  const Span<float3> new_evaluated_positions = curves.evaluated_positions();
+  EXPECT_NE(new_evaluated_positions.slice(evaluated_points_0),
+            evaluated_positions.as_span().slice(evaluated_points_0));
+  EXPECT_EQ(new_evaluated_positions.slice(evaluated_points_1),
+            evaluated_positions.as_span().slice(evaluated_points_1));
+}
+
+TEST(curves_geometry, RuntimeBackupPartialUpdate)
+{
+  CurvesGeometry curves_orig = create_basic_curves(12, 3);
+  curves_orig.fill_curve_types(CURVE_TYPE_CATMULL_ROM);
+  curves_orig.resolution_for_write().fill(4);
+  curves_orig.tag_positions_changed();
+
+  /* Mimic the depsgraph copy of the original curves, which is the only one with caches. */
+  CurvesGeometry curves = curves_orig;
+  const Array<float3> old_evaluated_positions(curves.evaluated_positions());
+  const IndexRange evaluated_points_0 = curves.evaluated_points_for_curve(0);
+  const IndexRange evaluated_points_1 = curves.evaluated_points_for_curve(1);
+
+  /* Change both the first and the second curve, but only tag the second curve as changed. */
+  curves_orig.positions_for_write()[0] = {0.0f, 0.0f, 2.0f};
+  curves_orig.positions_for_write()[5] = {1.0f, 2.0f, 3.0f};
+  curves_orig.tag_positions_changed({1});
+
+  CurvesGeometryRuntime *backup = curves_runtime_backup(curves);
+  curves = curves_orig;
+  curves_runtime_backup_restore(curves, curves_orig, backup);
+
+  /* The caches are reused, so only the evaluated data of the tagged curve is recalculated. */
+  const Span<float3> evaluated_positions = curves.evaluated_positions();
+  EXPECT_EQ(evaluated_positions.slice(evaluated_points_0),
+            old_evaluated_positions.as_span().slice(evaluated_points_0));
+  EXPECT_NE(evaluated_positions.slice(evaluated_points_1),
+            old_evaluated_positions.as_span().slice(evaluated_points_1));
+}
+
+TEST(curves_geometry, RuntimeBackupUntaggedUpdate)
+{
+  CurvesGeometry curves_orig = create_basic_curves(12, 3);
+  curves_orig.fill_curve_types(CURVE_TYPE_CATMULL_ROM);
+  curves_orig.resolution_for_write().fill(4);
+  curves_orig.tag_positions_changed();
+
+  CurvesGeometry curves = curves_orig;
+  const Array<float3> old_evaluated_positions(curves.evaluated_positions());
+  const IndexRange evaluated_points_0 = curves.evaluated_points_for_curve(0);
+
+  /* Without any recorded change, the caches can't be trusted and everything is recalculated. */
+  curves_orig.positions_for_write()[0] = {0.0f, 0.0f, 2.0f};
+
+  CurvesGeometryRuntime *backup = curves_runtime_backup(curves);
+  curves = curves_orig;
+  curves_runtime_backup_restore(curves, curves_orig, backup);
+
+  const Span<float3> evaluated_positions = curves.evaluated_positions();
+  EXPECT_NE(evaluated_positions.slice(evaluated_points_0),
+            old_evaluated_positions.as_span().slice(evaluated_points_0));
+}
+
+TEST(curves_geometry, ResolutionTolerance)
+{
+  /* A straight and a curved Catmull Rom curve. */
+  CurvesGeometry curves = create_basic_curves(8, 2);
+  curves.fill_curve_types(CURVE_TYPE_CATMULL_ROM);
+  curves.resolution_for_write().fill(16);
+  MutableSpan<float3> positions = curves.positions_for_write();
+  for (const int i : IndexRange(4)) {
+    positions[i] = {float(i), 0.0f, 0.0f};
+  }
+  positions[4] = {0.0f, 0.0f, 0.0f};
+  positions[5] = {1.0f, 1.0f, 0.0f};
+  positions[6] = {2.0f, 0.0f, 0.0f};
+  positions[7] = {3.0f, 1.0f, 0.0f};
+  EXPECT_EQ(curves.evaluated_points_num(), 16 * 3 * 2 + 2);
+
+  curves.resolution_tolerance_for_write().fill(0.01f);
+  curves.tag_topology_changed();
+  EXPECT_EQ(curves.evaluated_resolution()[0], 1);
+  EXPECT_GT(curves.evaluated_resolution()[1], 1);
+  EXPECT_LE(curves.evaluated_resolution()[1], 16);
+  EXPECT_EQ(curves.evaluated_points_for_curve(0).size(), 4);
+
+  /* Moving the points changes the number of evaluated points. */
+  positions[1].y = 1.0f;
+  curves.tag_positions_changed({0});
+  curves.ensure_evaluated_offsets();
+  EXPECT_GT(curves.evaluated_points_for_curve(0).size(), 4);
+  EXPECT_EQ(curves.evaluated_positions().size(), curves.evaluated_points_num());
+}
+
+TEST(curves_geometry, CompactEvaluatedCaches)
+{
+  CurvesGeometry curves = create_basic_curves(12, 3);
+  curves.fill_curve_types(CURVE_TYPE_CATMULL_ROM);
+  curves.resolution_for_write().fill(8);
+  curves.cyclic_for_write().last() = true;
+  curves.positions_for_write()[5] = {1.0f, 2.0f, 3.0f};
+
+  /* Nothing is compacted before the caches are calculated. */
+  EXPECT_EQ(curves.compact_evaluated_caches(), 0);
+
+  const Array<float3> positions(curves.evaluated_positions());
+  const Array<float3> tangents(curves.evaluated_tangents());
+  const Array<float3> normals(curves.evaluated_normals());
+  curves.ensure_evaluated_lengths();
+  const Array<float> lengths(curves.runtime->evaluated_length_cache.as_span());
+  EXPECT_EQ(curves.compact_evaluated_caches_bytes_saved(), 0);
+  const int64_t bytes_saved = curves.compact_evaluated_caches();
+  EXPECT_GT(bytes_saved, 0);
+  EXPECT_EQ(curves.compact_evaluated_caches_bytes_saved(), bytes_saved);
+  EXPECT_TRUE(curves.runtime->evaluated_position_cache.is_empty());
+  EXPECT_TRUE(curves.runtime->evaluated_tangent_cache.is_empty());
+  EXPECT_TRUE(curves.runtime->evaluated_normal_cache.is_empty());
+  EXPECT_TRUE(curves.runtime->evaluated_length_cache.is_empty());
+
+  /* Reading the data with buffers keeps the memory saved. */
+  Vector<float3> positions_buffer;
+  Vector<float3> tangents_buffer;
+  Vector<float3> normals_buffer;
+  Vector<float> lengths_buffer;
+  const Span<float3> decoded_positions = curves.evaluated_positions(positions_buffer);
+  const Span<float3> decoded_tangents = curves.evaluated_tangents(tangents_buffer);
+  const Span<float3> decoded_normals = curves.evaluated_normals(normals_buffer);
+  const Span<float> decoded_lengths = curves.evaluated_lengths(lengths_buffer);
+  EXPECT_EQ(curves.compact_evaluated_caches_bytes_saved(), bytes_saved);
+  EXPECT_EQ(decoded_positions.size(), positions.size());
+  EXPECT_EQ(decoded_tangents.size(), tangents.size());
+  for (const int i : tangents.index_range()) {
+    EXPECT_V3_NEAR(decoded_positions[i], positions[i], 1e-4f);
+    EXPECT_V3_NEAR(decoded_tangents[i], tangents[i], 1e-4f);
+    EXPECT_V3_NEAR(decoded_normals[i], normals[i], 1e-4f);
+  }
+  const VArray<bool> cyclic = curves.cyclic();
+  for (const int curve_index : curves.curves_range()) {
+    const IndexRange range = curves.lengths_range_for_curve(curve_index, cyclic[curve_index]);
+    for (const int i : range) {
+      EXPECT_NEAR(decoded_lengths[i], lengths[i], lengths[range.last()] * 1e-4f);
+    }
+  }
+
+  /* The other accessors decode the data into the caches again. */
+  const Span<float3> cached_tangents = curves.evaluated_tangents();
+  EXPECT_EQ(cached_tangents, decoded_tangents);
+  EXPECT_EQ(curves.evaluated_positions(), decoded_positions);
+  curves.ensure_evaluated_lengths();
+  EXPECT_EQ(curves.runtime->evaluated_length_cache.as_span(), decoded_lengths);
+  EXPECT_LT(curves.compact_evaluated_caches_bytes_saved(), bytes_saved);
+
+  /* Changed positions aren't decoded from the old data. */
+  curves.positions_for_write()[5] = {1.0f, 2.0f, -3.0f};
+  curves.tag_positions_changed({1});
+  EXPECT_TRUE(curves.runtime->evaluated_position_cache_compact.is_empty());
+  EXPECT_TRUE(curves.runtime->evaluated_normal_cache_compact.is_empty());
+  const IndexRange evaluated_points = curves.evaluated_points_for_curve(1);
+  EXPECT_NE(curves.evaluated_tangents().slice(evaluated_points),
+            tangents.as_span().slice(evaluated_points));
+}
+
 TEST(curves_geometry, BezierGenericEvaluation)
 {
   CurvesGeometry curves(3, 1);
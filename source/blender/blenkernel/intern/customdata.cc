@@ -10,6 +10,8 @@
 
 #include "MEM_guardedalloc.h"
 
+#include "atomic_ops.h"
+
 /* Since we have versioning code here (CustomData_verify_versions()). */
 #define DNA_DEPRECATED_ALLOW
 
@@ -20,6 +22,7 @@
 #include "BLI_bitmap.h"
 #include "BLI_color.hh"
 #include "BLI_endian_switch.h"
+#include "BLI_implicit_sharing.hh"
 #include "BLI_index_range.hh"
 #include "BLI_math.h"
 #include "BLI_math_color_blend.h"
@@ -2236,6 +2239,174 @@ void customData_mask_layers__print(const CustomData_MeshMasks *mask)
 
 /** \} */
 
+/* -------------------------------------------------------------------- */
+/** \name Implicit Sharing
+ *
+ * Layers don't get sharing info when they are created. It is only added when the layer data is
+ * shared with another layer for the first time (see #CD_SHARE). From then on, the sharing info
+ * owns the data and every layer that uses the data is a user of it.
+ * \{ */
+
+/** Frees the data of a layer once it is not used by any layer anymore. */
+class CustomDataLayerSharingInfo : public blender::ImplicitSharingInfo {
+ public:
+  const int type;
+  const int totelem;
+  /** Set to null when the last owner takes over the data again. */
+  void *data;
+  /**
+   * When the data is owned by something else (e.g. a memory mapped file), a user of that owner.
+   * The data is never taken over or freed by layers then.
+   */
+  const blender::ImplicitSharingInfo *data_owner;
+
+  CustomDataLayerSharingInfo(const int type,
+                             const int totelem,
+                             void *data,
+                             const blender::ImplicitSharingInfo *data_owner = nullptr)
+      : type(type), totelem(totelem), data(data), data_owner(data_owner)
+  {
+  }
+
+ private:
+  void delete_self_with_data() override
+  {
+    if (data_owner != nullptr) {
+      data_owner->user_remove();
+    }
+    else if (data != nullptr) {
+      const LayerTypeInfo *typeInfo = layerType_getInfo(type);
+      if (typeInfo->free) {
+        typeInfo->free(data, totelem, typeInfo->size);
+      }
+      MEM_freeN(data);
+    }
+    MEM_delete(this);
+  }
+};
+
+static const blender::ImplicitSharingInfo *customData_layer_ensure_sharing_info(
+    const CustomDataLayer &layer, const int totelem)
+{
+  /* The layer is const because sharing doesn't change its data. Multiple threads may try to
+   * share the same layer at the same time though, so the sharing info is set atomically. */
+  void **sharing_info_ptr = (void **)&const_cast<CustomDataLayer &>(layer).sharing_info;
+  if (void *sharing_info = atomic_load_ptr(sharing_info_ptr)) {
+    return static_cast<const blender::ImplicitSharingInfo *>(sharing_info);
+  }
+  CustomDataLayerSharingInfo *new_sharing_info = MEM_new<CustomDataLayerSharingInfo>(
+      __func__, layer.type, totelem, layer.data);
+  if (void *sharing_info = atomic_cas_ptr(sharing_info_ptr, nullptr, new_sharing_info)) {
+    /* Another thread added the sharing info in the meantime. */
+    new_sharing_info->data = nullptr;
+    new_sharing_info->user_remove();
+    return static_cast<const blender::ImplicitSharingInfo *>(sharing_info);
+  }
+  return new_sharing_info;
+}
+
+static void *customData_copy_layer_data(const int type, const void *data, const int totelem)
+{
+  const LayerTypeInfo *typeInfo = layerType_getInfo(type);
+  void *new_data = MEM_malloc_arrayN(size_t(totelem), typeInfo->size, layerType_getName(type));
+  if (typeInfo->copy) {
+    typeInfo->copy(data, new_data, totelem);
+  }
+  else {
+    memcpy(new_data, data, size_t(totelem) * typeInfo->size);
+  }
+  return new_data;
+}
+
+/**
+ * Make sure that the layer is the only owner of its data, so that it can be modified. Afterwards,
+ * the layer neither references data owned by someone else nor has sharing info.
+ */
+static void customData_layer_ensure_mutable(CustomDataLayer &layer, const int totelem)
+{
+  if (layer.sharing_info != nullptr) {
+    CustomDataLayerSharingInfo *sharing_info = const_cast<CustomDataLayerSharingInfo *>(
+        static_cast<const CustomDataLayerSharingInfo *>(layer.sharing_info));
+    if (sharing_info->is_mutable() && sharing_info->data_owner == nullptr) {
+      /* This layer is the last remaining owner, so it can take over the data without a copy. */
+      sharing_info->data = nullptr;
+    }
+    else if (layer.data != nullptr) {
+      layer.data = customData_copy_layer_data(layer.type, layer.data, totelem);
+    }
+    layer.sharing_info->user_remove();
+    layer.sharing_info = nullptr;
+  }
+  else if (layer.flag & CD_FLAG_NOFREE) {
+    if (layer.data != nullptr) {
+      layer.data = customData_copy_layer_data(layer.type, layer.data, totelem);
+    }
+    layer.flag &= ~CD_FLAG_NOFREE;
+  }
+}
+
+/**
+ * Make sure that a layer doesn't share its data before it is written to. Unlike
+ * #customData_layer_ensure_mutable this doesn't need the element count, because shared data
+ * stores it in its sharing info. Layers referencing data without owning it are written to as
+ * before.
+ */
+static void customData_layer_unshare(CustomDataLayer &layer)
+{
+  if (layer.sharing_info != nullptr) {
+    const CustomDataLayerSharingInfo *sharing_info =
+        static_cast<const CustomDataLayerSharingInfo *>(layer.sharing_info);
+    customData_layer_ensure_mutable(layer, sharing_info->totelem);
+  }
+}
+
+/**
+ * Turn a new layer that references the data of the source layer into a layer that shares
+ * ownership of the data. When the source doesn't own its data, its lifetime is unknown, so the
+ * data is copied instead.
+ */
+static void customData_layer_share_data(const CustomDataLayer &src_layer,
+                                        CustomDataLayer &dst_layer,
+                                        const int totelem)
+{
+  if (dst_layer.data == nullptr || dst_layer.data != src_layer.data ||
+      !(dst_layer.flag & CD_FLAG_NOFREE)) {
+    return;
+  }
+  if (src_layer.flag & CD_FLAG_NOFREE) {
+    customData_layer_ensure_mutable(dst_layer, totelem);
+    return;
+  }
+  const blender::ImplicitSharingInfo *sharing_info = customData_layer_ensure_sharing_info(
+      src_layer, totelem);
+  sharing_info->user_add();
+  dst_layer.sharing_info = sharing_info;
+  dst_layer.flag &= ~CD_FLAG_NOFREE;
+}
+
+/**
+ * Stop using shared data without copying it, before the layer gets new data. The data is freed
+ * when this layer was its last user.
+ */
+static void customData_layer_release_shared_data(CustomDataLayer &layer)
+{
+  if (layer.sharing_info != nullptr) {
+    layer.sharing_info->user_remove();
+    layer.sharing_info = nullptr;
+  }
+}
+
+/** True when other layers may use the same data, so it must not be modified or freed. */
+static bool customData_layer_is_referenced(const CustomDataLayer &layer)
+{
+  if (layer.flag & CD_FLAG_NOFREE) {
+    return true;
+  }
+  return layer.sharing_info != nullptr && !layer.sharing_info->is_mutable();
+}
+
+/** \} */
+
 /* -------------------------------------------------------------------- */
 /** \name CustomData Functions
  * \{ */
@@ -2326,6 +2497,7 @@ bool CustomData_merge(const CustomData *source,
       case CD_ASSIGN:
       case CD_REFERENCE:
       case CD_DUPLICATE:
+      case CD_SHARE:
         data = layer->data;
         break;
       default:
@@ -2337,6 +2509,13 @@ bool CustomData_merge(const CustomData *source,
       newlayer = customData_add_layer__internal(
           dest, type, CD_REFERENCE, data, totelem, layer->name);
     }
+    else if (alloctype == CD_SHARE) {
+      newlayer = customData_add_layer__internal(
+          dest, type, CD_REFERENCE, data, totelem, layer->name);
+      if (newlayer) {
+        customData_layer_share_data(*layer, *newlayer, totelem);
+      }
+    }
     else {
       newlayer = customData_add_layer__internal(dest, type, alloctype, data, totelem, layer->name);
     }
@@ -2363,6 +2542,8 @@ bool CustomData_merge(const CustomData *source,
       }
       if (alloctype == CD_ASSIGN) {
         layer->data = nullptr;
+        newlayer->sharing_info = layer->sharing_info;
+        layer->sharing_info = nullptr;
       }
     }
   }
@@ -2417,6 +2598,9 @@ void CustomData_realloc(CustomData *data, const int old_size, const int new_size
 
     const int64_t old_size_in_bytes = int64_t(old_size) * typeInfo->size;
     const int64_t new_size_in_bytes = int64_t(new_size) * typeInfo->size;
+    if (layer->sharing_info != nullptr) {
+      customData_layer_ensure_mutable(*layer, old_size);
+    }
     if (layer->flag & CD_FLAG_NOFREE) {
       const void *old_data = layer->data;
       layer->data = MEM_malloc_arrayN(new_size, typeInfo->size, __func__);
@@ -2476,7 +2660,11 @@ static void customData_free_layer__internal(CustomDataLayer *layer, const int to
     BKE_anonymous_attribute_id_decrement_weak(layer->anonymous_id);
     layer->anonymous_id = nullptr;
   }
-  if (!(layer->flag & CD_FLAG_NOFREE) && layer->data) {
+  if (layer->sharing_info != nullptr) {
+    layer->sharing_info->user_remove();
+    layer->sharing_info = nullptr;
+  }
+  else if (!(layer->flag & CD_FLAG_NOFREE) && layer->data) {
     typeInfo = layerType_getInfo(layer->type);
 
     if (typeInfo->free) {
@@ -2864,6 +3052,10 @@ static CustomDataLayer *customData_add_layer__internal(CustomData *data,
         }
       }
       break;
+    case CD_SHARE:
+      /* Sharing needs the source layer, see #CustomData_merge. */
+      BLI_assert_unreachable();
+      break;
   }
 
   int index = data->totlayer;
@@ -2961,6 +3153,29 @@ void *CustomData_add_layer_named(CustomData *data,
   return nullptr;
 }
 
+void *CustomData_add_layer_named_with_owner(CustomData *data,
+                                            const int type,
+                                            void *layerdata,
+                                            const int totelem,
+                                            const char *name,
+                                            const ImplicitSharingInfoHandle *owner)
+{
+  CustomDataLayer *layer = customData_add_layer__internal(
+      data, type, CD_REFERENCE, layerdata, totelem, name);
+  CustomData_update_typemap(data);
+
+  if (layer == nullptr) {
+    return nullptr;
+  }
+  if (layer->data == layerdata && (layer->flag & CD_FLAG_NOFREE)) {
+    owner->user_add();
+    layer->sharing_info = MEM_new<CustomDataLayerSharingInfo>(
+        __func__, type, totelem, layerdata, owner);
+    layer->flag &= ~CD_FLAG_NOFREE;
+  }
+  return layer->data;
+}
+
 void *CustomData_add_layer_anonymous(CustomData *data,
                                      const int type,
                                      const eCDAllocType alloctype,
@@ -3103,26 +3318,7 @@ static void *customData_duplicate_referenced_layer_index(CustomData *data,
   }
 
   CustomDataLayer *layer = &data->layers[layer_index];
-
-  if (layer->flag & CD_FLAG_NOFREE) {
-    /* MEM_dupallocN won't work in case of complex layers, like e.g.
-     * CD_MDEFORMVERT, which has pointers to allocated data...
-     * So in case a custom copy function is defined, use it!
-     */
-    const LayerTypeInfo *typeInfo = layerType_getInfo(layer->type);
-
-    if (typeInfo->copy) {
-      void *dst_data = MEM_malloc_arrayN(
-          (size_t)totelem, typeInfo->size, "CD duplicate ref layer");
-      typeInfo->copy(layer->data, dst_data, totelem);
-      layer->data = dst_data;
-    }
-    else {
-      layer->data = MEM_dupallocN(layer->data);
-    }
-
-    layer->flag &= ~CD_FLAG_NOFREE;
-  }
+  customData_layer_ensure_mutable(*layer, totelem);
 
   return layer->data;
 }
@@ -3187,9 +3383,7 @@ bool CustomData_is_referenced_layer(CustomData *data, const int type)
     return false;
   }
 
-  CustomDataLayer *layer = &data->layers[layer_index];
-
-  return (layer->flag & CD_FLAG_NOFREE) != 0;
+  return customData_layer_is_referenced(data->layers[layer_index]);
 }
 
 void CustomData_free_temporary(CustomData *data, const int totelem)
@@ -3258,6 +3452,8 @@ void CustomData_copy_data_layer(const CustomData *source,
 {
   const LayerTypeInfo *typeInfo;
 
+  customData_layer_unshare(dest->layers[dst_layer_index]);
+
   const void *src_data = source->layers[src_layer_index].data;
   void *dst_data = dest->layers[dst_layer_index].data;
 
@@ -3369,7 +3565,7 @@ void CustomData_copy_layer_type_data(const CustomData *source,
 void CustomData_free_elem(CustomData *data, const int index, const int count)
 {
   for (int i = 0; i < data->totlayer; i++) {
-    if (!(data->layers[i].flag & CD_FLAG_NOFREE)) {
+    if (!customData_layer_is_referenced(data->layers[i])) {
       const LayerTypeInfo *typeInfo = layerType_getInfo(data->layers[i].type);
 
       if (typeInfo->free) {
@@ -3437,6 +3633,7 @@ void CustomData_interp(const CustomData *source,
 
     /* if we found a matching layer, copy the data */
     if (dest->layers[dest_i].type == source->layers[src_i].type) {
+      customData_layer_unshare(dest->layers[dest_i]);
       void *src_data = source->layers[src_i].data;
 
       for (int j = 0; j < count; j++) {
@@ -3630,6 +3827,10 @@ void *CustomData_set_layer(const CustomData *data, const int type, void *ptr)
     return nullptr;
   }
 
+  if (data->layers[layer_index].data != ptr) {
+    /* Give up the share of the previous data, it stays valid for its other users. */
+    customData_layer_release_shared_data(data->layers[layer_index]);
+  }
   data->layers[layer_index].data = ptr;
 
   return ptr;
@@ -3643,6 +3844,10 @@ void *CustomData_set_layer_n(const CustomData *data, const int type, const int n
     return nullptr;
   }
 
+  if (data->layers[layer_index].data != ptr) {
+    /* Give up the share of the previous data, it stays valid for its other users. */
+    customData_layer_release_shared_data(data->layers[layer_index]);
+  }
   data->layers[layer_index].data = ptr;
 
   return ptr;
@@ -4091,7 +4296,7 @@ bool CustomData_has_interp(const CustomData *data)
 bool CustomData_has_referenced(const CustomData *data)
 {
   for (int i = 0; i < data->totlayer; i++) {
-    if (data->layers[i].flag & CD_FLAG_NOFREE) {
+    if (customData_layer_is_referenced(data->layers[i])) {
       return true;
     }
   }
@@ -4428,6 +4633,7 @@ void CustomData_blend_write_prepare(CustomData &data,
       continue;
     }
     layers_to_write.append(layer);
+    layers_to_write.last().sharing_info = nullptr;
   }
   data.totlayer = layers_to_write.size();
   data.maxlayer = data.totlayer;
@@ -5411,6 +5617,7 @@ void CustomData_blend_read(BlendDataReader *reader, CustomData *data, const int
     }
 
     layer->flag &= ~CD_FLAG_NOFREE;
+    layer->sharing_info = nullptr;
 
     if (CustomData_verify_versions(data, i)) {
       BLO_read_data_address(reader, &layer->data);
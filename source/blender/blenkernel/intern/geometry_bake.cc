@@ -0,0 +1,679 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/** \file
+ * \ingroup bke
+ *
+ * A bake file starts with a #FileHeader, followed by a geometry set:
+ * - The number of components, followed by the type and data of every component.
+ * - Custom data is stored as the number of layers, followed by a #LayerHeader and an array for
+ *   every layer.
+ * - Instance components store the geometry set of every reference after their own data.
+ *
+ * Arrays are stored as their size in bytes, followed by the data at the next offset that is a
+ * multiple of #array_alignment. All numbers use the byte order of the machine that wrote the file.
+ */
+
+#ifdef _WIN32
+#  include <io.h>
+#else
+#  include <unistd.h>
+#endif
+
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_fileops.h"
+#include "BLI_implicit_sharing.hh"
+#include "BLI_mmap.h"
+#include "BLI_path_util.h"
+#include "BLI_string.h"
+
+#include "DNA_curves_types.h"
+#include "DNA_mesh_types.h"
+#include "DNA_meshdata_types.h"
+#include "DNA_pointcloud_types.h"
+
+#include "BKE_curves.hh"
+#include "BKE_customdata.h"
+#include "BKE_geometry_bake.hh"
+#include "BKE_lib_id.h"
+#include "BKE_mesh.h"
+#include "BKE_pointcloud.h"
+
+namespace blender::bke {
+
+static constexpr char file_magic[8] = {'G', 'E', 'O', 'B', 'A', 'K', 'E', '\0'};
+static constexpr uint32_t file_version = 1;
+/** Every array is aligned for all attribute types and for SIMD loads. */
+static constexpr int64_t array_alignment = 64;
+
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  /** Detects files that were written with a different byte order. */
+  uint32_t endian_check;
+};
+
+struct LayerHeader {
+  int32_t type;
+  int32_t flag;
+  int32_t active;
+  int32_t active_rnd;
+  int32_t active_clone;
+  int32_t active_mask;
+  char name[MAX_CUSTOMDATA_LAYER_NAME];
+};
+
+/* -------------------------------------------------------------------- */
+/** \name Writing
+ * \{ */
+
+class BakeWriter {
+ private:
+  FILE *file_;
+  int64_t offset_ = 0;
+  bool failed_ = false;
+
+ public:
+  BakeWriter(FILE *file) : file_(file)
+  {
+  }
+
+  bool failed() const
+  {
+    return failed_;
+  }
+
+  void write(const void *data, const int64_t size)
+  {
+    if (size > 0 && fwrite(data, size_t(size), 1, file_) != 1) {
+      failed_ = true;
+    }
+    offset_ += size;
+  }
+
+  template<typename T> void write_value(const T &value)
+  {
+    this->write(&value, sizeof(T));
+  }
+
+  void write_array(const void *data, const int64_t size)
+  {
+    static const char zeros[array_alignment] = {0};
+    this->write_value<int64_t>(size);
+    this->write(zeros, (array_alignment - offset_ % array_alignment) % array_alignment);
+    this->write(data, size);
+  }
+};
+
+static void write_custom_data(BakeWriter &writer, const CustomData &data, const int size)
+{
+  Vector<const CustomDataLayer *> layers;
+  for (const CustomDataLayer &layer : Span(data.layers, data.totlayer)) {
+    if (layer.anonymous_id != nullptr) {
+      /* Anonymous attributes can't be accessed after the evaluation anyway. */
+      continue;
+    }
+    if (CustomData_layertype_is_dynamic(layer.type) || (layer.flag & CD_FLAG_NOCOPY)) {
+      continue;
+    }
+    layers.append(&layer);
+  }
+
+  writer.write_value<int32_t>(layers.size());
+  for (const CustomDataLayer *layer : layers) {
+    LayerHeader header;
+    memset(&header, 0, sizeof(header));
+    header.type = layer->type;
+    header.flag = layer->flag & (CD_FLAG_COLOR_ACTIVE | CD_FLAG_COLOR_RENDER);
+    header.active = layer->active;
+    header.active_rnd = layer->active_rnd;
+    header.active_clone = layer->active_clone;
+    header.active_mask = layer->active_mask;
+    STRNCPY(header.name, layer->name);
+    writer.write_value(header);
+    writer.write_array(layer->data, int64_t(size) * CustomData_sizeof(layer->type));
+  }
+}
+
+static void write_geometry_set(BakeWriter &writer, const GeometrySet &geometry);
+
+static void write_mesh(BakeWriter &writer, const Mesh &mesh)
+{
+  writer.write_value<int32_t>(mesh.totvert);
+  writer.write_value<int32_t>(mesh.totedge);
+  writer.write_value<int32_t>(mesh.totpoly);
+  writer.write_value<int32_t>(mesh.totloop);
+  write_custom_data(writer, mesh.vdata, mesh.totvert);
+  write_custom_data(writer, mesh.edata, mesh.totedge);
+  write_custom_data(writer, mesh.pdata, mesh.totpoly);
+  write_custom_data(writer, mesh.ldata, mesh.totloop);
+}
+
+static void write_pointcloud(BakeWriter &writer, const PointCloud &pointcloud)
+{
+  writer.write_value<int32_t>(pointcloud.totpoint);
+  write_custom_data(writer, pointcloud.pdata, pointcloud.totpoint);
+}
+
+static void write_curves(BakeWriter &writer, const Curves &curves_id)
+{
+  const CurvesGeometry &curves = CurvesGeometry::wrap(curves_id.geometry);
+  writer.write_value<int32_t>(curves.points_num());
+  writer.write_value<int32_t>(curves.curves_num());
+  writer.write_array(curves.curve_offsets, int64_t(curves.curves_num() + 1) * sizeof(int));
+  write_custom_data(writer, curves.point_data, curves.points_num());
+  write_custom_data(writer, curves.curve_data, curves.curves_num());
+}
+
+static void write_instances(BakeWriter &writer, const InstancesComponent &component)
+{
+  /* Object and collection instances are written as the geometry they contain. */
+  std::unique_ptr<InstancesComponent> instances{
+      static_cast<InstancesComponent *>(component.copy())};
+  instances->ensure_geometry_instances();
+
+  writer.write_value<int32_t>(instances->instances_num());
+  writer.write_value<int32_t>(instances->references_num());
+  writer.write_array(instances->instance_reference_handles().data(),
+                     instances->instances_num() * sizeof(int));
+  writer.write_array(instances->instance_transforms().data(),
+                     instances->instances_num() * sizeof(float4x4));
+  write_custom_data(writer, instances->instance_attributes().data, instances->instances_num());
+  for (const InstanceReference &reference : instances->references()) {
+    if (reference.type() == InstanceReference::Type::GeometrySet) {
+      write_geometry_set(writer, reference.geometry_set());
+    }
+    else {
+      write_geometry_set(writer, GeometrySet());
+    }
+  }
+}
+
+static void write_geometry_set(BakeWriter &writer, const GeometrySet &geometry)
+{
+  Vector<const GeometryComponent *> components;
+  for (const GeometryComponentType type : {GEO_COMPONENT_TYPE_MESH,
+                                           GEO_COMPONENT_TYPE_POINT_CLOUD,
+                                           GEO_COMPONENT_TYPE_CURVE,
+                                           GEO_COMPONENT_TYPE_INSTANCES}) {
+    const GeometryComponent *component = geometry.get_component_for_read(type);
+    if (component != nullptr && !component->is_empty()) {
+      components.append(component);
+    }
+  }
+
+  writer.write_value<int32_t>(components.size());
+  for (const GeometryComponent *component : components) {
+    writer.write_value<int32_t>(component->type());
+    switch (component->type()) {
+      case GEO_COMPONENT_TYPE_MESH:
+        write_mesh(writer, *static_cast<const MeshComponent *>(component)->get_for_read());
+        break;
+      case GEO_COMPONENT_TYPE_POINT_CLOUD:
+        write_pointcloud(writer,
+                         *static_cast<const PointCloudComponent *>(component)->get_for_read());
+        break;
+      case GEO_COMPONENT_TYPE_CURVE:
+        write_curves(writer, *static_cast<const CurveComponent *>(component)->get_for_read());
+        break;
+      case GEO_COMPONENT_TYPE_INSTANCES:
+        write_instances(writer, *static_cast<const InstancesComponent *>(component));
+        break;
+      default:
+        BLI_assert_unreachable();
+        break;
+    }
+  }
+}
+
+bool geometry_bake_write(const GeometrySet &geometry, const char *filepath)
+{
+  if (!BLI_make_existing_file(filepath)) {
+    return false;
+  }
+
+  /* Write to a temporary file first. This way, other processes never read a partially written
+   * file, and the memory of a file that is mapped already is not changed. */
+  static std::atomic<int> temp_file_counter = 0;
+  const std::string temp_filepath = std::string(filepath) + "." +
+                                    std::to_string(temp_file_counter++) + ".tmp";
+  FILE *file = BLI_fopen(temp_filepath.c_str(), "wb");
+  if (file == nullptr) {
+    return false;
+  }
+
+  BakeWriter writer{file};
+  FileHeader header;
+  memcpy(header.magic, file_magic, sizeof(file_magic));
+  header.version = file_version;
+  header.endian_check = 1;
+  writer.write_value(header);
+  write_geometry_set(writer, geometry);
+
+  const bool failed = writer.failed();
+  if (fclose(file) != 0 || failed || BLI_rename(temp_filepath.c_str(), filepath) != 0) {
+    BLI_delete(temp_filepath.c_str(), false, false);
+    return false;
+  }
+  return true;
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Reading
+ * \{ */
+
+class BakeReader {
+ private:
+  const char *data_;
+  int64_t size_;
+  int64_t offset_ = 0;
+
+ public:
+  BakeReader(const void *data, const int64_t size)
+      : data_(static_cast<const char *>(data)), size_(size)
+  {
+  }
+
+  /** \return Null if the file is too short. */
+  const void *read(const int64_t size)
+  {
+    if (size < 0 || size > size_ - offset_) {
+      return nullptr;
+    }
+    const void *data = data_ + offset_;
+    offset_ += size;
+    return data;
+  }
+
+  template<typename T> bool read_value(T &r_value)
+  {
+    const void *data = this->read(sizeof(T));
+    if (data == nullptr) {
+      return false;
+    }
+    memcpy(&r_value, data, sizeof(T));
+    return true;
+  }
+
+  /** \return Null if the array does not have the expected size. */
+  const void *read_array(const int64_t expected_size)
+  {
+    int64_t size;
+    if (!this->read_value(size) || size != expected_size) {
+      return nullptr;
+    }
+    if (this->read((array_alignment - offset_ % array_alignment) % array_alignment) == nullptr) {
+      return nullptr;
+    }
+    return this->read(size);
+  }
+};
+
+/**
+ * \param file_owner: The owner of the mapped file, to use its memory directly. Null to copy the
+ * data, when the layers are modified without checking whether they are shared.
+ */
+static bool read_custom_data(BakeReader &reader,
+                             CustomData &data,
+                             const int size,
+                             const ImplicitSharingInfo *file_owner)
+{
+  int32_t layers_num;
+  if (!reader.read_value(layers_num)) {
+    return false;
+  }
+  for ([[maybe_unused]] const int i : IndexRange(layers_num)) {
+    LayerHeader header;
+    if (!reader.read_value(header)) {
+      return false;
+    }
+    if (header.type < 0 || header.type >= CD_NUMTYPES ||
+        CustomData_layertype_is_dynamic(header.type)) {
+      return false;
+    }
+    const void *layer_data = reader.read_array(int64_t(size) * CustomData_sizeof(header.type));
+    if (layer_data == nullptr) {
+      return false;
+    }
+    header.name[sizeof(header.name) - 1] = '\0';
+
+    /* The mapped data is never changed, the layer is copied before it's modified. */
+    if (file_owner == nullptr) {
+      CustomData_add_layer_named(
+          &data, header.type, CD_DUPLICATE, const_cast<void *>(layer_data), size, header.name);
+    }
+    else {
+      CustomData_add_layer_named_with_owner(
+          &data, header.type, const_cast<void *>(layer_data), size, header.name, file_owner);
+    }
+    const int layer_index = CustomData_get_named_layer_index(&data, header.type, header.name);
+    if (layer_index == -1) {
+      return false;
+    }
+    CustomDataLayer &layer = data.layers[layer_index];
+    layer.flag |= header.flag;
+    layer.active = header.active;
+    layer.active_rnd = header.active_rnd;
+    layer.active_clone = header.active_clone;
+    layer.active_mask = header.active_mask;
+  }
+  return true;
+}
+
+static bool read_sizes(BakeReader &reader, MutableSpan<int> r_sizes)
+{
+  for (int &size : r_sizes) {
+    int32_t value;
+    if (!reader.read_value(value) || value < 0) {
+      return false;
+    }
+    size = value;
+  }
+  return true;
+}
+
+static bool read_geometry_set(BakeReader &reader,
+                              const ImplicitSharingInfo &file_owner,
+                              GeometrySet &r_geometry);
+
+/** Check that all indices are in range, so that the mesh can be used without crashing. */
+static bool mesh_topology_is_valid(const Mesh &mesh)
+{
+  const std::array<std::pair<const CustomData *, int>, 4> required_layers = {{
+      {&mesh.vdata, CD_MVERT},
+      {&mesh.edata, CD_MEDGE},
+      {&mesh.pdata, CD_MPOLY},
+      {&mesh.ldata, CD_MLOOP},
+  }};
+  const std::array<int, 4> sizes = {mesh.totvert, mesh.totedge, mesh.totpoly, mesh.totloop};
+  for (const int i : IndexRange(4)) {
+    if (sizes[i] > 0 &&
+        CustomData_get_layer(required_layers[i].first, required_layers[i].second) == nullptr) {
+      return false;
+    }
+  }
+
+  const Span<MEdge> edges = mesh.edges();
+  const Span<MPoly> polys = mesh.polys();
+  const Span<MLoop> loops = mesh.loops();
+  for (const MEdge &edge : edges) {
+    if (edge.v1 >= uint(mesh.totvert) || edge.v2 >= uint(mesh.totvert)) {
+      return false;
+    }
+  }
+  for (const MPoly &poly : polys) {
+    if (poly.loopstart < 0 || poly.totloop < 0 ||
+        int64_t(poly.loopstart) + poly.totloop > mesh.totloop) {
+      return false;
+    }
+  }
+  for (const MLoop &loop : loops) {
+    if (loop.v >= uint(mesh.totvert) || loop.e >= uint(mesh.totedge)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static Mesh *read_mesh(BakeReader &reader, const ImplicitSharingInfo &file_owner)
+{
+  std::array<int, 4> sizes;
+  if (!read_sizes(reader, sizes)) {
+    return nullptr;
+  }
+  Mesh *mesh = BKE_mesh_new_nomain(0, 0, 0, 0, 0);
+  /* Remove the empty default layers, the file contains all layers. */
+  CustomData_free(&mesh->vdata, 0);
+  CustomData_free(&mesh->edata, 0);
+  CustomData_free(&mesh->pdata, 0);
+  CustomData_free(&mesh->ldata, 0);
+  mesh->totvert = sizes[0];
+  mesh->totedge = sizes[1];
+  mesh->totpoly = sizes[2];
+  mesh->totloop = sizes[3];
+  if (!read_custom_data(reader, mesh->vdata, mesh->totvert, &file_owner) ||
+      !read_custom_data(reader, mesh->edata, mesh->totedge, &file_owner) ||
+      !read_custom_data(reader, mesh->pdata, mesh->totpoly, &file_owner) ||
+      !read_custom_data(reader, mesh->ldata, mesh->totloop, &file_owner) ||
+      !mesh_topology_is_valid(*mesh)) {
+    BKE_id_free(nullptr, mesh);
+    return nullptr;
+  }
+  BKE_mesh_normals_tag_dirty(mesh);
+  return mesh;
+}
+
+static PointCloud *read_pointcloud(BakeReader &reader, const ImplicitSharingInfo &file_owner)
+{
+  int size;
+  if (!read_sizes(reader, {&size, 1})) {
+    return nullptr;
+  }
+  PointCloud *pointcloud = BKE_pointcloud_new_nomain(0);
+  CustomData_free(&pointcloud->pdata, 0);
+  pointcloud->totpoint = size;
+  if (!read_custom_data(reader, pointcloud->pdata, size, &file_owner) ||
+      (size > 0 && CustomData_get_layer_named(&pointcloud->pdata, CD_PROP_FLOAT3, "position") ==
+                       nullptr)) {
+    BKE_id_free(nullptr, pointcloud);
+    return nullptr;
+  }
+  return pointcloud;
+}
+
+/** Check that the curves can be used without crashing. */
+static bool curves_are_valid(const CurvesGeometry &curves)
+{
+  if (curves.points_num() > 0 && curves.positions().is_empty()) {
+    return false;
+  }
+  const VArray<int8_t> types = curves.curve_types();
+  for (const int curve_i : curves.curves_range()) {
+    if (types[curve_i] < 0 || types[curve_i] >= CURVE_TYPES_NUM) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static Curves *read_curves(BakeReader &reader, const ImplicitSharingInfo &file_owner)
+{
+  std::array<int, 2> sizes;
+  if (!read_sizes(reader, sizes)) {
+    return nullptr;
+  }
+  const int points_num = sizes[0];
+  const int curves_num = sizes[1];
+  const int *offsets = static_cast<const int *>(
+      reader.read_array(int64_t(curves_num + 1) * sizeof(int)));
+  if (offsets == nullptr) {
+    return nullptr;
+  }
+  if (offsets[0] != 0 || offsets[curves_num] != points_num) {
+    return nullptr;
+  }
+  for (const int curve_i : IndexRange(curves_num)) {
+    if (offsets[curve_i + 1] < offsets[curve_i]) {
+      return nullptr;
+    }
+  }
+
+  Curves *curves_id = curves_new_nomain(0, 0);
+  CurvesGeometry &curves = CurvesGeometry::wrap(curves_id->geometry);
+  CustomData_free(&curves.point_data, 0);
+  CustomData_free(&curves.curve_data, 0);
+  curves.point_num = points_num;
+  curves.curve_num = curves_num;
+  /* The offsets are not stored in custom data, so they can't reference the file. */
+  MEM_freeN(curves.curve_offsets);
+  curves.curve_offsets = static_cast<int *>(
+      MEM_malloc_arrayN(curves_num + 1, sizeof(int), __func__));
+  memcpy(curves.curve_offsets, offsets, sizeof(int) * (curves_num + 1));
+
+  if (!read_custom_data(reader, curves.point_data, points_num, &file_owner) ||
+      !read_custom_data(reader, curves.curve_data, curves_num, &file_owner) ||
+      !curves_are_valid(curves)) {
+    BKE_id_free(nullptr, curves_id);
+    return nullptr;
+  }
+  curves.update_curve_types();
+  return curves_id;
+}
+
+static bool read_instances(BakeReader &reader,
+                           const ImplicitSharingInfo &file_owner,
+                           InstancesComponent &instances)
+{
+  std::array<int, 2> sizes;
+  if (!read_sizes(reader, sizes)) {
+    return false;
+  }
+  const int instances_num = sizes[0];
+  const int references_num = sizes[1];
+  const void *handles = reader.read_array(instances_num * sizeof(int));
+  if (handles == nullptr) {
+    return false;
+  }
+  const void *transforms = reader.read_array(instances_num * sizeof(float4x4));
+  if (transforms == nullptr) {
+    return false;
+  }
+
+  /* Instance data is stored in vectors that own their memory. */
+  instances.resize(instances_num);
+  instances.instance_reference_handles().copy_from(
+      {static_cast<const int *>(handles), instances_num});
+  instances.instance_transforms().copy_from(
+      {static_cast<const float4x4 *>(transforms), instances_num});
+  CustomData &attributes = instances.instance_attributes().data;
+  if (!read_custom_data(reader, attributes, instances_num, nullptr)) {
+    return false;
+  }
+
+  for ([[maybe_unused]] const int i : IndexRange(references_num)) {
+    GeometrySet geometry;
+    if (!read_geometry_set(reader, file_owner, geometry)) {
+      return false;
+    }
+    instances.add_reference(InstanceReference(std::move(geometry)));
+  }
+  for (const int handle : instances.instance_reference_handles()) {
+    if (handle < 0 || handle >= references_num) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool read_geometry_set(BakeReader &reader,
+                              const ImplicitSharingInfo &file_owner,
+                              GeometrySet &r_geometry)
+{
+  int32_t components_num;
+  if (!reader.read_value(components_num)) {
+    return false;
+  }
+  for ([[maybe_unused]] const int i : IndexRange(components_num)) {
+    int32_t type;
+    if (!reader.read_value(type)) {
+      return false;
+    }
+    switch (type) {
+      case GEO_COMPONENT_TYPE_MESH: {
+        Mesh *mesh = read_mesh(reader, file_owner);
+        if (mesh == nullptr) {
+          return false;
+        }
+        r_geometry.replace_mesh(mesh);
+        break;
+      }
+      case GEO_COMPONENT_TYPE_POINT_CLOUD: {
+        PointCloud *pointcloud = read_pointcloud(reader, file_owner);
+        if (pointcloud == nullptr) {
+          return false;
+        }
+        r_geometry.replace_pointcloud(pointcloud);
+        break;
+      }
+      case GEO_COMPONENT_TYPE_CURVE: {
+        Curves *curves = read_curves(reader, file_owner);
+        if (curves == nullptr) {
+          return false;
+        }
+        r_geometry.replace_curves(curves);
+        break;
+      }
+      case GEO_COMPONENT_TYPE_INSTANCES: {
+        if (!read_instances(
+                reader, file_owner, r_geometry.get_component_for_write<InstancesComponent>())) {
+          return false;
+        }
+        break;
+      }
+      default:
+        return false;
+    }
+  }
+  return true;
+}
+
+/** Keeps a mapped file alive while geometry uses its memory. */
+class MappedFileSharingInfo : public ImplicitSharingInfo {
+ private:
+  BLI_mmap_file *file_;
+
+ public:
+  MappedFileSharingInfo(BLI_mmap_file *file) : file_(file)
+  {
+  }
+
+ private:
+  void delete_self_with_data() override
+  {
+    BLI_mmap_free(file_);
+    MEM_delete(this);
+  }
+};
+
+std::optional<GeometrySet> geometry_bake_read(const char *filepath)
+{
+  const int file = BLI_open(filepath, O_BINARY | O_RDONLY, 0);
+  if (file == -1) {
+    return std::nullopt;
+  }
+  /* Get the size from the opened file, in case the file is baked again in the meantime. */
+  BLI_stat_t stat;
+  BLI_mmap_file *mmap_file = BLI_fstat(file, &stat) == 0 ? BLI_mmap_open(file) : nullptr;
+  close(file);
+  if (mmap_file == nullptr) {
+    return std::nullopt;
+  }
+  /* Every layer that uses the mapped memory adds a user, so the file is unmapped when the last
+   * geometry that uses it is freed. The user added here is removed at the end of this function. */
+  const ImplicitSharingInfo *file_owner = MEM_new<MappedFileSharingInfo>(__func__, mmap_file);
+
+  BakeReader reader{BLI_mmap_get_pointer(mmap_file), int64_t(stat.st_size)};
+  std::optional<GeometrySet> result;
+  FileHeader header;
+  if (reader.read_value(header) && memcmp(header.magic, file_magic, sizeof(file_magic)) == 0 &&
+      header.version == file_version && header.endian_check == 1) {
+    GeometrySet geometry;
+    if (read_geometry_set(reader, *file_owner, geometry)) {
+      result = std::move(geometry);
+    }
+  }
+  file_owner->user_remove();
+  return result;
+}
+
+/** \} */
+
+}  // namespace blender::bke
@@ -0,0 +1,290 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/** \file
+ * \ingroup bke
+ */
+
+#include <cstdio>
+#include <string>
+
+#include "BLI_fileops.h"
+#include "BLI_path_util.h"
+#include "BLI_vector.hh"
+
+#include "DNA_meshdata_types.h"
+#include "DNA_pointcloud_types.h"
+
+#include "BKE_appdir.h"
+#include "BKE_curves.hh"
+#include "BKE_geometry_bake.hh"
+#include "BKE_idtype.h"
+#include "BKE_lib_id.h"
+#include "BKE_mesh.h"
+#include "BKE_pointcloud.h"
+
+#include "testing/testing.h"
+
+namespace blender::bke::tests {
+
+class GeometryBakeTest : public testing::Test {
+ protected:
+  std::string directory_;
+  std::string filepath_;
+
+  void SetUp() override
+  {
+    BKE_idtype_init();
+    BKE_tempdir_init("");
+    char directory[FILE_MAX];
+    BLI_path_join(
+        directory, sizeof(directory), BKE_tempdir_session(), "geometry_bake_test", nullptr);
+    directory_ = directory;
+    char filepath[FILE_MAX];
+    BLI_path_join(filepath, sizeof(filepath), directory, "frame_000001.geobake", nullptr);
+    filepath_ = filepath;
+  }
+
+  void TearDown() override
+  {
+    BLI_delete(directory_.c_str(), true, true);
+  }
+};
+
+/* Two triangles that share an edge. */
+static Mesh *create_mesh()
+{
+  Mesh *mesh = BKE_mesh_new_nomain(4, 5, 0, 6, 2);
+  MutableSpan<MVert> verts = mesh->verts_for_write();
+  const float3 positions[4] = {{0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 1, 0}};
+  for (const int i : verts.index_range()) {
+    copy_v3_v3(verts[i].co, positions[i]);
+  }
+  MutableSpan<MEdge> edges = mesh->edges_for_write();
+  const int2 edge_verts[5] = {{0, 1}, {1, 2}, {2, 0}, {2, 3}, {3, 0}};
+  for (const int i : edges.index_range()) {
+    edges[i].v1 = edge_verts[i][0];
+    edges[i].v2 = edge_verts[i][1];
+  }
+  MutableSpan<MLoop> loops = mesh->loops_for_write();
+  const int2 loop_verts_and_edges[6] = {{0, 0}, {1, 1}, {2, 2}, {0, 2}, {2, 3}, {3, 4}};
+  for (const int i : loops.index_range()) {
+    loops[i].v = loop_verts_and_edges[i][0];
+    loops[i].e = loop_verts_and_edges[i][1];
+  }
+  MutableSpan<MPoly> polys = mesh->polys_for_write();
+  polys[0].loopstart = 0;
+  polys[0].totloop = 3;
+  polys[1].loopstart = 3;
+  polys[1].totloop = 3;
+
+  SpanAttributeWriter<float> weights =
+      mesh->attributes_for_write().lookup_or_add_for_write_span<float>("weight",
+                                                                       ATTR_DOMAIN_FACE);
+  weights.span[0] = 0.25f;
+  weights.span[1] = 0.75f;
+  weights.finish();
+  return mesh;
+}
+
+static CurvesGeometry create_curves()
+{
+  CurvesGeometry curves(9, 3);
+  curves.offsets_for_write().copy_from({0, 2, 5, 9});
+  MutableSpan<float3> positions = curves.positions_for_write();
+  for (const int i : positions.index_range()) {
+    positions[i] = float3(i, i * 2.0f, 0.0f);
+  }
+  curves.fill_curve_types(CURVE_TYPE_POLY);
+  curves.curve_types_for_write()[1] = CURVE_TYPE_CATMULL_ROM;
+  curves.update_curve_types();
+  curves.tilt_for_write().fill(0.5f);
+  return curves;
+}
+
+TEST_F(GeometryBakeTest, MeshRoundTrip)
+{
+  Mesh *mesh = create_mesh();
+  EXPECT_TRUE(geometry_bake_write(GeometrySet::create_with_mesh(mesh), filepath_.c_str()));
+
+  std::optional<GeometrySet> geometry = geometry_bake_read(filepath_.c_str());
+  ASSERT_TRUE(geometry.has_value());
+  const Mesh *result = geometry->get_mesh_for_read();
+  ASSERT_NE(result, nullptr);
+  EXPECT_EQ(result->totvert, 4);
+  EXPECT_EQ(result->totedge, 5);
+  EXPECT_EQ(result->totpoly, 2);
+  EXPECT_EQ(result->totloop, 6);
+
+  Mesh *expected = create_mesh();
+  for (const int i : IndexRange(4)) {
+    EXPECT_EQ(float3(result->verts()[i].co), float3(expected->verts()[i].co));
+  }
+  for (const int i : IndexRange(5)) {
+    EXPECT_EQ(result->edges()[i].v1, expected->edges()[i].v1);
+    EXPECT_EQ(result->edges()[i].v2, expected->edges()[i].v2);
+  }
+  for (const int i : IndexRange(6)) {
+    EXPECT_EQ(result->loops()[i].v, expected->loops()[i].v);
+    EXPECT_EQ(result->loops()[i].e, expected->loops()[i].e);
+  }
+  for (const int i : IndexRange(2)) {
+    EXPECT_EQ(result->polys()[i].loopstart, expected->polys()[i].loopstart);
+    EXPECT_EQ(result->polys()[i].totloop, expected->polys()[i].totloop);
+  }
+  const VArray<float> weights = result->attributes().lookup<float>("weight", ATTR_DOMAIN_FACE);
+  ASSERT_TRUE(weights);
+  EXPECT_EQ(weights[0], 0.25f);
+  EXPECT_EQ(weights[1], 0.75f);
+  BKE_id_free(nullptr, expected);
+}
+
+TEST_F(GeometryBakeTest, CurvesRoundTrip)
+{
+  const CurvesGeometry expected = create_curves();
+  EXPECT_TRUE(geometry_bake_write(GeometrySet::create_with_curves(curves_new_nomain(expected)),
+                                  filepath_.c_str()));
+
+  std::optional<GeometrySet> geometry = geometry_bake_read(filepath_.c_str());
+  ASSERT_TRUE(geometry.has_value());
+  const Curves *curves_id = geometry->get_curves_for_read();
+  ASSERT_NE(curves_id, nullptr);
+  const CurvesGeometry &curves = CurvesGeometry::wrap(curves_id->geometry);
+  EXPECT_EQ(curves.points_num(), 9);
+  EXPECT_EQ(curves.curves_num(), 3);
+  EXPECT_EQ(curves.offsets(), expected.offsets());
+  EXPECT_EQ(curves.positions(), expected.positions());
+  EXPECT_EQ(curves.curve_type_counts(), expected.curve_type_counts());
+  EXPECT_EQ(curves.tilt()[8], 0.5f);
+}
+
+TEST_F(GeometryBakeTest, InstancesRoundTrip)
+{
+  PointCloud *pointcloud = BKE_pointcloud_new_nomain(2);
+  {
+    SpanAttributeWriter<float3> positions =
+        pointcloud->attributes_for_write().lookup_for_write_span<float3>("position");
+    positions.span[0] = {1.0f, 2.0f, 3.0f};
+    positions.span[1] = {4.0f, 5.0f, 6.0f};
+    positions.finish();
+  }
+
+  GeometrySet geometry;
+  InstancesComponent &instances = geometry.get_component_for_write<InstancesComponent>();
+  const int handle = instances.add_reference(
+      InstanceReference(GeometrySet::create_with_pointcloud(pointcloud)));
+  for (const int i : IndexRange(3)) {
+    float4x4 transform = float4x4::identity();
+    transform.values[3][0] = float(i);
+    instances.add_instance(handle, transform);
+  }
+  EXPECT_TRUE(geometry_bake_write(geometry, filepath_.c_str()));
+
+  std::optional<GeometrySet> result = geometry_bake_read(filepath_.c_str());
+  ASSERT_TRUE(result.has_value());
+  const InstancesComponent *result_instances =
+      result->get_component_for_read<InstancesComponent>();
+  ASSERT_NE(result_instances, nullptr);
+  EXPECT_EQ(result_instances->instances_num(), 3);
+  EXPECT_EQ(result_instances->references_num(), 1);
+  EXPECT_EQ(result_instances->instance_transforms()[2].values[3][0], 2.0f);
+
+  const InstanceReference &reference = result_instances->references()[0];
+  ASSERT_EQ(reference.type(), InstanceReference::Type::GeometrySet);
+  const PointCloud *result_pointcloud = reference.geometry_set().get_pointcloud_for_read();
+  ASSERT_NE(result_pointcloud, nullptr);
+  const VArray<float3> positions = result_pointcloud->attributes().lookup<float3>(
+      "position", ATTR_DOMAIN_POINT);
+  EXPECT_EQ(positions[1], float3(4.0f, 5.0f, 6.0f));
+}
+
+TEST_F(GeometryBakeTest, ModifyLoadedGeometry)
+{
+  EXPECT_TRUE(
+      geometry_bake_write(GeometrySet::create_with_mesh(create_mesh()), filepath_.c_str()));
+  std::optional<GeometrySet> geometry = geometry_bake_read(filepath_.c_str());
+  ASSERT_TRUE(geometry.has_value());
+
+  /* The mapped memory is copied before it is modified, so the file does not change. */
+  Mesh *mesh = geometry->get_mesh_for_write();
+  mesh->verts_for_write()[0].co[0] = 10.0f;
+
+  std::optional<GeometrySet> geometry_again = geometry_bake_read(filepath_.c_str());
+  ASSERT_TRUE(geometry_again.has_value());
+  EXPECT_EQ(geometry_again->get_mesh_for_read()->verts()[0].co[0], 0.0f);
+  EXPECT_EQ(geometry->get_mesh_for_read()->verts()[0].co[0], 10.0f);
+}
+
+TEST_F(GeometryBakeTest, BakeAgainWhileLoaded)
+{
+  EXPECT_TRUE(
+      geometry_bake_write(GeometrySet::create_with_mesh(create_mesh()), filepath_.c_str()));
+  std::optional<GeometrySet> geometry = geometry_bake_read(filepath_.c_str());
+  ASSERT_TRUE(geometry.has_value());
+
+  /* Geometry that was loaded before keeps using the previous file. */
+  EXPECT_TRUE(geometry_bake_write(
+      GeometrySet::create_with_curves(curves_new_nomain(create_curves())), filepath_.c_str()));
+  EXPECT_EQ(geometry->get_mesh_for_read()->verts()[2].co[1], 1.0f);
+
+  /* A copy of the loaded geometry keeps using the file after the original is freed. */
+  GeometrySet copy = *geometry;
+  copy.get_component_for_write<MeshComponent>();
+  geometry.reset();
+  EXPECT_EQ(copy.get_mesh_for_read()->verts()[2].co[1], 1.0f);
+
+  std::optional<GeometrySet> new_geometry = geometry_bake_read(filepath_.c_str());
+  ASSERT_TRUE(new_geometry.has_value());
+  EXPECT_TRUE(new_geometry->has_curves());
+  EXPECT_FALSE(new_geometry->has_mesh());
+}
+
+TEST_F(GeometryBakeTest, InvalidCurveOffsets)
+{
+  CurvesGeometry curves = create_curves();
+  curves.offsets_for_write().copy_from({0, 5, 2, 9});
+  EXPECT_TRUE(geometry_bake_write(GeometrySet::create_with_curves(curves_new_nomain(curves)),
+                                  filepath_.c_str()));
+  EXPECT_FALSE(geometry_bake_read(filepath_.c_str()).has_value());
+
+  curves.offsets_for_write().copy_from({0, 2, 5, 8});
+  EXPECT_TRUE(geometry_bake_write(GeometrySet::create_with_curves(curves_new_nomain(curves)),
+                                  filepath_.c_str()));
+  EXPECT_FALSE(geometry_bake_read(filepath_.c_str()).has_value());
+}
+
+TEST_F(GeometryBakeTest, InvalidMeshIndices)
+{
+  Mesh *mesh = create_mesh();
+  mesh->edges_for_write()[3].v2 = 4;
+  EXPECT_TRUE(geometry_bake_write(GeometrySet::create_with_mesh(mesh), filepath_.c_str()));
+  EXPECT_FALSE(geometry_bake_read(filepath_.c_str()).has_value());
+
+  mesh = create_mesh();
+  mesh->polys_for_write()[1].totloop = 4;
+  EXPECT_TRUE(geometry_bake_write(GeometrySet::create_with_mesh(mesh), filepath_.c_str()));
+  EXPECT_FALSE(geometry_bake_read(filepath_.c_str()).has_value());
+
+  mesh = create_mesh();
+  mesh->loops_for_write()[5].e = 5;
+  EXPECT_TRUE(geometry_bake_write(GeometrySet::create_with_mesh(mesh), filepath_.c_str()));
+  EXPECT_FALSE(geometry_bake_read(filepath_.c_str()).has_value());
+}
+
+TEST_F(GeometryBakeTest, TruncatedFile)
+{
+  EXPECT_TRUE(
+      geometry_bake_write(GeometrySet::create_with_mesh(create_mesh()), filepath_.c_str()));
+  Vector<char> data(size_t(BLI_file_size(filepath_.c_str())));
+  FILE *file = BLI_fopen(filepath_.c_str(), "rb");
+  ASSERT_NE(file, nullptr);
+  EXPECT_EQ(fread(data.data(), data.size(), 1, file), 1);
+  fclose(file);
+
+  file = BLI_fopen(filepath_.c_str(), "wb");
+  ASSERT_NE(file, nullptr);
+  fwrite(data.data(), data.size() / 2, 1, file);
+  fclose(file);
+  EXPECT_FALSE(geometry_bake_read(filepath_.c_str()).has_value());
+}
+
+}  // namespace blender::bke::tests
@@ -35,7 +35,9 @@ GeometryComponent *CurveComponent::copy() const
 {
   CurveComponent *new_component = new CurveComponent();
   if (curves_ != nullptr) {
-    new_component->curves_ = BKE_curves_copy_for_eval(curves_, false);
+    const int share_flag = ownership_ == GeometryOwnershipType::Owned ? LIB_ID_COPY_CD_SHARE : 0;
+    new_component->curves_ = (Curves *)BKE_id_copy_ex(
+        nullptr, &curves_->id, nullptr, LIB_ID_COPY_LOCALIZE | share_flag);
     new_component->ownership_ = GeometryOwnershipType::Owned;
   }
   return new_component;
@@ -144,13 +146,14 @@ namespace blender::bke {
 static Array<float3> curve_normal_point_domain(const bke::CurvesGeometry &curves)
 {
   const VArray<int8_t> types = curves.curve_types();
-  const VArray<int> resolutions = curves.resolution();
+  const VArray<int> resolutions = curves.evaluated_resolution();
   const VArray<bool> curves_cyclic = curves.cyclic();
 
   const Span<float3> positions = curves.positions();
   const VArray<int8_t> normal_modes = curves.normal_mode();
 
-  const Span<float3> evaluated_normals = curves.evaluated_normals();
+  Vector<float3> evaluated_normals_buffer;
+  const Span<float3> evaluated_normals = curves.evaluated_normals(evaluated_normals_buffer);
 
   Array<float3> results(curves.points_num());
 
@@ -212,8 +215,14 @@ VArray<float3> curve_normals_varray(const CurvesGeometry &curves, const eAttrDom
 {
   const VArray<int8_t> types = curves.curve_types();
   if (curves.is_single_type(CURVE_TYPE_POLY)) {
+    Vector<float3> normals_buffer;
+    const Span<float3> normals = curves.evaluated_normals(normals_buffer);
+    if (normals_buffer.is_empty()) {
+      return curves.adapt_domain<float3>(
+          VArray<float3>::ForSpan(normals), ATTR_DOMAIN_POINT, domain);
+    }
     return curves.adapt_domain<float3>(
-        VArray<float3>::ForSpan(curves.evaluated_normals()), ATTR_DOMAIN_POINT, domain);
+        VArray<float3>::ForContainer(std::move(normals_buffer)), ATTR_DOMAIN_POINT, domain);
   }
 
   Array<float3> normals = curve_normal_point_domain(curves);
@@ -237,15 +246,30 @@ VArray<float3> curve_normals_varray(const CurvesGeometry &curves, const eAttrDom
  * \{ */
 
 static VArray<float> construct_curve_length_gvarray(const CurvesGeometry &curves,
-                                                    const eAttrDomain domain)
+                                                    const eAttrDomain domain,
+                                                    const bool precise)
 {
-  curves.ensure_evaluated_lengths();
-
   VArray<bool> cyclic = curves.cyclic();
-  VArray<float> lengths = VArray<float>::ForFunc(
-      curves.curves_num(), [&curves, cyclic = std::move(cyclic)](int64_t index) {
-        return curves.evaluated_length_total_for_curve(index, cyclic[index]);
-      });
+  VArray<float> lengths;
+  if (precise) {
+    curves.ensure_evaluated_lengths_precise();
+    lengths = VArray<float>::ForFunc(
+        curves.curves_num(), [&curves, cyclic = std::move(cyclic)](int64_t index) {
+          return curves.evaluated_length_precise_total_for_curve(index, cyclic[index]);
+        });
+  }
+  else {
+    Vector<float> evaluated_lengths_buffer;
+    const Span<float> evaluated_lengths = curves.evaluated_lengths(evaluated_lengths_buffer);
+    Array<float> totals(curves.curves_num());
+    threading::parallel_for(curves.curves_range(), 1024, [&](const IndexRange range) {
+      for (const int i : range) {
+        const IndexRange lengths_range = curves.lengths_range_for_curve(i, cyclic[i]);
+        totals[i] = lengths_range.is_empty() ? 0.0f : evaluated_lengths[lengths_range.last()];
+      }
+    });
+    lengths = VArray<float>::ForContainer(std::move(totals));
+  }
 
   if (domain == ATTR_DOMAIN_CURVE) {
     return lengths;
@@ -258,8 +282,8 @@ static VArray<float> construct_curve_length_gvarray(const CurvesGeometry &curves
   return {};
 }
 
-CurveLengthFieldInput::CurveLengthFieldInput()
-    : CurvesFieldInput(CPPType::get<float>(), "Spline Length node")
+CurveLengthFieldInput::CurveLengthFieldInput(const bool precise)
+    : CurvesFieldInput(CPPType::get<float>(), "Spline Length node"), precise_(precise)
 {
   category_ = Category::Generated;
 }
@@ -268,18 +292,22 @@ GVArray CurveLengthFieldInput::get_varray_for_context(const CurvesGeometry &curv
                                                       const eAttrDomain domain,
                                                       IndexMask UNUSED(mask)) const
 {
-  return construct_curve_length_gvarray(curves, domain);
+  return construct_curve_length_gvarray(curves, domain, precise_);
 }
 
 uint64_t CurveLengthFieldInput::hash() const
 {
   /* Some random constant hash. */
-  return 3549623580;
+  return get_default_hash_2(3549623580, precise_);
 }
 
 bool CurveLengthFieldInput::is_equal_to(const fn::FieldNode &other) const
 {
-  return dynamic_cast<const CurveLengthFieldInput *>(&other) != nullptr;
+  if (const CurveLengthFieldInput *other_length = dynamic_cast<const CurveLengthFieldInput *>(
+          &other)) {
+    return other_length->precise_ == precise_;
+  }
+  return false;
 }
 
 /** \} */
@@ -563,6 +591,24 @@ static ComponentAttributeProviders create_attribute_providers_for_curve()
                                                    tag_component_topology_changed,
                                                    AttributeValidator{&resolution_clamp});
 
+  static const fn::CustomMF_SI_SO<float, float> resolution_tolerance_clamp{
+      "Resolution Tolerance Validate",
+      [](float value) { return std::max(value, 0.0f); },
+      fn::CustomMF_presets::AllSpanOrSingle()};
+  static BuiltinCustomDataLayerProvider resolution_tolerance(
+      "resolution_tolerance",
+      ATTR_DOMAIN_CURVE,
+      CD_PROP_FLOAT,
+      CD_PROP_FLOAT,
+      BuiltinAttributeProvider::Creatable,
+      BuiltinAttributeProvider::Writable,
+      BuiltinAttributeProvider::Deletable,
+      curve_access,
+      make_array_read_attribute<float>,
+      make_array_write_attribute<float>,
+      tag_component_topology_changed,
+      AttributeValidator{&resolution_tolerance_clamp});
+
   static BuiltinCustomDataLayerProvider cyclic("cyclic",
                                                ATTR_DOMAIN_CURVE,
                                                CD_PROP_BOOL,
@@ -592,6 +638,7 @@ static ComponentAttributeProviders create_attribute_providers_for_curve()
                                       &nurbs_weight,
                                       &curve_type,
                                       &resolution,
+                                      &resolution_tolerance,
                                       &cyclic},
                                      {&curve_custom_data, &point_custom_data});
 }
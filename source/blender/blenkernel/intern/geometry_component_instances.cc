@@ -5,6 +5,8 @@
 #include "BLI_float4x4.hh"
 #include "BLI_index_mask.hh"
 #include "BLI_map.hh"
+#include "BLI_math_matrix.h"
+#include "BLI_math_rotation.h"
 #include "BLI_rand.hh"
 #include "BLI_set.hh"
 #include "BLI_span.hh"
@@ -21,6 +23,9 @@
 
 #include "BLI_cpp_type_make.hh"
 
+using blender::Array;
+using blender::float3;
+using blender::float4;
 using blender::float4x4;
 using blender::GSpan;
 using blender::IndexMask;
@@ -59,6 +64,7 @@ void InstancesComponent::reserve(int min_capacity)
 
 void InstancesComponent::resize(int capacity)
 {
+  this->tag_instances_changed();
   instance_reference_handles_.resize(capacity);
   instance_transforms_.resize(capacity);
   attributes_.reallocate(capacity);
@@ -66,6 +72,7 @@ void InstancesComponent::resize(int capacity)
 
 void InstancesComponent::clear()
 {
+  this->tag_instances_changed();
   instance_reference_handles_.clear();
   instance_transforms_.clear();
   attributes_.clear();
@@ -76,6 +83,7 @@ void InstancesComponent::add_instance(const int instance_handle, const float4x4
 {
   BLI_assert(instance_handle >= 0);
   BLI_assert(instance_handle < references_.size());
+  this->tag_instances_changed();
   instance_reference_handles_.append(instance_handle);
   instance_transforms_.append(transform);
   attributes_.reallocate(this->instances_num());
@@ -88,11 +96,13 @@ blender::Span<int> InstancesComponent::instance_reference_handles() const
 
 blender::MutableSpan<int> InstancesComponent::instance_reference_handles()
 {
+  this->tag_instances_changed();
   return instance_reference_handles_;
 }
 
 blender::MutableSpan<blender::float4x4> InstancesComponent::instance_transforms()
 {
+  this->tag_instances_changed();
   return instance_transforms_;
 }
 blender::Span<blender::float4x4> InstancesComponent::instance_transforms() const
@@ -105,6 +115,7 @@ GeometrySet &InstancesComponent::geometry_set_from_reference(const int reference
   /* If this assert fails, it means #ensure_geometry_instances must be called first or that the
    * reference can't be converted to a geometry set. */
   BLI_assert(references_[reference_index].type() == InstanceReference::Type::GeometrySet);
+  this->tag_instances_changed();
 
   /* The const cast is okay because the instance's hash in the set
    * is not changed by adjusting the data inside the geometry set. */
@@ -185,6 +196,8 @@ void InstancesComponent::remove_unused_references()
   const int tot_instances = this->instances_num();
   const int tot_references_before = references_.size();
 
+  this->tag_instances_changed();
+
   if (tot_instances == 0) {
     /* If there are no instances, no reference is needed. */
     references_.clear();
@@ -285,6 +298,7 @@ bool InstancesComponent::owns_direct_data() const
 void InstancesComponent::ensure_owns_direct_data()
 {
   BLI_assert(this->is_mutable());
+  this->tag_instances_changed();
   for (const InstanceReference &const_reference : references_) {
     /* Const cast is fine because we are not changing anything that would change the hash of the
      * reference. */
@@ -365,6 +379,13 @@ blender::Span<int> InstancesComponent::almost_unique_ids() const
   return almost_unique_ids_;
 }
 
+void InstancesComponent::tag_instances_changed()
+{
+  /* No lock is necessary, because the component is not shared when it is changed. */
+  flattened_instances_.reset();
+  compact_flattened_instances_.reset();
+}
+
 blender::bke::CustomDataAttributes &InstancesComponent::instance_attributes()
 {
   return this->attributes_;
@@ -523,3 +544,262 @@ std::optional<blender::bke::MutableAttributeAccessor> InstancesComponent::attrib
 }
 
 /** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Flattened Instances
+ * \{ */
+
+int64_t FlattenedInstances::Group::size() const
+{
+  return this->is_compact() ? scales.size() : transforms.size();
+}
+
+bool FlattenedInstances::Group::is_compact() const
+{
+  return !scales.is_empty();
+}
+
+float4x4 FlattenedInstances::Group::transform(const int64_t index) const
+{
+  if (!this->is_compact()) {
+    return transforms[index];
+  }
+  float4x4 transform;
+  const float3 size(scales[index]);
+  loc_quat_size_to_mat4(transform.values, translations[index], rotations[index], size);
+  return transform;
+}
+
+int64_t FlattenedInstances::instances_num() const
+{
+  int64_t num = 0;
+  for (const Group &group : groups) {
+    num += group.size();
+  }
+  return num;
+}
+
+int64_t FlattenedInstances::size_in_bytes() const
+{
+  int64_t size = sizeof(FlattenedInstances) + groups.size() * sizeof(Group);
+  for (const Group &group : groups) {
+    size += group.transforms.as_span().size_in_bytes() +
+            group.rotations.as_span().size_in_bytes() +
+            group.translations.as_span().size_in_bytes() + group.scales.as_span().size_in_bytes();
+  }
+  return size;
+}
+
+/**
+ * Decompose an instance transform into a rotation, a translation and a uniform scale.
+ * \return False if the transform has a non-uniform scale, shear or a perspective component.
+ */
+static bool transform_to_compact(const float4x4 &transform,
+                                 float4 &r_rotation,
+                                 float3 &r_translation,
+                                 float &r_scale)
+{
+  if (transform.values[0][3] != 0.0f || transform.values[1][3] != 0.0f ||
+      transform.values[2][3] != 0.0f || transform.values[3][3] != 1.0f) {
+    return false;
+  }
+  float rotation[3][3];
+  float3 size;
+  mat4_to_loc_rot_size(r_translation, rotation, size, transform.values);
+  if (size.x == 0.0f || !is_orthonormal_m3(rotation)) {
+    return false;
+  }
+  const float max_difference = std::abs(size.x) * 1e-5f;
+  if (std::abs(size.y - size.x) > max_difference || std::abs(size.z - size.x) > max_difference) {
+    return false;
+  }
+  mat3_normalized_to_quat(r_rotation, rotation);
+  r_scale = size.x;
+  return true;
+}
+
+/** Replace the full transforms of the group with compact ones, if all of them can be. */
+static void make_group_compact(FlattenedInstances::Group &group)
+{
+  const int64_t size = group.transforms.size();
+  Array<float4> rotations(size);
+  Array<float3> translations(size);
+  Array<float> scales(size);
+  for (const int64_t i : blender::IndexRange(size)) {
+    if (!transform_to_compact(group.transforms[i], rotations[i], translations[i], scales[i])) {
+      return;
+    }
+  }
+  group.rotations = std::move(rotations);
+  group.translations = std::move(translations);
+  group.scales = std::move(scales);
+  group.transforms = {};
+}
+
+/**
+ * Object and collection references are identified by their data, so that the same object
+ * instanced at different levels of the hierarchy ends up in the same group. Geometry references
+ * are identified by the reference that owns the geometry.
+ */
+static const void *flattened_group_key(const InstanceReference &reference)
+{
+  switch (reference.type()) {
+    case InstanceReference::Type::Object:
+      return &reference.object();
+    case InstanceReference::Type::Collection:
+      return &reference.collection();
+    default:
+      return &reference;
+  }
+}
+
+/**
+ * Flattened instances of nested components, which are only kept while the outermost component is
+ * flattened. That way, sub-hierarchies that are instanced multiple times are only expanded once,
+ * but the nested components don't keep the expanded transforms alive.
+ */
+using NestedFlattenedInstances =
+    blender::Map<const InstancesComponent *, std::unique_ptr<FlattenedInstances>>;
+
+static FlattenedInstances flatten_instances(const InstancesComponent &component,
+                                            NestedFlattenedInstances &nested_flattened)
+{
+  using namespace blender;
+  const Span<InstanceReference> references = component.references();
+  const Span<int> handles = component.instance_reference_handles();
+  const Span<float4x4> transforms = component.instance_transforms();
+
+  FlattenedInstances flattened;
+  Map<const void *, int> group_by_key;
+  auto add_group = [&](const InstanceReference &reference, const void *key) {
+    return group_by_key.lookup_or_add_cb(key, [&]() {
+      FlattenedInstances::Group group;
+      group.reference = reference;
+      group.key = key;
+      flattened.groups.append(std::move(group));
+      return flattened.groups.size() - 1;
+    });
+  };
+
+  /* For every reference, the group of the reference itself (or -1 if it only contains instances)
+   * and the result group of every group of the nested component. */
+  Array<int> leaf_group_by_handle(references.size(), -1);
+  Array<const FlattenedInstances *> nested_by_handle(references.size(), nullptr);
+  Array<Vector<int>> nested_groups_by_handle(references.size());
+  for (const int handle : references.index_range()) {
+    const InstanceReference &reference = references[handle];
+    switch (reference.type()) {
+      case InstanceReference::Type::None:
+        break;
+      case InstanceReference::Type::Object:
+      case InstanceReference::Type::Collection:
+        leaf_group_by_handle[handle] = add_group(reference, flattened_group_key(reference));
+        break;
+      case InstanceReference::Type::GeometrySet: {
+        const GeometrySet &geometry_set = reference.geometry_set();
+        const InstancesComponent *nested_component =
+            geometry_set.get_component_for_read<InstancesComponent>();
+        if (nested_component == nullptr) {
+          leaf_group_by_handle[handle] = add_group(reference, &reference);
+          break;
+        }
+        GeometrySet geometry_without_instances = geometry_set;
+        geometry_without_instances.remove<InstancesComponent>();
+        if (!geometry_without_instances.is_empty()) {
+          leaf_group_by_handle[handle] = add_group(
+              InstanceReference(std::move(geometry_without_instances)), &reference);
+        }
+        const FlattenedInstances *nested;
+        if (const std::unique_ptr<FlattenedInstances> *cached = nested_flattened.lookup_ptr(
+                nested_component)) {
+          nested = cached->get();
+        }
+        else {
+          std::unique_ptr<FlattenedInstances> new_nested = std::make_unique<FlattenedInstances>(
+              flatten_instances(*nested_component, nested_flattened));
+          nested = new_nested.get();
+          nested_flattened.add_new(nested_component, std::move(new_nested));
+        }
+        nested_by_handle[handle] = nested;
+        for (const FlattenedInstances::Group &nested_group : nested->groups) {
+          nested_groups_by_handle[handle].append(add_group(nested_group.reference,
+                                                           nested_group.key));
+        }
+        break;
+      }
+    }
+  }
+
+  /* Count the instances of every group to allocate the transform arrays only once. Nested
+   * hierarchies multiply the counts, so they are 64 bit. */
+  Array<int64_t> instances_by_handle(references.size(), 0);
+  for (const int handle : handles) {
+    instances_by_handle[handle]++;
+  }
+  Array<int64_t> group_sizes(flattened.groups.size(), 0);
+  for (const int handle : references.index_range()) {
+    if (leaf_group_by_handle[handle] != -1) {
+      group_sizes[leaf_group_by_handle[handle]] += instances_by_handle[handle];
+    }
+    if (nested_by_handle[handle] != nullptr) {
+      const Span<FlattenedInstances::Group> nested_groups = nested_by_handle[handle]->groups;
+      for (const int i : nested_groups.index_range()) {
+        group_sizes[nested_groups_by_handle[handle][i]] += instances_by_handle[handle] *
+                                                            nested_groups[i].size();
+      }
+    }
+  }
+  for (const int group_index : flattened.groups.index_range()) {
+    flattened.groups[group_index].transforms.reinitialize(group_sizes[group_index]);
+  }
+
+  Array<int64_t> group_fill(flattened.groups.size(), 0);
+  for (const int i : transforms.index_range()) {
+    const int handle = handles[i];
+    const float4x4 &transform = transforms[i];
+    if (leaf_group_by_handle[handle] != -1) {
+      const int group_index = leaf_group_by_handle[handle];
+      flattened.groups[group_index].transforms[group_fill[group_index]++] = transform;
+    }
+    if (nested_by_handle[handle] != nullptr) {
+      const Span<FlattenedInstances::Group> nested_groups = nested_by_handle[handle]->groups;
+      for (const int nested_group_index : nested_groups.index_range()) {
+        const FlattenedInstances::Group &nested_group = nested_groups[nested_group_index];
+        const int group_index = nested_groups_by_handle[handle][nested_group_index];
+        MutableSpan<float4x4> dst = flattened.groups[group_index].transforms.as_mutable_span();
+        dst = dst.slice(group_fill[group_index], nested_group.size());
+        for (const int64_t j : dst.index_range()) {
+          dst[j] = transform * nested_group.transform(j);
+        }
+        group_fill[group_index] += nested_group.size();
+      }
+    }
+  }
+  return flattened;
+}
+
+const FlattenedInstances &InstancesComponent::flattened_instances(
+    const bool use_compact_transforms) const
+{
+  using namespace blender;
+  std::lock_guard lock(flattened_instances_mutex_);
+  std::unique_ptr<FlattenedInstances> &flattened = use_compact_transforms ?
+                                                       compact_flattened_instances_ :
+                                                       flattened_instances_;
+  if (!flattened) {
+    /* Nested components are always flattened with full precision, so that the error of compact
+     * transforms doesn't accumulate over the nesting levels. */
+    NestedFlattenedInstances nested_flattened;
+    flattened = std::make_unique<FlattenedInstances>(flatten_instances(*this, nested_flattened));
+    if (use_compact_transforms) {
+      threading::parallel_for(flattened->groups.index_range(), 1, [&](const IndexRange range) {
+        for (const int group_index : range) {
+          make_group_compact(flattened->groups[group_index]);
+        }
+      });
+    }
+  }
+  return *flattened;
+}
+
+/** \} */
@@ -0,0 +1,106 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/** \file
+ * \ingroup bke
+ */
+
+#include "BKE_geometry_set.hh"
+
+#include "BLI_array.hh"
+#include "BLI_math_matrix.h"
+
+#include "DNA_collection_types.h"
+
+#include "testing/testing.h"
+
+namespace blender::bke::tests {
+
+static float4x4 translation_matrix(const float3 translation)
+{
+  float4x4 transform = float4x4::identity();
+  copy_v3_v3(transform.values[3], translation);
+  return transform;
+}
+
+/* Create a geometry set with instances of the collection at the given transforms. */
+static GeometrySet create_instances(Collection &collection, const Span<float4x4> transforms)
+{
+  GeometrySet geometry_set;
+  InstancesComponent &instances = geometry_set.get_component_for_write<InstancesComponent>();
+  const int handle = instances.add_reference(collection);
+  for (const float4x4 &transform : transforms) {
+    instances.add_instance(handle, transform);
+  }
+  return geometry_set;
+}
+
+TEST(instances_component, FlattenNested)
+{
+  Collection collection{};
+  const Array<float4x4> inner_transforms = {translation_matrix({1.0f, 0.0f, 0.0f}),
+                                            translation_matrix({0.0f, 2.0f, 0.0f})};
+  const GeometrySet inner = create_instances(collection, inner_transforms);
+
+  GeometrySet outer;
+  InstancesComponent &instances = outer.get_component_for_write<InstancesComponent>();
+  const int inner_handle = instances.add_reference(inner);
+  const int collection_handle = instances.add_reference(collection);
+  instances.add_instance(inner_handle, translation_matrix({0.0f, 0.0f, 3.0f}));
+  instances.add_instance(inner_handle, translation_matrix({0.0f, 0.0f, 4.0f}));
+  instances.add_instance(collection_handle, float4x4::identity());
+
+  const FlattenedInstances &flattened = instances.flattened_instances();
+  /* All instances of the collection are in one group, no matter how deep they are nested. */
+  ASSERT_EQ(flattened.groups.size(), 1);
+  const FlattenedInstances::Group &group = flattened.groups.first();
+  EXPECT_EQ(group.reference.type(), InstanceReference::Type::Collection);
+  EXPECT_EQ(&group.reference.collection(), &collection);
+  ASSERT_EQ(group.size(), 5);
+  EXPECT_EQ(flattened.instances_num(), 5);
+  EXPECT_EQ(group.transform(0).translation(), float3(1.0f, 0.0f, 3.0f));
+  EXPECT_EQ(group.transform(1).translation(), float3(0.0f, 2.0f, 3.0f));
+  EXPECT_EQ(group.transform(2).translation(), float3(1.0f, 0.0f, 4.0f));
+  EXPECT_EQ(group.transform(3).translation(), float3(0.0f, 2.0f, 4.0f));
+  EXPECT_EQ(group.transform(4).translation(), float3(0.0f));
+
+  /* The cache is freed when the instances change. */
+  instances.instance_transforms()[2] = translation_matrix({5.0f, 0.0f, 0.0f});
+  const FlattenedInstances &changed = instances.flattened_instances();
+  EXPECT_EQ(changed.groups.first().transform(4).translation(), float3(5.0f, 0.0f, 0.0f));
+}
+
+TEST(instances_component, FlattenCompact)
+{
+  Collection collection{};
+  float4x4 rotated;
+  const float rotation[3] = {0.3f, 0.5f, 1.2f};
+  const float scale[3] = {2.0f, 2.0f, 2.0f};
+  const float translation[3] = {1.0f, 2.0f, 3.0f};
+  loc_eul_size_to_mat4(rotated.values, translation, rotation, scale);
+  const Array<float4x4> transforms = {rotated, float4x4::identity()};
+  const GeometrySet geometry_set = create_instances(collection, transforms);
+  const InstancesComponent &instances =
+      *geometry_set.get_component_for_read<InstancesComponent>();
+
+  /* Full precision transforms are used by default. */
+  EXPECT_FALSE(instances.flattened_instances().groups.first().is_compact());
+  EXPECT_EQ(instances.flattened_instances().groups.first().transforms[0], rotated);
+
+  const FlattenedInstances &flattened = instances.flattened_instances(true);
+  const FlattenedInstances::Group &group = flattened.groups.first();
+  EXPECT_TRUE(group.is_compact());
+  for (const int i : IndexRange(2)) {
+    EXPECT_M4_NEAR(group.transform(i).values, transforms[i].values, 1e-5f);
+  }
+  EXPECT_LT(flattened.size_in_bytes(),
+            sizeof(FlattenedInstances) + sizeof(FlattenedInstances::Group) +
+                2 * sizeof(float4x4));
+
+  /* Non-uniform scale can't be represented compactly. */
+  GeometrySet stretched_set = create_instances(collection, transforms);
+  InstancesComponent &stretched = stretched_set.get_component_for_write<InstancesComponent>();
+  stretched.instance_transforms()[1].values[0][0] = 3.0f;
+  EXPECT_FALSE(stretched.flattened_instances(true).groups.first().is_compact());
+}
+
+}  // namespace blender::bke::tests
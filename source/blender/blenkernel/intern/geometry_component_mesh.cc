@@ -2,6 +2,7 @@
 
 #include "BLI_listbase.h"
 #include "BLI_task.hh"
+#include "BLI_tracing.hh"
 
 #include "DNA_mesh_types.h"
 #include "DNA_meshdata_types.h"
@@ -37,7 +38,11 @@ GeometryComponent *MeshComponent::copy() const
 {
   MeshComponent *new_component = new MeshComponent();
   if (mesh_ != nullptr) {
-    new_component->mesh_ = BKE_mesh_copy_for_eval(mesh_, false);
+    /* Owned meshes are only changed with functions that copy shared attribute arrays first, so
+     * the arrays can be shared with the copy. */
+    const int share_flag = ownership_ == GeometryOwnershipType::Owned ? LIB_ID_COPY_CD_SHARE : 0;
+    new_component->mesh_ = (Mesh *)BKE_id_copy_ex(
+        nullptr, &mesh_->id, nullptr, LIB_ID_COPY_LOCALIZE | share_flag);
     new_component->ownership_ = GeometryOwnershipType::Owned;
   }
   return new_component;
@@ -786,6 +791,7 @@ static blender::GVArray adapt_mesh_attribute_domain(const Mesh &mesh,
   if (from_domain == to_domain) {
     return varray;
   }
+  SCOPED_TRACE_EVENT("attribute", "Interpolate Mesh Attribute");
 
   switch (from_domain) {
     case ATTR_DOMAIN_CORNER: {
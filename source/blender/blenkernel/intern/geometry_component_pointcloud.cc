@@ -25,7 +25,9 @@ GeometryComponent *PointCloudComponent::copy() const
 {
   PointCloudComponent *new_component = new PointCloudComponent();
   if (pointcloud_ != nullptr) {
-    new_component->pointcloud_ = BKE_pointcloud_copy_for_eval(pointcloud_, false);
+    const int share_flag = ownership_ == GeometryOwnershipType::Owned ? LIB_ID_COPY_CD_SHARE : 0;
+    new_component->pointcloud_ = (PointCloud *)BKE_id_copy_ex(
+        nullptr, &pointcloud_->id, nullptr, LIB_ID_COPY_LOCALIZE | share_flag);
     new_component->ownership_ = GeometryOwnershipType::Owned;
   }
   return new_component;
@@ -225,8 +225,9 @@ bool GeometrySet::compute_boundbox_without_instances(float3 *r_min, float3 *r_ma
   if (const Curves *curves_id = this->get_curves_for_read()) {
     const bke::CurvesGeometry &curves = bke::CurvesGeometry::wrap(curves_id->geometry);
     /* Using the evaluated positions is somewhat arbitrary, but it is probably expected. */
+    Vector<float3> positions_buffer;
     std::optional<bounds::MinMaxResult<float3>> min_max = bounds::min_max(
-        curves.evaluated_positions());
+        curves.evaluated_positions(positions_buffer));
     if (min_max) {
       have_minmax = true;
       *r_min = math::min(*r_min, min_max->min);
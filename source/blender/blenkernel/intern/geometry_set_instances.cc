@@ -119,28 +119,34 @@ static void geometry_set_collect_recursive(const GeometrySet &geometry_set,
     const InstancesComponent &instances_component =
         *geometry_set.get_component_for_read<InstancesComponent>();
 
-    Span<float4x4> transforms = instances_component.instance_transforms();
-    Span<int> handles = instances_component.instance_reference_handles();
-    Span<InstanceReference> references = instances_component.references();
-    for (const int i : transforms.index_range()) {
-      const InstanceReference &reference = references[handles[i]];
-      const float4x4 instance_transform = transform * transforms[i];
-
+    /* Nested geometry instances are already expanded in the flattened instances, so every group
+     * of geometry instances can be added at once. */
+    const FlattenedInstances &flattened = instances_component.flattened_instances();
+    for (const FlattenedInstances::Group &group : flattened.groups) {
+      const InstanceReference &reference = group.reference;
       switch (reference.type()) {
         case InstanceReference::Type::Object: {
           Object &object = reference.object();
-          geometry_set_collect_recursive_object(object, instance_transform, r_sets);
+          for (const int64_t i : IndexRange(group.size())) {
+            geometry_set_collect_recursive_object(object, transform * group.transform(i), r_sets);
+          }
           break;
         }
         case InstanceReference::Type::Collection: {
           Collection &collection = reference.collection();
-          geometry_set_collect_recursive_collection_instance(
-              collection, instance_transform, r_sets);
+          for (const int64_t i : IndexRange(group.size())) {
+            geometry_set_collect_recursive_collection_instance(
+                collection, transform * group.transform(i), r_sets);
+          }
           break;
         }
         case InstanceReference::Type::GeometrySet: {
-          const GeometrySet &geometry_set = reference.geometry_set();
-          geometry_set_collect_recursive(geometry_set, instance_transform, r_sets);
+          r_sets.append({reference.geometry_set(), {}});
+          GeometryInstanceGroup &instance_group = r_sets.last();
+          instance_group.transforms.reserve(group.size());
+          for (const int64_t i : IndexRange(group.size())) {
+            instance_group.transforms.append(transform * group.transform(i));
+          }
           break;
         }
         case InstanceReference::Type::None: {
@@ -196,6 +202,7 @@ void InstancesComponent::ensure_geometry_instances()
 {
   using namespace blender;
   using namespace blender::bke;
+  this->tag_instances_changed();
   VectorSet<InstanceReference> new_references;
   new_references.reserve(references_.size());
   for (const InstanceReference &reference : references_) {
@@ -1265,6 +1265,8 @@ static void move_shapekey_layers_to_keyblocks(Mesh &mesh, Key &key_dst, const in
 {
   using namespace blender::bke;
   for (const int i : IndexRange(CustomData_number_of_layers(&mesh.vdata, CD_SHAPEKEY))) {
+    /* The layer data is moved to the key block, so it must not be shared. */
+    CustomData_duplicate_referenced_layer_n(&mesh.vdata, CD_SHAPEKEY, i, mesh.totvert);
     const int layer_index = CustomData_get_layer_index_n(&mesh.vdata, CD_SHAPEKEY, i);
     CustomDataLayer &layer = mesh.vdata.layers[layer_index];
 
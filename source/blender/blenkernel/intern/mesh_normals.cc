@@ -18,6 +18,7 @@
 
 #include "BLI_alloca.h"
 #include "BLI_bit_vector.hh"
+#include "BLI_cache_mutex.hh"
 #include "BLI_linklist.h"
 #include "BLI_linklist_stack.h"
 #include "BLI_math.h"
@@ -93,10 +94,42 @@ static void add_v3_v3_atomic(float r[3], const float a[3])
  * Related to managing normals but not directly related to calculating normals.
  * \{ */
 
+/**
+ * The runtime data isn't initialized for meshes that are only used to store data, like undo
+ * steps. Their normals are always considered dirty.
+ */
+static blender::CacheMutex *vert_normals_cache_mutex(const Mesh *mesh)
+{
+  return static_cast<blender::CacheMutex *>(mesh->runtime.vert_normals_cache_mutex);
+}
+
+static blender::CacheMutex *poly_normals_cache_mutex(const Mesh *mesh)
+{
+  return static_cast<blender::CacheMutex *>(mesh->runtime.poly_normals_cache_mutex);
+}
+
+/**
+ * Like #CacheMutex::ensure, but without a cache mutex the normals are dirty, so they are always
+ * computed.
+ */
+static void ensure_normals_cache(blender::CacheMutex *cache_mutex,
+                                 const blender::FunctionRef<void()> compute_cache)
+{
+  if (cache_mutex == nullptr) {
+    compute_cache();
+    return;
+  }
+  cache_mutex->ensure(compute_cache);
+}
+
 void BKE_mesh_normals_tag_dirty(Mesh *mesh)
 {
-  mesh->runtime.vert_normals_dirty = true;
-  mesh->runtime.poly_normals_dirty = true;
+  if (blender::CacheMutex *cache_mutex = vert_normals_cache_mutex(mesh)) {
+    cache_mutex->tag_dirty();
+  }
+  if (blender::CacheMutex *cache_mutex = poly_normals_cache_mutex(mesh)) {
+    cache_mutex->tag_dirty();
+  }
 }
 
 float (*BKE_mesh_vertex_normals_for_write(Mesh *mesh))[3]
@@ -125,24 +158,32 @@ float (*BKE_mesh_poly_normals_for_write(Mesh *mesh))[3]
 
 void BKE_mesh_vertex_normals_clear_dirty(Mesh *mesh)
 {
-  mesh->runtime.vert_normals_dirty = false;
+  /* The normals were written directly, so there is nothing to compute. Without runtime data the
+   * normals are always considered dirty. */
+  if (blender::CacheMutex *cache_mutex = vert_normals_cache_mutex(mesh)) {
+    cache_mutex->ensure([]() {});
+  }
   BKE_mesh_assert_normals_dirty_or_calculated(mesh);
 }
 
 void BKE_mesh_poly_normals_clear_dirty(Mesh *mesh)
 {
-  mesh->runtime.poly_normals_dirty = false;
+  if (blender::CacheMutex *cache_mutex = poly_normals_cache_mutex(mesh)) {
+    cache_mutex->ensure([]() {});
+  }
   BKE_mesh_assert_normals_dirty_or_calculated(mesh);
 }
 
 bool BKE_mesh_vertex_normals_are_dirty(const Mesh *mesh)
 {
-  return mesh->runtime.vert_normals_dirty;
+  const blender::CacheMutex *cache_mutex = vert_normals_cache_mutex(mesh);
+  return cache_mutex == nullptr || cache_mutex->is_dirty();
 }
 
 bool BKE_mesh_poly_normals_are_dirty(const Mesh *mesh)
 {
-  return mesh->runtime.poly_normals_dirty;
+  const blender::CacheMutex *cache_mutex = poly_normals_cache_mutex(mesh);
+  return cache_mutex == nullptr || cache_mutex->is_dirty();
 }
 
 void BKE_mesh_clear_derived_normals(Mesh *mesh)
@@ -150,16 +191,15 @@ void BKE_mesh_clear_derived_normals(Mesh *mesh)
   MEM_SAFE_FREE(mesh->runtime.vert_normals);
   MEM_SAFE_FREE(mesh->runtime.poly_normals);
 
-  mesh->runtime.vert_normals_dirty = true;
-  mesh->runtime.poly_normals_dirty = true;
+  BKE_mesh_normals_tag_dirty(mesh);
 }
 
 void BKE_mesh_assert_normals_dirty_or_calculated(const Mesh *mesh)
 {
-  if (!mesh->runtime.vert_normals_dirty) {
+  if (!BKE_mesh_vertex_normals_are_dirty(mesh)) {
     BLI_assert(mesh->runtime.vert_normals || mesh->totvert == 0);
   }
-  if (!mesh->runtime.poly_normals_dirty) {
+  if (!BKE_mesh_poly_normals_are_dirty(mesh)) {
     BLI_assert(mesh->runtime.poly_normals || mesh->totpoly == 0);
   }
 }
@@ -346,96 +386,72 @@ void BKE_mesh_calc_normals_poly_and_vertex(const MVert *mvert,
 
 const float (*BKE_mesh_vertex_normals_ensure(const Mesh *mesh))[3]
 {
-  if (!BKE_mesh_vertex_normals_are_dirty(mesh)) {
-    BLI_assert(mesh->runtime.vert_normals != nullptr || mesh->totvert == 0);
-    return mesh->runtime.vert_normals;
-  }
-
   if (mesh->totvert == 0) {
     return nullptr;
   }
 
-  ThreadMutex *normals_mutex = (ThreadMutex *)mesh->runtime.normals_mutex;
-  BLI_mutex_lock(normals_mutex);
-  if (!BKE_mesh_vertex_normals_are_dirty(mesh)) {
-    BLI_assert(mesh->runtime.vert_normals != nullptr);
-    BLI_mutex_unlock(normals_mutex);
-    return mesh->runtime.vert_normals;
-  }
-
-  float(*vert_normals)[3];
-  float(*poly_normals)[3];
-
-  /* Isolate task because a mutex is locked and computing normals is multi-threaded. */
-  blender::threading::isolate_task([&]() {
+  ensure_normals_cache(vert_normals_cache_mutex(mesh), [&]() {
     Mesh &mesh_mutable = *const_cast<Mesh *>(mesh);
     const Span<MVert> verts = mesh_mutable.verts();
     const Span<MPoly> polys = mesh_mutable.polys();
     const Span<MLoop> loops = mesh_mutable.loops();
 
-    vert_normals = BKE_mesh_vertex_normals_for_write(&mesh_mutable);
-    poly_normals = BKE_mesh_poly_normals_for_write(&mesh_mutable);
-
-    BKE_mesh_calc_normals_poly_and_vertex(verts.data(),
-                                          verts.size(),
-                                          loops.data(),
-                                          loops.size(),
-                                          polys.data(),
-                                          polys.size(),
-                                          poly_normals,
-                                          vert_normals);
-
-    BKE_mesh_vertex_normals_clear_dirty(&mesh_mutable);
-    BKE_mesh_poly_normals_clear_dirty(&mesh_mutable);
+    float(*vert_normals)[3] = BKE_mesh_vertex_normals_for_write(&mesh_mutable);
+
+    /* Polygon normals are calculated as part of the vertex normals anyway, so store them too if
+     * they are dirty. Otherwise they are only calculated temporarily, since other threads may be
+     * reading the existing polygon normals. */
+    bool vert_normals_calculated = false;
+    ensure_normals_cache(poly_normals_cache_mutex(mesh), [&]() {
+      BKE_mesh_calc_normals_poly_and_vertex(verts.data(),
+                                            verts.size(),
+                                            loops.data(),
+                                            loops.size(),
+                                            polys.data(),
+                                            polys.size(),
+                                            BKE_mesh_poly_normals_for_write(&mesh_mutable),
+                                            vert_normals);
+      vert_normals_calculated = true;
+    });
+    if (!vert_normals_calculated) {
+      BKE_mesh_calc_normals_poly_and_vertex(verts.data(),
+                                            verts.size(),
+                                            loops.data(),
+                                            loops.size(),
+                                            polys.data(),
+                                            polys.size(),
+                                            nullptr,
+                                            vert_normals);
+    }
   });
 
-  BLI_mutex_unlock(normals_mutex);
-  return vert_normals;
+  BLI_assert(mesh->runtime.vert_normals != nullptr);
+  return mesh->runtime.vert_normals;
 }
 
 const float (*BKE_mesh_poly_normals_ensure(const Mesh *mesh))[3]
 {
-  if (!BKE_mesh_poly_normals_are_dirty(mesh)) {
-    BLI_assert(mesh->runtime.poly_normals != nullptr || mesh->totpoly == 0);
-    return mesh->runtime.poly_normals;
-  }
-
   if (mesh->totpoly == 0) {
     return nullptr;
   }
 
-  ThreadMutex *normals_mutex = (ThreadMutex *)mesh->runtime.normals_mutex;
-  BLI_mutex_lock(normals_mutex);
-  if (!BKE_mesh_poly_normals_are_dirty(mesh)) {
-    BLI_assert(mesh->runtime.poly_normals != nullptr);
-    BLI_mutex_unlock(normals_mutex);
-    return mesh->runtime.poly_normals;
-  }
-
-  float(*poly_normals)[3];
-
-  /* Isolate task because a mutex is locked and computing normals is multi-threaded. */
-  blender::threading::isolate_task([&]() {
+  ensure_normals_cache(poly_normals_cache_mutex(mesh), [&]() {
     Mesh &mesh_mutable = *const_cast<Mesh *>(mesh);
     const Span<MVert> verts = mesh_mutable.verts();
     const Span<MPoly> polys = mesh_mutable.polys();
     const Span<MLoop> loops = mesh_mutable.loops();
 
-    poly_normals = BKE_mesh_poly_normals_for_write(&mesh_mutable);
-
     BKE_mesh_calc_normals_poly(verts.data(),
                                verts.size(),
                                loops.data(),
                                loops.size(),
                                polys.data(),
                                polys.size(),
-                               poly_normals);
-
-    BKE_mesh_poly_normals_clear_dirty(&mesh_mutable);
+                               BKE_mesh_poly_normals_for_write(&mesh_mutable));
   });
 
-  BLI_mutex_unlock(normals_mutex);
-  return poly_normals;
+  BLI_assert(mesh->runtime.poly_normals != nullptr);
+  return mesh->runtime.poly_normals;
 }
 
 void BKE_mesh_ensure_normals_for_display(Mesh *mesh)
@@ -2054,7 +2070,8 @@ static void mesh_set_custom_normals(Mesh *mesh, float (*r_custom_nors)[3], const
   short(*clnors)[2];
   const int numloops = mesh->totloop;
 
-  clnors = (short(*)[2])CustomData_get_layer(&mesh->ldata, CD_CUSTOMLOOPNORMAL);
+  clnors = (short(*)[2])CustomData_duplicate_referenced_layer(
+      &mesh->ldata, CD_CUSTOMLOOPNORMAL, numloops);
   if (clnors != nullptr) {
     memset(clnors, 0, sizeof(*clnors) * (size_t)numloops);
   }
@@ -13,6 +13,7 @@
 #include "DNA_meshdata_types.h"
 #include "DNA_object_types.h"
 
+#include "BLI_cache_mutex.hh"
 #include "BLI_math_geom.h"
 #include "BLI_task.hh"
 
@@ -39,8 +40,10 @@ static void mesh_runtime_init_mutexes(Mesh *mesh)
 {
   mesh->runtime.eval_mutex = MEM_new<ThreadMutex>("mesh runtime eval_mutex");
   BLI_mutex_init(static_cast<ThreadMutex *>(mesh->runtime.eval_mutex));
-  mesh->runtime.normals_mutex = MEM_new<ThreadMutex>("mesh runtime normals_mutex");
-  BLI_mutex_init(static_cast<ThreadMutex *>(mesh->runtime.normals_mutex));
+  mesh->runtime.vert_normals_cache_mutex = MEM_new<blender::CacheMutex>(
+      "mesh runtime vert_normals_cache_mutex");
+  mesh->runtime.poly_normals_cache_mutex = MEM_new<blender::CacheMutex>(
+      "mesh runtime poly_normals_cache_mutex");
   mesh->runtime.render_mutex = MEM_new<ThreadMutex>("mesh runtime render_mutex");
   BLI_mutex_init(static_cast<ThreadMutex *>(mesh->runtime.render_mutex));
 }
@@ -55,11 +58,10 @@ static void mesh_runtime_free_mutexes(Mesh *mesh)
     MEM_freeN(mesh->runtime.eval_mutex);
     mesh->runtime.eval_mutex = nullptr;
   }
-  if (mesh->runtime.normals_mutex != nullptr) {
-    BLI_mutex_end(static_cast<ThreadMutex *>(mesh->runtime.normals_mutex));
-    MEM_freeN(mesh->runtime.normals_mutex);
-    mesh->runtime.normals_mutex = nullptr;
-  }
+  MEM_delete(static_cast<blender::CacheMutex *>(mesh->runtime.vert_normals_cache_mutex));
+  mesh->runtime.vert_normals_cache_mutex = nullptr;
+  MEM_delete(static_cast<blender::CacheMutex *>(mesh->runtime.poly_normals_cache_mutex));
+  mesh->runtime.poly_normals_cache_mutex = nullptr;
   if (mesh->runtime.render_mutex != nullptr) {
     BLI_mutex_end(static_cast<ThreadMutex *>(mesh->runtime.render_mutex));
     MEM_freeN(mesh->runtime.render_mutex);
@@ -91,8 +93,6 @@ void BKE_mesh_runtime_reset_on_copy(Mesh *mesh, const int UNUSED(flag))
   runtime->shrinkwrap_data = nullptr;
   runtime->subsurf_face_dot_tags = nullptr;
 
-  runtime->vert_normals_dirty = true;
-  runtime->poly_normals_dirty = true;
   runtime->vert_normals = nullptr;
   runtime->poly_normals = nullptr;
 
@@ -178,6 +178,15 @@ int BKE_mesh_runtime_looptri_len(const Mesh *mesh)
 
 const MLoopTri *BKE_mesh_runtime_looptri_ensure(const Mesh *mesh)
 {
+  /* Avoid locking when the triangulation already exists. The array is only published after it
+   * is fully calculated in #BKE_mesh_runtime_looptri_recalc. */
+  MLoopTri *looptri_cached = static_cast<MLoopTri *>(
+      atomic_load_ptr((void *const *)&mesh->runtime.looptris.array));
+  if (looptri_cached != nullptr) {
+    BLI_assert(BKE_mesh_runtime_looptri_len(mesh) == mesh->runtime.looptris.len);
+    return looptri_cached;
+  }
+
   ThreadMutex *mesh_eval_mutex = (ThreadMutex *)mesh->runtime.eval_mutex;
   BLI_mutex_lock(mesh_eval_mutex);
 
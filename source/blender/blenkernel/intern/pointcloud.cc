@@ -76,7 +76,13 @@ static void pointcloud_copy_data(Main *UNUSED(bmain), ID *id_dst, const ID *id_s
   const PointCloud *pointcloud_src = (const PointCloud *)id_src;
   pointcloud_dst->mat = static_cast<Material **>(MEM_dupallocN(pointcloud_src->mat));
 
-  const eCDAllocType alloc_type = (flag & LIB_ID_COPY_CD_REFERENCE) ? CD_REFERENCE : CD_DUPLICATE;
+  eCDAllocType alloc_type = CD_DUPLICATE;
+  if (flag & LIB_ID_COPY_CD_REFERENCE) {
+    alloc_type = CD_REFERENCE;
+  }
+  else if (flag & LIB_ID_COPY_CD_SHARE) {
+    alloc_type = CD_SHARE;
+  }
   CustomData_copy(&pointcloud_src->pdata,
                   &pointcloud_dst->pdata,
                   CD_MASK_ALL,
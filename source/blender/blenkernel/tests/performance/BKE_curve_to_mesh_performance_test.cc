@@ -0,0 +1,86 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#include "testing/testing.h"
+
+#include "BLI_math_rotation.h"
+#include "BLI_timeit.hh"
+
+#include "DNA_mesh_types.h"
+
+#include "BKE_curve_to_mesh.hh"
+#include "BKE_curves.hh"
+#include "BKE_idtype.h"
+#include "BKE_lib_id.h"
+
+namespace blender::bke::tests {
+
+class curve_to_mesh_performance : public testing::Test {
+ public:
+  static void SetUpTestSuite()
+  {
+    BKE_idtype_init();
+  }
+};
+
+/** Main curves with the given number of points each, along the Z axis. */
+static CurvesGeometry create_main_curves(const int curves_num, const int points_per_curve)
+{
+  CurvesGeometry curves(curves_num * points_per_curve, curves_num);
+  MutableSpan<int> offsets = curves.offsets_for_write();
+  for (const int i : offsets.index_range()) {
+    offsets[i] = i * points_per_curve;
+  }
+  MutableSpan<float3> positions = curves.positions_for_write();
+  for (const int i : curves.points_range()) {
+    positions[i] = {float(i / points_per_curve), float(i % 2), float(i % points_per_curve)};
+  }
+  curves.fill_curve_types(CURVE_TYPE_CATMULL_ROM);
+  return curves;
+}
+
+/** A single cyclic poly curve in the shape of a circle. */
+static CurvesGeometry create_circle_profile(const int points_num)
+{
+  CurvesGeometry curves(points_num, 1);
+  curves.offsets_for_write().last() = points_num;
+  MutableSpan<float3> positions = curves.positions_for_write();
+  for (const int i : positions.index_range()) {
+    const float angle = 2.0f * float(M_PI) * i / points_num;
+    positions[i] = {std::cos(angle), std::sin(angle), 0.0f};
+  }
+  curves.fill_curve_types(CURVE_TYPE_POLY);
+  curves.cyclic_for_write().fill(true);
+  return curves;
+}
+
+/** 100k main curves swept with a 16 point profile, a typical cable harness. */
+TEST_F(curve_to_mesh_performance, CableHarness)
+{
+  CurvesGeometry main = create_main_curves(100000, 4);
+  main.resolution_for_write().fill(2);
+  {
+    MutableAttributeAccessor attributes = main.attributes_for_write();
+    SpanAttributeWriter<float> radii = attributes.lookup_or_add_for_write_only_span<float>(
+        "radius", ATTR_DOMAIN_POINT);
+    radii.span.fill(0.1f);
+    radii.finish();
+    SpanAttributeWriter<float> values = attributes.lookup_or_add_for_write_only_span<float>(
+        "value", ATTR_DOMAIN_POINT);
+    values.span.fill(1.0f);
+    values.finish();
+  }
+  CurvesGeometry profile = create_circle_profile(16);
+  main.evaluated_normals();
+
+  for ([[maybe_unused]] const int i : IndexRange(3)) {
+    Mesh *mesh;
+    {
+      SCOPED_TIMER("curve_to_mesh_sweep");
+      mesh = curve_to_mesh_sweep(main, profile, true);
+    }
+    EXPECT_EQ(mesh->totvert, 100000 * 7 * 16);
+    BKE_id_free(nullptr, mesh);
+  }
+}
+
+}  // namespace blender::bke::tests
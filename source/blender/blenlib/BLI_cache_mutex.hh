@@ -0,0 +1,89 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#pragma once
+
+/** \file
+ * \ingroup bli
+ *
+ * A #CacheMutex is used to protect a lazily computed cache that is shared between threads, like
+ * the evaluated positions of curves or the normals of a mesh. The cache data itself is stored
+ * separately, this class only keeps track of whether it is valid and makes sure that it is only
+ * computed once when many threads request it at the same time.
+ *
+ * Reading an up-to-date cache only requires a single atomic load, no lock is taken. When the cache
+ * is dirty, the first thread to request it computes it while holding a mutex, the other threads
+ * wait for it to finish. The computation runs in an isolated task, so that the computing thread
+ * only executes work spawned by the computation itself while it is waiting for that work. Without
+ * isolation, it could pick up an unrelated task that requests the same cache again, which would
+ * dead-lock.
+ *
+ * Usage:
+ * \code{.cc}
+ * class MyData {
+ *   mutable CacheMutex cache_mutex_;
+ *   mutable Vector<int> cache_data_;
+ *
+ *   Span<int> get_cache() const
+ *   {
+ *     cache_mutex_.ensure([&]() { this->cache_data_ = compute_cache(); });
+ *     return cache_data_;
+ *   }
+ *
+ *   void tag_changed()
+ *   {
+ *     cache_mutex_.tag_dirty();
+ *   }
+ * };
+ * \endcode
+ */
+
+#include <atomic>
+#include <mutex>
+
+#include "BLI_function_ref.hh"
+
+namespace blender {
+
+class CacheMutex {
+ private:
+  std::mutex mutex_;
+  std::atomic<bool> cache_valid_ = false;
+
+ public:
+  /**
+   * Make sure the cache exists and is up to date. This calls #compute_cache once to update the
+   * cache (which is stored outside of this class) if it is dirty, otherwise it does nothing.
+   *
+   * This function is thread-safe under the assumption that the same parameters are passed from
+   * every thread.
+   */
+  void ensure(FunctionRef<void()> compute_cache);
+
+  /**
+   * Reset the cache. The next time #ensure is called, the cache will be recomputed.
+   * This must not be called while another thread may be reading the cache.
+   */
+  void tag_dirty()
+  {
+    cache_valid_.store(false);
+  }
+
+  /**
+   * Return true if the cache currently does not exist or has been invalidated.
+   */
+  bool is_dirty() const
+  {
+    return !this->is_cached();
+  }
+
+  /**
+   * Return true if the cache exists and is valid. When this returns true, the cached data can be
+   * read without calling #ensure.
+   */
+  bool is_cached() const
+  {
+    return cache_valid_.load(std::memory_order_acquire);
+  }
+};
+
+}  // namespace blender
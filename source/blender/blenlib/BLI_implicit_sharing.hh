@@ -0,0 +1,70 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#pragma once
+
+/** \file
+ * \ingroup bli
+ *
+ * Implicit sharing allows multiple owners to share the same data as long as none of them modifies
+ * it. Before an owner modifies shared data, it has to make a copy of it first (copy-on-write).
+ * The #ImplicitSharingInfo keeps track of the number of owners and frees the data when the last
+ * owner is gone.
+ */
+
+#include <atomic>
+
+#include "BLI_utildefines.h"
+#include "BLI_utility_mixins.hh"
+
+namespace blender {
+
+/**
+ * The user count of some shared data, together with the knowledge of how to free that data.
+ * Every owner of the data is a user. Sub-classes implement #delete_self_with_data, which is
+ * called when the last user is removed.
+ */
+class ImplicitSharingInfo : NonCopyable, NonMovable {
+ private:
+  mutable std::atomic<int> users_;
+
+ public:
+  ImplicitSharingInfo(const int initial_users = 1) : users_(initial_users)
+  {
+  }
+
+  virtual ~ImplicitSharingInfo()
+  {
+    BLI_assert(users_ == 0);
+  }
+
+  /**
+   * True when there is only a single owner of the data, which may then modify it in place.
+   */
+  bool is_mutable() const
+  {
+    return users_.load(std::memory_order_acquire) == 1;
+  }
+
+  void user_add() const
+  {
+    users_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /**
+   * Remove a user and free the data when it was the last one. The caller must not access the data
+   * anymore afterwards.
+   */
+  void user_remove() const
+  {
+    const int old_users = users_.fetch_sub(1, std::memory_order_acq_rel);
+    BLI_assert(old_users >= 1);
+    if (old_users == 1) {
+      const_cast<ImplicitSharingInfo *>(this)->delete_self_with_data();
+    }
+  }
+
+ private:
+  virtual void delete_self_with_data() = 0;
+};
+
+}  // namespace blender
@@ -0,0 +1,197 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#pragma once
+
+/** \file
+ * \ingroup bli
+ *
+ * A #CompressedIndexMask contains sorted indices without duplicates, just like an #IndexMask.
+ * However, it owns the indices and stores them in a compact form, which makes it suitable for
+ * large selections that are kept around for a while.
+ *
+ * The index space is split into segments of #CompressedIndexMask::segment_size indices. Every
+ * segment that contains indices uses the smallest of three representations:
+ * - A range, when the indices in the segment are contiguous. This needs no additional memory.
+ * - A list of 16 bit offsets from the start of the segment, when there are only few indices.
+ * - A bitset, when there are many indices that are not contiguous.
+ *
+ * For example, a random selection of half of 50 million points needs about 6 MB, compared to
+ * 200 MB for the array of 64 bit integers that an #IndexMask references. Functions that expect
+ * an #IndexMask can be called with #to_index_mask, or with smaller masks for each segment with
+ * #foreach_segment.
+ */
+
+#include "BLI_function_ref.hh"
+#include "BLI_index_mask.hh"
+#include "BLI_math_bits.h"
+#include "BLI_vector.hh"
+
+namespace blender {
+
+class CompressedIndexMask {
+ public:
+  /** The number of indices that every segment covers. Offsets within a segment fit in 16 bit. */
+  static constexpr int64_t segment_size = 1 << 14;
+  static constexpr int64_t words_per_segment = segment_size / 64;
+  /** Segments with more indices use a bitset, which is smaller then. */
+  static constexpr int64_t max_offsets_num = words_per_segment * sizeof(uint64_t) /
+                                             sizeof(int16_t);
+
+  enum class SegmentType : int8_t {
+    Range,
+    Offsets,
+    Bits,
+  };
+
+  struct Segment {
+    /** The first index that the segment can contain. This is a multiple of #segment_size. */
+    int64_t start;
+    /** The number of indices in all previous segments. */
+    int64_t mask_start;
+    /** The number of indices in this segment, which is never zero. */
+    int64_t size;
+    /**
+     * For ranges, the offset of the first index from #start. Otherwise the position of the first
+     * offset or word of this segment in #offsets_ or #bits_.
+     */
+    int64_t data;
+    SegmentType type;
+  };
+
+ private:
+  Vector<Segment> segments_;
+  Vector<int16_t> offsets_;
+  Vector<uint64_t> bits_;
+
+ public:
+  /** Create a mask that contains no indices. */
+  CompressedIndexMask() = default;
+  explicit CompressedIndexMask(IndexMask mask);
+
+  /**
+   * Build a mask from bitsets of each segment, filled by #fill_bits in parallel.
+   *
+   * \param segment_starts: The sorted start indices of all segments that may contain indices.
+   * \param fill_bits: Sets the bits of the indices in a segment, from the given start. The bits
+   * are zero initially and there are #words_per_segment words with 64 bits each.
+   */
+  static CompressedIndexMask from_bits(
+      Span<int64_t> segment_starts,
+      FunctionRef<void(int64_t segment_start, MutableSpan<uint64_t> r_bits)> fill_bits);
+
+  static CompressedIndexMask from_union(const CompressedIndexMask &a,
+                                        const CompressedIndexMask &b);
+  static CompressedIndexMask from_intersection(const CompressedIndexMask &a,
+                                               const CompressedIndexMask &b);
+  /** Create a mask with the indices of #a that are not in #b. */
+  static CompressedIndexMask from_difference(const CompressedIndexMask &a,
+                                             const CompressedIndexMask &b);
+
+  int64_t size() const
+  {
+    return segments_.is_empty() ? 0 : segments_.last().mask_start + segments_.last().size;
+  }
+
+  bool is_empty() const
+  {
+    return segments_.is_empty();
+  }
+
+  Span<Segment> segments() const
+  {
+    return segments_;
+  }
+
+  /** The number of bytes used to store the indices. */
+  int64_t size_in_bytes() const
+  {
+    return segments_.size() * sizeof(Segment) + offsets_.size() * sizeof(int16_t) +
+           bits_.size() * sizeof(uint64_t);
+  }
+
+  bool contains(int64_t index) const;
+
+  /**
+   * Calls the given callback for every index in ascending order. Contiguous segments are
+   * iterated without reading memory.
+   */
+  template<typename Fn> void foreach_index(const Fn &fn) const
+  {
+    for (const Segment &segment : segments_) {
+      switch (segment.type) {
+        case SegmentType::Range: {
+          const int64_t first = segment.start + segment.data;
+          for (int64_t i = first; i < first + segment.size; i++) {
+            fn(i);
+          }
+          break;
+        }
+        case SegmentType::Offsets: {
+          for (const int16_t offset : this->segment_offsets(segment)) {
+            fn(segment.start + offset);
+          }
+          break;
+        }
+        case SegmentType::Bits: {
+          const Span<uint64_t> words = this->segment_bits(segment);
+          for (const int64_t word_index : words.index_range()) {
+            uint64_t word = words[word_index];
+            const int64_t word_start = segment.start + word_index * 64;
+            while (word != 0) {
+              fn(word_start + int64_t(bitscan_forward_uint64(word)));
+              /* Clear the lowest set bit. */
+              word &= word - 1;
+            }
+          }
+          break;
+        }
+      }
+    }
+  }
+
+  /**
+   * Calls the given callback with an #IndexMask for every segment, which is a range when
+   * possible. The mask is only valid during the call.
+   */
+  template<typename Fn> void foreach_segment(const Fn &fn) const
+  {
+    Vector<int64_t> indices;
+    for (const Segment &segment : segments_) {
+      if (segment.type == SegmentType::Range) {
+        fn(IndexMask(IndexRange(segment.start + segment.data, segment.size)));
+        continue;
+      }
+      indices.reinitialize(segment.size);
+      this->segment_to_indices(segment, indices);
+      fn(IndexMask(indices.as_span()));
+    }
+  }
+
+  /**
+   * Get an #IndexMask with the same indices. #r_indices is only filled if the indices are not
+   * contiguous.
+   */
+  IndexMask to_index_mask(Vector<int64_t> &r_indices) const;
+  void to_indices(MutableSpan<int64_t> r_indices) const;
+  /** Set the values at the indices in the mask to true, without changing the others. */
+  void to_bools(MutableSpan<bool> r_bools) const;
+
+ private:
+  Span<int16_t> segment_offsets(const Segment &segment) const
+  {
+    return offsets_.as_span().slice(segment.data, segment.size);
+  }
+
+  Span<uint64_t> segment_bits(const Segment &segment) const
+  {
+    return bits_.as_span().slice(segment.data, words_per_segment);
+  }
+
+  const Segment *find_segment(int64_t segment_start) const;
+  void segment_to_indices(const Segment &segment, MutableSpan<int64_t> r_indices) const;
+  void segment_to_bits(int64_t segment_start, MutableSpan<uint64_t> r_bits) const;
+  void append_segment(int64_t segment_start, Span<uint64_t> bits);
+  void append_mask(const CompressedIndexMask &other);
+};
+
+}  // namespace blender
@@ -11,6 +11,7 @@
 
 #include "BLI_enumerable_thread_specific.hh"
 #include "BLI_index_mask.hh"
+#include "BLI_index_mask_compressed.hh"
 #include "BLI_task.hh"
 #include "BLI_vector.hh"
 #include "BLI_virtual_array.hh"
@@ -71,4 +72,12 @@ IndexMask find_indices_from_virtual_array(IndexMask indices_to_check,
                                           int64_t parallel_grain_size,
                                           Vector<int64_t> &r_indices);
 
+/**
+ * Same as #find_indices_from_virtual_array, but the result owns its indices in the compact form
+ * of a #CompressedIndexMask. This is preferable for large selections, where the temporary
+ * vectors of the regular version use a lot of memory.
+ */
+CompressedIndexMask find_indices_from_virtual_array_compressed(IndexMask indices_to_check,
+                                                               const VArray<bool> &virtual_array);
+
 }  // namespace blender::index_mask_ops
@@ -154,6 +154,15 @@ void BLI_bvhtree_free(BVHTree *tree);
  */
 void BLI_bvhtree_insert(BVHTree *tree, int index, const float co[3], int numpoints);
 void BLI_bvhtree_balance(BVHTree *tree);
+/**
+ * Alternative to #BLI_bvhtree_balance that splits branches using the surface area heuristic,
+ * which takes longer to build but makes ray casts and nearest point queries faster. The leafs are
+ * reordered to match the tree, so #BLI_bvhtree_update_node can't be used afterwards.
+ *
+ * \note Only binary trees with x, y and z axes (`axis` other than 18) are supported, other trees
+ * are balanced with #BLI_bvhtree_balance.
+ */
+void BLI_bvhtree_balance_sah(BVHTree *tree);
 
 /**
  * Update: first update points/nodes, then call update_tree to refit the bounding volumes.
@@ -226,6 +235,21 @@ int BLI_bvhtree_find_nearest(BVHTree *tree,
                              BVHTree_NearestPointCallback callback,
                              void *userdata);
 
+/**
+ * Find the nearest node for many coordinates at once, in parallel.
+ *
+ * \param nearest: One result per coordinate, it has to be initialized like for
+ * #BLI_bvhtree_find_nearest_ex. Results for nearby coordinates are used as initial upper
+ * bound, so the callback has to compute the squared distance between the coordinate and the
+ * #BVHTreeNearest.co it finds.
+ */
+void BLI_bvhtree_find_nearest_batch(BVHTree *tree,
+                                    const float (*co)[3],
+                                    int points_num,
+                                    BVHTreeNearest *nearest,
+                                    BVHTree_NearestPointCallback callback,
+                                    void *userdata);
+
 /**
  * Find the first node nearby.
  * Favors speed over quality since it doesn't find the best target node.
@@ -277,6 +301,25 @@ void BLI_bvhtree_ray_cast_all(BVHTree *tree,
                               BVHTree_RayCastCallback callback,
                               void *userdata);
 
+/**
+ * Cast many rays at once, which is much faster than casting them one by one, especially when
+ * rays that are close to each other have similar directions. The rays are processed in
+ * parallel, so the callback has to be thread-safe.
+ *
+ * \param directions: Normalized ray directions.
+ * \param hits: One hit per ray, #BVHTreeRayHit.index and #BVHTreeRayHit.dist have to be
+ * initialized like for #BLI_bvhtree_ray_cast_ex.
+ */
+void BLI_bvhtree_ray_cast_batch(BVHTree *tree,
+                                const float (*origins)[3],
+                                const float (*directions)[3],
+                                int rays_num,
+                                float radius,
+                                BVHTreeRayHit *hits,
+                                BVHTree_RayCastCallback callback,
+                                void *userdata,
+                                int flag);
+
 float BLI_bvhtree_bb_raycast(const float bv[6],
                              const float light_start[3],
                              const float light_end[3],
@@ -329,6 +372,7 @@ extern const float bvhtree_kdop_axes[13][3];
 
 #  include "BLI_function_ref.hh"
 #  include "BLI_math_vector.hh"
+#  include "BLI_span.hh"
 
 namespace blender {
 
@@ -355,6 +399,43 @@ inline void BLI_bvhtree_ray_cast_all_cpp(BVHTree &tree,
       &fn);
 }
 
+inline void BLI_bvhtree_ray_cast_batch_cpp(BVHTree &tree,
+                                           const Span<float3> origins,
+                                           const Span<float3> directions,
+                                           const float radius,
+                                           MutableSpan<BVHTreeRayHit> hits,
+                                           BVHTree_RayCastCallback callback,
+                                           void *userdata,
+                                           const int flag = BVH_RAYCAST_DEFAULT)
+{
+  BLI_assert(origins.size() == hits.size());
+  BLI_assert(directions.size() == hits.size());
+  BLI_bvhtree_ray_cast_batch(&tree,
+                             reinterpret_cast<const float(*)[3]>(origins.data()),
+                             reinterpret_cast<const float(*)[3]>(directions.data()),
+                             int(hits.size()),
+                             radius,
+                             hits.data(),
+                             callback,
+                             userdata,
+                             flag);
+}
+
+inline void BLI_bvhtree_find_nearest_batch_cpp(BVHTree &tree,
+                                               const Span<float3> co,
+                                               MutableSpan<BVHTreeNearest> nearest,
+                                               BVHTree_NearestPointCallback callback,
+                                               void *userdata)
+{
+  BLI_assert(co.size() == nearest.size());
+  BLI_bvhtree_find_nearest_batch(&tree,
+                                 reinterpret_cast<const float(*)[3]>(co.data()),
+                                 int(nearest.size()),
+                                 nearest.data(),
+                                 callback,
+                                 userdata);
+}
+
 using BVHTree_RangeQuery_CPP = FunctionRef<void(int index, const float3 &co, float dist_sq)>;
 
 inline void BLI_bvhtree_range_query_cpp(BVHTree &tree,
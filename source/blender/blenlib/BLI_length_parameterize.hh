@@ -41,6 +41,67 @@ void accumulate_lengths(const Span<T> values, const bool cyclic, MutableSpan<flo
   }
 }
 
+namespace detail {
+
+/** Five point Gauss-Legendre quadrature of the derivative's magnitude. */
+template<typename DerivativeFn>
+inline float integrate_length_gauss(const DerivativeFn &derivative_fn,
+                                    const float start,
+                                    const float end)
+{
+  static constexpr float nodes[5] = {
+      0.0f, -0.5384693101056831f, 0.5384693101056831f, -0.9061798459386640f, 0.9061798459386640f};
+  static constexpr float weights[5] = {0.5688888888888889f,
+                                       0.4786286704993665f,
+                                       0.4786286704993665f,
+                                       0.2369268850561891f,
+                                       0.2369268850561891f};
+  const float half_size = 0.5f * (end - start);
+  const float center = 0.5f * (end + start);
+  float length = 0.0f;
+  for (const int i : IndexRange(5)) {
+    length += weights[i] * math::length(derivative_fn(center + half_size * nodes[i]));
+  }
+  return length * half_size;
+}
+
+template<typename DerivativeFn>
+inline float integrate_length_adaptive(const DerivativeFn &derivative_fn,
+                                       const float start,
+                                       const float end,
+                                       const float whole,
+                                       const int depth)
+{
+  const float middle = 0.5f * (start + end);
+  const float left = integrate_length_gauss(derivative_fn, start, middle);
+  const float right = integrate_length_gauss(derivative_fn, middle, end);
+  const float sum = left + right;
+  if (depth == 0 || std::abs(sum - whole) <= 1e-6f * sum) {
+    return sum;
+  }
+  return integrate_length_adaptive(derivative_fn, start, middle, left, depth - 1) +
+         integrate_length_adaptive(derivative_fn, middle, end, right, depth - 1);
+}
+
+}  // namespace detail
+
+/**
+ * Calculate the length of a parametric curve between two parameters by integrating the magnitude
+ * of its derivative with five point Gauss-Legendre quadrature. The interval is subdivided where
+ * the quadrature doesn't converge, which happens around sharp bends where the magnitude of the
+ * derivative isn't smooth. The derivative should be continuous in the interval.
+ *
+ * \param derivative_fn: Returns the derivative of the curve (a #float3) at a given parameter.
+ */
+template<typename DerivativeFn>
+inline float integrate_length(const DerivativeFn &derivative_fn,
+                              const float start,
+                              const float end)
+{
+  const float whole = detail::integrate_length_gauss(derivative_fn, start, end);
+  return detail::integrate_length_adaptive(derivative_fn, start, end, whole, 8);
+}
+
 template<typename T>
 inline void interpolate_to_masked(const Span<T> src,
                                   const Span<int> indices,
@@ -30,6 +30,10 @@
 #  endif
 #endif
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
 #include "BLI_index_range.hh"
 #include "BLI_lazy_threading.hh"
 #include "BLI_utildefines.h"
@@ -71,6 +75,105 @@ void parallel_for(IndexRange range, int64_t grain_size, const Function &function
   function(range);
 }
 
+/**
+ * Chooses the grain size for #parallel_for_adaptive based on how long it took to process elements
+ * in previous tasks. It is meant to be a static variable at the call site, so that measurements
+ * are reused by later calls with the same kind of work.
+ */
+class AdaptiveGrainSize {
+ public:
+  /**
+   * Tasks should take about this long. Shorter tasks make the scheduling overhead significant,
+   * longer tasks make it harder to balance the work between many threads.
+   */
+  static constexpr double target_task_ns = 20000.0;
+  /** Shorter durations are not used, because they are dominated by the timer resolution. */
+  static constexpr int64_t min_measurement_ns = 2000;
+
+ private:
+  /** Moving average of the time it takes to process one element, zero when unknown. */
+  std::atomic<double> ns_per_element_ = 0.0;
+  int64_t min_grain_size_;
+  int64_t max_grain_size_;
+
+ public:
+  AdaptiveGrainSize(const int64_t min_grain_size = 1, const int64_t max_grain_size = 1 << 20)
+      : min_grain_size_(min_grain_size), max_grain_size_(max_grain_size)
+  {
+  }
+
+  bool has_measurement() const
+  {
+    return ns_per_element_.load(std::memory_order_relaxed) > 0.0;
+  }
+
+  int64_t grain_size() const
+  {
+    const double ns_per_element = ns_per_element_.load(std::memory_order_relaxed);
+    if (ns_per_element <= 0.0) {
+      return min_grain_size_;
+    }
+    const double grain_size = target_task_ns / ns_per_element;
+    return int64_t(std::clamp(grain_size, double(min_grain_size_), double(max_grain_size_)));
+  }
+
+  void add_measurement(const int64_t elements_num, const std::chrono::nanoseconds duration)
+  {
+    if (elements_num == 0 || duration.count() < min_measurement_ns) {
+      return;
+    }
+    const double sample = double(duration.count()) / double(elements_num);
+    double old_value = ns_per_element_.load(std::memory_order_relaxed);
+    double new_value;
+    do {
+      /* Give recent measurements more weight, in case the work per element changes. */
+      new_value = old_value > 0.0 ? old_value * 0.75 + sample * 0.25 : sample;
+    } while (!ns_per_element_.compare_exchange_weak(old_value, new_value));
+  }
+};
+
+/**
+ * Same as #parallel_for, but the grain size is derived from the measured time per element instead
+ * of being fixed. This is useful when the cost per element is not known in advance or varies a
+ * lot, e.g. because it depends on the data type or on user settings. When nothing was measured
+ * yet, exponentially growing chunks are processed on the calling thread first.
+ */
+template<typename Function>
+void parallel_for_adaptive(IndexRange range,
+                           AdaptiveGrainSize &grain_size,
+                           const Function &function)
+{
+  if (range.size() == 0) {
+    return;
+  }
+#ifdef WITH_TBB
+  using Clock = std::chrono::steady_clock;
+  int64_t done_num = 0;
+  if (!grain_size.has_measurement()) {
+    for (int64_t chunk_size = 1; done_num < range.size(); chunk_size *= 2) {
+      const int64_t size = std::min(chunk_size, range.size() - done_num);
+      const IndexRange chunk = range.slice(done_num, size);
+      const Clock::time_point start = Clock::now();
+      function(chunk);
+      grain_size.add_measurement(chunk.size(), Clock::now() - start);
+      done_num += chunk.size();
+      if (grain_size.has_measurement()) {
+        break;
+      }
+    }
+  }
+  const IndexRange remaining = range.drop_front(done_num);
+  parallel_for(remaining, grain_size.grain_size(), [&](const IndexRange sub_range) {
+    const Clock::time_point start = Clock::now();
+    function(sub_range);
+    grain_size.add_measurement(sub_range.size(), Clock::now() - start);
+  });
+#else
+  UNUSED_VARS(grain_size);
+  function(range);
+#endif
+}
+
 template<typename Value, typename Function, typename Reduction>
 Value parallel_reduce(IndexRange range,
                       int64_t grain_size,
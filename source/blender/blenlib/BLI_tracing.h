@@ -0,0 +1,32 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#pragma once
+
+/** \file
+ * \ingroup bli
+ *
+ * Recording of a timeline of what every thread is doing, for profiling. See `BLI_tracing.hh` for
+ * how events are recorded.
+ */
+
+#include "BLI_utildefines.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Start recording events. They are written to the given file in the Chrome trace event format
+ * when #BLI_tracing_end is called. The file can be opened in Perfetto or `chrome://tracing`.
+ */
+void BLI_tracing_begin(const char *filepath);
+/**
+ * Stop recording events and write them to the file. Does nothing if tracing was not started.
+ * \return False if the file could not be written.
+ */
+bool BLI_tracing_end(void);
+bool BLI_tracing_is_enabled(void);
+
+#ifdef __cplusplus
+}
+#endif
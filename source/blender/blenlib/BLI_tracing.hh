@@ -0,0 +1,94 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#pragma once
+
+/** \file
+ * \ingroup bli
+ *
+ * Events are spans of time on a specific thread, which are only recorded when tracing has been
+ * started with #BLI_tracing_begin. Otherwise, a #ScopedEvent only costs an atomic load, so events
+ * can be added in places that are executed often, but not in the innermost loops.
+ *
+ * \code{.cc}
+ * SCOPED_TRACE_EVENT("geometry", "Realize Instances");
+ * SCOPED_TRACE_EVENT("lazy_function", [&]() { return fn.name(); });
+ * \endcode
+ */
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <type_traits>
+
+#include "BLI_string_ref.hh"
+#include "BLI_tracing.h"
+#include "BLI_utility_mixins.hh"
+
+namespace blender::tracing {
+
+namespace detail {
+extern std::atomic<bool> is_enabled;
+void add_event(const char *category,
+               StringRef name,
+               std::chrono::steady_clock::time_point start,
+               std::chrono::steady_clock::time_point end);
+}  // namespace detail
+
+inline bool is_enabled()
+{
+  return detail::is_enabled.load(std::memory_order_relaxed);
+}
+
+/**
+ * Records an event that lasts as long as this object exists.
+ */
+class ScopedEvent : NonCopyable, NonMovable {
+ private:
+  /** Null when tracing is disabled. */
+  const char *category_ = nullptr;
+  std::string name_;
+  std::chrono::steady_clock::time_point start_;
+
+ public:
+  /**
+   * \param category: Used to filter events in the viewer. Has to be a static string.
+   */
+  ScopedEvent(const char *category, StringRef name)
+  {
+    if (is_enabled()) {
+      this->start(category, name);
+    }
+  }
+
+  /**
+   * Same as above, but the name is only built when tracing is enabled.
+   */
+  template<typename GetNameFn,
+           BLI_ENABLE_IF((std::is_invocable_r_v<std::string, const GetNameFn &>))>
+  ScopedEvent(const char *category, const GetNameFn &get_name)
+  {
+    if (is_enabled()) {
+      this->start(category, get_name());
+    }
+  }
+
+  ~ScopedEvent()
+  {
+    if (category_ != nullptr) {
+      detail::add_event(category_, name_, start_, std::chrono::steady_clock::now());
+    }
+  }
+
+ private:
+  void start(const char *category, std::string name)
+  {
+    category_ = category;
+    name_ = std::move(name);
+    start_ = std::chrono::steady_clock::now();
+  }
+};
+
+}  // namespace blender::tracing
+
+#define SCOPED_TRACE_EVENT(category, name) \
+  blender::tracing::ScopedEvent scoped_trace_event(category, name)
@@ -847,6 +847,434 @@ static void non_recursive_bvh_div_nodes(const BVHTree *tree,
 
 /** \} */
 
+/* -------------------------------------------------------------------- */
+/** \name SAH Tree Build
+ *
+ * Alternative to the implicit tree built by #BLI_bvhtree_balance. The tree is built top-down,
+ * every branch is split where the surface area heuristic estimates the lowest cost for queries.
+ * Candidate splits are the boundaries between #BVH_SAH_BINS bins of the leaf centers along each
+ * axis. Sub-trees are built in parallel.
+ *
+ * A branch with N leafs is always followed by the N - 2 other branches of its sub-tree, so the
+ * index of every branch is known without synchronization between threads. At the end, the leafs
+ * are moved into the order in which they appear in the tree, so that the leafs of a sub-tree are
+ * next to each other in memory.
+ * \{ */
+
+#define BVH_SAH_BINS 16
+
+/** Smaller sub-trees are built by the thread that created them. */
+#define BVH_SAH_TASK_LEAF_THRESHOLD 4096
+
+/** Leafs of larger branches are bounded and binned by multiple threads. */
+#define BVH_SAH_PARALLEL_LEAF_THRESHOLD 65536
+
+typedef struct BVHSAHBin {
+  int count;
+  float min[3];
+  float max[3];
+} BVHSAHBin;
+
+typedef struct BVHSAHBounds {
+  /** Bounding volume of all leafs, for all axes of the tree. */
+  float bv[26];
+  /** Bounds of the leaf centers, which determine the size of the bins. */
+  float center_min[3];
+  float center_max[3];
+} BVHSAHBounds;
+
+typedef struct BVHSAHBinning {
+  BVHSAHBin bins[3][BVH_SAH_BINS];
+} BVHSAHBinning;
+
+typedef struct BVHSAHBuildData {
+  const BVHTree *tree;
+  /** The branches, stored after the leafs in #BVHTree.nodearray. */
+  BVHNode *branches_array;
+  /** Indices of the leafs in the order of the tree, reordered while splitting branches. */
+  int *leafs_order;
+  /** The centers of the leaf bounding volumes, indexed like the leafs in #BVHTree.nodearray. */
+  float (*leaf_centers)[3];
+  TaskPool *task_pool;
+} BVHSAHBuildData;
+
+/** A range in #BVHSAHBuildData.leafs_order that becomes the branch with the given index. */
+typedef struct BVHSAHRange {
+  int begin;
+  int end;
+  int branch_index;
+} BVHSAHRange;
+
+typedef struct BVHSAHRangeTaskData {
+  const BVHSAHBuildData *build;
+  const BVHSAHBounds *bounds;
+  float bin_scale[3];
+} BVHSAHRangeTaskData;
+
+/** Only the x, y and z axes are used to find splits, they are the first axes of the tree. */
+static void bvh_sah_leaf_center(const float *bv, float r_center[3])
+{
+  r_center[0] = (bv[0] + bv[1]) * 0.5f;
+  r_center[1] = (bv[2] + bv[3]) * 0.5f;
+  r_center[2] = (bv[4] + bv[5]) * 0.5f;
+}
+
+static void bvh_sah_bounds_init(const BVHTree *tree, BVHSAHBounds *bounds)
+{
+  for (axis_t axis_iter = tree->start_axis; axis_iter < tree->stop_axis; axis_iter++) {
+    bounds->bv[2 * axis_iter] = FLT_MAX;
+    bounds->bv[2 * axis_iter + 1] = -FLT_MAX;
+  }
+  copy_v3_fl(bounds->center_min, FLT_MAX);
+  copy_v3_fl(bounds->center_max, -FLT_MAX);
+}
+
+static void bvh_sah_bounds_add_leaf(const BVHSAHBuildData *data,
+                                    BVHSAHBounds *bounds,
+                                    const int leaf_index)
+{
+  const BVHTree *tree = data->tree;
+  const float *bv = tree->nodearray[leaf_index].bv;
+  for (axis_t axis_iter = tree->start_axis; axis_iter < tree->stop_axis; axis_iter++) {
+    bounds->bv[2 * axis_iter] = min_ff(bounds->bv[2 * axis_iter], bv[2 * axis_iter]);
+    bounds->bv[2 * axis_iter + 1] = max_ff(bounds->bv[2 * axis_iter + 1], bv[2 * axis_iter + 1]);
+  }
+  minmax_v3v3_v3(bounds->center_min, bounds->center_max, data->leaf_centers[leaf_index]);
+}
+
+static void bvh_sah_bounds_task_cb(void *__restrict userdata,
+                                   const int iter,
+                                   const TaskParallelTLS *__restrict tls)
+{
+  const BVHSAHRangeTaskData *data = userdata;
+  bvh_sah_bounds_add_leaf(data->build, tls->userdata_chunk, data->build->leafs_order[iter]);
+}
+
+static void bvh_sah_bounds_reduce(const void *__restrict userdata,
+                                  void *__restrict chunk_join,
+                                  void *__restrict chunk)
+{
+  const BVHSAHRangeTaskData *data = userdata;
+  const BVHTree *tree = data->build->tree;
+  BVHSAHBounds *join = chunk_join;
+  const BVHSAHBounds *bounds = chunk;
+  for (axis_t axis_iter = tree->start_axis; axis_iter < tree->stop_axis; axis_iter++) {
+    join->bv[2 * axis_iter] = min_ff(join->bv[2 * axis_iter], bounds->bv[2 * axis_iter]);
+    join->bv[2 * axis_iter + 1] = max_ff(join->bv[2 * axis_iter + 1],
+                                         bounds->bv[2 * axis_iter + 1]);
+  }
+  for (int i = 0; i < 3; i++) {
+    join->center_min[i] = min_ff(join->center_min[i], bounds->center_min[i]);
+    join->center_max[i] = max_ff(join->center_max[i], bounds->center_max[i]);
+  }
+}
+
+static int bvh_sah_bin_index(const BVHSAHRangeTaskData *data, const float center[3], int axis)
+{
+  const int bin = (int)((center[axis] - data->bounds->center_min[axis]) * data->bin_scale[axis]);
+  return clamp_i(bin, 0, BVH_SAH_BINS - 1);
+}
+
+static void bvh_sah_bin_add_leaf(const BVHSAHRangeTaskData *data,
+                                 BVHSAHBinning *binning,
+                                 const int leaf_index)
+{
+  const float *bv = data->build->tree->nodearray[leaf_index].bv;
+  const float *center = data->build->leaf_centers[leaf_index];
+  for (int axis = 0; axis < 3; axis++) {
+    BVHSAHBin *bin = &binning->bins[axis][bvh_sah_bin_index(data, center, axis)];
+    bin->count++;
+    for (int i = 0; i < 3; i++) {
+      bin->min[i] = min_ff(bin->min[i], bv[2 * i]);
+      bin->max[i] = max_ff(bin->max[i], bv[2 * i + 1]);
+    }
+  }
+}
+
+static void bvh_sah_binning_init(BVHSAHBinning *binning)
+{
+  for (int axis = 0; axis < 3; axis++) {
+    for (int i = 0; i < BVH_SAH_BINS; i++) {
+      BVHSAHBin *bin = &binning->bins[axis][i];
+      bin->count = 0;
+      copy_v3_fl(bin->min, FLT_MAX);
+      copy_v3_fl(bin->max, -FLT_MAX);
+    }
+  }
+}
+
+static void bvh_sah_binning_task_cb(void *__restrict userdata,
+                                    const int iter,
+                                    const TaskParallelTLS *__restrict tls)
+{
+  const BVHSAHRangeTaskData *data = userdata;
+  const int leaf_index = data->build->leafs_order[iter];
+  bvh_sah_bin_add_leaf(data, tls->userdata_chunk, leaf_index);
+}
+
+/** Extend the box by the bounds of the bin, empty bins are skipped. */
+static void bvh_sah_bin_extend(float min[3], float max[3], const BVHSAHBin *bin)
+{
+  if (bin->count > 0) {
+    for (int i = 0; i < 3; i++) {
+      min[i] = min_ff(min[i], bin->min[i]);
+      max[i] = max_ff(max[i], bin->max[i]);
+    }
+  }
+}
+
+static void bvh_sah_binning_reduce(const void *__restrict UNUSED(userdata),
+                                   void *__restrict chunk_join,
+                                   void *__restrict chunk)
+{
+  BVHSAHBinning *join = chunk_join;
+  const BVHSAHBinning *binning = chunk;
+  for (int axis = 0; axis < 3; axis++) {
+    for (int i = 0; i < BVH_SAH_BINS; i++) {
+      BVHSAHBin *bin_join = &join->bins[axis][i];
+      const BVHSAHBin *bin = &binning->bins[axis][i];
+      bvh_sah_bin_extend(bin_join->min, bin_join->max, bin);
+      bin_join->count += bin->count;
+    }
+  }
+}
+
+/** Half of the surface area of a box, which is proportional to the probability of a ray hit. */
+static float bvh_sah_half_area(const float min[3], const float max[3])
+{
+  float size[3];
+  sub_v3_v3v3(size, max, min);
+  if (size[0] < 0.0f) {
+    return 0.0f;
+  }
+  return size[0] * size[1] + size[1] * size[2] + size[2] * size[0];
+}
+
+/**
+ * Find the split with the lowest cost.
+ * \return False if all leaf centers are in the same bin along every axis.
+ */
+static bool bvh_sah_find_split(const BVHSAHBinning *binning, int *r_axis, int *r_bin)
+{
+  float best_cost = FLT_MAX;
+  for (int axis = 0; axis < 3; axis++) {
+    const BVHSAHBin *bins = binning->bins[axis];
+    /* Leafs on the right side of every split, accumulated from the right. */
+    int right_count[BVH_SAH_BINS];
+    float right_area[BVH_SAH_BINS];
+    float min[3], max[3];
+    copy_v3_fl(min, FLT_MAX);
+    copy_v3_fl(max, -FLT_MAX);
+    int count = 0;
+    for (int i = BVH_SAH_BINS - 1; i > 0; i--) {
+      bvh_sah_bin_extend(min, max, &bins[i]);
+      count += bins[i].count;
+      right_count[i] = count;
+      right_area[i] = bvh_sah_half_area(min, max);
+    }
+    copy_v3_fl(min, FLT_MAX);
+    copy_v3_fl(max, -FLT_MAX);
+    count = 0;
+    for (int i = 1; i < BVH_SAH_BINS; i++) {
+      bvh_sah_bin_extend(min, max, &bins[i - 1]);
+      count += bins[i - 1].count;
+      if (count == 0 || right_count[i] == 0) {
+        continue;
+      }
+      const float cost = (float)count * bvh_sah_half_area(min, max) +
+                         (float)right_count[i] * right_area[i];
+      if (cost < best_cost) {
+        best_cost = cost;
+        *r_axis = axis;
+        *r_bin = i;
+      }
+    }
+  }
+  return best_cost < FLT_MAX;
+}
+
+/**
+ * Compute the bounding volume of the branch and split its leafs into two ranges.
+ * \return The first leaf of the second range.
+ */
+static int bvh_sah_split_branch(const BVHSAHBuildData *data, BVHNode *node, int begin, int end)
+{
+  const BVHTree *tree = data->tree;
+  const bool use_threading = end - begin > BVH_SAH_PARALLEL_LEAF_THRESHOLD;
+
+  BVHSAHBounds bounds;
+  bvh_sah_bounds_init(tree, &bounds);
+  BVHSAHRangeTaskData task_data = {.build = data, .bounds = &bounds};
+  if (use_threading) {
+    TaskParallelSettings settings;
+    BLI_parallel_range_settings_defaults(&settings);
+    settings.userdata_chunk = &bounds;
+    settings.userdata_chunk_size = sizeof(bounds);
+    settings.func_reduce = bvh_sah_bounds_reduce;
+    BLI_task_parallel_range(begin, end, &task_data, bvh_sah_bounds_task_cb, &settings);
+  }
+  else {
+    for (int i = begin; i < end; i++) {
+      bvh_sah_bounds_add_leaf(data, &bounds, data->leafs_order[i]);
+    }
+  }
+  for (axis_t axis_iter = tree->start_axis; axis_iter < tree->stop_axis; axis_iter++) {
+    node->bv[2 * axis_iter] = bounds.bv[2 * axis_iter];
+    node->bv[2 * axis_iter + 1] = bounds.bv[2 * axis_iter + 1];
+  }
+
+  for (int axis = 0; axis < 3; axis++) {
+    const float extent = bounds.center_max[axis] - bounds.center_min[axis];
+    task_data.bin_scale[axis] = extent > 0.0f ? (float)BVH_SAH_BINS / extent : 0.0f;
+  }
+  BVHSAHBinning binning;
+  bvh_sah_binning_init(&binning);
+  if (use_threading) {
+    TaskParallelSettings settings;
+    BLI_parallel_range_settings_defaults(&settings);
+    settings.userdata_chunk = &binning;
+    settings.userdata_chunk_size = sizeof(binning);
+    settings.func_reduce = bvh_sah_binning_reduce;
+    BLI_task_parallel_range(begin, end, &task_data, bvh_sah_binning_task_cb, &settings);
+  }
+  else {
+    for (int i = begin; i < end; i++) {
+      bvh_sah_bin_add_leaf(&task_data, &binning, data->leafs_order[i]);
+    }
+  }
+
+  int split_axis = 0, split_bin = 0;
+  if (!bvh_sah_find_split(&binning, &split_axis, &split_bin)) {
+    /* All leaf centers are (almost) the same, any split is as good as another. */
+    node->main_axis = (char)(get_largest_axis(node->bv) / 2);
+    return (begin + end) / 2;
+  }
+  node->main_axis = (char)split_axis;
+
+  int *leafs_order = data->leafs_order;
+  int i = begin;
+  int j = end - 1;
+  while (i <= j) {
+    const float *center = data->leaf_centers[leafs_order[i]];
+    if (bvh_sah_bin_index(&task_data, center, split_axis) < split_bin) {
+      i++;
+    }
+    else {
+      SWAP(int, leafs_order[i], leafs_order[j]);
+      j--;
+    }
+  }
+  return i;
+}
+
+static void bvh_sah_build_task_cb(TaskPool *__restrict pool, void *taskdata);
+
+static void bvh_sah_build_range(BVHSAHBuildData *data, BVHSAHRange range)
+{
+  /* Continue with the larger child in the same loop, so that the recursion depth stays
+   * logarithmic even when splits are very uneven. */
+  while (true) {
+    BVHNode *node = &data->branches_array[range.branch_index];
+    const int mid = bvh_sah_split_branch(data, node, range.begin, range.end);
+
+    const BVHSAHRange children[2] = {
+        {range.begin, mid, range.branch_index + 1},
+        {mid, range.end, range.branch_index + (mid - range.begin)},
+    };
+    node->node_num = 2;
+    for (int k = 0; k < 2; k++) {
+      const BVHSAHRange *child = &children[k];
+      if (child->end - child->begin == 1) {
+        /* The leafs are moved to their position in the tree order after the build. */
+        node->children[k] = &data->tree->nodearray[child->begin];
+      }
+      else {
+        node->children[k] = &data->branches_array[child->branch_index];
+      }
+      node->children[k]->parent = node;
+    }
+
+    const int larger = (mid - range.begin >= range.end - mid) ? 0 : 1;
+    const BVHSAHRange *smaller_child = &children[1 - larger];
+    const int smaller_leafs_num = smaller_child->end - smaller_child->begin;
+    if (smaller_leafs_num >= BVH_SAH_TASK_LEAF_THRESHOLD) {
+      BVHSAHRange *task_range = MEM_mallocN(sizeof(BVHSAHRange), __func__);
+      *task_range = *smaller_child;
+      BLI_task_pool_push(data->task_pool, bvh_sah_build_task_cb, task_range, true, NULL);
+    }
+    else if (smaller_leafs_num > 1) {
+      bvh_sah_build_range(data, *smaller_child);
+    }
+
+    if (children[larger].end - children[larger].begin == 1) {
+      break;
+    }
+    range = children[larger];
+  }
+}
+
+static void bvh_sah_build_task_cb(TaskPool *__restrict pool, void *taskdata)
+{
+  BVHSAHBuildData *data = BLI_task_pool_user_data(pool);
+  bvh_sah_build_range(data, *(const BVHSAHRange *)taskdata);
+}
+
+typedef struct BVHSAHReorderData {
+  BVHTree *tree;
+  const int *leafs_order;
+  int *indices;
+  float *bvs;
+} BVHSAHReorderData;
+
+static void bvh_sah_gather_leafs_task_cb(void *__restrict userdata,
+                                         const int i,
+                                         const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const BVHSAHReorderData *data = userdata;
+  const int axis = data->tree->axis;
+  const BVHNode *leaf = &data->tree->nodearray[data->leafs_order[i]];
+  data->indices[i] = leaf->index;
+  memcpy(&data->bvs[i * axis], leaf->bv, sizeof(float) * (size_t)axis);
+}
+
+static void bvh_sah_scatter_leafs_task_cb(void *__restrict userdata,
+                                          const int i,
+                                          const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const BVHSAHReorderData *data = userdata;
+  const int axis = data->tree->axis;
+  BVHNode *leaf = &data->tree->nodearray[i];
+  leaf->index = data->indices[i];
+  memcpy(leaf->bv, &data->bvs[i * axis], sizeof(float) * (size_t)axis);
+}
+
+/**
+ * Move the leafs into the order of #BVHSAHBuildData.leafs_order. Only the indices and bounding
+ * volumes are copied, the pointers to the leafs stay the same.
+ */
+static void bvh_sah_reorder_leafs(BVHTree *tree, const int *leafs_order)
+{
+  const int leaf_num = tree->leaf_num;
+  BVHSAHReorderData data = {
+      .tree = tree,
+      .leafs_order = leafs_order,
+      .indices = MEM_malloc_arrayN((size_t)leaf_num, sizeof(int), __func__),
+      .bvs = MEM_malloc_arrayN((size_t)leaf_num * (size_t)tree->axis, sizeof(float), __func__),
+  };
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.use_threading = (leaf_num > KDOPBVH_THREAD_LEAF_THRESHOLD);
+  settings.min_iter_per_thread = 1024;
+  BLI_task_parallel_range(0, leaf_num, &data, bvh_sah_gather_leafs_task_cb, &settings);
+  BLI_task_parallel_range(0, leaf_num, &data, bvh_sah_scatter_leafs_task_cb, &settings);
+
+  MEM_freeN(data.indices);
+  MEM_freeN(data.bvs);
+}
+
+/** \} */
+
 /* -------------------------------------------------------------------- */
 /** \name BLI_bvhtree API
  * \{ */
@@ -966,6 +1394,58 @@ void BLI_bvhtree_balance(BVHTree *tree)
 #endif
 }
 
+void BLI_bvhtree_balance_sah(BVHTree *tree)
+{
+  BLI_assert(tree->branch_num == 0);
+
+  const int leaf_num = tree->leaf_num;
+  if (tree->tree_type != 2 || tree->start_axis != 0 || leaf_num < 2) {
+    /* Only binary trees are supported, which have enough pre-allocated branches for any tree
+     * shape. The x, y and z axes are needed to compute the surface area. */
+    BLI_bvhtree_balance(tree);
+    return;
+  }
+
+  int *leafs_order = MEM_malloc_arrayN((size_t)leaf_num, sizeof(int), __func__);
+  float(*leaf_centers)[3] = MEM_malloc_arrayN((size_t)leaf_num, sizeof(*leaf_centers), __func__);
+  for (int i = 0; i < leaf_num; i++) {
+    leafs_order[i] = i;
+    bvh_sah_leaf_center(tree->nodearray[i].bv, leaf_centers[i]);
+  }
+
+  BVHSAHBuildData data = {
+      .tree = tree,
+      .branches_array = tree->nodearray + leaf_num,
+      .leafs_order = leafs_order,
+      .leaf_centers = leaf_centers,
+      .task_pool = NULL,
+  };
+  data.branches_array[0].parent = NULL;
+  data.task_pool = BLI_task_pool_create(&data, TASK_PRIORITY_HIGH);
+  const BVHSAHRange root_range = {0, leaf_num, 0};
+  bvh_sah_build_range(&data, root_range);
+  BLI_task_pool_work_and_wait(data.task_pool);
+  BLI_task_pool_free(data.task_pool);
+
+  MEM_freeN(leaf_centers);
+  bvh_sah_reorder_leafs(tree, leafs_order);
+  MEM_freeN(leafs_order);
+
+  /* A binary tree always has one branch less than it has leafs. */
+  tree->branch_num = leaf_num - 1;
+  for (int i = 0; i < tree->branch_num; i++) {
+    tree->nodes[leaf_num + i] = &tree->nodearray[leaf_num + i];
+  }
+
+#ifdef USE_VERIFY_TREE
+  bvhtree_verify(tree);
+#endif
+
+#ifdef USE_PRINT_TREE
+  bvhtree_info(tree);
+#endif
+}
+
 static void bvhtree_node_inflate(const BVHTree *tree, BVHNode *node, const float dist)
 {
   axis_t axis_iter;
@@ -2026,6 +2506,477 @@ void BLI_bvhtree_ray_cast_all(BVHTree *tree,
 
 /** \} */
 
+/* -------------------------------------------------------------------- */
+/** \name BLI_bvhtree_ray_cast_batch / BLI_bvhtree_find_nearest_batch
+ *
+ * Many queries are processed at once. They are sorted along a Morton curve, so that consecutive
+ * queries are close to each other, and then traversed in packets. Every node is visited only
+ * once per packet and is tested against all queries of the packet in loops over the lanes,
+ * which the compiler can vectorize.
+ * \{ */
+
+/** Number of queries that are traversed together. */
+#define BVH_PACKET_SIZE 8
+/** Number of packets that are processed by a task, in the sorted order. */
+#define BVH_PACKETS_PER_TASK 16
+/** Sorting doesn't pay off for fewer queries. */
+#define BVH_BATCH_SORT_THRESHOLD 256
+
+/** Spread the lower 10 bits of the value, so that there are two zero bits between them. */
+static uint bvh_morton_expand_bits(uint v)
+{
+  v = (v * 0x00010001u) & 0xFF0000FFu;
+  v = (v * 0x00000101u) & 0x0F00F00Fu;
+  v = (v * 0x00000011u) & 0xC30C30C3u;
+  v = (v * 0x00000005u) & 0x49249249u;
+  return v;
+}
+
+static uint bvh_morton_quantize(const float value, const float min, const float scale)
+{
+  const float f = (value - min) * scale;
+  /* Also handles NaN. */
+  if (!(f > 0.0f)) {
+    return 0;
+  }
+  return f < 1023.0f ? (uint)f : 1023;
+}
+
+/**
+ * Compute the order in which the queries are processed, sorted by the Morton codes of their
+ * positions.
+ * \return An array that has to be freed by the caller.
+ */
+static int *bvh_batch_order(const float (*co)[3], const int num)
+{
+  int *order = MEM_malloc_arrayN((size_t)num, sizeof(int), __func__);
+  for (int i = 0; i < num; i++) {
+    order[i] = i;
+  }
+  if (num < BVH_BATCH_SORT_THRESHOLD) {
+    return order;
+  }
+
+  float min[3], max[3];
+  INIT_MINMAX(min, max);
+  for (int i = 0; i < num; i++) {
+    minmax_v3v3_v3(min, max, co[i]);
+  }
+  float scale[3];
+  for (int axis = 0; axis < 3; axis++) {
+    const float extent = max[axis] - min[axis];
+    scale[axis] = (extent > 0.0f && extent < FLT_MAX) ? 1023.0f / extent : 0.0f;
+  }
+
+  uint *codes = MEM_malloc_arrayN((size_t)num, sizeof(uint), __func__);
+  uint *codes_tmp = MEM_malloc_arrayN((size_t)num, sizeof(uint), __func__);
+  int *order_tmp = MEM_malloc_arrayN((size_t)num, sizeof(int), __func__);
+  for (int i = 0; i < num; i++) {
+    codes[i] = (bvh_morton_expand_bits(bvh_morton_quantize(co[i][0], min[0], scale[0])) << 2) |
+               (bvh_morton_expand_bits(bvh_morton_quantize(co[i][1], min[1], scale[1])) << 1) |
+               bvh_morton_expand_bits(bvh_morton_quantize(co[i][2], min[2], scale[2]));
+  }
+
+  /* Radix sort, one byte at a time. After an even number of passes, the sorted data is in the
+   * original arrays again. */
+  for (uint shift = 0; shift < 32; shift += 8) {
+    int offsets[256] = {0};
+    for (int i = 0; i < num; i++) {
+      offsets[(codes[i] >> shift) & 0xFF]++;
+    }
+    int offset = 0;
+    for (int i = 0; i < 256; i++) {
+      const int count = offsets[i];
+      offsets[i] = offset;
+      offset += count;
+    }
+    for (int i = 0; i < num; i++) {
+      const int dst = offsets[(codes[i] >> shift) & 0xFF]++;
+      codes_tmp[dst] = codes[i];
+      order_tmp[dst] = order[i];
+    }
+    SWAP(uint *, codes, codes_tmp);
+    SWAP(int *, order, order_tmp);
+  }
+
+  MEM_freeN(codes);
+  MEM_freeN(codes_tmp);
+  MEM_freeN(order_tmp);
+  return order;
+}
+
+static int bvh_packet_first_lane(const uint lanes)
+{
+  int lane = 0;
+  while (!(lanes & (1u << lane))) {
+    lane++;
+  }
+  return lane;
+}
+
+typedef struct BVHRayPacket {
+  /** Lane data for the box tests. Unused lanes have a negative distance. */
+  float origin[3][BVH_PACKET_SIZE];
+  float idot_axis[3][BVH_PACKET_SIZE];
+  float dist[BVH_PACKET_SIZE];
+  float radius;
+  /** Full data of every ray, for the callbacks. */
+  BVHRayCastData rays[BVH_PACKET_SIZE];
+} BVHRayPacket;
+
+typedef struct BVHRayCastBatchData {
+  BVHTree *tree;
+  const float (*origins)[3];
+  const float (*directions)[3];
+  float radius;
+  BVHTreeRayHit *hits;
+  BVHTree_RayCastCallback callback;
+  void *userdata;
+  int flag;
+  const int *order;
+  int rays_num;
+} BVHRayCastBatchData;
+
+/** \return The lanes of the active rays that hit the bounding volume before their current hit. */
+static uint ray_packet_nearest_hit(const BVHRayPacket *packet, const float bv[6], const uint lanes)
+{
+  float t_near[BVH_PACKET_SIZE];
+  float t_far[BVH_PACKET_SIZE];
+  for (int lane = 0; lane < BVH_PACKET_SIZE; lane++) {
+    t_near[lane] = 0.0f;
+    t_far[lane] = packet->dist[lane];
+  }
+  for (int axis = 0; axis < 3; axis++) {
+    const float bv_min = bv[2 * axis] - packet->radius;
+    const float bv_max = bv[2 * axis + 1] + packet->radius;
+    for (int lane = 0; lane < BVH_PACKET_SIZE; lane++) {
+      const float t0 = (bv_min - packet->origin[axis][lane]) * packet->idot_axis[axis][lane];
+      const float t1 = (bv_max - packet->origin[axis][lane]) * packet->idot_axis[axis][lane];
+      t_near[lane] = max_ff(t_near[lane], min_ff(t0, t1));
+      t_far[lane] = min_ff(t_far[lane], max_ff(t0, t1));
+    }
+  }
+  uint hit_lanes = 0;
+  for (int lane = 0; lane < BVH_PACKET_SIZE; lane++) {
+    hit_lanes |= (uint)(t_near[lane] <= t_far[lane]) << lane;
+  }
+  return hit_lanes & lanes;
+}
+
+static void dfs_raycast_packet(BVHRayPacket *packet, BVHNode *node, uint lanes)
+{
+  lanes = ray_packet_nearest_hit(packet, node->bv, lanes);
+  if (lanes == 0) {
+    return;
+  }
+
+  if (node->node_num == 0) {
+    for (int lane = 0; lane < BVH_PACKET_SIZE; lane++) {
+      if (!(lanes & (1u << lane))) {
+        continue;
+      }
+      BVHRayCastData *data = &packet->rays[lane];
+      if (data->callback) {
+        data->callback(data->userdata, node->index, &data->ray, &data->hit);
+      }
+      else {
+        const float dist = (data->ray.radius == 0.0f) ? fast_ray_nearest_hit(data, node) :
+                                                        ray_nearest_hit(data, node->bv);
+        if (dist < data->hit.dist) {
+          data->hit.index = node->index;
+          data->hit.dist = dist;
+          madd_v3_v3v3fl(data->hit.co, data->ray.origin, data->ray.direction, dist);
+        }
+      }
+      packet->dist[lane] = data->hit.dist;
+    }
+  }
+  else {
+    /* Rays in a packet usually have similar directions, the first one decides the order. */
+    const BVHRayCastData *data = &packet->rays[bvh_packet_first_lane(lanes)];
+    if (data->ray_dot_axis[node->main_axis] > 0.0f) {
+      for (int i = 0; i != node->node_num; i++) {
+        dfs_raycast_packet(packet, node->children[i], lanes);
+      }
+    }
+    else {
+      for (int i = node->node_num - 1; i >= 0; i--) {
+        dfs_raycast_packet(packet, node->children[i], lanes);
+      }
+    }
+  }
+}
+
+static void bvhtree_ray_cast_batch_task_cb(void *__restrict userdata,
+                                           const int task_index,
+                                           const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const BVHRayCastBatchData *data = userdata;
+  BVHNode *root = data->tree->nodes[data->tree->leaf_num];
+  const int begin = task_index * BVH_PACKETS_PER_TASK * BVH_PACKET_SIZE;
+  const int end = min_ii(begin + BVH_PACKETS_PER_TASK * BVH_PACKET_SIZE, data->rays_num);
+
+  BVHRayPacket packet;
+  packet.radius = data->radius;
+  for (int packet_begin = begin; packet_begin < end; packet_begin += BVH_PACKET_SIZE) {
+    const int lanes_num = min_ii(BVH_PACKET_SIZE, end - packet_begin);
+    for (int lane = 0; lane < BVH_PACKET_SIZE; lane++) {
+      if (lane >= lanes_num) {
+        for (int axis = 0; axis < 3; axis++) {
+          packet.origin[axis][lane] = 0.0f;
+          packet.idot_axis[axis][lane] = 0.0f;
+        }
+        packet.dist[lane] = -1.0f;
+        continue;
+      }
+      const int ray_index = data->order[packet_begin + lane];
+      BVHRayCastData *ray = &packet.rays[lane];
+      ray->tree = data->tree;
+      ray->callback = data->callback;
+      ray->userdata = data->userdata;
+      copy_v3_v3(ray->ray.origin, data->origins[ray_index]);
+      copy_v3_v3(ray->ray.direction, data->directions[ray_index]);
+      ray->ray.radius = data->radius;
+      bvhtree_ray_cast_data_precalc(ray, data->flag);
+      ray->hit = data->hits[ray_index];
+      for (int axis = 0; axis < 3; axis++) {
+        packet.origin[axis][lane] = ray->ray.origin[axis];
+        packet.idot_axis[axis][lane] = ray->idot_axis[axis];
+      }
+      packet.dist[lane] = ray->hit.dist;
+    }
+
+    dfs_raycast_packet(&packet, root, (1u << lanes_num) - 1);
+
+    for (int lane = 0; lane < lanes_num; lane++) {
+      data->hits[data->order[packet_begin + lane]] = packet.rays[lane].hit;
+    }
+  }
+}
+
+void BLI_bvhtree_ray_cast_batch(BVHTree *tree,
+                                const float (*origins)[3],
+                                const float (*directions)[3],
+                                const int rays_num,
+                                const float radius,
+                                BVHTreeRayHit *hits,
+                                BVHTree_RayCastCallback callback,
+                                void *userdata,
+                                const int flag)
+{
+  if (rays_num == 0 || tree->nodes[tree->leaf_num] == NULL) {
+    return;
+  }
+
+  int *order = bvh_batch_order(origins, rays_num);
+  BVHRayCastBatchData data = {
+      .tree = tree,
+      .origins = origins,
+      .directions = directions,
+      .radius = radius,
+      .hits = hits,
+      .callback = callback,
+      .userdata = userdata,
+      .flag = flag,
+      .order = order,
+      .rays_num = rays_num,
+  };
+
+  const int queries_per_task = BVH_PACKETS_PER_TASK * BVH_PACKET_SIZE;
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.use_threading = rays_num > queries_per_task;
+  BLI_task_parallel_range(0,
+                          (int)divide_ceil_u((uint)rays_num, (uint)queries_per_task),
+                          &data,
+                          bvhtree_ray_cast_batch_task_cb,
+                          &settings);
+
+  MEM_freeN(order);
+}
+
+typedef struct BVHNearestPacket {
+  /** Lane data for the box tests. Unused lanes have a negative distance. */
+  float co[3][BVH_PACKET_SIZE];
+  float dist_sq[BVH_PACKET_SIZE];
+  /** Full data of every query, for the callbacks. */
+  const float *co_ptr[BVH_PACKET_SIZE];
+  BVHTreeNearest nearest[BVH_PACKET_SIZE];
+  BVHTree_NearestPointCallback callback;
+  void *userdata;
+} BVHNearestPacket;
+
+typedef struct BVHNearestBatchData {
+  BVHTree *tree;
+  const float (*co)[3];
+  BVHTreeNearest *nearest;
+  BVHTree_NearestPointCallback callback;
+  void *userdata;
+  const int *order;
+  int points_num;
+} BVHNearestBatchData;
+
+/** \return The active lanes whose bounding volume is closer than their current nearest. */
+static uint nearest_packet_dist_sq(const BVHNearestPacket *packet, const float bv[6], uint lanes)
+{
+  float dist_sq[BVH_PACKET_SIZE];
+  for (int lane = 0; lane < BVH_PACKET_SIZE; lane++) {
+    dist_sq[lane] = 0.0f;
+  }
+  for (int axis = 0; axis < 3; axis++) {
+    const float bv_min = bv[2 * axis];
+    const float bv_max = bv[2 * axis + 1];
+    for (int lane = 0; lane < BVH_PACKET_SIZE; lane++) {
+      const float co = packet->co[axis][lane];
+      const float d = max_ff(max_ff(bv_min - co, co - bv_max), 0.0f);
+      dist_sq[lane] += d * d;
+    }
+  }
+  uint closer_lanes = 0;
+  for (int lane = 0; lane < BVH_PACKET_SIZE; lane++) {
+    closer_lanes |= (uint)(dist_sq[lane] < packet->dist_sq[lane]) << lane;
+  }
+  return closer_lanes & lanes;
+}
+
+static void dfs_find_nearest_packet(BVHNearestPacket *packet, BVHNode *node, uint lanes)
+{
+  lanes = nearest_packet_dist_sq(packet, node->bv, lanes);
+  if (lanes == 0) {
+    return;
+  }
+
+  if (node->node_num == 0) {
+    for (int lane = 0; lane < BVH_PACKET_SIZE; lane++) {
+      if (!(lanes & (1u << lane))) {
+        continue;
+      }
+      BVHTreeNearest *nearest = &packet->nearest[lane];
+      if (packet->callback) {
+        packet->callback(packet->userdata, node->index, packet->co_ptr[lane], nearest);
+      }
+      else {
+        float co[3];
+        const float dist_sq = calc_nearest_point_squared(packet->co_ptr[lane], node, co);
+        if (dist_sq < nearest->dist_sq) {
+          nearest->index = node->index;
+          nearest->dist_sq = dist_sq;
+          copy_v3_v3(nearest->co, co);
+        }
+      }
+      packet->dist_sq[lane] = nearest->dist_sq;
+    }
+  }
+  else {
+    const int lane = bvh_packet_first_lane(lanes);
+    const float proj = packet->co[node->main_axis][lane];
+    if (proj <= node->children[0]->bv[node->main_axis * 2 + 1]) {
+      for (int i = 0; i != node->node_num; i++) {
+        dfs_find_nearest_packet(packet, node->children[i], lanes);
+      }
+    }
+    else {
+      for (int i = node->node_num - 1; i >= 0; i--) {
+        dfs_find_nearest_packet(packet, node->children[i], lanes);
+      }
+    }
+  }
+}
+
+static void bvhtree_find_nearest_batch_task_cb(void *__restrict userdata,
+                                               const int task_index,
+                                               const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const BVHNearestBatchData *data = userdata;
+  BVHNode *root = data->tree->nodes[data->tree->leaf_num];
+  const int begin = task_index * BVH_PACKETS_PER_TASK * BVH_PACKET_SIZE;
+  const int end = min_ii(begin + BVH_PACKETS_PER_TASK * BVH_PACKET_SIZE, data->points_num);
+
+  BVHNearestPacket packet;
+  packet.callback = data->callback;
+  packet.userdata = data->userdata;
+  /* The results of the previous packet, which are usually close to the points of the next. */
+  BVHTreeNearest prev_nearest[BVH_PACKET_SIZE];
+  int prev_lanes_num = 0;
+  for (int packet_begin = begin; packet_begin < end; packet_begin += BVH_PACKET_SIZE) {
+    const int lanes_num = min_ii(BVH_PACKET_SIZE, end - packet_begin);
+    for (int lane = 0; lane < BVH_PACKET_SIZE; lane++) {
+      if (lane >= lanes_num) {
+        for (int axis = 0; axis < 3; axis++) {
+          packet.co[axis][lane] = 0.0f;
+        }
+        packet.dist_sq[lane] = -1.0f;
+        continue;
+      }
+      const int point_index = data->order[packet_begin + lane];
+      const float *co = data->co[point_index];
+      BVHTreeNearest *nearest = &packet.nearest[lane];
+      *nearest = data->nearest[point_index];
+      /* Start with the closest previous result as upper bound, which culls most of the tree. */
+      for (int i = 0; i < prev_lanes_num; i++) {
+        if (prev_nearest[i].index == -1) {
+          continue;
+        }
+        const float dist_sq = len_squared_v3v3(co, prev_nearest[i].co);
+        if (dist_sq < nearest->dist_sq) {
+          *nearest = prev_nearest[i];
+          nearest->dist_sq = dist_sq;
+        }
+      }
+      packet.co_ptr[lane] = co;
+      for (int axis = 0; axis < 3; axis++) {
+        packet.co[axis][lane] = co[axis];
+      }
+      packet.dist_sq[lane] = nearest->dist_sq;
+    }
+
+    dfs_find_nearest_packet(&packet, root, (1u << lanes_num) - 1);
+
+    for (int lane = 0; lane < lanes_num; lane++) {
+      data->nearest[data->order[packet_begin + lane]] = packet.nearest[lane];
+      prev_nearest[lane] = packet.nearest[lane];
+    }
+    prev_lanes_num = lanes_num;
+  }
+}
+
+void BLI_bvhtree_find_nearest_batch(BVHTree *tree,
+                                    const float (*co)[3],
+                                    const int points_num,
+                                    BVHTreeNearest *nearest,
+                                    BVHTree_NearestPointCallback callback,
+                                    void *userdata)
+{
+  if (points_num == 0 || tree->nodes[tree->leaf_num] == NULL) {
+    return;
+  }
+
+  int *order = bvh_batch_order(co, points_num);
+  BVHNearestBatchData data = {
+      .tree = tree,
+      .co = co,
+      .nearest = nearest,
+      .callback = callback,
+      .userdata = userdata,
+      .order = order,
+      .points_num = points_num,
+  };
+
+  const int queries_per_task = BVH_PACKETS_PER_TASK * BVH_PACKET_SIZE;
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.use_threading = points_num > queries_per_task;
+  BLI_task_parallel_range(0,
+                          (int)divide_ceil_u((uint)points_num, (uint)queries_per_task),
+                          &data,
+                          bvhtree_find_nearest_batch_task_cb,
+                          &settings);
+
+  MEM_freeN(order);
+}
+
+/** \} */
+
 /* -------------------------------------------------------------------- */
 /** \name BLI_bvhtree_range_query
  *
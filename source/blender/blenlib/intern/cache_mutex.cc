@@ -0,0 +1,31 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/** \file
+ * \ingroup bli
+ */
+
+#include "BLI_cache_mutex.hh"
+#include "BLI_task.hh"
+
+namespace blender {
+
+void CacheMutex::ensure(const FunctionRef<void()> compute_cache)
+{
+  /* Fast path when the cache is up to date. The acquire ordering makes sure that the cached data
+   * written by the thread that computed it is visible to this thread as well. */
+  if (cache_valid_.load(std::memory_order_acquire)) {
+    return;
+  }
+  std::scoped_lock lock{mutex_};
+  /* Double checked lock: another thread may have computed the cache while this one waited. */
+  if (cache_valid_.load(std::memory_order_relaxed)) {
+    return;
+  }
+  /* Use task isolation because a mutex is locked and the cache computation might use
+   * multi-threading. */
+  threading::isolate_task(compute_cache);
+
+  cache_valid_.store(true, std::memory_order_release);
+}
+
+}  // namespace blender
@@ -241,4 +241,73 @@ IndexMask find_indices_from_virtual_array(const IndexMask indices_to_check,
   return detail::find_indices_based_on_predicate__merge(indices_to_check, sub_masks, r_indices);
 }
 
+/**
+ * Get the part of the mask that is in the segment with the given start.
+ */
+static IndexMask slice_to_segment(const IndexMask mask, const int64_t segment_start)
+{
+  const int64_t segment_end = segment_start + CompressedIndexMask::segment_size;
+  if (mask.is_range()) {
+    const IndexRange range = mask.as_range();
+    const int64_t start = std::max(range.start(), segment_start);
+    const int64_t end = std::min(range.one_after_last(), segment_end);
+    return IndexRange(start, std::max<int64_t>(end - start, 0));
+  }
+  const Span<int64_t> indices = mask.indices();
+  const int64_t *begin = std::lower_bound(indices.begin(), indices.end(), segment_start);
+  const int64_t *end = std::lower_bound(begin, indices.end(), segment_end);
+  return indices.slice(begin - indices.begin(), end - begin);
+}
+
+CompressedIndexMask find_indices_from_virtual_array_compressed(const IndexMask indices_to_check,
+                                                               const VArray<bool> &virtual_array)
+{
+  if (indices_to_check.is_empty()) {
+    return {};
+  }
+  if (virtual_array.is_single()) {
+    return virtual_array.get_internal_single() ? CompressedIndexMask(indices_to_check) :
+                                                 CompressedIndexMask();
+  }
+
+  /* Find the start of every segment that contains indices to check. */
+  Vector<int64_t> segment_starts;
+  int64_t pos = 0;
+  while (pos < indices_to_check.size()) {
+    const int64_t index = indices_to_check[pos];
+    const int64_t segment_start = index - index % CompressedIndexMask::segment_size;
+    segment_starts.append(segment_start);
+    pos += slice_to_segment(indices_to_check.slice(pos, indices_to_check.size() - pos),
+                            segment_start)
+               .size();
+  }
+
+  auto set_bit = [](MutableSpan<uint64_t> bits, const int64_t offset, const bool value) {
+    bits[offset >> 6] |= uint64_t(value) << (offset & 63);
+  };
+
+  if (virtual_array.is_span()) {
+    const Span<bool> span = virtual_array.get_internal_span();
+    return CompressedIndexMask::from_bits(
+        segment_starts, [&](const int64_t segment_start, MutableSpan<uint64_t> r_bits) {
+          for (const int64_t i : slice_to_segment(indices_to_check, segment_start)) {
+            set_bit(r_bits, i - segment_start, span[i]);
+          }
+        });
+  }
+
+  threading::EnumerableThreadSpecific<Vector<bool>> materialize_buffers;
+  return CompressedIndexMask::from_bits(
+      segment_starts, [&](const int64_t segment_start, MutableSpan<uint64_t> r_bits) {
+        const IndexMask segment_mask = slice_to_segment(indices_to_check, segment_start);
+        /* Materialize the segment at once to avoid virtual function call overhead. */
+        Vector<bool> &buffer = materialize_buffers.local();
+        buffer.reinitialize(segment_mask.size());
+        virtual_array.materialize_compressed(segment_mask, buffer);
+        for (const int64_t i : segment_mask.index_range()) {
+          set_bit(r_bits, segment_mask[i] - segment_start, buffer[i]);
+        }
+      });
+}
+
 }  // namespace blender::index_mask_ops
@@ -0,0 +1,378 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/** \file
+ * \ingroup bli
+ */
+
+#include <algorithm>
+#include <array>
+
+#include "BLI_array.hh"
+#include "BLI_index_mask_compressed.hh"
+#include "BLI_task.hh"
+
+namespace blender {
+
+using Segment = CompressedIndexMask::Segment;
+using SegmentType = CompressedIndexMask::SegmentType;
+
+static int64_t segment_start_of(const int64_t index)
+{
+  return index - index % CompressedIndexMask::segment_size;
+}
+
+static int64_t count_bits(const Span<uint64_t> words)
+{
+  int64_t count = 0;
+  for (const uint64_t word : words) {
+    count += count_bits_i(uint32_t(word)) + count_bits_i(uint32_t(word >> 32));
+  }
+  return count;
+}
+
+static void set_bits_in_range(MutableSpan<uint64_t> r_bits, const IndexRange range)
+{
+  for (const int64_t i : range) {
+    r_bits[i >> 6] |= uint64_t(1) << (i & 63);
+  }
+}
+
+CompressedIndexMask::CompressedIndexMask(const IndexMask mask)
+{
+  if (mask.is_empty()) {
+    return;
+  }
+  if (mask.is_range()) {
+    /* Split the range at segment boundaries without going through bitsets. */
+    const IndexRange range = mask.as_range();
+    int64_t mask_start = 0;
+    for (int64_t start = segment_start_of(range.first()); start <= range.last();
+         start += segment_size) {
+      const int64_t first = std::max(start, range.first());
+      const int64_t size = std::min(start + segment_size, range.one_after_last()) - first;
+      segments_.append({start, mask_start, size, first - start, SegmentType::Range});
+      mask_start += size;
+    }
+    return;
+  }
+  const Span<int64_t> indices = mask.indices();
+  Array<uint64_t> bits(words_per_segment);
+  int64_t pos = 0;
+  while (pos < indices.size()) {
+    const int64_t start = segment_start_of(indices[pos]);
+    const int64_t end = std::lower_bound(
+                            indices.begin() + pos, indices.end(), start + segment_size) -
+                        indices.begin();
+    bits.fill(0);
+    for (const int64_t i : indices.slice(pos, end - pos)) {
+      bits[(i - start) >> 6] |= uint64_t(1) << ((i - start) & 63);
+    }
+    this->append_segment(start, bits);
+    pos = end;
+  }
+}
+
+void CompressedIndexMask::append_segment(const int64_t segment_start, const Span<uint64_t> bits)
+{
+  BLI_assert(bits.size() == words_per_segment);
+  const int64_t size = count_bits(bits);
+  if (size == 0) {
+    return;
+  }
+  const int64_t mask_start = this->size();
+
+  int64_t first_word = 0;
+  while (bits[first_word] == 0) {
+    first_word++;
+  }
+  int64_t last_word = words_per_segment - 1;
+  while (bits[last_word] == 0) {
+    last_word--;
+  }
+  const int64_t first = first_word * 64 + bitscan_forward_uint64(bits[first_word]);
+  /* The reverse bit-scan counts the leading zeros. */
+  const int64_t last = last_word * 64 + 63 - bitscan_reverse_uint64(bits[last_word]);
+
+  if (last - first + 1 == size) {
+    segments_.append({segment_start, mask_start, size, first, SegmentType::Range});
+    return;
+  }
+  if (size <= max_offsets_num) {
+    segments_.append({segment_start, mask_start, size, offsets_.size(), SegmentType::Offsets});
+    for (const int64_t word_index : IndexRange(first_word, last_word - first_word + 1)) {
+      uint64_t word = bits[word_index];
+      while (word != 0) {
+        offsets_.append(int16_t(word_index * 64 + bitscan_forward_uint64(word)));
+        word &= word - 1;
+      }
+    }
+    return;
+  }
+  segments_.append({segment_start, mask_start, size, bits_.size(), SegmentType::Bits});
+  bits_.extend(bits);
+}
+
+void CompressedIndexMask::append_mask(const CompressedIndexMask &other)
+{
+  BLI_assert(this->is_empty() || other.is_empty() ||
+             segments_.last().start < other.segments_.first().start);
+  const int64_t mask_start = this->size();
+  for (Segment segment : other.segments_) {
+    segment.mask_start += mask_start;
+    if (segment.type == SegmentType::Offsets) {
+      segment.data += offsets_.size();
+    }
+    else if (segment.type == SegmentType::Bits) {
+      segment.data += bits_.size();
+    }
+    segments_.append(segment);
+  }
+  offsets_.extend(other.offsets_);
+  bits_.extend(other.bits_);
+}
+
+CompressedIndexMask CompressedIndexMask::from_bits(
+    const Span<int64_t> segment_starts,
+    const FunctionRef<void(int64_t segment_start, MutableSpan<uint64_t> r_bits)> fill_bits)
+{
+  /* Every task builds a separate mask for a few segments, those are joined afterwards. */
+  const int64_t segments_per_task = 16;
+  const int64_t tasks_num = (segment_starts.size() + segments_per_task - 1) / segments_per_task;
+  Array<CompressedIndexMask> sub_masks(tasks_num);
+  threading::parallel_for(IndexRange(tasks_num), 1, [&](const IndexRange tasks) {
+    Array<uint64_t> bits(words_per_segment);
+    for (const int64_t task : tasks) {
+      const IndexRange range = segment_starts.index_range().slice(
+          task * segments_per_task,
+          std::min(segments_per_task, segment_starts.size() - task * segments_per_task));
+      for (const int64_t segment_start : segment_starts.slice(range)) {
+        BLI_assert(segment_start % segment_size == 0);
+        bits.fill(0);
+        fill_bits(segment_start, bits);
+        sub_masks[task].append_segment(segment_start, bits);
+      }
+    }
+  });
+
+  CompressedIndexMask mask;
+  for (const CompressedIndexMask &sub_mask : sub_masks) {
+    mask.append_mask(sub_mask);
+  }
+  return mask;
+}
+
+static Vector<int64_t> segment_starts_of(const CompressedIndexMask &mask)
+{
+  Vector<int64_t> starts(mask.segments().size());
+  for (const int64_t i : mask.segments().index_range()) {
+    starts[i] = mask.segments()[i].start;
+  }
+  return starts;
+}
+
+CompressedIndexMask CompressedIndexMask::from_union(const CompressedIndexMask &a,
+                                                    const CompressedIndexMask &b)
+{
+  const Vector<int64_t> starts_a = segment_starts_of(a);
+  const Vector<int64_t> starts_b = segment_starts_of(b);
+  Vector<int64_t> starts(starts_a.size() + starts_b.size());
+  const int64_t *end = std::set_union(
+      starts_a.begin(), starts_a.end(), starts_b.begin(), starts_b.end(), starts.begin());
+  starts.resize(end - starts.begin());
+  return from_bits(starts, [&](const int64_t segment_start, MutableSpan<uint64_t> r_bits) {
+    a.segment_to_bits(segment_start, r_bits);
+    b.segment_to_bits(segment_start, r_bits);
+  });
+}
+
+CompressedIndexMask CompressedIndexMask::from_intersection(const CompressedIndexMask &a,
+                                                           const CompressedIndexMask &b)
+{
+  const Vector<int64_t> starts_a = segment_starts_of(a);
+  const Vector<int64_t> starts_b = segment_starts_of(b);
+  Vector<int64_t> starts(starts_a.size() + starts_b.size());
+  const int64_t *end = std::set_intersection(
+      starts_a.begin(), starts_a.end(), starts_b.begin(), starts_b.end(), starts.begin());
+  starts.resize(end - starts.begin());
+  return from_bits(starts, [&](const int64_t segment_start, MutableSpan<uint64_t> r_bits) {
+    std::array<uint64_t, words_per_segment> bits_b{};
+    a.segment_to_bits(segment_start, r_bits);
+    b.segment_to_bits(segment_start, bits_b);
+    for (const int64_t i : r_bits.index_range()) {
+      r_bits[i] &= bits_b[i];
+    }
+  });
+}
+
+CompressedIndexMask CompressedIndexMask::from_difference(const CompressedIndexMask &a,
+                                                         const CompressedIndexMask &b)
+{
+  return from_bits(segment_starts_of(a),
+                   [&](const int64_t segment_start, MutableSpan<uint64_t> r_bits) {
+                     std::array<uint64_t, words_per_segment> bits_b{};
+                     a.segment_to_bits(segment_start, r_bits);
+                     b.segment_to_bits(segment_start, bits_b);
+                     for (const int64_t i : r_bits.index_range()) {
+                       r_bits[i] &= ~bits_b[i];
+                     }
+                   });
+}
+
+const Segment *CompressedIndexMask::find_segment(const int64_t segment_start) const
+{
+  const Segment *segment = std::lower_bound(
+      segments_.begin(), segments_.end(), segment_start, [](const Segment &a, const int64_t b) {
+        return a.start < b;
+      });
+  if (segment == segments_.end() || segment->start != segment_start) {
+    return nullptr;
+  }
+  return segment;
+}
+
+bool CompressedIndexMask::contains(const int64_t index) const
+{
+  if (index < 0) {
+    return false;
+  }
+  const int64_t segment_start = segment_start_of(index);
+  const Segment *segment = this->find_segment(segment_start);
+  if (segment == nullptr) {
+    return false;
+  }
+  const int64_t offset = index - segment_start;
+  switch (segment->type) {
+    case SegmentType::Range:
+      return offset >= segment->data && offset < segment->data + segment->size;
+    case SegmentType::Offsets: {
+      const Span<int16_t> offsets = this->segment_offsets(*segment);
+      return std::binary_search(offsets.begin(), offsets.end(), int16_t(offset));
+    }
+    case SegmentType::Bits:
+      return (this->segment_bits(*segment)[offset >> 6] & (uint64_t(1) << (offset & 63))) != 0;
+  }
+  BLI_assert_unreachable();
+  return false;
+}
+
+void CompressedIndexMask::segment_to_indices(const Segment &segment,
+                                             MutableSpan<int64_t> r_indices) const
+{
+  BLI_assert(r_indices.size() == segment.size);
+  switch (segment.type) {
+    case SegmentType::Range: {
+      for (const int64_t i : r_indices.index_range()) {
+        r_indices[i] = segment.start + segment.data + i;
+      }
+      break;
+    }
+    case SegmentType::Offsets: {
+      const Span<int16_t> offsets = this->segment_offsets(segment);
+      for (const int64_t i : r_indices.index_range()) {
+        r_indices[i] = segment.start + offsets[i];
+      }
+      break;
+    }
+    case SegmentType::Bits: {
+      const Span<uint64_t> words = this->segment_bits(segment);
+      int64_t pos = 0;
+      for (const int64_t word_index : words.index_range()) {
+        uint64_t word = words[word_index];
+        while (word != 0) {
+          r_indices[pos++] = segment.start + word_index * 64 + bitscan_forward_uint64(word);
+          word &= word - 1;
+        }
+      }
+      break;
+    }
+  }
+}
+
+void CompressedIndexMask::segment_to_bits(const int64_t segment_start,
+                                          MutableSpan<uint64_t> r_bits) const
+{
+  BLI_assert(r_bits.size() == words_per_segment);
+  const Segment *segment = this->find_segment(segment_start);
+  if (segment == nullptr) {
+    return;
+  }
+  switch (segment->type) {
+    case SegmentType::Range:
+      set_bits_in_range(r_bits, IndexRange(segment->data, segment->size));
+      break;
+    case SegmentType::Offsets:
+      for (const int16_t offset : this->segment_offsets(*segment)) {
+        r_bits[offset >> 6] |= uint64_t(1) << (offset & 63);
+      }
+      break;
+    case SegmentType::Bits: {
+      const Span<uint64_t> words = this->segment_bits(*segment);
+      for (const int64_t i : r_bits.index_range()) {
+        r_bits[i] |= words[i];
+      }
+      break;
+    }
+  }
+}
+
+IndexMask CompressedIndexMask::to_index_mask(Vector<int64_t> &r_indices) const
+{
+  if (segments_.is_empty()) {
+    return IndexMask(0);
+  }
+  /* The indices are contiguous when the first and last segments are ranges and everything in
+   * between is contained as well. */
+  const Segment &first = segments_.first();
+  const Segment &last = segments_.last();
+  if (first.type == SegmentType::Range && last.type == SegmentType::Range) {
+    const int64_t first_index = first.start + first.data;
+    const int64_t last_index = last.start + last.data + last.size - 1;
+    if (last_index - first_index + 1 == this->size()) {
+      return IndexRange(first_index, this->size());
+    }
+  }
+  r_indices.reinitialize(this->size());
+  this->to_indices(r_indices);
+  return r_indices.as_span();
+}
+
+void CompressedIndexMask::to_indices(MutableSpan<int64_t> r_indices) const
+{
+  BLI_assert(r_indices.size() == this->size());
+  threading::parallel_for(segments_.index_range(), 16, [&](const IndexRange range) {
+    for (const Segment &segment : segments_.as_span().slice(range)) {
+      this->segment_to_indices(segment, r_indices.slice(segment.mask_start, segment.size));
+    }
+  });
+}
+
+void CompressedIndexMask::to_bools(MutableSpan<bool> r_bools) const
+{
+  threading::parallel_for(segments_.index_range(), 16, [&](const IndexRange range) {
+    for (const Segment &segment : segments_.as_span().slice(range)) {
+      switch (segment.type) {
+        case SegmentType::Range:
+          r_bools.slice(segment.start + segment.data, segment.size).fill(true);
+          break;
+        case SegmentType::Offsets:
+          for (const int16_t offset : this->segment_offsets(segment)) {
+            r_bools[segment.start + offset] = true;
+          }
+          break;
+        case SegmentType::Bits: {
+          const Span<uint64_t> words = this->segment_bits(segment);
+          for (const int64_t word_index : words.index_range()) {
+            uint64_t word = words[word_index];
+            while (word != 0) {
+              r_bools[segment.start + word_index * 64 + bitscan_forward_uint64(word)] = true;
+              word &= word - 1;
+            }
+          }
+          break;
+        }
+      }
+    }
+  });
+}
+
+}  // namespace blender
@@ -70,9 +70,9 @@ MINLINE unsigned int bitscan_reverse_uint64(unsigned long long a)
 {
   BLI_assert(a != 0);
 #ifdef _MSC_VER
-  unsigned long clz;
-  _BitScanReverse64(&clz, a);
-  return 31 - clz;
+  unsigned long index;
+  _BitScanReverse64(&index, a);
+  return 63 - index;
 #else
   return (unsigned int)__builtin_clzll(a);
 #endif
@@ -0,0 +1,163 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/** \file
+ * \ingroup bli
+ *
+ * Every thread records its events into a separate buffer, so that threads don't have to
+ * synchronize while tracing. The buffers are only combined when the file is written.
+ */
+
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "BLI_fileops.h"
+#include "BLI_tracing.hh"
+
+namespace blender::tracing {
+
+using Clock = std::chrono::steady_clock;
+
+namespace detail {
+std::atomic<bool> is_enabled = false;
+}
+
+struct Event {
+  const char *category;
+  std::string name;
+  Clock::time_point start;
+  Clock::time_point end;
+};
+
+struct ThreadEvents {
+  int thread_index;
+  /** Only locked by the thread itself and when the file is written, so it's not contended. */
+  std::mutex mutex;
+  std::vector<Event> events;
+};
+
+/**
+ * The buffers of all threads that recorded events. They are not freed when tracing ends, because
+ * the threads keep pointers to them. Standard containers are used, because these static variables
+ * are destructed after the memory leak detection runs.
+ */
+static std::mutex all_thread_events_mutex;
+static std::vector<std::unique_ptr<ThreadEvents>> all_thread_events;
+static std::string output_filepath;
+static Clock::time_point tracing_start;
+
+static ThreadEvents &get_local_thread_events()
+{
+  static thread_local ThreadEvents *local_events = nullptr;
+  if (local_events == nullptr) {
+    std::lock_guard lock{all_thread_events_mutex};
+    all_thread_events.push_back(std::make_unique<ThreadEvents>());
+    local_events = all_thread_events.back().get();
+    local_events->thread_index = int(all_thread_events.size());
+  }
+  return *local_events;
+}
+
+void detail::add_event(const char *category,
+                       const StringRef name,
+                       const Clock::time_point start,
+                       const Clock::time_point end)
+{
+  ThreadEvents &thread_events = get_local_thread_events();
+  std::lock_guard lock{thread_events.mutex};
+  thread_events.events.push_back({category, name, start, end});
+}
+
+static void write_json_string(FILE *file, const StringRef str)
+{
+  fputc('"', file);
+  for (const char c : str) {
+    if (c == '"' || c == '\\') {
+      fputc('\\', file);
+      fputc(c, file);
+    }
+    else if (uint8_t(c) < 0x20) {
+      fprintf(file, "\\u%04x", int(c));
+    }
+    else {
+      fputc(c, file);
+    }
+  }
+  fputc('"', file);
+}
+
+static double to_microseconds(const Clock::duration duration)
+{
+  return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+static void write_events(FILE *file)
+{
+  fprintf(file, "{\"traceEvents\": [\n");
+  bool is_first = true;
+  for (std::unique_ptr<ThreadEvents> &thread_events : all_thread_events) {
+    std::lock_guard lock{thread_events->mutex};
+    if (thread_events->events.empty()) {
+      continue;
+    }
+    fprintf(file,
+            "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, "
+            "\"args\": {\"name\": \"Thread %d\"}}",
+            is_first ? "" : ",\n",
+            thread_events->thread_index,
+            thread_events->thread_index);
+    is_first = false;
+    for (const Event &event : thread_events->events) {
+      fprintf(file, ",\n{\"name\": ");
+      write_json_string(file, event.name);
+      fprintf(file,
+              ", \"cat\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": 1, "
+              "\"tid\": %d}",
+              event.category,
+              to_microseconds(event.start - tracing_start),
+              to_microseconds(event.end - event.start),
+              thread_events->thread_index);
+    }
+    thread_events->events = {};
+  }
+  fprintf(file, "\n]}\n");
+}
+
+}  // namespace blender::tracing
+
+using namespace blender::tracing;
+
+void BLI_tracing_begin(const char *filepath)
+{
+  std::lock_guard lock{all_thread_events_mutex};
+  output_filepath = filepath;
+  tracing_start = Clock::now();
+  detail::is_enabled.store(true);
+}
+
+bool BLI_tracing_end(void)
+{
+  if (!detail::is_enabled.exchange(false)) {
+    return true;
+  }
+  std::lock_guard lock{all_thread_events_mutex};
+  FILE *file = BLI_fopen(output_filepath.c_str(), "w");
+  if (file == nullptr) {
+    for (std::unique_ptr<ThreadEvents> &thread_events : all_thread_events) {
+      std::lock_guard thread_lock{thread_events->mutex};
+      thread_events->events = {};
+    }
+    return false;
+  }
+  write_events(file);
+  fclose(file);
+  return true;
+}
+
+bool BLI_tracing_is_enabled(void)
+{
+  return blender::tracing::is_enabled();
+}
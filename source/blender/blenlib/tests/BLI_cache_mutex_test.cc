@@ -0,0 +1,73 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <atomic>
+
+#include "BLI_array.hh"
+#include "BLI_cache_mutex.hh"
+#include "BLI_task.hh"
+
+#include "testing/testing.h"
+
+namespace blender::tests {
+
+TEST(cache_mutex, DefaultIsDirty)
+{
+  CacheMutex cache_mutex;
+  EXPECT_TRUE(cache_mutex.is_dirty());
+  EXPECT_FALSE(cache_mutex.is_cached());
+}
+
+TEST(cache_mutex, ComputeOnce)
+{
+  CacheMutex cache_mutex;
+  int compute_count = 0;
+  int value = 0;
+  for ([[maybe_unused]] const int i : IndexRange(3)) {
+    cache_mutex.ensure([&]() {
+      compute_count++;
+      value = 5;
+    });
+  }
+  EXPECT_EQ(compute_count, 1);
+  EXPECT_EQ(value, 5);
+  EXPECT_TRUE(cache_mutex.is_cached());
+}
+
+TEST(cache_mutex, TagDirty)
+{
+  CacheMutex cache_mutex;
+  int compute_count = 0;
+  cache_mutex.ensure([&]() { compute_count++; });
+  cache_mutex.tag_dirty();
+  EXPECT_TRUE(cache_mutex.is_dirty());
+  cache_mutex.ensure([&]() { compute_count++; });
+  EXPECT_EQ(compute_count, 2);
+  EXPECT_FALSE(cache_mutex.is_dirty());
+}
+
+TEST(cache_mutex, ContendedReaders)
+{
+  CacheMutex cache_mutex;
+  std::atomic<int> compute_count = 0;
+  Array<int> cache;
+  std::atomic<int64_t> sum = 0;
+  threading::parallel_for(IndexRange(10000), 1, [&](const IndexRange range) {
+    for ([[maybe_unused]] const int i : range) {
+      cache_mutex.ensure([&]() {
+        compute_count++;
+        /* The computation is multi-threaded itself, which requires task isolation. */
+        cache.reinitialize(1000);
+        threading::parallel_for(cache.index_range(), 100, [&](const IndexRange sub_range) {
+          for (const int j : sub_range) {
+            cache[j] = j;
+          }
+        });
+      });
+      sum += cache.last();
+    }
+  });
+  EXPECT_EQ(compute_count, 1);
+  EXPECT_EQ(sum, 10000 * 999);
+}
+
+}  // namespace blender::tests
@@ -0,0 +1,89 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include "BLI_implicit_sharing.hh"
+#include "BLI_vector.hh"
+
+#include "testing/testing.h"
+
+namespace blender::tests {
+
+class SharedVectorInfo : public ImplicitSharingInfo {
+ public:
+  Vector<int> data;
+  bool *freed;
+
+  SharedVectorInfo(Vector<int> data, bool *freed) : data(std::move(data)), freed(freed)
+  {
+  }
+
+ private:
+  void delete_self_with_data() override
+  {
+    *freed = true;
+    delete this;
+  }
+};
+
+/* A minimal owner of shared data that makes a copy before it is modified. */
+class SharedVector {
+ private:
+  const SharedVectorInfo *info_;
+
+ public:
+  SharedVector(const SharedVectorInfo *info) : info_(info)
+  {
+  }
+
+  SharedVector(const SharedVector &other) : info_(other.info_)
+  {
+    info_->user_add();
+  }
+
+  ~SharedVector()
+  {
+    info_->user_remove();
+  }
+
+  const Vector<int> &data() const
+  {
+    return info_->data;
+  }
+
+  Vector<int> &data_for_write(bool *freed)
+  {
+    if (!info_->is_mutable()) {
+      const SharedVectorInfo *new_info = new SharedVectorInfo(info_->data, freed);
+      info_->user_remove();
+      info_ = new_info;
+    }
+    return const_cast<SharedVectorInfo *>(info_)->data;
+  }
+};
+
+TEST(implicit_sharing, CopyOnWrite)
+{
+  bool original_freed = false;
+  bool copy_freed = false;
+  {
+    const SharedVector a(new SharedVectorInfo({1, 2, 3}, &original_freed));
+    {
+      SharedVector b = a;
+      EXPECT_EQ(a.data().data(), b.data().data());
+
+      b.data_for_write(&copy_freed)[0] = 10;
+      EXPECT_NE(a.data().data(), b.data().data());
+      EXPECT_EQ(a.data()[0], 1);
+      EXPECT_EQ(b.data()[0], 10);
+
+      /* The data is mutable now, so it is not copied again. */
+      const int *b_data = b.data().data();
+      b.data_for_write(&copy_freed)[1] = 20;
+      EXPECT_EQ(b.data().data(), b_data);
+    }
+    EXPECT_TRUE(copy_freed);
+    EXPECT_FALSE(original_freed);
+  }
+  EXPECT_TRUE(original_freed);
+}
+
+}  // namespace blender::tests
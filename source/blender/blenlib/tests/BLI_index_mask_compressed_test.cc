@@ -0,0 +1,190 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include "BLI_array.hh"
+#include "BLI_index_mask_compressed.hh"
+#include "BLI_index_mask_ops.hh"
+#include "BLI_rand.hh"
+#include "testing/testing.h"
+
+namespace blender::tests {
+
+using SegmentType = CompressedIndexMask::SegmentType;
+
+static Vector<int64_t> to_vector(const CompressedIndexMask &mask)
+{
+  Vector<int64_t> indices;
+  mask.foreach_index([&](const int64_t i) { indices.append(i); });
+  return indices;
+}
+
+/** Random indices where every segment uses a different representation. */
+static Vector<int64_t> create_mixed_indices()
+{
+  const int64_t segment_size = CompressedIndexMask::segment_size;
+  RandomNumberGenerator rng(42);
+  Vector<int64_t> indices;
+  /* A few indices in the first segment. */
+  indices.extend({3, 100, 5000});
+  /* A range in the second segment. */
+  for (const int64_t i : IndexRange(segment_size + 10, 200)) {
+    indices.append(i);
+  }
+  /* Many random indices in the fourth segment. */
+  for (const int64_t i : IndexRange(segment_size * 3, segment_size)) {
+    if (rng.get_float() < 0.5f) {
+      indices.append(i);
+    }
+  }
+  return indices;
+}
+
+static Array<bool> to_bools(const Span<int64_t> indices, const int64_t size)
+{
+  Array<bool> bools(size, false);
+  for (const int64_t i : indices) {
+    bools[i] = true;
+  }
+  return bools;
+}
+
+TEST(index_mask_compressed, DefaultConstructor)
+{
+  CompressedIndexMask mask;
+  EXPECT_TRUE(mask.is_empty());
+  EXPECT_EQ(mask.size(), 0);
+  EXPECT_FALSE(mask.contains(0));
+  Vector<int64_t> indices;
+  EXPECT_TRUE(mask.to_index_mask(indices).is_empty());
+}
+
+TEST(index_mask_compressed, RangeConstructor)
+{
+  const int64_t segment_size = CompressedIndexMask::segment_size;
+  CompressedIndexMask mask(IndexRange(segment_size - 5, segment_size * 2));
+  EXPECT_EQ(mask.size(), segment_size * 2);
+  EXPECT_EQ(mask.segments().size(), 3);
+  for (const CompressedIndexMask::Segment &segment : mask.segments()) {
+    EXPECT_EQ(segment.type, SegmentType::Range);
+  }
+  EXPECT_TRUE(mask.contains(segment_size - 5));
+  EXPECT_FALSE(mask.contains(segment_size - 6));
+  EXPECT_TRUE(mask.contains(segment_size * 3 - 6));
+  EXPECT_FALSE(mask.contains(segment_size * 3 - 5));
+  EXPECT_EQ(mask.size_in_bytes(), 3 * sizeof(CompressedIndexMask::Segment));
+
+  /* Contiguous masks are converted back without filling the indices. */
+  Vector<int64_t> indices;
+  IndexMask index_mask = mask.to_index_mask(indices);
+  EXPECT_TRUE(index_mask.is_range());
+  EXPECT_EQ(index_mask.as_range(), IndexRange(segment_size - 5, segment_size * 2));
+  EXPECT_TRUE(indices.is_empty());
+}
+
+TEST(index_mask_compressed, SegmentTypes)
+{
+  const Vector<int64_t> indices = create_mixed_indices();
+  CompressedIndexMask mask{IndexMask(indices)};
+  EXPECT_EQ(mask.size(), indices.size());
+  ASSERT_EQ(mask.segments().size(), 3);
+  EXPECT_EQ(mask.segments()[0].type, SegmentType::Offsets);
+  EXPECT_EQ(mask.segments()[1].type, SegmentType::Range);
+  EXPECT_EQ(mask.segments()[2].type, SegmentType::Bits);
+  EXPECT_LT(mask.size_in_bytes(), indices.size() * sizeof(int64_t) / 8);
+
+  EXPECT_EQ(to_vector(mask).as_span(), indices.as_span());
+  const Array<bool> expected_bools = to_bools(indices, CompressedIndexMask::segment_size * 5);
+  for (const int64_t i : expected_bools.index_range()) {
+    EXPECT_EQ(mask.contains(i), expected_bools[i]);
+  }
+
+  Vector<int64_t> mask_indices;
+  EXPECT_EQ(mask.to_index_mask(mask_indices).indices(), indices.as_span());
+
+  Vector<int64_t> segment_indices;
+  mask.foreach_segment([&](const IndexMask segment_mask) {
+    segment_indices.extend(segment_mask.indices());
+  });
+  EXPECT_EQ(segment_indices.as_span(), indices.as_span());
+
+  Array<bool> bools(expected_bools.size(), false);
+  mask.to_bools(bools);
+  EXPECT_EQ(bools.as_span(), expected_bools.as_span());
+}
+
+TEST(index_mask_compressed, SetOperations)
+{
+  const int64_t segment_size = CompressedIndexMask::segment_size;
+  const Vector<int64_t> indices_a = create_mixed_indices();
+  Vector<int64_t> indices_b;
+  for (int64_t i = 0; i < segment_size * 5; i += 3) {
+    indices_b.append(i);
+  }
+  const CompressedIndexMask a{IndexMask(indices_a)};
+  const CompressedIndexMask b{IndexMask(indices_b)};
+
+  const Array<bool> bools_a = to_bools(indices_a, segment_size * 5);
+  Vector<int64_t> expected_union;
+  Vector<int64_t> expected_intersection;
+  Vector<int64_t> expected_difference;
+  for (const int64_t i : IndexRange(segment_size * 5)) {
+    const bool in_a = bools_a[i];
+    const bool in_b = i % 3 == 0;
+    if (in_a || in_b) {
+      expected_union.append(i);
+    }
+    if (in_a && in_b) {
+      expected_intersection.append(i);
+    }
+    if (in_a && !in_b) {
+      expected_difference.append(i);
+    }
+  }
+
+  const CompressedIndexMask union_mask = CompressedIndexMask::from_union(a, b);
+  EXPECT_EQ(union_mask.size(), expected_union.size());
+  EXPECT_EQ(to_vector(union_mask).as_span(), expected_union.as_span());
+  const CompressedIndexMask intersection_mask = CompressedIndexMask::from_intersection(a, b);
+  EXPECT_EQ(to_vector(intersection_mask).as_span(), expected_intersection.as_span());
+  const CompressedIndexMask difference_mask = CompressedIndexMask::from_difference(a, b);
+  EXPECT_EQ(to_vector(difference_mask).as_span(), expected_difference.as_span());
+
+  EXPECT_TRUE(CompressedIndexMask::from_difference(a, a).is_empty());
+}
+
+TEST(index_mask_compressed, FromVirtualArray)
+{
+  const int64_t size = CompressedIndexMask::segment_size * 3 + 7;
+  Array<bool> bools(size);
+  Vector<int64_t> expected;
+  for (const int64_t i : bools.index_range()) {
+    bools[i] = i % 5 == 0 || i > size - 100;
+    if (bools[i] && i % 2 == 1) {
+      expected.append(i);
+    }
+  }
+  Vector<int64_t> odd_indices;
+  for (int64_t i = 1; i < size; i += 2) {
+    odd_indices.append(i);
+  }
+
+  const VArray<bool> span_varray = VArray<bool>::ForSpan(bools);
+  const CompressedIndexMask span_mask =
+      index_mask_ops::find_indices_from_virtual_array_compressed(odd_indices.as_span(),
+                                                                 span_varray);
+  EXPECT_EQ(to_vector(span_mask).as_span(), expected.as_span());
+
+  const VArray<bool> func_varray = VArray<bool>::ForFunc(
+      size, [&](const int64_t i) { return bools[i]; });
+  const CompressedIndexMask func_mask =
+      index_mask_ops::find_indices_from_virtual_array_compressed(odd_indices.as_span(),
+                                                                 func_varray);
+  EXPECT_EQ(to_vector(func_mask).as_span(), expected.as_span());
+
+  const CompressedIndexMask single_mask =
+      index_mask_ops::find_indices_from_virtual_array_compressed(
+          IndexRange(size), VArray<bool>::ForSingle(true, size));
+  EXPECT_EQ(single_mask.size(), size);
+  EXPECT_EQ(single_mask.segments().size(), 4);
+}
+
+}  // namespace blender::tests
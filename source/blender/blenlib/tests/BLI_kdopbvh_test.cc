@@ -66,11 +66,17 @@ static void optimal_check_callback(void *userdata,
  * Note that a small epsilon is added to the BVH nodes bounds, even if we pass in zero.
  * Use rounding to ensure very close nodes don't cause the wrong node to be found as nearest.
  */
-static void find_nearest_points_test(
-    int points_len, float scale, int round, int random_seed, bool optimal = false)
+static void find_nearest_points_test(int points_len,
+                                     float scale,
+                                     int round,
+                                     int random_seed,
+                                     bool optimal = false,
+                                     bool use_sah = false)
 {
   struct RNG *rng = BLI_rng_new(random_seed);
-  BVHTree *tree = BLI_bvhtree_new(points_len, 0.0, 8, 8);
+  /* The SAH build only supports binary trees. */
+  BVHTree *tree = use_sah ? BLI_bvhtree_new(points_len, 0.0, 2, 6) :
+                            BLI_bvhtree_new(points_len, 0.0, 8, 8);
 
   void *mem = MEM_mallocN(sizeof(float[3]) * points_len, __func__);
   float(*points)[3] = (float(*)[3])mem;
@@ -79,7 +85,12 @@ static void find_nearest_points_test(
     rng_v3_round(points[i], 3, rng, round, scale);
     BLI_bvhtree_insert(tree, i, points[i], 1);
   }
-  BLI_bvhtree_balance(tree);
+  if (use_sah) {
+    BLI_bvhtree_balance_sah(tree);
+  }
+  else {
+    BLI_bvhtree_balance(tree);
+  }
 
   /* first find each point */
   BVHTree_NearestPointCallback callback = optimal ? optimal_check_callback : nullptr;
@@ -132,3 +143,186 @@ TEST(kdopbvh, OptimalFindNearest_500)
 {
   find_nearest_points_test(500, 1.0, 1000, 12, true);
 }
+
+TEST(kdopbvh, SAHFindNearest_2)
+{
+  find_nearest_points_test(2, 1.0, 1000, 123, false, true);
+}
+TEST(kdopbvh, SAHFindNearest_500)
+{
+  find_nearest_points_test(500, 1.0, 1000, 12, false, true);
+}
+TEST(kdopbvh, SAHOptimalFindNearest_500)
+{
+  find_nearest_points_test(500, 1.0, 1000, 12, true, true);
+}
+TEST(kdopbvh, SAHFindNearest_100000)
+{
+  /* Large enough to build sub-trees in parallel. */
+  find_nearest_points_test(100000, 1.0, 100000, 7, false, true);
+}
+
+static void raycast_callback(void *userdata, int index, const BVHTreeRay *ray, BVHTreeRayHit *hit)
+{
+  const float(*spheres)[3] = (const float(*)[3])userdata;
+  const float radius = 0.01f;
+  /* Use the closest point on the ray as hit distance, that is enough for comparing trees. */
+  float offset[3], closest[3];
+  sub_v3_v3v3(offset, spheres[index], ray->origin);
+  const float dist = dot_v3v3(offset, ray->direction);
+  madd_v3_v3v3fl(closest, ray->origin, ray->direction, dist);
+  if (dist >= 0.0f && dist < hit->dist && len_v3v3(closest, spheres[index]) <= radius) {
+    hit->index = index;
+    hit->dist = dist;
+  }
+}
+
+/** Ray casts into trees built with both methods have to find the same spheres. */
+TEST(kdopbvh, SAHRayCast)
+{
+  const int spheres_num = 20000;
+  const float radius = 0.01f;
+  struct RNG *rng = BLI_rng_new(5);
+  float(*spheres)[3] = (float(*)[3])MEM_mallocN(sizeof(float[3]) * spheres_num, __func__);
+  BVHTree *tree_median = BLI_bvhtree_new(spheres_num, 0.0, 2, 6);
+  BVHTree *tree_sah = BLI_bvhtree_new(spheres_num, 0.0, 2, 6);
+  for (int i = 0; i < spheres_num; i++) {
+    rng_v3_round(spheres[i], 3, rng, 100000, 1.0f);
+    float bounds[2][3];
+    copy_v3_v3(bounds[0], spheres[i]);
+    copy_v3_v3(bounds[1], spheres[i]);
+    add_v3_fl(bounds[0], -radius);
+    add_v3_fl(bounds[1], radius);
+    BLI_bvhtree_insert(tree_median, i, bounds[0], 2);
+    BLI_bvhtree_insert(tree_sah, i, bounds[0], 2);
+  }
+  BLI_bvhtree_balance(tree_median);
+  BLI_bvhtree_balance_sah(tree_sah);
+
+  int hits_num = 0;
+  for (int i = 0; i < 1000; i++) {
+    float origin[3], direction[3];
+    rng_v3_round(origin, 3, rng, 100000, 2.0f);
+    rng_v3_round(direction, 3, rng, 100000, 1.0f);
+    if (normalize_v3(direction) == 0.0f) {
+      continue;
+    }
+    BVHTreeRayHit hit_median, hit_sah;
+    hit_median.index = hit_sah.index = -1;
+    hit_median.dist = hit_sah.dist = BVH_RAYCAST_DIST_MAX;
+    BLI_bvhtree_ray_cast(
+        tree_median, origin, direction, 0.0f, &hit_median, raycast_callback, spheres);
+    BLI_bvhtree_ray_cast(tree_sah, origin, direction, 0.0f, &hit_sah, raycast_callback, spheres);
+    EXPECT_EQ(hit_median.index, hit_sah.index);
+    hits_num += hit_sah.index != -1;
+  }
+  EXPECT_GT(hits_num, 0);
+
+  BLI_bvhtree_free(tree_median);
+  BLI_bvhtree_free(tree_sah);
+  BLI_rng_free(rng);
+  MEM_freeN(spheres);
+}
+
+TEST(kdopbvh, RayCastBatch)
+{
+  const int spheres_num = 20000;
+  const int rays_num = 3000;
+  const float radius = 0.01f;
+  struct RNG *rng = BLI_rng_new(6);
+  float(*spheres)[3] = (float(*)[3])MEM_mallocN(sizeof(float[3]) * spheres_num, __func__);
+  BVHTree *tree = BLI_bvhtree_new(spheres_num, 0.0, 2, 6);
+  for (int i = 0; i < spheres_num; i++) {
+    rng_v3_round(spheres[i], 3, rng, 100000, 1.0f);
+    float bounds[2][3];
+    copy_v3_v3(bounds[0], spheres[i]);
+    copy_v3_v3(bounds[1], spheres[i]);
+    add_v3_fl(bounds[0], -radius);
+    add_v3_fl(bounds[1], radius);
+    BLI_bvhtree_insert(tree, i, bounds[0], 2);
+  }
+  BLI_bvhtree_balance(tree);
+
+  float(*origins)[3] = (float(*)[3])MEM_mallocN(sizeof(float[3]) * rays_num, __func__);
+  float(*directions)[3] = (float(*)[3])MEM_mallocN(sizeof(float[3]) * rays_num, __func__);
+  BVHTreeRayHit *hits = (BVHTreeRayHit *)MEM_mallocN(sizeof(BVHTreeRayHit) * rays_num, __func__);
+  for (int i = 0; i < rays_num; i++) {
+    rng_v3_round(origins[i], 3, rng, 100000, 2.0f);
+    do {
+      rng_v3_round(directions[i], 3, rng, 100000, 1.0f);
+    } while (normalize_v3(directions[i]) == 0.0f);
+    hits[i].index = -1;
+    hits[i].dist = BVH_RAYCAST_DIST_MAX;
+  }
+  BLI_bvhtree_ray_cast_batch(tree,
+                             origins,
+                             directions,
+                             rays_num,
+                             0.0f,
+                             hits,
+                             raycast_callback,
+                             spheres,
+                             BVH_RAYCAST_DEFAULT);
+
+  int hits_num = 0;
+  for (int i = 0; i < rays_num; i++) {
+    BVHTreeRayHit hit;
+    hit.index = -1;
+    hit.dist = BVH_RAYCAST_DIST_MAX;
+    BLI_bvhtree_ray_cast(tree, origins[i], directions[i], 0.0f, &hit, raycast_callback, spheres);
+    EXPECT_EQ(hit.index, hits[i].index);
+    hits_num += hit.index != -1;
+  }
+  EXPECT_GT(hits_num, 0);
+
+  BLI_bvhtree_free(tree);
+  BLI_rng_free(rng);
+  MEM_freeN(spheres);
+  MEM_freeN(origins);
+  MEM_freeN(directions);
+  MEM_freeN(hits);
+}
+
+TEST(kdopbvh, FindNearestBatch)
+{
+  const int points_num = 5000;
+  const int queries_num = 3000;
+  struct RNG *rng = BLI_rng_new(7);
+  BVHTree *tree = BLI_bvhtree_new(points_num, 0.0, 2, 6);
+  for (int i = 0; i < points_num; i++) {
+    float co[3];
+    rng_v3_round(co, 3, rng, 100000, 1.0f);
+    BLI_bvhtree_insert(tree, i, co, 1);
+  }
+  BLI_bvhtree_balance(tree);
+
+  float(*co)[3] = (float(*)[3])MEM_mallocN(sizeof(float[3]) * queries_num, __func__);
+  BVHTreeNearest *nearest = (BVHTreeNearest *)MEM_mallocN(sizeof(BVHTreeNearest) * queries_num,
+                                                          __func__);
+  for (int i = 0; i < queries_num; i++) {
+    rng_v3_round(co[i], 3, rng, 100000, 1.5f);
+    nearest[i].index = -1;
+    nearest[i].dist_sq = FLT_MAX;
+  }
+  /* Some queries with a limited distance. */
+  for (int i = 0; i < queries_num; i += 3) {
+    nearest[i].dist_sq = 0.001f;
+  }
+  BLI_bvhtree_find_nearest_batch(tree, co, queries_num, nearest, nullptr, nullptr);
+
+  for (int i = 0; i < queries_num; i++) {
+    BVHTreeNearest expected;
+    expected.index = -1;
+    expected.dist_sq = (i % 3 == 0) ? 0.001f : FLT_MAX;
+    BLI_bvhtree_find_nearest(tree, co[i], &expected, nullptr, nullptr);
+    EXPECT_EQ(expected.index == -1, nearest[i].index == -1);
+    if (expected.index != -1) {
+      EXPECT_FLOAT_EQ(expected.dist_sq, nearest[i].dist_sq);
+    }
+  }
+
+  BLI_bvhtree_free(tree);
+  BLI_rng_free(rng);
+  MEM_freeN(co);
+  MEM_freeN(nearest);
+}
@@ -48,3 +48,15 @@ TEST(math_bits, BitscanReverseClearUint)
   EXPECT_EQ(bitscan_reverse_clear_uint(&a), 31);
   EXPECT_EQ(a, 0);
 }
+
+TEST(math_bits, BitscanUint64)
+{
+  EXPECT_EQ(bitscan_forward_uint64(1), 0);
+  EXPECT_EQ(bitscan_reverse_uint64(1), 63);
+  EXPECT_EQ(bitscan_forward_uint64(0x8000000000000000ull), 63);
+  EXPECT_EQ(bitscan_reverse_uint64(0x8000000000000000ull), 0);
+  EXPECT_EQ(bitscan_forward_uint64(0x0000000100000000ull), 32);
+  EXPECT_EQ(bitscan_reverse_uint64(0x0000000100000000ull), 31);
+  EXPECT_EQ(bitscan_forward_uint64(0x00f0000000000f00ull), 8);
+  EXPECT_EQ(bitscan_reverse_uint64(0x00f0000000000f00ull), 8);
+}
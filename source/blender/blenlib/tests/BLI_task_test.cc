@@ -294,3 +294,34 @@ TEST(task, ParallelInvoke)
                                       [&]() { counter++; });
   EXPECT_EQ(counter, 6);
 }
+
+TEST(task, ParallelForAdaptive)
+{
+  blender::threading::AdaptiveGrainSize grain_size;
+  EXPECT_FALSE(grain_size.has_measurement());
+
+  for ([[maybe_unused]] const int iteration : blender::IndexRange(3)) {
+    std::atomic<int> counters[ITEMS_NUM];
+    for (std::atomic<int> &counter : counters) {
+      counter = 0;
+    }
+    blender::threading::parallel_for_adaptive(
+        blender::IndexRange(ITEMS_NUM), grain_size, [&](const blender::IndexRange range) {
+          for (const int64_t i : range) {
+            /* Do enough work per element for it to be measured. */
+            volatile float value = 0.0f;
+            for (int j = 0; j < 1000; j++) {
+              value = value + float(j);
+            }
+            counters[i]++;
+          }
+        });
+    for (const std::atomic<int> &counter : counters) {
+      EXPECT_EQ(counter, 1);
+    }
+  }
+
+  EXPECT_TRUE(grain_size.has_measurement());
+  EXPECT_GE(grain_size.grain_size(), 1);
+  EXPECT_LT(grain_size.grain_size(), ITEMS_NUM);
+}
@@ -0,0 +1,227 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <iostream>
+
+#include "testing/testing.h"
+
+#include "BLI_array.hh"
+#include "BLI_kdopbvh.h"
+#include "BLI_math_geom.h"
+#include "BLI_math_vec_types.hh"
+#include "BLI_math_vector.h"
+#include "BLI_rand.hh"
+#include "BLI_timeit.hh"
+
+namespace blender::tests {
+
+/* Compare the median split build with the SAH build for a triangle mesh whose density varies a
+ * lot, which is where the median split produces boxes with a lot of empty space. Both the build
+ * time and the time of ray casts and nearest point queries are measured. */
+
+static constexpr int grid_resolution = 700;
+static constexpr int queries_num = 200000;
+
+struct Triangles {
+  Array<float3> positions;
+  Array<int3> tris;
+};
+
+/* A height field in which the triangles get much smaller towards one corner. */
+static Triangles create_triangles()
+{
+  const int verts_per_side = grid_resolution + 1;
+  Triangles triangles;
+  triangles.positions.reinitialize(verts_per_side * verts_per_side);
+  for (const int y : IndexRange(verts_per_side)) {
+    for (const int x : IndexRange(verts_per_side)) {
+      const float u = float(x) / grid_resolution;
+      const float v = float(y) / grid_resolution;
+      const float3 co(u * u * u * 100.0f, v * v * v * 100.0f, 0.0f);
+      triangles.positions[y * verts_per_side + x] = float3(
+          co.x, co.y, std::sin(co.x * 0.3f) * std::cos(co.y * 0.2f) * 2.0f);
+    }
+  }
+  triangles.tris.reinitialize(grid_resolution * grid_resolution * 2);
+  for (const int y : IndexRange(grid_resolution)) {
+    for (const int x : IndexRange(grid_resolution)) {
+      const int v0 = y * verts_per_side + x;
+      const int v1 = v0 + 1;
+      const int v2 = v0 + verts_per_side;
+      const int v3 = v2 + 1;
+      const int quad = y * grid_resolution + x;
+      triangles.tris[quad * 2] = int3(v0, v1, v3);
+      triangles.tris[quad * 2 + 1] = int3(v0, v3, v2);
+    }
+  }
+  return triangles;
+}
+
+static BVHTree *build_tree(const Triangles &triangles, const bool use_sah)
+{
+  BVHTree *tree = BLI_bvhtree_new(triangles.tris.size(), 0.0f, 2, 6);
+  for (const int i : triangles.tris.index_range()) {
+    const int3 &tri = triangles.tris[i];
+    float co[3][3];
+    copy_v3_v3(co[0], triangles.positions[tri.x]);
+    copy_v3_v3(co[1], triangles.positions[tri.y]);
+    copy_v3_v3(co[2], triangles.positions[tri.z]);
+    BLI_bvhtree_insert(tree, i, co[0], 3);
+  }
+  SCOPED_TIMER("  Build");
+  if (use_sah) {
+    BLI_bvhtree_balance_sah(tree);
+  }
+  else {
+    BLI_bvhtree_balance(tree);
+  }
+  return tree;
+}
+
+static void raycast_callback(void *userdata,
+                             int index,
+                             const BVHTreeRay *ray,
+                             BVHTreeRayHit *hit)
+{
+  const Triangles &triangles = *static_cast<const Triangles *>(userdata);
+  const int3 &tri = triangles.tris[index];
+  float dist;
+  if (isect_ray_tri_v3(ray->origin,
+                       ray->direction,
+                       triangles.positions[tri.x],
+                       triangles.positions[tri.y],
+                       triangles.positions[tri.z],
+                       &dist,
+                       nullptr)) {
+    if (dist < hit->dist) {
+      hit->index = index;
+      hit->dist = dist;
+    }
+  }
+}
+
+static void nearest_callback(void *userdata, int index, const float co[3], BVHTreeNearest *nearest)
+{
+  const Triangles &triangles = *static_cast<const Triangles *>(userdata);
+  const int3 &tri = triangles.tris[index];
+  float3 closest;
+  closest_on_tri_to_point_v3(closest,
+                             co,
+                             triangles.positions[tri.x],
+                             triangles.positions[tri.y],
+                             triangles.positions[tri.z]);
+  const float dist_sq = len_squared_v3v3(co, closest);
+  if (dist_sq < nearest->dist_sq) {
+    nearest->index = index;
+    nearest->dist_sq = dist_sq;
+    copy_v3_v3(nearest->co, closest);
+  }
+}
+
+TEST(kdopbvh_performance, MedianAndSAH)
+{
+  Triangles triangles = create_triangles();
+
+  RandomNumberGenerator rng(0);
+  Array<float3> ray_origins(queries_num);
+  Array<float3> ray_directions(queries_num);
+  Array<float3> nearest_points(queries_num);
+  for (const int i : IndexRange(queries_num)) {
+    ray_origins[i] = float3(rng.get_float() * 100.0f, rng.get_float() * 100.0f, 10.0f);
+    ray_directions[i] = math::normalize(
+        float3(rng.get_float() - 0.5f, rng.get_float() - 0.5f, -1.0f));
+    nearest_points[i] = float3(
+        rng.get_float() * 110.0f, rng.get_float() * 110.0f, rng.get_float() * 10.0f - 5.0f);
+  }
+
+  int hits_num[2] = {0, 0};
+  for (const bool use_sah : {false, true}) {
+    std::cout << (use_sah ? "SAH" : "Median") << ":\n";
+    BVHTree *tree = build_tree(triangles, use_sah);
+    {
+      SCOPED_TIMER("  Ray cast");
+      for (const int i : IndexRange(queries_num)) {
+        BVHTreeRayHit hit;
+        hit.index = -1;
+        hit.dist = BVH_RAYCAST_DIST_MAX;
+        BLI_bvhtree_ray_cast(
+            tree, ray_origins[i], ray_directions[i], 0.0f, &hit, raycast_callback, &triangles);
+        hits_num[use_sah] += hit.index != -1;
+      }
+    }
+    {
+      SCOPED_TIMER("  Find nearest");
+      for (const int i : IndexRange(queries_num)) {
+        BVHTreeNearest nearest;
+        nearest.index = -1;
+        nearest.dist_sq = FLT_MAX;
+        BLI_bvhtree_find_nearest(tree, nearest_points[i], &nearest, nearest_callback, &triangles);
+      }
+    }
+    BLI_bvhtree_free(tree);
+  }
+  EXPECT_EQ(hits_num[0], hits_num[1]);
+}
+
+/* Cast rays from scattered points down onto the terrain and find the nearest surface positions,
+ * once with a query per point and once with the batch functions. */
+TEST(kdopbvh_performance, SingleAndBatch)
+{
+  Triangles triangles = create_triangles();
+  BVHTree *tree = build_tree(triangles, true);
+
+  const int points_num = 200000;
+  RandomNumberGenerator rng(0);
+  Array<float3> points(points_num);
+  for (const int i : IndexRange(points_num)) {
+    points[i] = float3(rng.get_float() * 100.0f, rng.get_float() * 100.0f, 10.0f);
+  }
+  const Array<float3> directions(points_num, float3(0.0f, 0.0f, -1.0f));
+
+  Array<BVHTreeRayHit> hits(points_num);
+  Array<BVHTreeRayHit> batch_hits(points_num);
+  for (BVHTreeRayHit &hit : hits) {
+    hit.index = -1;
+    hit.dist = BVH_RAYCAST_DIST_MAX;
+  }
+  batch_hits.as_mutable_span().copy_from(hits);
+  {
+    SCOPED_TIMER("Ray cast");
+    for (const int i : IndexRange(points_num)) {
+      BLI_bvhtree_ray_cast(
+          tree, points[i], directions[i], 0.0f, &hits[i], raycast_callback, &triangles);
+    }
+  }
+  {
+    SCOPED_TIMER("Ray cast batch");
+    BLI_bvhtree_ray_cast_batch_cpp(
+        *tree, points, directions, 0.0f, batch_hits, raycast_callback, &triangles);
+  }
+
+  Array<BVHTreeNearest> nearest(points_num);
+  for (BVHTreeNearest &item : nearest) {
+    item.index = -1;
+    item.dist_sq = FLT_MAX;
+  }
+  Array<BVHTreeNearest> batch_nearest = nearest;
+  {
+    SCOPED_TIMER("Find nearest");
+    for (const int i : IndexRange(points_num)) {
+      BLI_bvhtree_find_nearest(tree, points[i], &nearest[i], nearest_callback, &triangles);
+    }
+  }
+  {
+    SCOPED_TIMER("Find nearest batch");
+    BLI_bvhtree_find_nearest_batch_cpp(
+        *tree, points, batch_nearest, nearest_callback, &triangles);
+  }
+
+  /* The results may only differ for ties and because of rounding, when the result of a nearby
+   * point is used as initial bound. */
+  for (const int i : IndexRange(points_num)) {
+    EXPECT_NEAR(hits[i].dist, batch_hits[i].dist, 1e-4f);
+    EXPECT_NEAR(nearest[i].dist_sq, batch_nearest[i].dist_sq, nearest[i].dist_sq * 1e-5f);
+  }
+  BLI_bvhtree_free(tree);
+}
+
+}  // namespace blender::tests
@@ -0,0 +1,68 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <cmath>
+
+#include "testing/testing.h"
+
+#include "BLI_array.hh"
+#include "BLI_task.hh"
+#include "BLI_timeit.hh"
+
+namespace blender::tests {
+
+/* Compare fixed grain sizes that are common in the code base with #parallel_for_adaptive, for
+ * work that is very cheap per element and for work that is expensive per element. A fixed grain
+ * size is usually only a good fit for one of them. The difference grows with the number of
+ * threads, so this is most interesting on machines with many cores. */
+
+static constexpr int64_t fixed_grain_sizes[] = {128, 2048, 10000};
+static constexpr int repetitions_num = 10;
+
+template<typename Fn> static void benchmark_grain_sizes(const int64_t size, const Fn &fn)
+{
+  for (const int64_t grain_size : fixed_grain_sizes) {
+    SCOPED_TIMER("Fixed grain size " + std::to_string(grain_size));
+    for ([[maybe_unused]] const int i : IndexRange(repetitions_num)) {
+      threading::parallel_for(IndexRange(size), grain_size, fn);
+    }
+  }
+  threading::AdaptiveGrainSize grain_size;
+  {
+    SCOPED_TIMER("Adaptive grain size");
+    for ([[maybe_unused]] const int i : IndexRange(repetitions_num)) {
+      threading::parallel_for_adaptive(IndexRange(size), grain_size, fn);
+    }
+  }
+  std::cout << "Chosen grain size: " << grain_size.grain_size() << "\n";
+}
+
+TEST(parallel_for_performance, CheapElements)
+{
+  const int64_t size = 50000000;
+  Array<float> src(size, 1.0f);
+  Array<float> dst(size);
+  benchmark_grain_sizes(size, [&](const IndexRange range) {
+    for (const int64_t i : range) {
+      dst[i] = src[i] * 2.0f;
+    }
+  });
+  EXPECT_EQ(dst.last(), 2.0f);
+}
+
+TEST(parallel_for_performance, ExpensiveElements)
+{
+  const int64_t size = 10000;
+  Array<float> dst(size);
+  benchmark_grain_sizes(size, [&](const IndexRange range) {
+    for (const int64_t i : range) {
+      float value = float(i);
+      for (int j = 0; j < 1000; j++) {
+        value = std::sin(value) + 1.0f;
+      }
+      dst[i] = value;
+    }
+  });
+  EXPECT_GT(dst.last(), 0.0f);
+}
+
+}  // namespace blender::tests
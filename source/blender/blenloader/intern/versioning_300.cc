@@ -3437,5 +3437,17 @@ void blo_do_versions_300(FileData *fd, Library *UNUSED(lib), Main *bmain)
         }
       }
     }
+
+    /* Memory limit for the cache of geometry nodes modifiers. */
+    if (!DNA_struct_elem_find(fd->filesdna, "NodesModifierData", "int", "cache_memory_limit")) {
+      LISTBASE_FOREACH (Object *, object, &bmain->objects) {
+        LISTBASE_FOREACH (ModifierData *, md, &object->modifiers) {
+          if (md->type == eModifierType_Nodes) {
+            NodesModifierData *nmd = (NodesModifierData *)md;
+            nmd->cache_memory_limit = 1024;
+          }
+        }
+      }
+    }
   }
 }
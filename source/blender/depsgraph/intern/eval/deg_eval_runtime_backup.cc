@@ -25,7 +25,8 @@ RuntimeBackup::RuntimeBackup(const Depsgraph *depsgraph)
       drawdata_ptr(nullptr),
       movieclip_backup(depsgraph),
       volume_backup(depsgraph),
-      gpencil_backup(depsgraph)
+      gpencil_backup(depsgraph),
+      curves_backup(depsgraph)
 {
   drawdata_backup.first = drawdata_backup.last = nullptr;
 }
@@ -63,6 +64,9 @@ void RuntimeBackup::init_from_id(ID *id)
     case ID_GD:
       gpencil_backup.init_from_gpencil(reinterpret_cast<bGPdata *>(id));
       break;
+    case ID_CV:
+      curves_backup.init_from_curves(reinterpret_cast<Curves *>(id));
+      break;
     default:
       break;
   }
@@ -106,6 +110,9 @@ void RuntimeBackup::restore_to_id(ID *id)
     case ID_GD:
       gpencil_backup.restore_to_gpencil(reinterpret_cast<bGPdata *>(id));
       break;
+    case ID_CV:
+      curves_backup.restore_to_curves(reinterpret_cast<Curves *>(id));
+      break;
     default:
       break;
   }
@@ -10,6 +10,7 @@
 #include "DNA_ID.h"
 
 #include "intern/eval/deg_eval_runtime_backup_animation.h"
+#include "intern/eval/deg_eval_runtime_backup_curves.h"
 #include "intern/eval/deg_eval_runtime_backup_gpencil.h"
 #include "intern/eval/deg_eval_runtime_backup_movieclip.h"
 #include "intern/eval/deg_eval_runtime_backup_object.h"
@@ -56,6 +57,7 @@ class RuntimeBackup {
   MovieClipBackup movieclip_backup;
   VolumeBackup volume_backup;
   GPencilBackup gpencil_backup;
+  CurvesBackup curves_backup;
 };
 
 }  // namespace blender::deg
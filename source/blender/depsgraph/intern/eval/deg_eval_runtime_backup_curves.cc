@@ -0,0 +1,46 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/** \file
+ * \ingroup depsgraph
+ */
+
+#include "intern/eval/deg_eval_runtime_backup_curves.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "DNA_curves_types.h"
+
+#include "BKE_curves.hh"
+
+namespace blender::deg {
+
+CurvesBackup::CurvesBackup(const Depsgraph * /*depsgraph*/) : runtime(nullptr)
+{
+}
+
+CurvesBackup::~CurvesBackup()
+{
+  MEM_delete(runtime);
+}
+
+void CurvesBackup::init_from_curves(Curves *curves)
+{
+  runtime = bke::curves_runtime_backup(bke::CurvesGeometry::wrap(curves->geometry));
+}
+
+void CurvesBackup::restore_to_curves(Curves *curves)
+{
+  if (runtime == nullptr) {
+    return;
+  }
+  const Curves *curves_orig = reinterpret_cast<const Curves *>(curves->id.orig_id);
+  if (curves_orig == nullptr) {
+    return;
+  }
+  bke::curves_runtime_backup_restore(bke::CurvesGeometry::wrap(curves->geometry),
+                                     bke::CurvesGeometry::wrap(curves_orig->geometry),
+                                     runtime);
+  runtime = nullptr;
+}
+
+}  // namespace blender::deg
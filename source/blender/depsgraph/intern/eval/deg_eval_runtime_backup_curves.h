@@ -0,0 +1,32 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/** \file
+ * \ingroup depsgraph
+ */
+
+#pragma once
+
+struct Curves;
+
+namespace blender::bke {
+class CurvesGeometryRuntime;
+}
+
+namespace blender::deg {
+
+struct Depsgraph;
+
+/* Keeps the evaluated caches of curves, so that they can be reused when only some curves changed.
+ */
+class CurvesBackup {
+ public:
+  CurvesBackup(const Depsgraph *depsgraph);
+  ~CurvesBackup();
+
+  void init_from_curves(Curves *curves);
+  void restore_to_curves(Curves *curves);
+
+  bke::CurvesGeometryRuntime *runtime;
+};
+
+}  // namespace blender::deg
@@ -41,6 +41,7 @@ using blender::Array;
 using blender::float3;
 using blender::IndexRange;
 using blender::Span;
+using blender::Vector;
 
 /* See: edit_curve_point_vert.glsl for duplicate includes. */
 #define SELECT 1
@@ -470,7 +471,8 @@ static void curve_create_curves_pos(CurveRenderData *rdata, GPUVertBuf *vbo_curv
 
   const blender::bke::CurvesGeometry &curves = blender::bke::CurvesGeometry::wrap(
       rdata->curve_eval->geometry);
-  const Span<float3> positions = curves.evaluated_positions();
+  Vector<float3> positions_buffer;
+  const Span<float3> positions = curves.evaluated_positions(positions_buffer);
   GPU_vertbuf_attr_fill(vbo_curves_pos, attr_id.pos, positions.data());
 }
 
@@ -386,6 +386,13 @@ void move_last_point_and_resample(MoveAndResampleBuffers &buffer,
   positions.last() = new_last_position;
 }
 
+IndexMask changed_curves_to_mask(Vector<int64_t> &r_indices)
+{
+  std::sort(r_indices.begin(), r_indices.end());
+  r_indices.resize(std::unique(r_indices.begin(), r_indices.end()) - r_indices.begin());
+  return r_indices.as_span();
+}
+
 CurvesSculptCommonContext::CurvesSculptCommonContext(const bContext &C)
 {
   this->depsgraph = CTX_data_depsgraph_pointer(&C);
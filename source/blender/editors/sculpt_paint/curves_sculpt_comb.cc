@@ -162,7 +162,11 @@ struct CombOperationExecutor {
 
     this->restore_segment_lengths(changed_curves);
 
-    curves_orig_->tag_positions_changed();
+    Vector<int64_t> changed_curve_indices;
+    for (const Vector<int> &local_changed_curves : changed_curves) {
+      changed_curve_indices.extend(local_changed_curves.begin(), local_changed_curves.end());
+    }
+    curves_orig_->tag_positions_changed(changed_curves_to_mask(changed_curve_indices));
     DEG_id_tag_update(&curves_id_orig_->id, ID_RECALC_GEOMETRY);
     WM_main_add_notifier(NC_GEOM | ND_DATA, &curves_id_orig_->id);
     ED_region_tag_redraw(ctx_.region);
@@ -332,7 +332,12 @@ struct CurvesEffectOperationExecutor {
       self_->effect_->execute(*curves_, influences.curve_indices, influences.move_distances_cu);
     });
 
-    curves_->tag_positions_changed();
+    Vector<int64_t> changed_curve_indices;
+    for (const Influences &influences : influences_for_thread) {
+      changed_curve_indices.extend(influences.curve_indices.begin(),
+                                   influences.curve_indices.end());
+    }
+    curves_->tag_positions_changed(changed_curves_to_mask(changed_curve_indices));
     DEG_id_tag_update(&curves_id_->id, ID_RECALC_GEOMETRY);
     WM_main_add_notifier(NC_GEOM | ND_DATA, &curves_id_->id);
     ED_region_tag_redraw(ctx_.region);
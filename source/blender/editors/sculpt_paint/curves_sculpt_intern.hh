@@ -120,6 +120,13 @@ void move_last_point_and_resample(MoveAndResampleBuffers &buffer,
                                   MutableSpan<float3> positions,
                                   const float3 &new_last_position);
 
+/**
+ * Turn indices of curves changed by a brush into a mask that can be passed to
+ * #CurvesGeometry::tag_positions_changed. The indices may be gathered in any order and may contain
+ * duplicates, i.e. because of symmetry.
+ */
+IndexMask changed_curves_to_mask(Vector<int64_t> &r_indices);
+
 class CurvesSculptCommonContext {
  public:
   const Depsgraph *depsgraph = nullptr;
@@ -5,6 +5,7 @@
 #include "curves_sculpt_intern.hh"
 
 #include "BLI_float4x4.hh"
+#include "BLI_index_mask_ops.hh"
 #include "BLI_vector.hh"
 
 #include "PIL_time.h"
@@ -138,7 +139,12 @@ struct PinchOperationExecutor {
     }
 
     this->restore_segment_lengths(changed_curves);
-    curves_->tag_positions_changed();
+
+    Vector<int64_t> changed_curve_indices;
+    curves_->tag_positions_changed(index_mask_ops::find_indices_based_on_predicate(
+        curve_selection_, 4096, changed_curve_indices, [&](const int64_t curve_i) {
+          return changed_curves[curve_i];
+        }));
     DEG_id_tag_update(&curves_id_->id, ID_RECALC_GEOMETRY);
     WM_main_add_notifier(NC_GEOM | ND_DATA, &curves_id_->id);
     ED_region_tag_redraw(ctx_.region);
@@ -154,7 +154,13 @@ struct PuffOperationExecutor {
     this->puff(curve_weights);
     this->restore_segment_lengths();
 
-    curves_->tag_positions_changed();
+    Vector<int64_t> changed_curve_indices;
+    for (const int curve_selection_i : curve_selection_.index_range()) {
+      if (curve_weights[curve_selection_i] > 0.0f) {
+        changed_curve_indices.append(curve_selection_[curve_selection_i]);
+      }
+    }
+    curves_->tag_positions_changed(changed_curve_indices.as_span());
     DEG_id_tag_update(&curves_id_->id, ID_RECALC_GEOMETRY);
     WM_main_add_notifier(NC_GEOM | ND_DATA, &curves_id_->id);
     ED_region_tag_redraw(ctx_.region);
@@ -271,24 +277,33 @@ struct PuffOperationExecutor {
     BLI_assert(curve_weights.size() == curve_selection_.size());
     MutableSpan<float3> positions_cu = curves_->positions_for_write();
 
+    /* Find the nearest positions on the surface for all curves at once. The curves will be
+     * aligned to the normals at these positions. */
+    Array<float3> first_positions_su(curve_selection_.size());
+    Array<BVHTreeNearest> nearest_su(curve_selection_.size());
+    threading::parallel_for(curve_selection_.index_range(), 1024, [&](const IndexRange range) {
+      for (const int curve_selection_i : range) {
+        const int curve_i = curve_selection_[curve_selection_i];
+        const int first_point_i = curves_->points_for_curve(curve_i).first();
+        first_positions_su[curve_selection_i] = transforms_.curves_to_surface *
+                                                positions_cu[first_point_i];
+        nearest_su[curve_selection_i].index = -1;
+        nearest_su[curve_selection_i].dist_sq = FLT_MAX;
+      }
+    });
+    BLI_bvhtree_find_nearest_batch_cpp(*surface_bvh_.tree,
+                                       first_positions_su,
+                                       nearest_su,
+                                       surface_bvh_.nearest_callback,
+                                       &surface_bvh_);
+
     threading::parallel_for(curve_selection_.index_range(), 256, [&](const IndexRange range) {
       Vector<float> accumulated_lengths_cu;
       for (const int curve_selection_i : range) {
         const int curve_i = curve_selection_[curve_selection_i];
         const IndexRange points = curves_->points_for_curve(curve_i);
-        const int first_point_i = points[0];
-        const float3 first_pos_cu = positions_cu[first_point_i];
-        const float3 first_pos_su = transforms_.curves_to_surface * first_pos_cu;
-
-        /* Find the nearest position on the surface. The curve will be aligned to the normal of
-         * that point. */
-        BVHTreeNearest nearest;
-        nearest.dist_sq = FLT_MAX;
-        BLI_bvhtree_find_nearest(surface_bvh_.tree,
-                                 first_pos_su,
-                                 &nearest,
-                                 surface_bvh_.nearest_callback,
-                                 &surface_bvh_);
+        const float3 first_pos_cu = positions_cu[points[0]];
+        const BVHTreeNearest &nearest = nearest_su[curve_selection_i];
 
         const MLoopTri &looptri = surface_looptris_[nearest.index];
         const float3 closest_pos_su = nearest.co;
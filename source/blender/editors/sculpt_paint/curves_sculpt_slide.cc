@@ -238,7 +238,13 @@ struct SlideOperationExecutor {
           stroke_extension.reports, RPT_WARNING, TIP_("UV map or surface attachment is invalid"));
     }
 
-    curves_orig_->tag_positions_changed();
+    Vector<int64_t> changed_curve_indices;
+    for (const SlideInfo &slide_info : self_->slide_info_) {
+      for (const SlideCurveInfo &slide_curve_info : slide_info.curves_to_slide) {
+        changed_curve_indices.append(slide_curve_info.curve_i);
+      }
+    }
+    curves_orig_->tag_positions_changed(changed_curves_to_mask(changed_curve_indices));
     DEG_id_tag_update(&curves_id_orig_->id, ID_RECALC_GEOMETRY);
     WM_main_add_notifier(NC_GEOM | ND_DATA, &curves_id_orig_->id);
     ED_region_tag_redraw(ctx_.region);
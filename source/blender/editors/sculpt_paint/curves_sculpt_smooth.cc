@@ -14,6 +14,7 @@
 #include "WM_api.h"
 
 #include "BLI_enumerable_thread_specific.hh"
+#include "BLI_index_mask_ops.hh"
 
 #include "curves_sculpt_intern.hh"
 
@@ -109,7 +110,15 @@ struct SmoothOperationExecutor {
     }
 
     this->smooth(point_smooth_factors);
-    curves_->tag_positions_changed();
+
+    Vector<int64_t> changed_curve_indices;
+    curves_->tag_positions_changed(index_mask_ops::find_indices_based_on_predicate(
+        curve_selection_, 512, changed_curve_indices, [&](const int64_t curve_i) {
+          const Span<float> factors = point_smooth_factors.as_span().slice(
+              curves_->points_for_curve(curve_i));
+          return std::any_of(
+              factors.begin(), factors.end(), [](const float factor) { return factor > 0.0f; });
+        }));
     DEG_id_tag_update(&curves_id_->id, ID_RECALC_GEOMETRY);
     WM_main_add_notifier(NC_GEOM | ND_DATA, &curves_id_->id);
     ED_region_tag_redraw(ctx_.region);
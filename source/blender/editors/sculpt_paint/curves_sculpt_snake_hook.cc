@@ -148,32 +148,37 @@ struct SnakeHookOperatorExecutor {
       return;
     }
 
+    Array<bool> changed_curves(curves_->curves_num(), false);
     if (falloff_shape_ == PAINT_FALLOFF_SHAPE_SPHERE) {
-      this->spherical_snake_hook_with_symmetry();
+      this->spherical_snake_hook_with_symmetry(changed_curves);
     }
     else if (falloff_shape_ == PAINT_FALLOFF_SHAPE_TUBE) {
-      this->projected_snake_hook_with_symmetry();
+      this->projected_snake_hook_with_symmetry(changed_curves);
     }
     else {
       BLI_assert_unreachable();
     }
 
-    curves_->tag_positions_changed();
+    Vector<int64_t> changed_curve_indices;
+    curves_->tag_positions_changed(index_mask_ops::find_indices_based_on_predicate(
+        curves_->curves_range(), 4096, changed_curve_indices, [&](const int64_t curve_i) {
+          return changed_curves[curve_i];
+        }));
     DEG_id_tag_update(&curves_id_->id, ID_RECALC_GEOMETRY);
     WM_main_add_notifier(NC_GEOM | ND_DATA, &curves_id_->id);
     ED_region_tag_redraw(ctx_.region);
   }
 
-  void projected_snake_hook_with_symmetry()
+  void projected_snake_hook_with_symmetry(MutableSpan<bool> r_changed_curves)
   {
     const Vector<float4x4> symmetry_brush_transforms = get_symmetry_brush_transforms(
         eCurvesSymmetryType(curves_id_->symmetry));
     for (const float4x4 &brush_transform : symmetry_brush_transforms) {
-      this->projected_snake_hook(brush_transform);
+      this->projected_snake_hook(brush_transform, r_changed_curves);
     }
   }
 
-  void projected_snake_hook(const float4x4 &brush_transform)
+  void projected_snake_hook(const float4x4 &brush_transform, MutableSpan<bool> r_changed_curves)
   {
     const float4x4 brush_transform_inv = brush_transform.inverted();
     const bke::crazyspace::GeometryDeformation deformation =
@@ -224,11 +229,12 @@ struct SnakeHookOperatorExecutor {
 
         const float3 last_point_cu = positions_cu[last_point_i] + translation_orig;
         move_last_point_and_resample(resample_buffer, positions_cu.slice(points), last_point_cu);
+        r_changed_curves[curve_i] = true;
       }
     });
   }
 
-  void spherical_snake_hook_with_symmetry()
+  void spherical_snake_hook_with_symmetry(MutableSpan<bool> r_changed_curves)
   {
     float4x4 projection;
     ED_view3d_ob_project_mat_get(ctx_.rv3d, object_, projection.values);
@@ -252,14 +258,17 @@ struct SnakeHookOperatorExecutor {
     const Vector<float4x4> symmetry_brush_transforms = get_symmetry_brush_transforms(
         eCurvesSymmetryType(curves_id_->symmetry));
     for (const float4x4 &brush_transform : symmetry_brush_transforms) {
-      this->spherical_snake_hook(
-          brush_transform * brush_start_cu, brush_transform * brush_end_cu, brush_radius_cu);
+      this->spherical_snake_hook(brush_transform * brush_start_cu,
+                                 brush_transform * brush_end_cu,
+                                 brush_radius_cu,
+                                 r_changed_curves);
     }
   }
 
   void spherical_snake_hook(const float3 &brush_start_cu,
                             const float3 &brush_end_cu,
-                            const float brush_radius_cu)
+                            const float brush_radius_cu,
+                            MutableSpan<bool> r_changed_curves)
   {
     const bke::crazyspace::GeometryDeformation deformation =
         bke::crazyspace::get_evaluated_curves_deformation(*ctx_.depsgraph, *object_);
@@ -293,6 +302,7 @@ struct SnakeHookOperatorExecutor {
 
         const float3 last_point_cu = positions_cu[last_point_i] + translation_orig;
         move_last_point_and_resample(resample_buffer, positions_cu.slice(points), last_point_cu);
+        r_changed_curves[curve_i] = true;
       }
     });
   }
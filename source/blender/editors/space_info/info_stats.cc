@@ -12,6 +12,7 @@
 #include "DNA_armature_types.h"
 #include "DNA_collection_types.h"
 #include "DNA_curve_types.h"
+#include "DNA_curves_types.h"
 #include "DNA_gpencil_types.h"
 #include "DNA_lattice_types.h"
 #include "DNA_mesh_types.h"
@@ -34,6 +35,7 @@
 #include "BKE_blender_version.h"
 #include "BKE_context.h"
 #include "BKE_curve.h"
+#include "BKE_curves.hh"
 #include "BKE_displist.h"
 #include "BKE_editmesh.h"
 #include "BKE_gpencil.h"
@@ -71,6 +73,8 @@ struct SceneStats {
   uint64_t totlamp, totlampsel;
   uint64_t tottri;
   uint64_t totgplayer, totgpframe, totgpstroke, totgppoint;
+  /** Memory saved by compacting evaluated curves caches, see #SCE_PERF_COMPACT_CURVES_CACHES. */
+  uint64_t curves_caches_bytes_saved;
 };
 
 struct SceneStatsFmt {
@@ -84,6 +88,7 @@ struct SceneStatsFmt {
   char tottri[MAX_INFO_NUM_LEN];
   char totgplayer[MAX_INFO_NUM_LEN], totgpframe[MAX_INFO_NUM_LEN];
   char totgpstroke[MAX_INFO_NUM_LEN], totgppoint[MAX_INFO_NUM_LEN];
+  char curves_caches_bytes_saved[MAX_INFO_NUM_LEN];
 };
 
 static bool stats_mesheval(const Mesh *me_eval, bool is_selected, SceneStats *stats)
@@ -179,7 +184,16 @@ static void stats_object(Object *ob,
       }
       break;
     }
-    case OB_CURVES:
+    case OB_CURVES: {
+      const Curves *curves_eval = static_cast<const Curves *>(ob->data);
+      if (!BLI_gset_add(objects_gset, (void *)curves_eval)) {
+        break;
+      }
+      const blender::bke::CurvesGeometry &curves = blender::bke::CurvesGeometry::wrap(
+          curves_eval->geometry);
+      stats->curves_caches_bytes_saved += curves.compact_evaluated_caches_bytes_saved();
+      break;
+    }
     case OB_POINTCLOUD:
     case OB_VOLUME: {
       break;
@@ -488,6 +502,13 @@ static bool format_stats(
   SCENE_STATS_FMT_INT(totgppoint);
 
 #undef SCENE_STATS_FMT_INT
+
+  /* Only shown when compact curves caches are used. */
+  stats_fmt->curves_caches_bytes_saved[0] = '\0';
+  if (stats->curves_caches_bytes_saved > 0) {
+    BLI_str_format_byte_unit(
+        stats_fmt->curves_caches_bytes_saved, stats->curves_caches_bytes_saved, false);
+  }
   return true;
 }
 
@@ -717,6 +738,7 @@ void ED_info_draw_stats(
     STROKES,
     POINTS,
     LIGHTS,
+    CACHES_SAVED,
     MAX_LABELS_COUNT
   };
   char labels[MAX_LABELS_COUNT][64];
@@ -733,6 +755,7 @@ void ED_info_draw_stats(
   STRNCPY(labels[STROKES], IFACE_("Strokes"));
   STRNCPY(labels[POINTS], IFACE_("Points"));
   STRNCPY(labels[LIGHTS], IFACE_("Lights"));
+  STRNCPY(labels[CACHES_SAVED], IFACE_("Caches Saved"));
 
   int longest_label = 0;
   int i;
@@ -794,6 +817,15 @@ void ED_info_draw_stats(
     stats_row(col1, labels[EDGES], col2, stats_fmt.totedge, nullptr, y, height);
     stats_row(col1, labels[FACES], col2, stats_fmt.totface, nullptr, y, height);
     stats_row(col1, labels[TRIS], col2, stats_fmt.tottri, nullptr, y, height);
+    if (stats_fmt.curves_caches_bytes_saved[0] != '\0') {
+      stats_row(col1,
+                labels[CACHES_SAVED],
+                col2,
+                stats_fmt.curves_caches_bytes_saved,
+                nullptr,
+                y,
+                height);
+    }
   }
 
   BLF_disable(font_id, BLF_SHADOW);
@@ -473,6 +473,13 @@ Vector<GVArray> evaluate_fields(ResourceScope &scope,
                                 const FieldContext &context,
                                 Span<GVMutableArray> dst_varrays = {});
 
+/**
+ * Build the procedure that #evaluate_fields uses to compute the fields for many indices, and
+ * return it in the dot format. This is useful to check how the field tree is simplified before
+ * evaluation, by comparing the result with #optimize turned off.
+ */
+std::string field_procedure_to_dot(Span<GFieldRef> fields, bool optimize = true);
+
 /* -------------------------------------------------------------------- */
 /** \name Utility functions for simple field creation and evaluation
  * \{ */
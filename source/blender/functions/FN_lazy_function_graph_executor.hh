@@ -9,6 +9,8 @@
  * another #Graph again).
  */
 
+#include <chrono>
+
 #include "BLI_vector.hh"
 #include "BLI_vector_set.hh"
 
@@ -54,10 +56,27 @@ class GraphExecutorSideEffectProvider {
   virtual Vector<const FunctionNode *> get_nodes_with_side_effects(const Context &context) const;
 };
 
+/**
+ * Can be implemented to tell the #GraphExecutor how long the execution of nodes is expected to
+ * take, e.g. based on the run times measured in a previous evaluation. The executor uses these
+ * estimates to run the nodes on the longest path through the graph first and to start using
+ * multiple threads as soon as there are multiple expensive nodes that can run at the same time.
+ */
+class GraphExecutorNodeCostProvider {
+ public:
+  virtual ~GraphExecutorNodeCostProvider() = default;
+  /**
+   * May be called from multiple threads at the same time. Nodes that have no estimate return zero.
+   */
+  virtual std::chrono::nanoseconds get_node_cost(const FunctionNode &node,
+                                                 const Context &context) const;
+};
+
 class GraphExecutor : public LazyFunction {
  public:
   using Logger = GraphExecutorLogger;
   using SideEffectProvider = GraphExecutorSideEffectProvider;
+  using NodeCostProvider = GraphExecutorNodeCostProvider;
 
  private:
   /**
@@ -78,6 +97,10 @@ class GraphExecutor : public LazyFunction {
    * during evaluation.
    */
   const SideEffectProvider *side_effect_provider_;
+  /**
+   * Optional estimates of how long nodes take to execute, which are used for scheduling.
+   */
+  const NodeCostProvider *node_cost_provider_;
 
   friend class Executor;
 
@@ -86,7 +109,8 @@ class GraphExecutor : public LazyFunction {
                 Span<const OutputSocket *> graph_inputs,
                 Span<const InputSocket *> graph_outputs,
                 const Logger *logger,
-                const SideEffectProvider *side_effect_provider);
+                const SideEffectProvider *side_effect_provider,
+                const NodeCostProvider *node_cost_provider);
 
   void *init_storage(LinearAllocator<> &allocator) const override;
   void destruct_storage(void *storage) const override;
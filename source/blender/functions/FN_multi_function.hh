@@ -65,6 +65,23 @@ class MultiFunction {
     return false;
   }
 
+  /**
+   * Element-wise functions compute every output element only from the input elements at the same
+   * index. They can also be called on contiguous arrays with #call_element_wise, which avoids
+   * the overhead of index masks and virtual arrays. This allows fusing chains of such functions
+   * into a single #FusedMultiFunction.
+   */
+  virtual bool is_element_wise() const
+  {
+    return false;
+  }
+
+  /**
+   * Compute #size elements of an element-wise function.
+   * \param params: A pointer to the first element of every parameter. Outputs are uninitialized.
+   */
+  virtual void call_element_wise(int64_t size, Span<void *> params) const;
+
   int param_amount() const
   {
     return signature_ref_->param_types.size();
@@ -97,6 +97,33 @@ template<size_t... Indices> struct SomeSpanOrSingle {
   }
 };
 
+/**
+ * The default preset. It behaves like #AllSpanOrSingle for functions with up to
+ * #max_devirtualized_inputs inputs and like #Materialized for functions with more inputs. This way
+ * small functions avoid virtual function calls for the most common inputs, while the number of
+ * generated loops per function stays bounded.
+ */
+struct AutoSpanOrSingle {
+  /** Every additional input doubles the number of loops that are generated. */
+  static constexpr size_t max_devirtualized_inputs = 3;
+
+  static constexpr bool use_devirtualization = true;
+  static constexpr FallbackMode fallback_mode = FallbackMode::Materialized;
+
+  template<typename Fn, typename... ParamTypes>
+  void try_devirtualize(devi::Devirtualizer<Fn, ParamTypes...> &devirtualizer)
+  {
+    using devi::DeviMode;
+    constexpr size_t inputs_num = (size_t(is_VArray_v<ParamTypes>) + ...);
+    if constexpr (inputs_num <= max_devirtualized_inputs) {
+      devirtualizer.try_execute_devirtualized(
+          make_value_sequence<DeviMode,
+                              DeviMode::Span | DeviMode::Single | DeviMode::Range,
+                              sizeof...(ParamTypes)>());
+    }
+  }
+};
+
 }  // namespace CustomMF_presets
 
 namespace detail {
@@ -318,15 +345,16 @@ void execute_materialized(TypeSequence<ParamTags...> /* param_tags */,
 template<typename... ParamTags> class CustomMF : public MultiFunction {
  private:
   std::function<void(IndexMask mask, MFParams params)> fn_;
+  std::function<void(int64_t size, Span<void *> params)> element_wise_fn_;
   MFSignature signature_;
 
   using TagsSequence = TypeSequence<ParamTags...>;
 
  public:
-  template<typename ElementFn, typename ExecPreset = CustomMF_presets::Materialized>
+  template<typename ElementFn, typename ExecPreset = CustomMF_presets::AutoSpanOrSingle>
   CustomMF(const char *name,
            ElementFn element_fn,
-           ExecPreset exec_preset = CustomMF_presets::Materialized())
+           ExecPreset exec_preset = CustomMF_presets::AutoSpanOrSingle())
   {
     MFSignatureBuilder signature{name};
     add_signature_parameters(signature, std::make_index_sequence<TagsSequence::size()>());
@@ -337,6 +365,28 @@ template<typename... ParamTags> class CustomMF : public MultiFunction {
       execute(
           element_fn, exec_preset, mask, params, std::make_index_sequence<TagsSequence::size()>());
     };
+    element_wise_fn_ = [element_fn](const int64_t size, const Span<void *> params) {
+      execute_element_wise(
+          element_fn, size, params, std::make_index_sequence<TagsSequence::size()>());
+    };
+  }
+
+  /**
+   * Executes #element_fn on contiguous arrays. Since the types are known here, the compiler can
+   * optimize the loop for every function separately.
+   */
+  template<typename ElementFn, size_t... I>
+  static void execute_element_wise(ElementFn element_fn,
+                                   const int64_t size,
+                                   const Span<void *> params,
+                                   std::index_sequence<I...> /* indices */)
+  {
+    detail::execute_array(
+        TagsSequence(),
+        std::index_sequence<I...>(),
+        element_fn,
+        IndexRange(size),
+        static_cast<typename TagsSequence::template at_index<I>::base_type *>(params[I])...);
   }
 
   template<typename ElementFn, typename ExecPreset, size_t... I>
@@ -417,6 +467,16 @@ template<typename... ParamTags> class CustomMF : public MultiFunction {
   {
     fn_(mask, params);
   }
+
+  bool is_element_wise() const override
+  {
+    return true;
+  }
+
+  void call_element_wise(const int64_t size, const Span<void *> params) const override
+  {
+    element_wise_fn_(size, params);
+  }
 };
 
 /**
@@ -431,10 +491,10 @@ template<typename In1, typename Out1>
 class CustomMF_SI_SO : public CustomMF<MFParamTag<MFParamCategory::SingleInput, In1>,
                                        MFParamTag<MFParamCategory::SingleOutput, Out1>> {
  public:
-  template<typename ElementFn, typename ExecPreset = CustomMF_presets::Materialized>
+  template<typename ElementFn, typename ExecPreset = CustomMF_presets::AutoSpanOrSingle>
   CustomMF_SI_SO(const char *name,
                  ElementFn element_fn,
-                 ExecPreset exec_preset = CustomMF_presets::Materialized())
+                 ExecPreset exec_preset = CustomMF_presets::AutoSpanOrSingle())
       : CustomMF<MFParamTag<MFParamCategory::SingleInput, In1>,
                  MFParamTag<MFParamCategory::SingleOutput, Out1>>(
             name,
@@ -455,10 +515,10 @@ class CustomMF_SI_SI_SO : public CustomMF<MFParamTag<MFParamCategory::SingleInpu
                                           MFParamTag<MFParamCategory::SingleInput, In2>,
                                           MFParamTag<MFParamCategory::SingleOutput, Out1>> {
  public:
-  template<typename ElementFn, typename ExecPreset = CustomMF_presets::Materialized>
+  template<typename ElementFn, typename ExecPreset = CustomMF_presets::AutoSpanOrSingle>
   CustomMF_SI_SI_SO(const char *name,
                     ElementFn element_fn,
-                    ExecPreset exec_preset = CustomMF_presets::Materialized())
+                    ExecPreset exec_preset = CustomMF_presets::AutoSpanOrSingle())
       : CustomMF<MFParamTag<MFParamCategory::SingleInput, In1>,
                  MFParamTag<MFParamCategory::SingleInput, In2>,
                  MFParamTag<MFParamCategory::SingleOutput, Out1>>(
@@ -484,10 +544,10 @@ class CustomMF_SI_SI_SI_SO : public CustomMF<MFParamTag<MFParamCategory::SingleI
                                              MFParamTag<MFParamCategory::SingleInput, In3>,
                                              MFParamTag<MFParamCategory::SingleOutput, Out1>> {
  public:
-  template<typename ElementFn, typename ExecPreset = CustomMF_presets::Materialized>
+  template<typename ElementFn, typename ExecPreset = CustomMF_presets::AutoSpanOrSingle>
   CustomMF_SI_SI_SI_SO(const char *name,
                        ElementFn element_fn,
-                       ExecPreset exec_preset = CustomMF_presets::Materialized())
+                       ExecPreset exec_preset = CustomMF_presets::AutoSpanOrSingle())
       : CustomMF<MFParamTag<MFParamCategory::SingleInput, In1>,
                  MFParamTag<MFParamCategory::SingleInput, In2>,
                  MFParamTag<MFParamCategory::SingleInput, In3>,
@@ -516,10 +576,10 @@ class CustomMF_SI_SI_SI_SI_SO : public CustomMF<MFParamTag<MFParamCategory::Sing
                                                 MFParamTag<MFParamCategory::SingleInput, In4>,
                                                 MFParamTag<MFParamCategory::SingleOutput, Out1>> {
  public:
-  template<typename ElementFn, typename ExecPreset = CustomMF_presets::Materialized>
+  template<typename ElementFn, typename ExecPreset = CustomMF_presets::AutoSpanOrSingle>
   CustomMF_SI_SI_SI_SI_SO(const char *name,
                           ElementFn element_fn,
-                          ExecPreset exec_preset = CustomMF_presets::Materialized())
+                          ExecPreset exec_preset = CustomMF_presets::AutoSpanOrSingle())
       : CustomMF<MFParamTag<MFParamCategory::SingleInput, In1>,
                  MFParamTag<MFParamCategory::SingleInput, In2>,
                  MFParamTag<MFParamCategory::SingleInput, In3>,
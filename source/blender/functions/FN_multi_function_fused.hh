@@ -0,0 +1,62 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#pragma once
+
+/** \file
+ * \ingroup fn
+ *
+ * A #FusedMultiFunction calls a chain of element-wise multi-functions (see
+ * #MultiFunction::is_element_wise) as a single function. The elements are processed in small
+ * chunks, so that intermediate values stay in buffers that fit into the CPU cache instead of
+ * being written to arrays as large as the mask. Inputs are only read from virtual arrays once per
+ * chunk and every function is called on contiguous arrays, which avoids most of the per-function
+ * overhead when the functions themselves are cheap, like most math operations.
+ */
+
+#include "FN_multi_function.hh"
+
+namespace blender::fn {
+
+class FusedMultiFunction : public MultiFunction {
+ public:
+  /** The number of elements that are computed by all functions before the next chunk starts. */
+  static constexpr int64_t chunk_size = 64;
+
+  struct Call {
+    /** An element-wise function with a single output. */
+    const MultiFunction *fn;
+    /**
+     * Indices of the values passed into the inputs of the function. The inputs of the fused
+     * function come first, followed by the outputs of all previous calls.
+     */
+    Vector<int> inputs;
+  };
+
+ private:
+  Vector<const CPPType *> value_types_;
+  int inputs_num_;
+  Vector<Call> calls_;
+  MFSignature signature_;
+
+ public:
+  /**
+   * \param calls: The functions in the order they are called. The output of the last call is the
+   * output of the fused function.
+   */
+  FusedMultiFunction(Span<const CPPType *> input_types, Vector<Call> calls);
+
+  void call(IndexMask mask, MFParams params, MFContext context) const override;
+  std::string debug_name() const override;
+
+  bool is_element_wise() const override
+  {
+    return true;
+  }
+
+  void call_element_wise(int64_t size, Span<void *> params) const override;
+
+ private:
+  void call_chunk(int64_t size, Span<void *> values) const;
+};
+
+}  // namespace blender::fn
@@ -10,18 +10,32 @@
 
 namespace blender::fn {
 
+class ValueAllocator;
+
 /** A multi-function that executes a procedure internally. */
 class MFProcedureExecutor : public MultiFunction {
  private:
   MFSignature signature_;
   const MFProcedure &procedure_;
+  /** The number of indices that are evaluated at the same time, or zero to not use tiles. */
+  int64_t tile_size_;
 
  public:
-  MFProcedureExecutor(const MFProcedure &procedure);
+  /**
+   * \param use_tiles: Evaluate large masks in tiles of a few thousand indices at a time, which
+   * keeps the buffers of intermediate variables small and reuses them for every tile. This is
+   * ignored for procedures with vector variables.
+   */
+  MFProcedureExecutor(const MFProcedure &procedure, bool use_tiles = true);
 
   void call(IndexMask mask, MFParams params, MFContext context) const override;
 
  private:
+  void execute(IndexMask mask,
+               MFParams params,
+               MFContext context,
+               ValueAllocator &value_allocator) const;
+
   ExecutionHints get_execution_hints() const override;
 };
 
@@ -5,10 +5,12 @@
 #include "BLI_multi_value_map.hh"
 #include "BLI_set.hh"
 #include "BLI_stack.hh"
+#include "BLI_tracing.hh"
 #include "BLI_vector_set.hh"
 
 #include "FN_field.hh"
 #include "FN_multi_function_builder.hh"
+#include "FN_multi_function_fused.hh"
 #include "FN_multi_function_procedure.hh"
 #include "FN_multi_function_procedure_builder.hh"
 #include "FN_multi_function_procedure_executor.hh"
@@ -138,18 +140,121 @@ static Set<GFieldRef> find_varying_fields(const FieldTreeInfo &field_tree_info,
   return found_fields;
 }
 
+/**
+ * Identifies a call to a multi-function by the function and the variables passed to its inputs.
+ * Two calls with the same key compute the same values, so only one of them has to be executed.
+ * Different functions are compared with #MultiFunction::equals, which e.g. detects equal
+ * constants.
+ */
+struct CallKey {
+  const MultiFunction *fn;
+  Vector<MFVariable *> inputs;
+
+  uint64_t hash() const
+  {
+    uint64_t hash = fn->hash();
+    for (const MFVariable *variable : inputs) {
+      hash = hash * 33 ^ get_default_hash(variable);
+    }
+    return hash;
+  }
+
+  friend bool operator==(const CallKey &a, const CallKey &b)
+  {
+    return (a.fn == b.fn || a.fn->equals(*b.fn)) && a.inputs.as_span() == b.inputs.as_span();
+  }
+};
+
+/**
+ * Element-wise operations that are called as a single #FusedMultiFunction, so that intermediate
+ * values don't have to be stored in arrays as large as the mask.
+ */
+struct FusedOperations {
+  /** The operations in the order they are called. The last one computes the output. */
+  VectorSet<const FieldOperation *> operations;
+  /** Fields that are computed outside and are passed into the operations. */
+  VectorSet<GFieldRef> inputs;
+};
+
+/** Limits the size of the buffers used by a fused function and the recursion depth below. */
+static constexpr int max_fused_operations = 32;
+
+static bool is_fusable_operation(const FieldOperation &operation)
+{
+  const MultiFunction &fn = operation.multi_function();
+  if (!fn.is_element_wise()) {
+    return false;
+  }
+  int outputs_num = 0;
+  for (const int param_index : fn.param_indices()) {
+    const MFParamType param_type = fn.param_type(param_index);
+    if (param_type.interface_type() == MFParamType::Output) {
+      outputs_num++;
+    }
+    else if (param_type.interface_type() != MFParamType::Input) {
+      return false;
+    }
+  }
+  return outputs_num == 1;
+}
+
+/**
+ * Add the operation to #r_fused after all the operations that compute its inputs and can be
+ * fused with it.
+ */
+static void gather_fused_operations(
+    const FieldOperation &operation,
+    const FunctionRef<bool(const FieldOperation &user, GFieldRef field)> can_fuse_input,
+    FusedOperations &r_fused)
+{
+  for (const GField &input : operation.inputs()) {
+    if (r_fused.operations.size() + 1 < max_fused_operations && can_fuse_input(operation, input)) {
+      const FieldOperation &input_operation = static_cast<const FieldOperation &>(input.node());
+      if (!r_fused.operations.contains(&input_operation)) {
+        gather_fused_operations(input_operation, can_fuse_input, r_fused);
+      }
+    }
+    else {
+      r_fused.inputs.add(input);
+    }
+  }
+  r_fused.operations.add_new(&operation);
+}
+
 /**
  * Builds the #procedure so that it computes the fields.
+ *
+ * \param optimize: Simplify the field tree while building the procedure:
+ * - Operations that don't depend on any input are evaluated once while building and are replaced
+ *   with their result, when all output fields depend on inputs.
+ * - Operations that call the same function with the same inputs are only called once, even when
+ *   they are different nodes in the field tree.
+ * - Equal constants share a single variable.
+ * - Chains of element-wise operations whose intermediate results are not used elsewhere are
+ *   fused into a single function call.
  */
 static void build_multi_function_procedure_for_fields(MFProcedure &procedure,
                                                       ResourceScope &scope,
                                                       const FieldTreeInfo &field_tree_info,
-                                                      Span<GFieldRef> output_fields)
+                                                      Span<GFieldRef> output_fields,
+                                                      const bool optimize)
 {
   MFProcedureBuilder builder{procedure};
-  /* Every input, intermediate and output field corresponds to a variable in the procedure. */
+  /* Every input, intermediate and output field corresponds to a variable in the procedure. When
+   * the procedure is optimized, multiple fields can share the same variable. */
   Map<GFieldRef, MFVariable *> variable_by_field;
 
+  /* Constant subtrees are only folded when the procedure is evaluated for many indices. Otherwise
+   * it would be evaluated only once anyway, and folding the subtrees of constant output fields
+   * would recurse. */
+  const bool fold_constants = optimize &&
+                              std::all_of(output_fields.begin(),
+                                          output_fields.end(),
+                                          [](const GFieldRef field) {
+                                            return field.node().depends_on_input();
+                                          });
+  Map<CallKey, MFCallInstruction *> call_by_key;
+
   /* Start by adding the field inputs as parameters to the procedure. */
   for (const FieldInput &field_input : field_tree_info.deduplicated_field_inputs) {
     MFVariable &variable = builder.add_input_parameter(
@@ -157,10 +262,178 @@ static void build_multi_function_procedure_for_fields(MFProcedure &procedure,
     variable_by_field.add_new({field_input, 0}, &variable);
   }
 
+  auto field_is_used = [&](const GFieldRef field) {
+    return !field_tree_info.field_users.lookup(field).is_empty() || output_fields.contains(field);
+  };
+
+  /* Add a call to a function that outputs a constant value, or reuse an existing equal one. */
+  auto add_constant = [&](const GFieldRef field, const MultiFunction &fn) {
+    if (!optimize || !field.cpp_type().is_equality_comparable()) {
+      variable_by_field.add_new(field, builder.add_call<1>(fn)[0]);
+      return;
+    }
+    MFCallInstruction *call = call_by_key.lookup_or_add_cb(CallKey{&fn, {}}, [&]() {
+      return &builder.add_call_with_all_variables(
+          fn, {&procedure.new_variable(MFDataType::ForSingle(field.cpp_type()))});
+    });
+    variable_by_field.add_new(field, call->params()[0]);
+  };
+
+  /* Replace the used outputs of an operation that doesn't depend on any input with constants. */
+  auto fold_operation = [&](const FieldOperation &operation) {
+    const MultiFunction &multi_function = operation.multi_function();
+    Vector<GFieldRef> used_outputs;
+    int output_index = 0;
+    for (const int param_index : multi_function.param_indices()) {
+      if (multi_function.param_type(param_index).interface_type() == MFParamType::Output) {
+        const GFieldRef output_field{operation, output_index};
+        if (field_is_used(output_field)) {
+          used_outputs.append(output_field);
+        }
+        output_index++;
+      }
+    }
+    FieldContext context;
+    const Vector<GVArray> values = evaluate_fields(scope, used_outputs, IndexRange(1), context);
+    for (const int i : used_outputs.index_range()) {
+      const CPPType &type = used_outputs[i].cpp_type();
+      BUFFER_FOR_CPP_TYPE_VALUE(type, buffer);
+      values[i].get_to_uninitialized(0, buffer);
+      const MultiFunction &fn = procedure.construct_function<CustomMF_GenericConstant>(
+          type, buffer, true);
+      type.destruct(buffer);
+      add_constant(used_outputs[i], fn);
+    }
+  };
+
+  /* Add a call for an operation whose input variables are ready. */
+  auto add_operation_call = [&](const FieldOperation &operation_node) {
+    const MultiFunction &multi_function = operation_node.multi_function();
+    const Span<GField> operation_inputs = operation_node.inputs();
+    Vector<MFVariable *> variables(multi_function.param_amount(), nullptr);
+
+    CallKey key{&multi_function, {}};
+    int param_input_index = 0;
+    for (const int param_index : multi_function.param_indices()) {
+      const MFParamType param_type = multi_function.param_type(param_index);
+      if (param_type.interface_type() == MFParamType::Input) {
+        const GField &input_field = operation_inputs[param_input_index];
+        variables[param_index] = variable_by_field.lookup(input_field);
+        key.inputs.append(variables[param_index]);
+        param_input_index++;
+      }
+    }
+
+    /* Reuse a call with the same inputs if there is one, only adding variables for outputs that
+     * it ignored until now. */
+    MFCallInstruction *existing_call = optimize ? call_by_key.lookup_default(key, nullptr) :
+                                                  nullptr;
+
+    int param_output_index = 0;
+    for (const int param_index : multi_function.param_indices()) {
+      const MFParamType param_type = multi_function.param_type(param_index);
+      const MFParamType::InterfaceType interface_type = param_type.interface_type();
+      if (interface_type == MFParamType::Input) {
+        continue;
+      }
+      BLI_assert(interface_type == MFParamType::Output);
+      const GFieldRef output_field{operation_node, param_output_index};
+      param_output_index++;
+      if (!field_is_used(output_field)) {
+        /* Ignored outputs don't need a variable. */
+        continue;
+      }
+      MFVariable *variable = existing_call ? existing_call->params()[param_index] : nullptr;
+      if (variable == nullptr) {
+        /* Create a new variable for used outputs. */
+        variable = &procedure.new_variable(param_type.data_type());
+        if (existing_call) {
+          existing_call->set_param_variable(param_index, variable);
+        }
+      }
+      variables[param_index] = variable;
+      variable_by_field.add_new(output_field, variable);
+    }
+    if (existing_call == nullptr) {
+      MFCallInstruction &call = builder.add_call_with_all_variables(multi_function, variables);
+      if (optimize) {
+        call_by_key.add_new(std::move(key), &call);
+      }
+    }
+  };
+
+  /* An input of an operation can be computed by the same fused function when nothing else uses
+   * the input. */
+  auto can_fuse_input = [&](const FieldOperation &user, const GFieldRef field) {
+    if (field.node().node_type() != FieldNodeType::Operation) {
+      return false;
+    }
+    const FieldOperation &operation = static_cast<const FieldOperation &>(field.node());
+    if (!is_fusable_operation(operation)) {
+      return false;
+    }
+    if (fold_constants && !operation.depends_on_input()) {
+      /* The result is folded into a constant instead. */
+      return false;
+    }
+    if (output_fields.contains(field) || variable_by_field.contains(field)) {
+      return false;
+    }
+    for (const GFieldRef &other_user : field_tree_info.field_users.lookup(field)) {
+      if (&other_user.node() != &user) {
+        return false;
+      }
+    }
+    return true;
+  };
+
+  /* Find the operations that can be fused with the given one, or return null if there are none. */
+  auto find_fused_operations = [&](const FieldOperation &operation) -> const FusedOperations * {
+    if (!optimize || !is_fusable_operation(operation)) {
+      return nullptr;
+    }
+    FusedOperations fused;
+    gather_fused_operations(operation, can_fuse_input, fused);
+    if (fused.operations.size() == 1) {
+      return nullptr;
+    }
+    return &scope.add_value(std::move(fused));
+  };
+
+  /* Add a single call that computes the output of all fused operations. */
+  auto add_fused_call = [&](const FusedOperations &fused) {
+    Vector<const CPPType *> input_types;
+    Vector<MFVariable *> variables;
+    Map<GFieldRef, int> value_by_field;
+    for (const GFieldRef &input : fused.inputs) {
+      value_by_field.add_new(input, input_types.size());
+      input_types.append(&input.cpp_type());
+      variables.append(variable_by_field.lookup(input));
+    }
+    Vector<FusedMultiFunction::Call> calls;
+    for (const FieldOperation *operation : fused.operations) {
+      FusedMultiFunction::Call call{&operation->multi_function(), {}};
+      for (const GField &input : operation->inputs()) {
+        call.inputs.append(value_by_field.lookup(input));
+      }
+      value_by_field.add_new({*operation, 0}, input_types.size() + calls.size());
+      calls.append(std::move(call));
+    }
+    const MultiFunction &fn = procedure.construct_function<FusedMultiFunction>(input_types,
+                                                                               std::move(calls));
+    const GFieldRef output_field{*fused.operations.as_span().last(), 0};
+    MFVariable &variable = procedure.new_variable(MFDataType::ForSingle(output_field.cpp_type()));
+    variables.append(&variable);
+    builder.add_call_with_all_variables(fn, variables);
+    variable_by_field.add_new(output_field, &variable);
+  };
+
   /* Utility struct that is used to do proper depth first search traversal of the tree below. */
   struct FieldWithIndex {
     GFieldRef field;
     int current_input_index = 0;
+    /** Set when the operation is called together with operations that compute its inputs. */
+    const FusedOperations *fused = nullptr;
   };
 
   for (GFieldRef field : output_fields) {
@@ -186,50 +459,30 @@ static void build_multi_function_procedure_for_fields(MFProcedure &procedure,
           const FieldOperation &operation_node = static_cast<const FieldOperation &>(field.node());
           const Span<GField> operation_inputs = operation_node.inputs();
 
-          if (field_with_index.current_input_index < operation_inputs.size()) {
+          if (fold_constants && !operation_node.depends_on_input()) {
+            fold_operation(operation_node);
+            break;
+          }
+          if (field_with_index.current_input_index == 0) {
+            field_with_index.fused = find_fused_operations(operation_node);
+          }
+          const FusedOperations *fused = field_with_index.fused;
+          const int inputs_num = fused ? fused->inputs.size() : operation_inputs.size();
+          if (field_with_index.current_input_index < inputs_num) {
             /* Not all inputs are handled yet. Push the next input field to the stack and increment
              * the input index. */
-            fields_to_check.push({operation_inputs[field_with_index.current_input_index]});
+            const int input_index = field_with_index.current_input_index;
+            fields_to_check.push(
+                {fused ? fused->inputs[input_index] : GFieldRef(operation_inputs[input_index])});
             field_with_index.current_input_index++;
           }
+          else if (fused) {
+            add_fused_call(*fused);
+          }
           else {
             /* All inputs variables are ready, now gather all variables that are used by the
              * function and call it. */
-            const MultiFunction &multi_function = operation_node.multi_function();
-            Vector<MFVariable *> variables(multi_function.param_amount());
-
-            int param_input_index = 0;
-            int param_output_index = 0;
-            for (const int param_index : multi_function.param_indices()) {
-              const MFParamType param_type = multi_function.param_type(param_index);
-              const MFParamType::InterfaceType interface_type = param_type.interface_type();
-              if (interface_type == MFParamType::Input) {
-                const GField &input_field = operation_inputs[param_input_index];
-                variables[param_index] = variable_by_field.lookup(input_field);
-                param_input_index++;
-              }
-              else if (interface_type == MFParamType::Output) {
-                const GFieldRef output_field{operation_node, param_output_index};
-                const bool output_is_ignored =
-                    field_tree_info.field_users.lookup(output_field).is_empty() &&
-                    !output_fields.contains(output_field);
-                if (output_is_ignored) {
-                  /* Ignored outputs don't need a variable. */
-                  variables[param_index] = nullptr;
-                }
-                else {
-                  /* Create a new variable for used outputs. */
-                  MFVariable &new_variable = procedure.new_variable(param_type.data_type());
-                  variables[param_index] = &new_variable;
-                  variable_by_field.add_new(output_field, &new_variable);
-                }
-                param_output_index++;
-              }
-              else {
-                BLI_assert_unreachable();
-              }
-            }
-            builder.add_call_with_all_variables(multi_function, variables);
+            add_operation_call(operation_node);
           }
           break;
         }
@@ -237,8 +490,7 @@ static void build_multi_function_procedure_for_fields(MFProcedure &procedure,
           const FieldConstant &constant_node = static_cast<const FieldConstant &>(field_node);
           const MultiFunction &fn = procedure.construct_function<CustomMF_GenericConstant>(
               constant_node.type(), constant_node.value().get(), false);
-          MFVariable &new_variable = *builder.add_call<1>(fn)[0];
-          variable_by_field.add_new(field, &new_variable);
+          add_constant(field, fn);
           break;
         }
       }
@@ -258,12 +510,15 @@ static void build_multi_function_procedure_for_fields(MFProcedure &procedure,
     builder.add_output_parameter(*variable);
   }
 
-  /* Remove the variables that should not be destructed from the map. */
-  for (const GFieldRef &field : output_fields) {
-    variable_by_field.remove(field);
-  }
-  /* Add destructor calls for the remaining variables. */
+  /* Add destructor calls for the remaining variables. Variables that are shared by multiple
+   * fields are only destructed once. */
+  VectorSet<MFVariable *> variables_to_destruct;
   for (MFVariable *variable : variable_by_field.values()) {
+    if (!already_output_variables.contains(variable)) {
+      variables_to_destruct.add(variable);
+    }
+  }
+  for (MFVariable *variable : variables_to_destruct) {
     builder.add_destruct(*variable);
   }
 
@@ -271,7 +526,6 @@ static void build_multi_function_procedure_for_fields(MFProcedure &procedure,
 
   procedure_optimization::move_destructs_up(procedure, return_instr);
 
-  // std::cout << procedure.to_dot() << "\n";
   BLI_assert(procedure.validate());
 }
 
@@ -367,7 +621,7 @@ Vector<GVArray> evaluate_fields(ResourceScope &scope,
     /* Build the procedure for those fields. */
     MFProcedure procedure;
     build_multi_function_procedure_for_fields(
-        procedure, scope, field_tree_info, varying_fields_to_evaluate);
+        procedure, scope, field_tree_info, varying_fields_to_evaluate, true);
     MFProcedureExecutor procedure_executor{procedure};
 
     MFParamsBuilder mf_params{procedure_executor, &mask};
@@ -419,7 +673,7 @@ Vector<GVArray> evaluate_fields(ResourceScope &scope,
     /* Build the procedure for those fields. */
     MFProcedure procedure;
     build_multi_function_procedure_for_fields(
-        procedure, scope, field_tree_info, constant_fields_to_evaluate);
+        procedure, scope, field_tree_info, constant_fields_to_evaluate, true);
     MFProcedureExecutor procedure_executor{procedure};
     MFParamsBuilder mf_params{procedure_executor, 1};
     MFContextBuilder mf_context;
@@ -468,22 +722,26 @@ Vector<GVArray> evaluate_fields(ResourceScope &scope,
       }
       /* Still have to copy over the data in the destination provided by the caller. */
       if (dst_varray.is_span()) {
-        /* Materialize into a span. */
-        threading::parallel_for(mask.index_range(), 2048, [&](const IndexRange range) {
-          computed_varray.materialize_to_uninitialized(mask.slice(range),
-                                                       dst_varray.get_internal_span().data());
-        });
+        /* Materialize into a span. The cost per element depends on the type and virtual array. */
+        static threading::AdaptiveGrainSize grain_size;
+        threading::parallel_for_adaptive(
+            mask.index_range(), grain_size, [&](const IndexRange range) {
+              computed_varray.materialize_to_uninitialized(mask.slice(range),
+                                                           dst_varray.get_internal_span().data());
+            });
       }
       else {
         /* Slower materialize into a different structure. */
         const CPPType &type = computed_varray.type();
-        threading::parallel_for(mask.index_range(), 2048, [&](const IndexRange range) {
-          BUFFER_FOR_CPP_TYPE_VALUE(type, buffer);
-          for (const int i : mask.slice(range)) {
-            computed_varray.get_to_uninitialized(i, buffer);
-            dst_varray.set_by_relocate(i, buffer);
-          }
-        });
+        static threading::AdaptiveGrainSize grain_size;
+        threading::parallel_for_adaptive(
+            mask.index_range(), grain_size, [&](const IndexRange range) {
+              BUFFER_FOR_CPP_TYPE_VALUE(type, buffer);
+              for (const int i : mask.slice(range)) {
+                computed_varray.get_to_uninitialized(i, buffer);
+                dst_varray.set_by_relocate(i, buffer);
+              }
+            });
       }
       r_varrays[out_index] = dst_varray;
     }
@@ -491,6 +749,15 @@ Vector<GVArray> evaluate_fields(ResourceScope &scope,
   return r_varrays;
 }
 
+std::string field_procedure_to_dot(Span<GFieldRef> fields, const bool optimize)
+{
+  ResourceScope scope;
+  const FieldTreeInfo field_tree_info = preprocess_field_tree(fields);
+  MFProcedure procedure;
+  build_multi_function_procedure_for_fields(procedure, scope, field_tree_info, fields, optimize);
+  return procedure.to_dot();
+}
+
 void evaluate_constant_field(const GField &field, void *r_value)
 {
   if (field.node().depends_on_input()) {
@@ -773,6 +1040,7 @@ static IndexMask evaluate_selection(const Field<bool> &selection_field,
 void FieldEvaluator::evaluate()
 {
   BLI_assert_msg(!is_evaluated_, "Cannot evaluate fields twice.");
+  SCOPED_TRACE_EVENT("field", "Evaluate Fields");
 
   selection_mask_ = evaluate_selection(selection_field_, context_, mask_, scope_);
 
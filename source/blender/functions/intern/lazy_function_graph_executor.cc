@@ -37,6 +37,13 @@
  * When all tasks are completed, the executor gives back control to the caller which may later
  * provide new inputs to the graph which in turn leads to new nodes being scheduled and the process
  * starts again.
+ *
+ * When the caller provides estimates for how long nodes take to execute, scheduled nodes are
+ * executed in the order of their priority, which is the estimated length of the longest path from
+ * the node to the end of the graph. Doing the nodes on this critical path first avoids that a
+ * single long branch is started only when all the other work is done already, leaving other
+ * threads without anything to do. The estimates are also used to start using multiple threads
+ * before an expensive node runs, when there are other expensive nodes that are ready already.
  */
 
 #include <mutex>
@@ -47,6 +54,7 @@
 #include "BLI_task.h"
 #include "BLI_task.hh"
 #include "BLI_timeit.hh"
+#include "BLI_tracing.hh"
 
 #include "FN_lazy_function_graph_executor.hh"
 
@@ -164,6 +172,17 @@ struct NodeState {
    * not run twice at the same time accidentally.
    */
   NodeScheduleState schedule_state = NodeScheduleState::NotScheduled;
+  /**
+   * Estimated time it takes to execute this node. This is zero when there is no estimate. It does
+   * not change after the node state has been initialized, so it can be accessed without locking.
+   */
+  std::chrono::nanoseconds cost{0};
+  /**
+   * Estimated time it takes to execute this node and all nodes on the most expensive path from it
+   * to the end of the graph. Scheduled nodes with a higher priority are executed first. Like
+   * #cost, this can be accessed without locking.
+   */
+  std::chrono::nanoseconds priority{0};
   /**
    * Custom storage of the node.
    */
@@ -206,7 +225,8 @@ struct CurrentTask {
    */
   std::mutex mutex;
   /**
-   * Nodes that have been scheduled to execute next.
+   * Nodes that have been scheduled to execute next. They are sorted by #NodeState::priority, so
+   * the last node should be executed first.
    */
   Vector<const FunctionNode *> scheduled_nodes;
   /**
@@ -218,6 +238,13 @@ struct CurrentTask {
 
 class Executor {
  private:
+  /**
+   * Enabling multi-threading has some overhead, so it's only done based on the cost estimates when
+   * nodes are expected to take at least this long.
+   */
+  static constexpr std::chrono::nanoseconds parallel_node_cost_threshold =
+      std::chrono::milliseconds(1);
+
   const GraphExecutor &self_;
   /**
    * Remembers which inputs have been loaded from the caller already, to avoid loading them twice.
@@ -335,6 +362,67 @@ class Executor {
         this->construct_initial_node_state(allocator, node, node_state);
       }
     });
+
+    if (self_.node_cost_provider_ != nullptr) {
+      this->compute_node_priorities();
+    }
+  }
+
+  /**
+   * Compute the priority of every node from the cost estimates, with a depth-first search that
+   * handles the nodes after all the nodes that depend on them. This is possible because the graph
+   * does not have cycles.
+   */
+  void compute_node_priorities()
+  {
+    const Span<const Node *> nodes = self_.graph_.nodes();
+    bool has_cost = false;
+    for (const Node *node : nodes) {
+      if (node->is_function()) {
+        NodeState &node_state = *node_states_[node->index_in_graph()];
+        node_state.cost = self_.node_cost_provider_->get_node_cost(
+            static_cast<const FunctionNode &>(*node), *context_);
+        has_cost |= node_state.cost.count() > 0;
+      }
+    }
+    if (!has_cost) {
+      return;
+    }
+
+    Array<bool> is_done(nodes.size(), false);
+    /* Nodes are pushed a second time when all their dependent nodes have been pushed. */
+    Vector<std::pair<const Node *, bool>> stack;
+    for (const Node *start_node : nodes) {
+      stack.append({start_node, false});
+      while (!stack.is_empty()) {
+        const auto [node, dependents_done] = stack.pop_last();
+        if (is_done[node->index_in_graph()]) {
+          continue;
+        }
+        if (!dependents_done) {
+          stack.append({node, true});
+          for (const OutputSocket *output_socket : node->outputs()) {
+            for (const InputSocket *target_socket : output_socket->targets()) {
+              const Node &target_node = target_socket->node();
+              if (!is_done[target_node.index_in_graph()]) {
+                stack.append({&target_node, false});
+              }
+            }
+          }
+          continue;
+        }
+        std::chrono::nanoseconds max_dependent_priority{0};
+        for (const OutputSocket *output_socket : node->outputs()) {
+          for (const InputSocket *target_socket : output_socket->targets()) {
+            const NodeState &target_state = *node_states_[target_socket->node().index_in_graph()];
+            max_dependent_priority = std::max(max_dependent_priority, target_state.priority);
+          }
+        }
+        NodeState &node_state = *node_states_[node->index_in_graph()];
+        node_state.priority = node_state.cost + max_dependent_priority;
+        is_done[node->index_in_graph()] = true;
+      }
+    }
   }
 
   void construct_initial_node_state(LinearAllocator<> &allocator,
@@ -544,10 +632,10 @@ class Executor {
         const FunctionNode &node = static_cast<const FunctionNode &>(locked_node.node);
         if (this->use_multi_threading()) {
           std::lock_guard lock{current_task.mutex};
-          current_task.scheduled_nodes.append(&node);
+          this->add_scheduled_node(current_task.scheduled_nodes, node);
         }
         else {
-          current_task.scheduled_nodes.append(&node);
+          this->add_scheduled_node(current_task.scheduled_nodes, node);
         }
         current_task.has_scheduled_nodes.store(true, std::memory_order_relaxed);
         break;
@@ -565,6 +653,25 @@ class Executor {
     }
   }
 
+  /**
+   * Insert the node so that the scheduled nodes stay sorted by priority. Nodes with the same
+   * priority are executed in the reverse order in which they were scheduled, which is also the
+   * order when there are no cost estimates.
+   */
+  void add_scheduled_node(Vector<const FunctionNode *> &scheduled_nodes, const FunctionNode &node)
+  {
+    const std::chrono::nanoseconds priority = node_states_[node.index_in_graph()]->priority;
+    int64_t insert_index = scheduled_nodes.size();
+    while (insert_index > 0) {
+      const FunctionNode &other_node = *scheduled_nodes[insert_index - 1];
+      if (node_states_[other_node.index_in_graph()]->priority <= priority) {
+        break;
+      }
+      insert_index--;
+    }
+    scheduled_nodes.insert(insert_index, &node);
+  }
+
   void with_locked_node(const Node &node,
                         NodeState &node_state,
                         CurrentTask &current_task,
@@ -608,10 +715,35 @@ class Executor {
       if (current_task.scheduled_nodes.is_empty()) {
         current_task.has_scheduled_nodes.store(false, std::memory_order_relaxed);
       }
+      else if (this->should_run_scheduled_nodes_in_parallel(node, current_task)) {
+        /* The node with the highest priority stays on the current thread, so that the critical
+         * path is not delayed by moving it to another thread. */
+        if (this->try_enable_multi_threading()) {
+          this->move_scheduled_nodes_to_task_pool(current_task);
+        }
+      }
       this->run_node_task(node, current_task);
     }
   }
 
+  /**
+   * Decide whether the other scheduled nodes should be given to other threads before the given
+   * node runs. That is worth it when the node is expected to take a while and there is expensive
+   * work waiting for it.
+   */
+  bool should_run_scheduled_nodes_in_parallel(const FunctionNode &node,
+                                              const CurrentTask &current_task) const
+  {
+    const NodeState &node_state = *node_states_[node.index_in_graph()];
+    if (node_state.cost < parallel_node_cost_threshold) {
+      return false;
+    }
+    /* The last scheduled node has the highest priority. */
+    const FunctionNode &next_node = *current_task.scheduled_nodes.last();
+    const NodeState &next_node_state = *node_states_[next_node.index_in_graph()];
+    return next_node_state.priority >= parallel_node_cost_threshold;
+  }
+
   void run_node_task(const FunctionNode &node, CurrentTask &current_task)
   {
     NodeState &node_state = *node_states_[node.index_in_graph()];
@@ -1150,7 +1282,10 @@ inline void Executor::execute_node(const FunctionNode &node,
   };
 
   lazy_threading::HintReceiver blocking_hint_receiver{blocking_hint_fn};
-  fn.execute(node_params, fn_context);
+  {
+    SCOPED_TRACE_EVENT("lazy_function", [&]() { return fn.name(); });
+    fn.execute(node_params, fn_context);
+  }
 
   if (self_.logger_ != nullptr) {
     self_.logger_->log_after_node_execute(node, node_params, fn_context);
@@ -1161,12 +1296,14 @@ GraphExecutor::GraphExecutor(const Graph &graph,
                              const Span<const OutputSocket *> graph_inputs,
                              const Span<const InputSocket *> graph_outputs,
                              const Logger *logger,
-                             const SideEffectProvider *side_effect_provider)
+                             const SideEffectProvider *side_effect_provider,
+                             const NodeCostProvider *node_cost_provider)
     : graph_(graph),
       graph_inputs_(graph_inputs),
       graph_outputs_(graph_outputs),
       logger_(logger),
-      side_effect_provider_(side_effect_provider)
+      side_effect_provider_(side_effect_provider),
+      node_cost_provider_(node_cost_provider)
 {
   for (const OutputSocket *socket : graph_inputs_) {
     BLI_assert(socket->node().is_dummy());
@@ -1223,6 +1360,13 @@ Vector<const FunctionNode *> GraphExecutorSideEffectProvider::get_nodes_with_sid
   return {};
 }
 
+std::chrono::nanoseconds GraphExecutorNodeCostProvider::get_node_cost(
+    const FunctionNode &node, const Context &context) const
+{
+  UNUSED_VARS(node, context);
+  return std::chrono::nanoseconds(0);
+}
+
 void GraphExecutorLogger::dump_when_outputs_are_missing(const FunctionNode &node,
                                                         Span<const OutputSocket *> missing_sockets,
                                                         const Context &context) const
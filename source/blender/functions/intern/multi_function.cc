@@ -19,6 +19,13 @@ ExecutionHints MultiFunction::get_execution_hints() const
   return ExecutionHints{};
 }
 
+void MultiFunction::call_element_wise(const int64_t UNUSED(size),
+                                      const Span<void *> UNUSED(params)) const
+{
+  /* Only element-wise functions have to implement this. */
+  BLI_assert_unreachable();
+}
+
 static bool supports_threading_by_slicing_params(const MultiFunction &fn)
 {
   for (const int i : fn.param_indices()) {
@@ -0,0 +1,177 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#include "BLI_array.hh"
+#include "BLI_linear_allocator.hh"
+
+#include "FN_multi_function_fused.hh"
+
+namespace blender::fn {
+
+FusedMultiFunction::FusedMultiFunction(const Span<const CPPType *> input_types,
+                                       Vector<Call> calls)
+    : value_types_(input_types), inputs_num_(input_types.size()), calls_(std::move(calls))
+{
+  BLI_assert(!calls_.is_empty());
+  MFSignatureBuilder signature{"Fused"};
+  for (const CPPType *type : input_types) {
+    signature.single_input("Input", *type);
+  }
+  for (const Call &call : calls_) {
+    const MultiFunction &fn = *call.fn;
+    BLI_assert(fn.is_element_wise());
+    for (const int param_index : fn.param_indices()) {
+      const MFParamType param_type = fn.param_type(param_index);
+      if (param_type.interface_type() == MFParamType::Output) {
+        value_types_.append(&param_type.data_type().single_type());
+      }
+    }
+    BLI_assert(value_types_.size() == inputs_num_ + (&call - calls_.begin()) + 1);
+  }
+  signature.single_output("Output", *value_types_.last());
+  signature_ = signature.build();
+  this->set_signature(&signature_);
+}
+
+std::string FusedMultiFunction::debug_name() const
+{
+  std::string name = "Fused(";
+  for (const Call &call : calls_) {
+    if (&call != calls_.begin()) {
+      name += ", ";
+    }
+    name += call.fn->debug_name();
+  }
+  name += ")";
+  return name;
+}
+
+void FusedMultiFunction::call(IndexMask mask, MFParams params, MFContext UNUSED(context)) const
+{
+  const int output_value = value_types_.size() - 1;
+  const CPPType &output_type = *value_types_[output_value];
+  GMutableSpan output = params.uninitialized_single_output(inputs_num_, "Output");
+
+  /* Every value gets a buffer for one chunk, even though inputs and the output don't always need
+   * it. */
+  LinearAllocator<> allocator;
+  Array<void *> buffers(value_types_.size());
+  for (const int i : value_types_.index_range()) {
+    const CPPType &type = *value_types_[i];
+    buffers[i] = allocator.allocate(type.size() * chunk_size, type.alignment());
+  }
+
+  Array<const GVArray *> inputs(inputs_num_);
+  Array<GSpan> input_spans(inputs_num_);
+  Array<bool> input_is_single(inputs_num_, false);
+  for (const int i : IndexRange(inputs_num_)) {
+    const CPPType &type = *value_types_[i];
+    const GVArray &varray = params.readonly_single_input(i, "Input");
+    inputs[i] = &varray;
+    if (varray.is_single()) {
+      /* Fill the buffer only once, it is reused for every chunk. */
+      varray.get_internal_single_to_uninitialized(buffers[i]);
+      type.fill_construct_n(buffers[i], POINTER_OFFSET(buffers[i], type.size()), chunk_size - 1);
+      input_is_single[i] = true;
+    }
+    else if (varray.is_span()) {
+      input_spans[i] = varray.get_internal_span();
+    }
+  }
+
+  Array<void *> values(value_types_.size());
+  for (int64_t chunk_start = 0; chunk_start < mask.size(); chunk_start += chunk_size) {
+    const IndexMask sliced_mask = mask.slice(chunk_start, chunk_size);
+    const int64_t size = sliced_mask.size();
+    const bool sliced_mask_is_range = sliced_mask.is_range();
+
+    Array<bool, 16> input_is_materialized(inputs_num_, false);
+    for (const int i : IndexRange(inputs_num_)) {
+      if (input_is_single[i]) {
+        values[i] = buffers[i];
+      }
+      else if (sliced_mask_is_range && !input_spans[i].is_empty()) {
+        /* The function does not change its inputs. */
+        values[i] = const_cast<void *>(input_spans[i][sliced_mask[0]]);
+      }
+      else {
+        inputs[i]->materialize_compressed_to_uninitialized(sliced_mask, buffers[i]);
+        values[i] = buffers[i];
+        input_is_materialized[i] = true;
+      }
+    }
+    for (const int i : IndexRange(inputs_num_, calls_.size() - 1)) {
+      values[i] = buffers[i];
+    }
+    /* The output is computed in place when the chunk is contiguous. */
+    values[output_value] = sliced_mask_is_range ? output[sliced_mask[0]] : buffers[output_value];
+
+    this->call_chunk(size, values);
+
+    if (!sliced_mask_is_range) {
+      void *computed = buffers[output_value];
+      for (const int64_t i : IndexRange(size)) {
+        output_type.relocate_construct(POINTER_OFFSET(computed, output_type.size() * i),
+                                       output[sliced_mask[i]]);
+      }
+    }
+    for (const int i : IndexRange(inputs_num_)) {
+      if (input_is_materialized[i]) {
+        value_types_[i]->destruct_n(buffers[i], size);
+      }
+    }
+  }
+
+  for (const int i : IndexRange(inputs_num_)) {
+    if (input_is_single[i]) {
+      value_types_[i]->destruct_n(buffers[i], chunk_size);
+    }
+  }
+}
+
+void FusedMultiFunction::call_element_wise(const int64_t size, const Span<void *> params) const
+{
+  const int output_value = value_types_.size() - 1;
+  LinearAllocator<> allocator;
+  Array<void *> values(value_types_.size());
+  for (const int i : IndexRange(inputs_num_, calls_.size() - 1)) {
+    const CPPType &type = *value_types_[i];
+    values[i] = allocator.allocate(type.size() * chunk_size, type.alignment());
+  }
+
+  for (int64_t chunk_start = 0; chunk_start < size; chunk_start += chunk_size) {
+    for (const int i : IndexRange(inputs_num_)) {
+      values[i] = POINTER_OFFSET(params[i], value_types_[i]->size() * chunk_start);
+    }
+    values[output_value] = POINTER_OFFSET(params[inputs_num_],
+                                          value_types_[output_value]->size() * chunk_start);
+    this->call_chunk(std::min(chunk_size, size - chunk_start), values);
+  }
+}
+
+void FusedMultiFunction::call_chunk(const int64_t size, const Span<void *> values) const
+{
+  Vector<void *, 8> call_params;
+  for (const int call_index : calls_.index_range()) {
+    const Call &call = calls_[call_index];
+    const MultiFunction &fn = *call.fn;
+    call_params.clear();
+    int input_index = 0;
+    for (const int param_index : fn.param_indices()) {
+      if (fn.param_type(param_index).interface_type() == MFParamType::Input) {
+        call_params.append(values[call.inputs[input_index]]);
+        input_index++;
+      }
+      else {
+        call_params.append(values[inputs_num_ + call_index]);
+      }
+    }
+    fn.call_element_wise(size, call_params);
+  }
+
+  /* Only the output of the last call is kept. */
+  for (const int i : IndexRange(inputs_num_, calls_.size() - 1)) {
+    value_types_[i]->destruct_n(values[i], size);
+  }
+}
+
+}  // namespace blender::fn
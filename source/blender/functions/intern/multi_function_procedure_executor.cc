@@ -3,10 +3,34 @@
 #include "FN_multi_function_procedure_executor.hh"
 
 #include "BLI_stack.hh"
+#include "BLI_task.hh"
 
 namespace blender::fn {
 
-MFProcedureExecutor::MFProcedureExecutor(const MFProcedure &procedure) : procedure_(procedure)
+/**
+ * Choose the number of indices per tile so that the buffers of all variables fit into the L2 cache
+ * together. Only few of them are allocated at the same time usually, because destruct
+ * instructions are moved up and buffers are reused.
+ * \return Zero if the procedure can't be evaluated in tiles.
+ */
+static int64_t compute_tile_size(const MFProcedure &procedure)
+{
+  constexpr int64_t tile_bytes = 256 * 1024;
+  int64_t bytes_per_index = 0;
+  for (const MFVariable *variable : procedure.variables()) {
+    const MFDataType data_type = variable->data_type();
+    if (data_type.is_vector()) {
+      /* Vector arrays can't be sliced. */
+      return 0;
+    }
+    /* Small types share buffers of the same size, see #ValueAllocator::obtain_Span. */
+    bytes_per_index += std::max<int64_t>(data_type.single_type().size(), 16);
+  }
+  return std::clamp<int64_t>(tile_bytes / std::max<int64_t>(bytes_per_index, 1), 1024, 8192);
+}
+
+MFProcedureExecutor::MFProcedureExecutor(const MFProcedure &procedure, const bool use_tiles)
+    : procedure_(procedure), tile_size_(use_tiles ? compute_tile_size(procedure) : 0)
 {
   MFSignatureBuilder signature("Procedure Executor");
 
@@ -153,8 +177,15 @@ class ValueAllocator : NonCopyable, NonMovable {
   Stack<void *> small_single_value_free_list_;
   Map<const CPPType *, Stack<void *>> single_value_free_lists_;
 
+  /**
+   * Span buffers are reused without checking their size, so they are allocated with at least this
+   * size when the allocator is used for multiple masks.
+   */
+  int min_span_size_;
+
  public:
-  ValueAllocator(LinearAllocator<> &linear_allocator) : linear_allocator_(linear_allocator)
+  ValueAllocator(LinearAllocator<> &linear_allocator, const int min_span_size = 0)
+      : linear_allocator_(linear_allocator), min_span_size_(min_span_size)
   {
   }
 
@@ -176,6 +207,7 @@ class ValueAllocator : NonCopyable, NonMovable {
   VariableValue_Span *obtain_Span(const CPPType &type, int size)
   {
     void *buffer = nullptr;
+    size = std::max(size, min_span_size_);
 
     const int64_t element_size = type.size();
     const int64_t alignment = type.alignment();
@@ -821,17 +853,17 @@ class VariableState : NonCopyable, NonMovable {
 /** Keeps track of the states of all variables during evaluation. */
 class VariableStates {
  private:
-  ValueAllocator value_allocator_;
+  ValueAllocator &value_allocator_;
   const MFProcedure &procedure_;
   /** The state of every variable, indexed by #MFVariable::index_in_procedure(). */
   Array<VariableState> variable_states_;
   IndexMask full_mask_;
 
  public:
-  VariableStates(LinearAllocator<> &linear_allocator,
+  VariableStates(ValueAllocator &value_allocator,
                  const MFProcedure &procedure,
                  IndexMask full_mask)
-      : value_allocator_(linear_allocator),
+      : value_allocator_(value_allocator),
         procedure_(procedure),
         variable_states_(procedure.variables().size()),
         full_mask_(full_mask)
@@ -1173,15 +1205,111 @@ class InstructionScheduler {
   }
 };
 
+/**
+ * Find the part of the mask with indices in the range, assuming that the mask is sorted.
+ */
+static IndexRange mask_slice_in_range(const IndexMask mask, const IndexRange range)
+{
+  if (mask.is_range()) {
+    const IndexRange mask_range = mask.as_range();
+    const int64_t start = std::max(range.start(), mask_range.start());
+    const int64_t end = std::min(range.one_after_last(), mask_range.one_after_last());
+    return IndexRange(start - mask_range.start(), std::max<int64_t>(end - start, 0));
+  }
+  const Span<int64_t> indices = mask.indices();
+  const int64_t *start = std::lower_bound(indices.begin(), indices.end(), range.start());
+  const int64_t *end = std::lower_bound(start, indices.end(), range.one_after_last());
+  return IndexRange(start - indices.begin(), end - start);
+}
+
+/**
+ * Create parameters that only contain the given range of indices of the original parameters,
+ * offset so that the range starts at zero.
+ */
+static void add_sliced_params(const MultiFunction &fn,
+                              MFParams params,
+                              const IndexRange slice,
+                              MFParamsBuilder &r_params)
+{
+  for (const int param_index : fn.param_indices()) {
+    const MFParamType param_type = fn.param_type(param_index);
+    switch (param_type.category()) {
+      case MFParamCategory::SingleInput: {
+        const GVArray &varray = params.readonly_single_input(param_index);
+        r_params.add_readonly_single_input(varray.slice(slice));
+        break;
+      }
+      case MFParamCategory::SingleMutable: {
+        const GMutableSpan span = params.single_mutable(param_index);
+        r_params.add_single_mutable(span.slice(slice));
+        break;
+      }
+      case MFParamCategory::SingleOutput: {
+        const GMutableSpan span = params.uninitialized_single_output_if_required(param_index);
+        if (span.is_empty()) {
+          r_params.add_ignored_single_output();
+        }
+        else {
+          r_params.add_uninitialized_single_output(span.slice(slice));
+        }
+        break;
+      }
+      case MFParamCategory::VectorInput:
+      case MFParamCategory::VectorMutable:
+      case MFParamCategory::VectorOutput: {
+        BLI_assert_unreachable();
+        break;
+      }
+    }
+  }
+}
+
 void MFProcedureExecutor::call(IndexMask full_mask, MFParams params, MFContext context) const
 {
   BLI_assert(procedure_.validate());
 
-  AlignedBuffer<512, 64> local_buffer;
-  LinearAllocator<> linear_allocator;
-  linear_allocator.provide_buffer(local_buffer);
+  if (tile_size_ == 0 || full_mask.size() <= tile_size_) {
+    AlignedBuffer<512, 64> local_buffer;
+    LinearAllocator<> linear_allocator;
+    linear_allocator.provide_buffer(local_buffer);
+    ValueAllocator value_allocator{linear_allocator};
+    this->execute(full_mask, params, context, value_allocator);
+    return;
+  }
+
+  /* Evaluate the whole procedure for every tile of indices separately. That way the intermediate
+   * buffers are small enough to stay in the CPU cache, and they are reused for the next tile
+   * instead of allocating buffers for the entire mask. Tiles are ranges of indices rather than
+   * parts of the mask, so that the buffers always have at most the tile size. */
+  const int64_t first_index = full_mask[0];
+  const int64_t tiles_num = (full_mask.last() - first_index + tile_size_) / tile_size_;
+  threading::parallel_for(IndexRange(tiles_num), 8, [&](const IndexRange tiles) {
+    AlignedBuffer<512, 64> local_buffer;
+    LinearAllocator<> linear_allocator;
+    linear_allocator.provide_buffer(local_buffer);
+    ValueAllocator value_allocator{linear_allocator, int(tile_size_)};
+    Vector<int64_t> offset_mask_indices;
+    for (const int64_t tile : tiles) {
+      const IndexRange tile_range(first_index + tile * tile_size_, tile_size_);
+      const IndexRange mask_slice = mask_slice_in_range(full_mask, tile_range);
+      if (mask_slice.is_empty()) {
+        continue;
+      }
+      const IndexMask tile_mask = full_mask.slice_and_offset(mask_slice, offset_mask_indices);
+      const IndexRange params_slice(full_mask[mask_slice.first()], tile_mask.min_array_size());
+      MFParamsBuilder tile_params{*this, tile_mask.min_array_size()};
+      add_sliced_params(*this, params, params_slice, tile_params);
+      this->execute(tile_mask, tile_params, context, value_allocator);
+    }
+  });
+}
 
-  VariableStates variable_states{linear_allocator, procedure_, full_mask};
+void MFProcedureExecutor::execute(IndexMask full_mask,
+                                  MFParams params,
+                                  MFContext context,
+                                  ValueAllocator &value_allocator) const
+{
+  VariableStates variable_states{value_allocator, procedure_, full_mask};
   variable_states.add_initial_variable_states(*this, procedure_, params);
 
   InstructionScheduler scheduler;
@@ -1260,7 +1388,8 @@ void MFProcedureExecutor::call(IndexMask full_mask, MFParams params, MFContext c
 MultiFunction::ExecutionHints MFProcedureExecutor::get_execution_hints() const
 {
   ExecutionHints hints;
-  hints.allocates_array = true;
+  /* With tiles, the size of the allocated buffers doesn't depend on the size of the mask. */
+  hints.allocates_array = tile_size_ == 0;
   hints.min_grain_size = 10000;
   return hints;
 }
@@ -289,4 +289,124 @@ TEST(field, IgnoredOutput)
   EXPECT_EQ(results.get(3), 5);
 }
 
+/** Count the calls to functions with the given name in a procedure exported to dot. */
+static int count_calls(const std::string &dot, const std::string &name)
+{
+  const std::string label = name + ": ";
+  int count = 0;
+  for (size_t i = dot.find(label); i != std::string::npos; i = dot.find(label, i + 1)) {
+    count++;
+  }
+  return count;
+}
+
+TEST(field, MergeEqualOperations)
+{
+  GField index_field{std::make_shared<IndexFieldInput>()};
+
+  int calls_num = 0;
+  CustomMF_SI_SI_SO<int, int, int> add_fn{"add", [&](int a, int b) {
+                                            calls_num++;
+                                            return a + b;
+                                          }};
+  /* Two separate but equal operations, using separate but equal constants. */
+  const int ten = 10;
+  GField add_field_1{std::make_shared<FieldOperation>(
+      add_fn, Vector<GField>{index_field, make_constant_field(CPPType::get<int>(), &ten)})};
+  GField add_field_2{std::make_shared<FieldOperation>(
+      add_fn, Vector<GField>{index_field, make_constant_field(CPPType::get<int>(), &ten)})};
+
+  static TwoOutputFunction two_outputs_fn;
+  GField add_10_field{
+      std::make_shared<FieldOperation>(two_outputs_fn, Vector<GField>{add_field_1, add_field_2}),
+      1};
+  GField add_field_3{
+      std::make_shared<FieldOperation>(two_outputs_fn, Vector<GField>{add_field_2, add_field_1}),
+      0};
+
+  FieldContext context;
+  ResourceScope scope;
+  Vector<GVArray> results = evaluate_fields(
+      scope, {add_10_field, add_field_3}, IndexRange(4), context);
+  EXPECT_EQ(calls_num, 4);
+  EXPECT_EQ(results[0].typed<int>().get(3), 36);
+  EXPECT_EQ(results[1].typed<int>().get(3), 26);
+
+  const std::string optimized = field_procedure_to_dot({add_10_field, add_field_3});
+  const std::string unoptimized = field_procedure_to_dot({add_10_field, add_field_3}, false);
+  EXPECT_EQ(count_calls(optimized, "add"), 1);
+  EXPECT_EQ(count_calls(unoptimized, "add"), 2);
+  EXPECT_EQ(count_calls(optimized, "Two Outputs"), 1);
+  EXPECT_EQ(count_calls(optimized, "Constant"), 1);
+}
+
+TEST(field, FoldConstantOperations)
+{
+  GField index_field{std::make_shared<IndexFieldInput>()};
+
+  int calls_num = 0;
+  CustomMF_SI_SO<int, int> double_fn{"double", [&](int a) {
+                                       calls_num++;
+                                       return a * 2;
+                                     }};
+  const int value = 5;
+  GField constant_field{std::make_shared<FieldOperation>(
+      double_fn, Vector<GField>{make_constant_field(CPPType::get<int>(), &value)})};
+
+  CustomMF_SI_SI_SO<int, int, int> add_fn{"add", [](int a, int b) { return a + b; }};
+  GField add_field{
+      std::make_shared<FieldOperation>(add_fn, Vector<GField>{index_field, constant_field})};
+
+  FieldContext context;
+  ResourceScope scope;
+  Vector<GVArray> results = evaluate_fields(scope, {add_field}, IndexRange(4), context);
+  EXPECT_EQ(calls_num, 1);
+  EXPECT_EQ(results[0].typed<int>().get(3), 13);
+
+  /* The constant operation is evaluated while building the procedure. */
+  EXPECT_EQ(count_calls(field_procedure_to_dot({add_field}), "double"), 0);
+  EXPECT_EQ(count_calls(field_procedure_to_dot({add_field}, false), "double"), 1);
+}
+
+TEST(field, FuseElementWiseOperations)
+{
+  GField index_field{std::make_shared<IndexFieldInput>()};
+
+  CustomMF_SI_SI_SO<int, int, int> add_fn{"add", [](int a, int b) { return a + b; }};
+  CustomMF_SI_SO<int, int> double_fn{"double", [](int a) { return a * 2; }};
+  const int ten = 10;
+  GField add_field{std::make_shared<FieldOperation>(
+      add_fn, Vector<GField>{index_field, make_constant_field(CPPType::get<int>(), &ten)})};
+  GField double_field{std::make_shared<FieldOperation>(double_fn, Vector<GField>{add_field})};
+  /* The same intermediate value is passed to both inputs. */
+  GField sum_field{
+      std::make_shared<FieldOperation>(add_fn, Vector<GField>{double_field, double_field})};
+
+  /* Use a mask that is contiguous in the first chunk only. */
+  Vector<int64_t> indices;
+  for (int64_t i = 0; i < 100; i++) {
+    indices.append(i);
+  }
+  for (int64_t i = 101; i < 300; i += 2) {
+    indices.append(i);
+  }
+
+  FieldContext context;
+  ResourceScope scope;
+  Vector<GVArray> results = evaluate_fields(scope, {sum_field}, indices.as_span(), context);
+  for (const int64_t i : indices) {
+    EXPECT_EQ(results[0].typed<int>().get(i), (i + 10) * 4);
+  }
+
+  const std::string fused = field_procedure_to_dot({sum_field});
+  EXPECT_EQ(count_calls(fused, "Fused(add, double, add)"), 1);
+  EXPECT_EQ(count_calls(fused, "add"), 0);
+  EXPECT_EQ(count_calls(field_procedure_to_dot({sum_field}, false), "add"), 2);
+
+  /* Intermediate values that are used elsewhere are not fused. */
+  const std::string partially_fused = field_procedure_to_dot({sum_field, add_field});
+  EXPECT_EQ(count_calls(partially_fused, "Fused(double, add)"), 1);
+  EXPECT_EQ(count_calls(partially_fused, "add"), 1);
+}
+
 }  // namespace blender::fn::tests
@@ -68,6 +68,44 @@ class SimpleSideEffectProvider : public GraphExecutor::SideEffectProvider {
   }
 };
 
+class RecordExecutionFunction : public LazyFunction {
+ private:
+  std::string name_;
+  Vector<std::string> *r_executed_names_;
+
+ public:
+  RecordExecutionFunction(std::string name, Vector<std::string> *r_executed_names)
+      : name_(std::move(name)), r_executed_names_(r_executed_names)
+  {
+    debug_name_ = "Record Execution";
+    inputs_.append({"A", CPPType::get<int>()});
+    outputs_.append({"Result", CPPType::get<int>()});
+  }
+
+  void execute_impl(Params &params, const Context &UNUSED(context)) const override
+  {
+    r_executed_names_->append(name_);
+    params.set_output(0, params.get_input<int>(0));
+  }
+};
+
+class SimpleNodeCostProvider : public GraphExecutor::NodeCostProvider {
+ private:
+  Map<const FunctionNode *, std::chrono::nanoseconds> costs_;
+
+ public:
+  SimpleNodeCostProvider(Map<const FunctionNode *, std::chrono::nanoseconds> costs)
+      : costs_(std::move(costs))
+  {
+  }
+
+  std::chrono::nanoseconds get_node_cost(const FunctionNode &node,
+                                         const Context &UNUSED(context)) const override
+  {
+    return costs_.lookup_default(&node, std::chrono::nanoseconds(0));
+  }
+};
+
 TEST(lazy_function, SimpleAdd)
 {
   const AddLazyFunction add_fn;
@@ -105,11 +143,68 @@ TEST(lazy_function, SideEffects)
 
   SimpleSideEffectProvider side_effect_provider{{&store_node}};
 
-  GraphExecutor executor_fn{graph, {&input_node.output(0)}, {}, nullptr, &side_effect_provider};
+  GraphExecutor executor_fn{
+      graph, {&input_node.output(0)}, {}, nullptr, &side_effect_provider, nullptr};
   execute_lazy_function_eagerly(executor_fn, nullptr, std::make_tuple(5), std::make_tuple());
 
   EXPECT_EQ(dst1, 15);
   EXPECT_EQ(dst2, 105);
 }
 
+TEST(lazy_function, CriticalPathFirst)
+{
+  BLI_task_scheduler_init();
+  Vector<std::string> executed_names;
+  const RecordExecutionFunction fn_a{"A", &executed_names};
+  const RecordExecutionFunction fn_b{"B", &executed_names};
+  const RecordExecutionFunction fn_c{"C", &executed_names};
+
+  /* Node A is followed by node C, which is expensive. Node B does not have an estimate. */
+  Graph graph;
+  DummyNode &input_node = graph.add_dummy({}, {&CPPType::get<int>()});
+  FunctionNode &node_a = graph.add_function(fn_a);
+  FunctionNode &node_b = graph.add_function(fn_b);
+  FunctionNode &node_c = graph.add_function(fn_c);
+  DummyNode &output_node = graph.add_dummy({&CPPType::get<int>(), &CPPType::get<int>()}, {});
+
+  graph.add_link(input_node.output(0), node_a.input(0));
+  graph.add_link(input_node.output(0), node_b.input(0));
+  graph.add_link(node_a.output(0), node_c.input(0));
+  graph.add_link(node_c.output(0), output_node.input(0));
+  graph.add_link(node_b.output(0), output_node.input(1));
+  graph.update_node_indices();
+
+  const Vector<const OutputSocket *> graph_inputs{&input_node.output(0)};
+  const Vector<const InputSocket *> graph_outputs{&output_node.input(0), &output_node.input(1)};
+
+  {
+    /* Without estimates, the node that was scheduled last runs first. */
+    GraphExecutor executor_fn{graph, graph_inputs, graph_outputs, nullptr, nullptr, nullptr};
+    int result_1 = 0;
+    int result_2 = 0;
+    execute_lazy_function_eagerly(
+        executor_fn, nullptr, std::make_tuple(3), std::make_tuple(&result_1, &result_2));
+    EXPECT_EQ(result_1, 3);
+    EXPECT_EQ(result_2, 3);
+    EXPECT_EQ(executed_names.as_span(), Span<std::string>({"B", "A", "C"}));
+  }
+
+  executed_names.clear();
+  {
+    Map<const FunctionNode *, std::chrono::nanoseconds> costs;
+    costs.add(&node_a, std::chrono::microseconds(10));
+    costs.add(&node_c, std::chrono::microseconds(100));
+    const SimpleNodeCostProvider cost_provider{std::move(costs)};
+    GraphExecutor executor_fn{
+        graph, graph_inputs, graph_outputs, nullptr, nullptr, &cost_provider};
+    int result_1 = 0;
+    int result_2 = 0;
+    execute_lazy_function_eagerly(
+        executor_fn, nullptr, std::make_tuple(3), std::make_tuple(&result_1, &result_2));
+    EXPECT_EQ(result_1, 3);
+    EXPECT_EQ(result_2, 3);
+    EXPECT_EQ(executed_names.as_span(), Span<std::string>({"A", "C", "B"}));
+  }
+}
+
 }  // namespace blender::fn::lazy_function::tests
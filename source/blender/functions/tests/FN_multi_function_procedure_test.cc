@@ -92,6 +92,72 @@ TEST(multi_function_procedure, SimpleTest)
   EXPECT_EQ(output_array[2], 19);
 }
 
+TEST(multi_function_procedure, Tiles)
+{
+  /**
+   * procedure(int var1, int var2, int *var4) {
+   *   int var3 = var1 + var2;
+   *   var4 = var1 + var3;
+   * }
+   */
+
+  CustomMF_SI_SI_SO<int, int, int> add_fn{"add", [](int a, int b) { return a + b; }};
+
+  MFProcedure procedure;
+  MFProcedureBuilder builder{procedure};
+
+  MFVariable *var1 = &builder.add_single_input_parameter<int>();
+  MFVariable *var2 = &builder.add_single_input_parameter<int>();
+  auto [var3] = builder.add_call<1>(add_fn, {var1, var2});
+  auto [var4] = builder.add_call<1>(add_fn, {var1, var3});
+  builder.add_destruct({var1, var2, var3});
+  builder.add_return();
+  builder.add_output_parameter(*var4);
+
+  EXPECT_TRUE(procedure.validate());
+
+  /* A mask with a dense part, a sparse part and a gap that is larger than a tile. */
+  const int size = 100000;
+  Vector<int64_t> indices;
+  for (const int i : IndexRange(size)) {
+    if (i < 30000 || (i >= 60000 && i % 3 == 0)) {
+      indices.append(i);
+    }
+  }
+  const IndexMask mask{indices};
+
+  Array<int> input_array(size);
+  for (const int i : IndexRange(size)) {
+    input_array[i] = i;
+  }
+
+  for (const bool use_tiles : {false, true}) {
+    MFProcedureExecutor executor{procedure, use_tiles};
+
+    MFParamsBuilder params{executor, &mask};
+    MFContextBuilder context;
+    params.add_readonly_single_input(input_array.as_span());
+    params.add_readonly_single_input_value(3);
+    Array<int> output_array(size, -1);
+    params.add_uninitialized_single_output(output_array.as_mutable_span());
+
+    executor.call_auto(mask, params, context);
+
+    EXPECT_EQ(output_array[0], 3);
+    EXPECT_EQ(output_array[29999], 29999 * 2 + 3);
+    EXPECT_EQ(output_array[30000], -1);
+    EXPECT_EQ(output_array[60000], 60000 * 2 + 3);
+    EXPECT_EQ(output_array[60001], -1);
+    EXPECT_EQ(output_array[99999], 99999 * 2 + 3);
+    for (const int64_t i : mask) {
+      if (output_array[i] != i * 2 + 3) {
+        ADD_FAILURE() << "Wrong value at index " << i;
+        break;
+      }
+    }
+  }
+}
+
 TEST(multi_function_procedure, BranchTest)
 {
   /**
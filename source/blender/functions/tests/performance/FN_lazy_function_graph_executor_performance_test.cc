@@ -0,0 +1,142 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <mutex>
+
+#include "testing/testing.h"
+
+#include "BLI_map.hh"
+#include "BLI_task.h"
+#include "BLI_timeit.hh"
+
+#include "FN_lazy_function_execute.hh"
+#include "FN_lazy_function_graph.hh"
+#include "FN_lazy_function_graph_executor.hh"
+
+namespace blender::fn::lazy_function::tests {
+
+/* A wide graph with one long branch of expensive nodes, similar to a node tree where a boolean
+ * feeds a large realize instances node while many cheaper operations are done on the side. Compare
+ * the evaluation without cost estimates with one that uses the run times of the first evaluation
+ * to schedule the long branch first. */
+
+static constexpr int chain_length = 8;
+static constexpr int side_branches_num = 8;
+static constexpr std::chrono::milliseconds node_work_time{4};
+
+/** Simulates an expensive node that does not hint that it takes a while. */
+class BusyLazyFunction : public LazyFunction {
+ public:
+  BusyLazyFunction()
+  {
+    debug_name_ = "Busy";
+    inputs_.append({"A", CPPType::get<int>()});
+    outputs_.append({"Result", CPPType::get<int>()});
+  }
+
+  void execute_impl(Params &params, const Context &UNUSED(context)) const override
+  {
+    const int value = params.get_input<int>(0);
+    const auto end_time = std::chrono::steady_clock::now() + node_work_time;
+    while (std::chrono::steady_clock::now() < end_time) {
+    }
+    params.set_output(0, value + 1);
+  }
+};
+
+/** Remembers the run time of every node, which is used as estimate in the next evaluation. */
+class RunTimeLogger : public GraphExecutor::Logger, public GraphExecutor::NodeCostProvider {
+ private:
+  using Clock = std::chrono::steady_clock;
+  mutable std::mutex mutex_;
+  mutable Map<const FunctionNode *, Clock::time_point> start_times_;
+  mutable Map<const FunctionNode *, std::chrono::nanoseconds> run_times_;
+
+ public:
+  void log_before_node_execute(const FunctionNode &node,
+                               const Params &UNUSED(params),
+                               const Context &UNUSED(context)) const override
+  {
+    std::lock_guard lock{mutex_};
+    start_times_.add_overwrite(&node, Clock::now());
+  }
+
+  void log_after_node_execute(const FunctionNode &node,
+                              const Params &UNUSED(params),
+                              const Context &UNUSED(context)) const override
+  {
+    std::lock_guard lock{mutex_};
+    run_times_.add_overwrite(&node, Clock::now() - start_times_.lookup(&node));
+  }
+
+  std::chrono::nanoseconds get_node_cost(const FunctionNode &node,
+                                         const Context &UNUSED(context)) const override
+  {
+    std::lock_guard lock{mutex_};
+    return run_times_.lookup_default(&node, std::chrono::nanoseconds(0));
+  }
+};
+
+TEST(lazy_function_graph_executor_performance, LongBranch)
+{
+  BLI_task_scheduler_init();
+  const BusyLazyFunction busy_fn;
+
+  Graph graph;
+  DummyNode &input_node = graph.add_dummy({}, {&CPPType::get<int>()});
+  Vector<const CPPType *> output_types(side_branches_num + 1, &CPPType::get<int>());
+  DummyNode &output_node = graph.add_dummy(output_types, {});
+
+  const OutputSocket *previous_socket = &input_node.output(0);
+  for ([[maybe_unused]] const int i : IndexRange(chain_length)) {
+    FunctionNode &node = graph.add_function(busy_fn);
+    graph.add_link(const_cast<OutputSocket &>(*previous_socket), node.input(0));
+    previous_socket = &node.output(0);
+  }
+  graph.add_link(const_cast<OutputSocket &>(*previous_socket), output_node.input(0));
+  for (const int i : IndexRange(side_branches_num)) {
+    FunctionNode &node = graph.add_function(busy_fn);
+    graph.add_link(input_node.output(0), node.input(0));
+    graph.add_link(node.output(0), output_node.input(i + 1));
+  }
+  graph.update_node_indices();
+
+  const Vector<const OutputSocket *> graph_inputs{&input_node.output(0)};
+  Vector<const InputSocket *> graph_outputs;
+  for (const InputSocket *socket : output_node.inputs()) {
+    graph_outputs.append(socket);
+  }
+
+  RunTimeLogger logger;
+  for (const bool use_estimates : {false, true}) {
+    GraphExecutor executor_fn{
+        graph, graph_inputs, graph_outputs, &logger, nullptr, use_estimates ? &logger : nullptr};
+    int chain_result = 0;
+    Array<int> side_results(side_branches_num, 0);
+    Vector<GMutablePointer> outputs{&chain_result};
+    for (int &result : side_results) {
+      outputs.append(&result);
+    }
+    int input = 0;
+    Vector<GMutablePointer> inputs{&input};
+    Array<std::optional<ValueUsage>> input_usages(1);
+    Array<ValueUsage> output_usages(outputs.size(), ValueUsage::Used);
+    Array<bool> set_outputs(outputs.size(), false);
+
+    LinearAllocator<> allocator;
+    Context context;
+    context.storage = executor_fn.init_storage(allocator);
+    BasicParams params{executor_fn, inputs, outputs, input_usages, output_usages, set_outputs};
+    {
+      SCOPED_TIMER(use_estimates ? "Critical path first" : "Without estimates");
+      executor_fn.execute(params, context);
+    }
+    executor_fn.destruct_storage(context.storage);
+
+    EXPECT_EQ(chain_result, chain_length);
+    for (const int result : side_results) {
+      EXPECT_EQ(result, 1);
+    }
+  }
+}
+
+}  // namespace blender::fn::lazy_function::tests
@@ -0,0 +1,114 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <iostream>
+
+#include "testing/testing.h"
+
+#include "BLI_array.hh"
+#include "BLI_math_vec_types.hh"
+#include "BLI_math_vector.hh"
+#include "BLI_timeit.hh"
+
+#include "FN_multi_function_builder.hh"
+
+namespace blender::fn::tests {
+
+/* Common float and float3 math functions built with different presets, evaluated for inputs that
+ * are spans, single values or derived virtual arrays. Derived arrays can't be devirtualized, so
+ * they show the cost of the fallback. */
+
+static constexpr int64_t size = 1000000;
+static constexpr int repetitions_num = 20;
+
+enum class InputKind {
+  Span,
+  Single,
+  Derived,
+};
+
+static const char *input_kind_name(const InputKind kind)
+{
+  switch (kind) {
+    case InputKind::Span:
+      return "Span";
+    case InputKind::Single:
+      return "Single";
+    case InputKind::Derived:
+      return "Derived";
+  }
+  return "";
+}
+
+template<typename T> static GVArray make_input(const InputKind kind, const Span<T> values)
+{
+  switch (kind) {
+    case InputKind::Span:
+      return VArray<T>::ForSpan(values);
+    case InputKind::Single:
+      return VArray<T>::ForSingle(values[0], values.size());
+    case InputKind::Derived:
+      return VArray<T>::ForFunc(values.size(), [values](const int64_t i) { return values[i]; });
+  }
+  return {};
+}
+
+template<typename T, typename Fn>
+static void benchmark_presets(const char *name, const Span<T> a, const Span<T> b, const Fn &fn)
+{
+  const CustomMF_SI_SI_SO<T, T, T> simple_fn{name, fn, CustomMF_presets::Simple()};
+  const CustomMF_SI_SI_SO<T, T, T> materialized_fn{name, fn, CustomMF_presets::Materialized()};
+  const CustomMF_SI_SI_SO<T, T, T> auto_fn{name, fn, CustomMF_presets::AutoSpanOrSingle()};
+  const std::pair<const char *, const MultiFunction *> functions[] = {
+      {"Simple", &simple_fn}, {"Materialized", &materialized_fn}, {"Auto", &auto_fn}};
+
+  Array<T> result(size);
+  for (const InputKind kind_a : {InputKind::Span, InputKind::Derived}) {
+    for (const InputKind kind_b : {InputKind::Span, InputKind::Single, InputKind::Derived}) {
+      const GVArray input_a = make_input(kind_a, a);
+      const GVArray input_b = make_input(kind_b, b);
+      std::cout << name << " (" << input_kind_name(kind_a) << ", " << input_kind_name(kind_b)
+                << "):\n";
+      for (const auto &[preset_name, function] : functions) {
+        MFParamsBuilder params{*function, size};
+        params.add_readonly_single_input(input_a);
+        params.add_readonly_single_input(input_b);
+        params.add_uninitialized_single_output(result.as_mutable_span());
+        MFContextBuilder context;
+        SCOPED_TIMER(std::string("  ") + preset_name);
+        for ([[maybe_unused]] const int i : IndexRange(repetitions_num)) {
+          function->call(IndexRange(size), params, context);
+        }
+      }
+    }
+  }
+}
+
+TEST(multi_function_builder_performance, FloatMath)
+{
+  Array<float> a(size);
+  Array<float> b(size);
+  for (const int64_t i : IndexRange(size)) {
+    a[i] = float(i % 1000);
+    b[i] = float(i % 77) + 1.0f;
+  }
+  benchmark_presets<float>("Add", a, b, [](float a, float b) { return a + b; });
+  benchmark_presets<float>("Multiply Add", a, b, [](float a, float b) { return a * b + a; });
+  benchmark_presets<float>("Divide", a, b, [](float a, float b) { return a / b; });
+}
+
+TEST(multi_function_builder_performance, Float3Math)
+{
+  Array<float3> a(size);
+  Array<float3> b(size);
+  for (const int64_t i : IndexRange(size)) {
+    a[i] = float3(float(i % 1000), 1.0f, 2.0f);
+    b[i] = float3(1.0f, float(i % 77), 3.0f);
+  }
+  benchmark_presets<float3>("Add", a, b, [](float3 a, float3 b) { return a + b; });
+  benchmark_presets<float3>(
+      "Cross Product", a, b, [](float3 a, float3 b) { return math::cross(a, b); });
+  benchmark_presets<float3>(
+      "Normalize Sum", a, b, [](float3 a, float3 b) { return math::normalize(a + b); });
+}
+
+}  // namespace blender::fn::tests
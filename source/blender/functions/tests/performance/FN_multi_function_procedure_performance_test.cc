@@ -0,0 +1,85 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <iostream>
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_array.hh"
+#include "BLI_timeit.hh"
+
+#include "FN_multi_function_builder.hh"
+#include "FN_multi_function_procedure_builder.hh"
+#include "FN_multi_function_procedure_executor.hh"
+#include "FN_multi_function_procedure_optimization.hh"
+
+namespace blender::fn::tests {
+
+/* A chain of simple math operations evaluated for many indices, which is limited by memory
+ * bandwidth when every intermediate array is as large as the mask. Compare evaluating the whole
+ * mask at once with evaluating it in tiles that reuse small buffers. */
+
+static constexpr int64_t size = 10000000;
+static constexpr int chain_length = 20;
+
+TEST(multi_function_procedure_performance, MathChain)
+{
+  CustomMF_SI_SI_SO<float, float, float> add_fn{"add", [](float a, float b) { return a + b; }};
+  CustomMF_SI_SI_SO<float, float, float> mul_fn{"mul", [](float a, float b) { return a * b; }};
+
+  /**
+   * procedure(float var_in, float *var_out) {
+   *   var_1 = var_in * var_in;
+   *   var_2 = var_1 + var_in;
+   *   ...
+   * }
+   */
+  MFProcedure procedure;
+  MFProcedureBuilder builder{procedure};
+  MFVariable *input = &builder.add_single_input_parameter<float>();
+  MFVariable *previous = input;
+  for (const int i : IndexRange(chain_length)) {
+    const MultiFunction &fn = (i % 2 == 0) ? mul_fn : add_fn;
+    MFVariable *next = builder.add_call<1>(fn, {previous, input})[0];
+    if (previous != input) {
+      builder.add_destruct(*previous);
+    }
+    previous = next;
+  }
+  builder.add_destruct(*input);
+  MFReturnInstruction &return_instr = builder.add_return();
+  builder.add_output_parameter(*previous);
+  procedure_optimization::move_destructs_up(procedure, return_instr);
+  EXPECT_TRUE(procedure.validate());
+
+  Array<float> input_values(size);
+  for (const int64_t i : input_values.index_range()) {
+    input_values[i] = float(i % 100) / 100.0f;
+  }
+  Array<float> result_full(size);
+  Array<float> result_tiles(size);
+
+  for (const bool use_tiles : {false, true}) {
+    MFProcedureExecutor executor{procedure, use_tiles};
+    MutableSpan<float> result = use_tiles ? result_tiles : result_full;
+
+    MFParamsBuilder params{executor, size};
+    MFContextBuilder context;
+    params.add_readonly_single_input(input_values.as_span());
+    params.add_uninitialized_single_output(result);
+
+    const size_t memory_before = MEM_get_memory_in_use();
+    MEM_reset_peak_memory();
+    {
+      SCOPED_TIMER(use_tiles ? "Tiles" : "Full Arrays");
+      executor.call_auto(IndexRange(size), params, context);
+    }
+    std::cout << "  Peak memory of intermediate buffers: "
+              << (MEM_get_peak_memory() - memory_before) / 1024 << " KiB\n";
+  }
+
+  EXPECT_EQ(result_full.as_span(), result_tiles.as_span());
+}
+
+}  // namespace blender::fn::tests
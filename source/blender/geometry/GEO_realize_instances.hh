@@ -33,4 +33,40 @@ struct RealizeInstancesOptions {
  */
 GeometrySet realize_instances(GeometrySet geometry_set, const RealizeInstancesOptions &options);
 
+/**
+ * Gives access to the attributes that #realize_instances would create, without building the
+ * realized geometry. Creating it only gathers the offsets and transforms of all instances.
+ * Attribute values are read from the instanced geometries when they are accessed, so only the
+ * data that is actually used is transformed and copied. That is much cheaper when e.g. only the
+ * positions of many instances of the same geometry are needed.
+ */
+class LazyRealizedInstances : NonCopyable, NonMovable {
+ private:
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+
+ public:
+  LazyRealizedInstances(GeometrySet geometry_set, const RealizeInstancesOptions &options);
+  ~LazyRealizedInstances();
+
+  /** Number of elements in a domain of the realized geometry of the given type. */
+  int domain_size(GeometryComponentType component_type, eAttrDomain domain) const;
+
+  /**
+   * Get a virtual array for an attribute of the realized geometry of the given type, which reads
+   * the values from the instanced geometries when it is accessed. Positions, ids, material
+   * indices, the built-in curve attributes and all attributes that are propagated generically
+   * are supported. The virtual array references this object, so it must not outlive it.
+   * \return An empty virtual array if the attribute is not supported or would not exist.
+   */
+  GVArray lookup(GeometryComponentType component_type,
+                 const bke::AttributeIDRef &attribute_id) const;
+
+  /**
+   * Build the realized geometry, the same as #realize_instances. Generic attributes are filled
+   * from the virtual arrays returned by #lookup.
+   */
+  GeometrySet realize() const;
+};
+
 }  // namespace blender::geometry
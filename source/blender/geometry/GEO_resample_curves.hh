@@ -21,21 +21,28 @@ struct ResampleCurvesOutputAttributeIDs {
  * samples defined by the count field. Interpolate attributes to the result, with an accuracy that
  * depends on the curve's resolution parameter.
  *
+ * \param use_precise_lengths: Space the samples with the lengths along the exact curve (see
+ * #CurvesGeometry::evaluated_lengths_precise_for_curve), rather than with the lengths along the
+ * evaluated points, which depend on the resolution.
+ *
  * \note The values provided by the #count_field are clamped to 1 or greater.
  */
 CurvesGeometry resample_to_count(const CurvesGeometry &src_curves,
                                  const fn::Field<bool> &selection_field,
                                  const fn::Field<int> &count_field,
+                                 bool use_precise_lengths = false,
                                  const ResampleCurvesOutputAttributeIDs &output_ids = {});
 
 /**
  * Create new curves resampled to make each segment have the length specified by the
  * #segment_length field input, rounded to make the length of each segment the same.
- * The accuracy will depend on the curve's resolution parameter.
+ * The accuracy will depend on the curve's resolution parameter, unless
+ * \a use_precise_lengths is true.
  */
 CurvesGeometry resample_to_length(const CurvesGeometry &src_curves,
                                   const fn::Field<bool> &selection_field,
                                   const fn::Field<float> &segment_length_field,
+                                  bool use_precise_lengths = false,
                                   const ResampleCurvesOutputAttributeIDs &output_ids = {});
 
 /**
@@ -27,10 +27,13 @@ bke::CurvesGeometry trim_curves(const bke::CurvesGeometry &src_curves,
  * \param lengths: Distance along the curve on form [0.0, length] to determine the point for.
  * \param curve_indices: Curve index to lookup for each 'length', negative index are set to 0.
  * \param is_normalized: If true, 'lengths' are normalized to the interval [0.0, 1.0].
+ * \param use_precise_lengths: Measure lengths along the exact curve, see
+ * #CurvesGeometry::evaluated_lengths_precise_for_curve.
  */
 Array<bke::curves::CurvePoint, 12> lookup_curve_points(const bke::CurvesGeometry &curves,
                                                        Span<float> lengths,
                                                        Span<int64_t> curve_indices,
-                                                       bool is_normalized);
+                                                       bool is_normalized,
+                                                       bool use_precise_lengths = false);
 
 }  // namespace blender::geometry
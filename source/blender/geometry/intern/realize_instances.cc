@@ -12,7 +12,9 @@
 #include "BLI_devirtualize_parameters.hh"
 #include "BLI_noise.hh"
 #include "BLI_task.hh"
+#include "BLI_tracing.hh"
 
+#include "BKE_attribute_math.hh"
 #include "BKE_collection.h"
 #include "BKE_curves.hh"
 #include "BKE_deform.h"
@@ -277,47 +279,23 @@ static void copy_transformed_positions(const Span<float3> src,
   });
 }
 
-static void threaded_copy(const GSpan src, GMutableSpan dst)
-{
-  BLI_assert(src.size() == dst.size());
-  BLI_assert(src.type() == dst.type());
-  threading::parallel_for(IndexRange(src.size()), 1024, [&](const IndexRange range) {
-    src.type().copy_construct_n(src.slice(range).data(), dst.slice(range).data(), range.size());
-  });
-}
-
-static void threaded_fill(const GPointer value, GMutableSpan dst)
-{
-  BLI_assert(*value.type() == dst.type());
-  threading::parallel_for(IndexRange(dst.size()), 1024, [&](const IndexRange range) {
-    value.type()->fill_construct_n(value.get(), dst.slice(range).data(), range.size());
-  });
-}
-
+/**
+ * Fill the generic attributes of the realized geometry from the virtual arrays returned by
+ * #LazyRealizedInstances::lookup, so that realizing everything and accessing single attributes
+ * lazily share the same code.
+ */
 static void copy_generic_attributes_to_result(
-    const Span<std::optional<GVArraySpan>> src_attributes,
-    const AttributeFallbacksArray &attribute_fallbacks,
     const OrderedAttributes &ordered_attributes,
-    const FunctionRef<IndexRange(eAttrDomain)> &range_fn,
+    const FunctionRef<GVArray(const AttributeIDRef &)> lookup_fn,
     MutableSpan<GSpanAttributeWriter> dst_attribute_writers)
 {
   threading::parallel_for(
-      dst_attribute_writers.index_range(), 10, [&](const IndexRange attribute_range) {
+      dst_attribute_writers.index_range(), 1, [&](const IndexRange attribute_range) {
         for (const int attribute_index : attribute_range) {
-          const eAttrDomain domain = ordered_attributes.kinds[attribute_index].domain;
-          const IndexRange element_slice = range_fn(domain);
-
-          GMutableSpan dst_span = dst_attribute_writers[attribute_index].span.slice(element_slice);
-          if (src_attributes[attribute_index].has_value()) {
-            threaded_copy(*src_attributes[attribute_index], dst_span);
-          }
-          else {
-            const CPPType &cpp_type = dst_span.type();
-            const void *fallback = attribute_fallbacks.array[attribute_index] == nullptr ?
-                                       cpp_type.default_value() :
-                                       attribute_fallbacks.array[attribute_index];
-            threaded_fill({cpp_type, fallback}, dst_span);
-          }
+          const GVArray src = lookup_fn(ordered_attributes.ids[attribute_index]);
+          GMutableSpan dst_span = dst_attribute_writers[attribute_index].span;
+          BLI_assert(src.size() == dst_span.size());
+          src.materialize(dst_span.data());
         }
       });
 }
@@ -449,6 +427,11 @@ static void foreach_geometry_in_reference(
   }
 }
 
+/**
+ * This doesn't use #InstancesComponent::flattened_instances, because every realized instance needs
+ * the attribute values and the id of the instances at all nesting levels it is contained in. The
+ * flattened instances only keep the combined transforms.
+ */
 static void gather_realize_tasks_for_instances(GatherTasksInfo &gather_info,
                                                const InstancesComponent &instances_component,
                                                const float4x4 &base_transform,
@@ -695,8 +678,6 @@ static AllPointCloudsInfo preprocess_pointclouds(const GeometrySet &geometry_set
 static void execute_realize_pointcloud_task(
     const RealizeInstancesOptions &options,
     const RealizePointCloudTask &task,
-    const OrderedAttributes &ordered_attributes,
-    MutableSpan<GSpanAttributeWriter> dst_attribute_writers,
     MutableSpan<int> all_dst_ids,
     MutableSpan<float3> all_dst_positions)
 {
@@ -712,23 +693,14 @@ static void execute_realize_pointcloud_task(
     create_result_ids(
         options, pointcloud_info.stored_ids, task.id, all_dst_ids.slice(point_slice));
   }
-
-  copy_generic_attributes_to_result(
-      pointcloud_info.attributes,
-      task.attribute_fallbacks,
-      ordered_attributes,
-      [&](const eAttrDomain domain) {
-        BLI_assert(domain == ATTR_DOMAIN_POINT);
-        UNUSED_VARS_NDEBUG(domain);
-        return point_slice;
-      },
-      dst_attribute_writers);
 }
 
 static void execute_realize_pointcloud_tasks(const RealizeInstancesOptions &options,
                                              const AllPointCloudsInfo &all_pointclouds_info,
                                              const Span<RealizePointCloudTask> tasks,
                                              const OrderedAttributes &ordered_attributes,
+                                             const FunctionRef<GVArray(const AttributeIDRef &)>
+                                                 lookup_fn,
                                              GeometrySet &r_realized_geometry)
 {
   if (tasks.is_empty()) {
@@ -770,12 +742,11 @@ static void execute_realize_pointcloud_tasks(const RealizeInstancesOptions &opti
       const RealizePointCloudTask &task = tasks[task_index];
       execute_realize_pointcloud_task(options,
                                       task,
-                                      ordered_attributes,
-                                      dst_attribute_writers,
                                       point_ids.span,
                                       positions.span);
     }
   });
+  copy_generic_attributes_to_result(ordered_attributes, lookup_fn, dst_attribute_writers);
 
   /* Tag modified attributes. */
   for (GSpanAttributeWriter &dst_attribute : dst_attribute_writers) {
@@ -907,8 +878,6 @@ static AllMeshesInfo preprocess_meshes(const GeometrySet &geometry_set,
 
 static void execute_realize_mesh_task(const RealizeInstancesOptions &options,
                                       const RealizeMeshTask &task,
-                                      const OrderedAttributes &ordered_attributes,
-                                      MutableSpan<GSpanAttributeWriter> dst_attribute_writers,
                                       MutableSpan<MVert> all_dst_verts,
                                       MutableSpan<MEdge> all_dst_edges,
                                       MutableSpan<MPoly> all_dst_polys,
@@ -1000,33 +969,14 @@ static void execute_realize_mesh_task(const RealizeInstancesOptions &options,
                       task.id,
                       all_dst_vertex_ids.slice(task.start_indices.vertex, mesh.totvert));
   }
-
-  copy_generic_attributes_to_result(
-      mesh_info.attributes,
-      task.attribute_fallbacks,
-      ordered_attributes,
-      [&](const eAttrDomain domain) {
-        switch (domain) {
-          case ATTR_DOMAIN_POINT:
-            return dst_vert_range;
-          case ATTR_DOMAIN_EDGE:
-            return dst_edge_range;
-          case ATTR_DOMAIN_FACE:
-            return dst_poly_range;
-          case ATTR_DOMAIN_CORNER:
-            return dst_loop_range;
-          default:
-            BLI_assert_unreachable();
-            return IndexRange();
-        }
-      },
-      dst_attribute_writers);
 }
 
 static void execute_realize_mesh_tasks(const RealizeInstancesOptions &options,
                                        const AllMeshesInfo &all_meshes_info,
                                        const Span<RealizeMeshTask> tasks,
                                        const OrderedAttributes &ordered_attributes,
+                                       const FunctionRef<GVArray(const AttributeIDRef &)>
+                                           lookup_fn,
                                        const VectorSet<Material *> &ordered_materials,
                                        GeometrySet &r_realized_geometry)
 {
@@ -1092,8 +1042,6 @@ static void execute_realize_mesh_tasks(const RealizeInstancesOptions &options,
       const RealizeMeshTask &task = tasks[task_index];
       execute_realize_mesh_task(options,
                                 task,
-                                ordered_attributes,
-                                dst_attribute_writers,
                                 dst_verts,
                                 dst_edges,
                                 dst_polys,
@@ -1102,6 +1050,7 @@ static void execute_realize_mesh_tasks(const RealizeInstancesOptions &options,
                                 material_indices.span);
     }
   });
+  copy_generic_attributes_to_result(ordered_attributes, lookup_fn, dst_attribute_writers);
 
   /* Tag modified attributes. */
   for (GSpanAttributeWriter &dst_attribute : dst_attribute_writers) {
@@ -1225,9 +1174,7 @@ static AllCurvesInfo preprocess_curves(const GeometrySet &geometry_set,
 static void execute_realize_curve_task(const RealizeInstancesOptions &options,
                                        const AllCurvesInfo &all_curves_info,
                                        const RealizeCurveTask &task,
-                                       const OrderedAttributes &ordered_attributes,
                                        bke::CurvesGeometry &dst_curves,
-                                       MutableSpan<GSpanAttributeWriter> dst_attribute_writers,
                                        MutableSpan<int> all_dst_ids,
                                        MutableSpan<float3> all_handle_left,
                                        MutableSpan<float3> all_handle_right,
@@ -1289,29 +1236,14 @@ static void execute_realize_curve_task(const RealizeInstancesOptions &options,
     create_result_ids(
         options, curves_info.stored_ids, task.id, all_dst_ids.slice(dst_point_range));
   }
-
-  copy_generic_attributes_to_result(
-      curves_info.attributes,
-      task.attribute_fallbacks,
-      ordered_attributes,
-      [&](const eAttrDomain domain) {
-        switch (domain) {
-          case ATTR_DOMAIN_POINT:
-            return IndexRange(task.start_indices.point, curves.points_num());
-          case ATTR_DOMAIN_CURVE:
-            return IndexRange(task.start_indices.curve, curves.curves_num());
-          default:
-            BLI_assert_unreachable();
-            return IndexRange();
-        }
-      },
-      dst_attribute_writers);
 }
 
 static void execute_realize_curve_tasks(const RealizeInstancesOptions &options,
                                         const AllCurvesInfo &all_curves_info,
                                         const Span<RealizeCurveTask> tasks,
                                         const OrderedAttributes &ordered_attributes,
+                                        const FunctionRef<GVArray(const AttributeIDRef &)>
+                                            lookup_fn,
                                         GeometrySet &r_realized_geometry)
 {
   if (tasks.is_empty()) {
@@ -1382,9 +1314,7 @@ static void execute_realize_curve_tasks(const RealizeInstancesOptions &options,
       execute_realize_curve_task(options,
                                  all_curves_info,
                                  task,
-                                 ordered_attributes,
                                  dst_curves,
-                                 dst_attribute_writers,
                                  point_ids.span,
                                  handle_left.span,
                                  handle_right.span,
@@ -1392,6 +1322,7 @@ static void execute_realize_curve_tasks(const RealizeInstancesOptions &options,
                                  resolution.span);
     }
   });
+  copy_generic_attributes_to_result(ordered_attributes, lookup_fn, dst_attribute_writers);
 
   /* Type counts have to be updated eagerly. */
   dst_curves.runtime->type_counts.fill(0);
@@ -1423,6 +1354,283 @@ static void execute_realize_curve_tasks(const RealizeInstancesOptions &options,
 
 /** \} */
 
+/* -------------------------------------------------------------------- */
+/** \name Lazy Realized Attributes
+ * \{ */
+
+/** How values of a lazily realized attribute are computed from the instanced geometry. */
+enum class LazyRealizeMode {
+  /** The values are copied unchanged. */
+  Copy,
+  /** The values are positions that are transformed by the instance transform. */
+  Transform,
+  /** The values are ids that are mixed with the instance id. Missing ids are replaced by the
+   * element index. */
+  HashIds,
+};
+
+/** The elements of one realize task in a domain of the realized geometry. */
+struct LazyRealizeSegment {
+  IndexRange range;
+  /** Index of the instanced geometry in the sources array. */
+  int source_index;
+  /** Value used when the source is empty, or null to use the default value of the type. */
+  const void *fallback;
+  const float4x4 *transform;
+  uint32_t id;
+};
+
+/**
+ * A virtual array that reads the values of a realized attribute from the instanced geometries.
+ * Every segment of the array corresponds to a realize task, whose source is shared by all
+ * instances of the same geometry.
+ */
+template<typename T> class VArrayImpl_For_LazyRealize final : public VArrayImpl<T> {
+ private:
+  struct Segment {
+    int source_index;
+    T fallback;
+    const float4x4 *transform;
+    uint32_t id;
+  };
+
+  /** Start index of every segment, followed by the total size. */
+  Array<int> offsets_;
+  Array<Segment> segments_;
+  Array<VArray<T>> sources_;
+  LazyRealizeMode mode_;
+
+ public:
+  VArrayImpl_For_LazyRealize(const Span<LazyRealizeSegment> segments,
+                             const Span<GVArray> sources,
+                             const LazyRealizeMode mode)
+      : VArrayImpl<T>(segments.is_empty() ? 0 : segments.last().range.one_after_last()),
+        offsets_(segments.size() + 1),
+        segments_(segments.size()),
+        sources_(sources.size()),
+        mode_(mode)
+  {
+    const CPPType &type = CPPType::get<T>();
+    for (const int i : segments.index_range()) {
+      const LazyRealizeSegment &segment = segments[i];
+      offsets_[i] = segment.range.start();
+      const void *fallback = segment.fallback ? segment.fallback : type.default_value();
+      segments_[i] = {segment.source_index,
+                      *static_cast<const T *>(fallback),
+                      segment.transform,
+                      segment.id};
+    }
+    offsets_.last() = this->size_;
+    for (const int i : sources.index_range()) {
+      if (sources[i]) {
+        sources_[i] = sources[i].typed<T>();
+      }
+    }
+  }
+
+ private:
+  int find_segment(const int64_t index) const
+  {
+    return int(std::upper_bound(offsets_.begin(), offsets_.end(), index) - offsets_.begin()) - 1;
+  }
+
+  T get(const int64_t index) const override
+  {
+    const int segment_index = this->find_segment(index);
+    const Segment &segment = segments_[segment_index];
+    const int64_t local_index = index - offsets_[segment_index];
+    const VArray<T> &source = sources_[segment.source_index];
+    T value = source ? source[local_index] : segment.fallback;
+    this->postprocess(segment, local_index, !source.is_empty(), {&value, 1});
+    return value;
+  }
+
+  void postprocess(const Segment &segment,
+                   const int64_t start,
+                   const bool from_source,
+                   MutableSpan<T> values) const
+  {
+    UNUSED_VARS(segment, start, from_source, values);
+    if constexpr (std::is_same_v<T, float3>) {
+      if (mode_ == LazyRealizeMode::Transform && from_source) {
+        for (float3 &value : values) {
+          value = *segment.transform * value;
+        }
+      }
+    }
+    if constexpr (std::is_same_v<T, int>) {
+      if (mode_ == LazyRealizeMode::HashIds) {
+        if (from_source) {
+          for (int &value : values) {
+            value = noise::hash(segment.id, value);
+          }
+        }
+        else {
+          for (const int i : values.index_range()) {
+            values[i] = noise::hash(segment.id, int(start + i));
+          }
+        }
+      }
+    }
+  }
+
+  /** Fill #dst with the values in #range, walking over all segments that overlap it. */
+  void materialize_range(const IndexRange range, MutableSpan<T> dst) const
+  {
+    int segment_index = this->find_segment(range.start());
+    int64_t index = range.start();
+    while (index < range.one_after_last()) {
+      const Segment &segment = segments_[segment_index];
+      const int64_t segment_start = offsets_[segment_index];
+      const int64_t segment_end = std::min<int64_t>(offsets_[segment_index + 1],
+                                                    range.one_after_last());
+      segment_index++;
+      if (segment_end <= index) {
+        continue;
+      }
+      const IndexRange local_range(index - segment_start, segment_end - index);
+      MutableSpan<T> segment_dst = dst.slice(index - range.start(), local_range.size());
+      const VArray<T> &source = sources_[segment.source_index];
+      if (source) {
+        source.materialize_compressed(local_range, segment_dst);
+      }
+      else {
+        segment_dst.fill(segment.fallback);
+      }
+      this->postprocess(segment, local_range.start(), !source.is_empty(), segment_dst);
+      index = segment_end;
+    }
+  }
+
+  void materialize(IndexMask mask, MutableSpan<T> r_span) const override
+  {
+    if (!mask.is_range()) {
+      VArrayImpl<T>::materialize(mask, r_span);
+      return;
+    }
+    const IndexRange range = mask.as_range();
+    threading::parallel_for(range, 4096, [&](const IndexRange sub_range) {
+      this->materialize_range(sub_range, r_span.slice(sub_range));
+    });
+  }
+
+  void materialize_to_uninitialized(IndexMask mask, MutableSpan<T> r_span) const override
+  {
+    if constexpr (!std::is_trivially_constructible_v<T>) {
+      mask.foreach_index([&](const int64_t i) { new (&r_span[i]) T(); });
+    }
+    this->materialize(mask, r_span);
+  }
+
+  void materialize_compressed(IndexMask mask, MutableSpan<T> r_span) const override
+  {
+    if (!mask.is_range()) {
+      VArrayImpl<T>::materialize_compressed(mask, r_span);
+      return;
+    }
+    const IndexRange range = mask.as_range();
+    threading::parallel_for(IndexRange(range.size()), 4096, [&](const IndexRange sub_range) {
+      this->materialize_range(range.slice(sub_range), r_span.slice(sub_range));
+    });
+  }
+
+  void materialize_compressed_to_uninitialized(IndexMask mask,
+                                               MutableSpan<T> r_span) const override
+  {
+    default_construct_n(r_span.data(), r_span.size());
+    this->materialize_compressed(mask, r_span);
+  }
+};
+
+/** The data that a lazily realized attribute is read from. */
+struct LazyRealizeSources {
+  const CPPType *type = nullptr;
+  eAttrDomain domain = ATTR_DOMAIN_POINT;
+  /** A virtual array for every preprocessed geometry. Empty when the geometry does not have the
+   * attribute. */
+  Array<GVArray> sources;
+  LazyRealizeMode mode = LazyRealizeMode::Copy;
+  /** Index in the #OrderedAttributes of the geometry type, used to find instance fallbacks. */
+  int attribute_index = -1;
+  /** Used when the attribute is not propagated generically and a geometry does not have it. */
+  const void *fallback = nullptr;
+};
+
+/**
+ * Create a virtual array for the realized attribute that has one segment for every task.
+ * \param task_fn: Returns the range of the task in the attribute domain and the index of its
+ * preprocessed geometry.
+ */
+template<typename Task, typename TaskFn>
+static GVArray create_lazy_realized_varray(const Span<Task> tasks,
+                                           const LazyRealizeSources &sources,
+                                           const TaskFn &task_fn)
+{
+  Array<LazyRealizeSegment> segments(tasks.size());
+  for (const int i : tasks.index_range()) {
+    const Task &task = tasks[i];
+    const std::pair<IndexRange, int> range_and_source = task_fn(task);
+    segments[i].range = range_and_source.first;
+    segments[i].source_index = range_and_source.second;
+    segments[i].fallback = sources.attribute_index == -1 ?
+                               sources.fallback :
+                               task.attribute_fallbacks.array[sources.attribute_index];
+    segments[i].transform = &task.transform;
+    segments[i].id = task.id;
+  }
+  GVArray varray;
+  attribute_math::convert_to_static_type(*sources.type, [&](auto dummy) {
+    using T = decltype(dummy);
+    varray = VArray<T>::template For<VArrayImpl_For_LazyRealize<T>>(
+        segments, sources.sources, sources.mode);
+  });
+  return varray;
+}
+
+/**
+ * Find the sources of a generically propagated attribute.
+ * \return False if the attribute is not propagated generically.
+ */
+template<typename RealizeInfo>
+static bool lookup_generic_lazy_sources(const OrderedAttributes &ordered_attributes,
+                                        const Span<RealizeInfo> infos,
+                                        const AttributeIDRef &attribute_id,
+                                        LazyRealizeSources &r_sources)
+{
+  const int attribute_index = ordered_attributes.ids.index_of_try(attribute_id);
+  if (attribute_index == -1) {
+    return false;
+  }
+  const AttributeKind &kind = ordered_attributes.kinds[attribute_index];
+  r_sources.type = custom_data_type_to_cpp_type(kind.data_type);
+  r_sources.domain = kind.domain;
+  r_sources.attribute_index = attribute_index;
+  r_sources.sources.reinitialize(infos.size());
+  for (const int i : infos.index_range()) {
+    if (const std::optional<GVArraySpan> &attribute = infos[i].attributes[attribute_index]) {
+      r_sources.sources[i] = GVArray::ForSpan(*attribute);
+    }
+  }
+  return true;
+}
+
+/** Find the sources of the id attribute, which are the stored ids of every geometry. */
+static void lookup_id_lazy_sources(const RealizeInstancesOptions &options,
+                                   const Span<Span<int>> stored_ids,
+                                   LazyRealizeSources &r_sources)
+{
+  r_sources.type = &CPPType::get<int>();
+  r_sources.mode = options.keep_original_ids ? LazyRealizeMode::Copy : LazyRealizeMode::HashIds;
+  r_sources.sources.reinitialize(stored_ids.size());
+  for (const int i : stored_ids.index_range()) {
+    if (!stored_ids[i].is_empty()) {
+      r_sources.sources[i] = VArray<int>::ForSpan(stored_ids[i]);
+    }
+  }
+}
+
+/** \} */
+
 /* -------------------------------------------------------------------- */
 /** \name Realize Instances
  * \{ */
@@ -1437,68 +1645,337 @@ static void remove_id_attribute_from_instances(GeometrySet &geometry_set)
   });
 }
 
-GeometrySet realize_instances(GeometrySet geometry_set, const RealizeInstancesOptions &options)
+struct LazyRealizedInstances::Impl {
+  /** The preprocessed data references the geometry, so it is owned here. */
+  GeometrySet geometry_set;
+  RealizeInstancesOptions options;
+  AllPointCloudsInfo pointclouds;
+  AllMeshesInfo meshes;
+  AllCurvesInfo curves;
+  Vector<std::unique_ptr<GArray<>>> temporary_arrays;
+  GatherTasks tasks;
+  /** The offsets after all tasks are gathered, which are the sizes of the realized domains. */
+  GatherOffsets sizes;
+
+  GVArray lookup_pointcloud(const AttributeIDRef &attribute_id) const;
+  GVArray lookup_mesh(const AttributeIDRef &attribute_id) const;
+  GVArray lookup_curves(const AttributeIDRef &attribute_id) const;
+};
+
+LazyRealizedInstances::LazyRealizedInstances(GeometrySet geometry_set,
+                                             const RealizeInstancesOptions &options)
+    : impl_(std::make_unique<Impl>())
 {
   /* The algorithm works in three steps:
    * 1. Preprocess each unique geometry that is instanced (e.g. each `Mesh`).
    * 2. Gather "tasks" that need to be executed to realize the instances. Each task corresponds to
    *    instances of the previously preprocessed geometry.
-   * 3. Execute all tasks in parallel.
+   * 3. Execute all tasks in parallel, either in #realize or lazily when an attribute returned by
+   *    #lookup is accessed.
    */
-
-  if (!geometry_set.has_instances()) {
-    return geometry_set;
-  }
-
+  Impl &impl = *impl_;
+  impl.geometry_set = std::move(geometry_set);
+  impl.options = options;
   if (options.keep_original_ids) {
-    remove_id_attribute_from_instances(geometry_set);
+    remove_id_attribute_from_instances(impl.geometry_set);
   }
 
-  AllPointCloudsInfo all_pointclouds_info = preprocess_pointclouds(geometry_set, options);
-  AllMeshesInfo all_meshes_info = preprocess_meshes(geometry_set, options);
-  AllCurvesInfo all_curves_info = preprocess_curves(geometry_set, options);
+  impl.pointclouds = preprocess_pointclouds(impl.geometry_set, options);
+  impl.meshes = preprocess_meshes(impl.geometry_set, options);
+  impl.curves = preprocess_curves(impl.geometry_set, options);
 
-  Vector<std::unique_ptr<GArray<>>> temporary_arrays;
-  const bool create_id_attribute = all_pointclouds_info.create_id_attribute ||
-                                   all_meshes_info.create_id_attribute ||
-                                   all_curves_info.create_id_attribute;
-  GatherTasksInfo gather_info = {all_pointclouds_info,
-                                 all_meshes_info,
-                                 all_curves_info,
-                                 create_id_attribute,
-                                 temporary_arrays};
+  const bool create_id_attribute = impl.pointclouds.create_id_attribute ||
+                                   impl.meshes.create_id_attribute ||
+                                   impl.curves.create_id_attribute;
+  GatherTasksInfo gather_info = {
+      impl.pointclouds, impl.meshes, impl.curves, create_id_attribute, impl.temporary_arrays};
   const float4x4 transform = float4x4::identity();
   InstanceContext attribute_fallbacks(gather_info);
-  gather_realize_tasks_recursive(gather_info, geometry_set, transform, attribute_fallbacks);
+  gather_realize_tasks_recursive(gather_info, impl.geometry_set, transform, attribute_fallbacks);
+  impl.tasks = std::move(gather_info.r_tasks);
+  impl.sizes = gather_info.r_offsets;
+}
+
+LazyRealizedInstances::~LazyRealizedInstances() = default;
+
+int LazyRealizedInstances::domain_size(const GeometryComponentType component_type,
+                                       const eAttrDomain domain) const
+{
+  const GatherOffsets &sizes = impl_->sizes;
+  switch (component_type) {
+    case GEO_COMPONENT_TYPE_POINT_CLOUD:
+      return domain == ATTR_DOMAIN_POINT ? sizes.pointcloud_offset : 0;
+    case GEO_COMPONENT_TYPE_MESH:
+      switch (domain) {
+        case ATTR_DOMAIN_POINT:
+          return sizes.mesh_offsets.vertex;
+        case ATTR_DOMAIN_EDGE:
+          return sizes.mesh_offsets.edge;
+        case ATTR_DOMAIN_FACE:
+          return sizes.mesh_offsets.poly;
+        case ATTR_DOMAIN_CORNER:
+          return sizes.mesh_offsets.loop;
+        default:
+          return 0;
+      }
+    case GEO_COMPONENT_TYPE_CURVE:
+      switch (domain) {
+        case ATTR_DOMAIN_POINT:
+          return sizes.curves_offsets.point;
+        case ATTR_DOMAIN_CURVE:
+          return sizes.curves_offsets.curve;
+        default:
+          return 0;
+      }
+    default:
+      return 0;
+  }
+}
+
+GVArray LazyRealizedInstances::lookup(const GeometryComponentType component_type,
+                                      const AttributeIDRef &attribute_id) const
+{
+  switch (component_type) {
+    case GEO_COMPONENT_TYPE_POINT_CLOUD:
+      return impl_->lookup_pointcloud(attribute_id);
+    case GEO_COMPONENT_TYPE_MESH:
+      return impl_->lookup_mesh(attribute_id);
+    case GEO_COMPONENT_TYPE_CURVE:
+      return impl_->lookup_curves(attribute_id);
+    default:
+      return {};
+  }
+}
+
+GVArray LazyRealizedInstances::Impl::lookup_pointcloud(const AttributeIDRef &attribute_id) const
+{
+  const Span<RealizePointCloudTask> tasks = this->tasks.pointcloud_tasks;
+  const Span<PointCloudRealizeInfo> infos = this->pointclouds.realize_info;
+  if (tasks.is_empty()) {
+    return {};
+  }
+  LazyRealizeSources sources;
+  if (lookup_generic_lazy_sources(this->pointclouds.attributes, infos, attribute_id, sources)) {
+    /* Sources are filled in already. */
+  }
+  else if (attribute_id == "position") {
+    sources.type = &CPPType::get<float3>();
+    sources.mode = LazyRealizeMode::Transform;
+    sources.sources.reinitialize(infos.size());
+    for (const int i : infos.index_range()) {
+      sources.sources[i] = VArray<float3>::ForSpan(infos[i].positions);
+    }
+  }
+  else if (attribute_id == "id" && this->pointclouds.create_id_attribute) {
+    Array<Span<int>> stored_ids(infos.size());
+    for (const int i : infos.index_range()) {
+      stored_ids[i] = infos[i].stored_ids;
+    }
+    lookup_id_lazy_sources(this->options, stored_ids, sources);
+  }
+  else {
+    return {};
+  }
+  return create_lazy_realized_varray(tasks, sources, [&](const RealizePointCloudTask &task) {
+    return std::make_pair(IndexRange(task.start_index, task.pointcloud_info->pointcloud->totpoint),
+                          int(task.pointcloud_info - infos.data()));
+  });
+}
+
+GVArray LazyRealizedInstances::Impl::lookup_mesh(const AttributeIDRef &attribute_id) const
+{
+  const Span<RealizeMeshTask> tasks = this->tasks.mesh_tasks;
+  const Span<MeshRealizeInfo> infos = this->meshes.realize_info;
+  if (tasks.is_empty()) {
+    return {};
+  }
+  LazyRealizeSources sources;
+  if (lookup_generic_lazy_sources(this->meshes.attributes, infos, attribute_id, sources)) {
+    /* Sources are filled in already. */
+  }
+  else if (attribute_id == "position") {
+    sources.type = &CPPType::get<float3>();
+    sources.mode = LazyRealizeMode::Transform;
+    sources.sources.reinitialize(infos.size());
+    for (const int i : infos.index_range()) {
+      sources.sources[i] = infos[i].mesh->attributes().lookup_or_default<float3>(
+          "position", ATTR_DOMAIN_POINT, float3(0));
+    }
+  }
+  else if (attribute_id == "id" && this->meshes.create_id_attribute) {
+    Array<Span<int>> stored_ids(infos.size());
+    for (const int i : infos.index_range()) {
+      stored_ids[i] = infos[i].stored_vertex_ids;
+    }
+    lookup_id_lazy_sources(this->options, stored_ids, sources);
+  }
+  else if (attribute_id == "material_index" && this->meshes.create_material_index_attribute) {
+    sources.type = &CPPType::get<int>();
+    sources.domain = ATTR_DOMAIN_FACE;
+    sources.sources.reinitialize(infos.size());
+    for (const int i : infos.index_range()) {
+      const MeshRealizeInfo &mesh_info = infos[i];
+      const int materials_num = mesh_info.mesh->totcol;
+      sources.sources[i] = VArray<int>::ForFunc(
+          mesh_info.mesh->totpoly, [&mesh_info, materials_num](const int64_t poly_index) {
+            if (materials_num == 0) {
+              /* The material index map contains the index of the null material in the result. */
+              return mesh_info.material_index_map.first();
+            }
+            const int src_index = mesh_info.material_indices[poly_index];
+            const bool valid = IndexRange(materials_num).contains(src_index);
+            return valid ? mesh_info.material_index_map[src_index] : 0;
+          });
+    }
+  }
+  else {
+    return {};
+  }
+  return create_lazy_realized_varray(tasks, sources, [&](const RealizeMeshTask &task) {
+    const Mesh &mesh = *task.mesh_info->mesh;
+    const MeshElementStartIndices &starts = task.start_indices;
+    const int source_index = int(task.mesh_info - infos.data());
+    switch (sources.domain) {
+      case ATTR_DOMAIN_POINT:
+        return std::make_pair(IndexRange(starts.vertex, mesh.totvert), source_index);
+      case ATTR_DOMAIN_EDGE:
+        return std::make_pair(IndexRange(starts.edge, mesh.totedge), source_index);
+      case ATTR_DOMAIN_FACE:
+        return std::make_pair(IndexRange(starts.poly, mesh.totpoly), source_index);
+      case ATTR_DOMAIN_CORNER:
+        return std::make_pair(IndexRange(starts.loop, mesh.totloop), source_index);
+      default:
+        BLI_assert_unreachable();
+        return std::make_pair(IndexRange(), source_index);
+    }
+  });
+}
+
+GVArray LazyRealizedInstances::Impl::lookup_curves(const AttributeIDRef &attribute_id) const
+{
+  const Span<RealizeCurveTask> tasks = this->tasks.curve_tasks;
+  const Span<RealizeCurveInfo> infos = this->curves.realize_info;
+  if (tasks.is_empty()) {
+    return {};
+  }
+  static const float default_radius = 1.0f;
+  LazyRealizeSources sources;
+  if (lookup_generic_lazy_sources(this->curves.attributes, infos, attribute_id, sources)) {
+    /* Sources are filled in already. */
+  }
+  else if (attribute_id == "position") {
+    sources.type = &CPPType::get<float3>();
+    sources.mode = LazyRealizeMode::Transform;
+    sources.sources.reinitialize(infos.size());
+    for (const int i : infos.index_range()) {
+      const bke::CurvesGeometry &curves = bke::CurvesGeometry::wrap(infos[i].curves->geometry);
+      sources.sources[i] = VArray<float3>::ForSpan(curves.positions());
+    }
+  }
+  else if ((attribute_id == "handle_left" || attribute_id == "handle_right") &&
+           this->curves.create_handle_postion_attributes) {
+    const bool is_left = attribute_id == "handle_left";
+    sources.type = &CPPType::get<float3>();
+    sources.mode = LazyRealizeMode::Transform;
+    sources.sources.reinitialize(infos.size());
+    for (const int i : infos.index_range()) {
+      const Span<float3> handles = is_left ? infos[i].handle_left : infos[i].handle_right;
+      if (!handles.is_empty()) {
+        sources.sources[i] = VArray<float3>::ForSpan(handles);
+      }
+    }
+  }
+  else if (attribute_id == "radius" && this->curves.create_radius_attribute) {
+    sources.type = &CPPType::get<float>();
+    sources.fallback = &default_radius;
+    sources.sources.reinitialize(infos.size());
+    for (const int i : infos.index_range()) {
+      if (!infos[i].radius.is_empty()) {
+        sources.sources[i] = VArray<float>::ForSpan(infos[i].radius);
+      }
+    }
+  }
+  else if (attribute_id == "resolution" && this->curves.create_resolution_attribute) {
+    sources.type = &CPPType::get<int>();
+    sources.domain = ATTR_DOMAIN_CURVE;
+    sources.sources.reinitialize(infos.size());
+    for (const int i : infos.index_range()) {
+      sources.sources[i] = infos[i].resolution;
+    }
+  }
+  else if (attribute_id == "id" && this->curves.create_id_attribute) {
+    Array<Span<int>> stored_ids(infos.size());
+    for (const int i : infos.index_range()) {
+      stored_ids[i] = infos[i].stored_ids;
+    }
+    lookup_id_lazy_sources(this->options, stored_ids, sources);
+  }
+  else {
+    return {};
+  }
+  return create_lazy_realized_varray(tasks, sources, [&](const RealizeCurveTask &task) {
+    const bke::CurvesGeometry &curves = bke::CurvesGeometry::wrap(
+        task.curve_info->curves->geometry);
+    const int source_index = int(task.curve_info - infos.data());
+    if (sources.domain == ATTR_DOMAIN_CURVE) {
+      return std::make_pair(IndexRange(task.start_indices.curve, curves.curves_num()),
+                            source_index);
+    }
+    return std::make_pair(IndexRange(task.start_indices.point, curves.points_num()),
+                          source_index);
+  });
+}
 
+GeometrySet LazyRealizedInstances::realize() const
+{
+  const Impl &impl = *impl_;
   GeometrySet new_geometry_set;
-  execute_realize_pointcloud_tasks(options,
-                                   all_pointclouds_info,
-                                   gather_info.r_tasks.pointcloud_tasks,
-                                   all_pointclouds_info.attributes,
+  execute_realize_pointcloud_tasks(impl.options,
+                                   impl.pointclouds,
+                                   impl.tasks.pointcloud_tasks,
+                                   impl.pointclouds.attributes,
+                                   [&](const AttributeIDRef &attribute_id) {
+                                     return impl.lookup_pointcloud(attribute_id);
+                                   },
                                    new_geometry_set);
-  execute_realize_mesh_tasks(options,
-                             all_meshes_info,
-                             gather_info.r_tasks.mesh_tasks,
-                             all_meshes_info.attributes,
-                             all_meshes_info.materials,
+  execute_realize_mesh_tasks(impl.options,
+                             impl.meshes,
+                             impl.tasks.mesh_tasks,
+                             impl.meshes.attributes,
+                             [&](const AttributeIDRef &attribute_id) {
+                               return impl.lookup_mesh(attribute_id);
+                             },
+                             impl.meshes.materials,
                              new_geometry_set);
-  execute_realize_curve_tasks(options,
-                              all_curves_info,
-                              gather_info.r_tasks.curve_tasks,
-                              all_curves_info.attributes,
+  execute_realize_curve_tasks(impl.options,
+                              impl.curves,
+                              impl.tasks.curve_tasks,
+                              impl.curves.attributes,
+                              [&](const AttributeIDRef &attribute_id) {
+                                return impl.lookup_curves(attribute_id);
+                              },
                               new_geometry_set);
 
-  if (gather_info.r_tasks.first_volume) {
-    new_geometry_set.add(*gather_info.r_tasks.first_volume);
+  if (impl.tasks.first_volume) {
+    new_geometry_set.add(*impl.tasks.first_volume);
   }
-  if (gather_info.r_tasks.first_edit_data) {
-    new_geometry_set.add(*gather_info.r_tasks.first_edit_data);
+  if (impl.tasks.first_edit_data) {
+    new_geometry_set.add(*impl.tasks.first_edit_data);
   }
 
   return new_geometry_set;
 }
 
+GeometrySet realize_instances(GeometrySet geometry_set, const RealizeInstancesOptions &options)
+{
+  if (!geometry_set.has_instances()) {
+    return geometry_set;
+  }
+  SCOPED_TRACE_EVENT("geometry", "Realize Instances");
+
+  return LazyRealizedInstances(std::move(geometry_set), options).realize();
+}
+
 /** \} */
 
 }  // namespace blender::geometry
@@ -27,7 +27,8 @@ static fn::Field<int> get_count_input_max_one(const fn::Field<int> &count_field)
   return fn::Field<int>(std::move(clamp_op));
 }
 
-static fn::Field<int> get_count_input_from_length(const fn::Field<float> &length_field)
+static fn::Field<int> get_count_input_from_length(const fn::Field<float> &length_field,
+                                                  const bool use_precise_lengths)
 {
   static fn::CustomMF_SI_SI_SO<float, float, int> get_count_fn(
       "Length Input to Count",
@@ -41,7 +42,8 @@ static fn::Field<int> get_count_input_from_length(const fn::Field<float> &length
 
   auto get_count_op = std::make_shared<fn::FieldOperation>(fn::FieldOperation(
       get_count_fn,
-      {fn::Field<float>(std::make_shared<bke::CurveLengthFieldInput>()), length_field}));
+      {fn::Field<float>(std::make_shared<bke::CurveLengthFieldInput>(use_precise_lengths)),
+       length_field}));
 
   return fn::Field<int>(std::move(get_count_op));
 }
@@ -119,6 +121,9 @@ struct AttributesForInterpolation : NonCopyable, NonMovable {
 
   Span<float3> src_evaluated_tangents;
   Span<float3> src_evaluated_normals;
+  /** Storage for the evaluated directions when they are decoded from compact caches. */
+  Vector<float3> src_evaluated_tangents_buffer;
+  Vector<float3> src_evaluated_normals_buffer;
   MutableSpan<float3> dst_tangents;
   MutableSpan<float3> dst_normals;
 };
@@ -169,14 +174,16 @@ static void gather_point_attributes_to_interpolate(
 
   bke::MutableAttributeAccessor dst_attributes = dst_curves.attributes_for_write();
   if (output_ids.tangent_id) {
-    result.src_evaluated_tangents = src_curves.evaluated_tangents();
+    result.src_evaluated_tangents = src_curves.evaluated_tangents(
+        result.src_evaluated_tangents_buffer);
     bke::GSpanAttributeWriter dst_attribute = dst_attributes.lookup_or_add_for_write_only_span(
         output_ids.tangent_id, ATTR_DOMAIN_POINT, CD_PROP_FLOAT3);
     result.dst_tangents = dst_attribute.span.typed<float3>();
     result.dst_attributes.append(std::move(dst_attribute));
   }
   if (output_ids.normal_id) {
-    result.src_evaluated_normals = src_curves.evaluated_normals();
+    result.src_evaluated_normals = src_curves.evaluated_normals(
+        result.src_evaluated_normals_buffer);
     bke::GSpanAttributeWriter dst_attribute = dst_attributes.lookup_or_add_for_write_only_span(
         output_ids.normal_id, ATTR_DOMAIN_POINT, CD_PROP_FLOAT3);
     result.dst_normals = dst_attribute.span.typed<float3>();
@@ -234,6 +241,7 @@ static void normalize_curve_point_data(const CurvesGeometry &curves,
 static CurvesGeometry resample_to_uniform(const CurvesGeometry &src_curves,
                                           const fn::Field<bool> &selection_field,
                                           const fn::Field<int> &count_field,
+                                          const bool use_precise_lengths,
                                           const ResampleCurvesOutputAttributeIDs &output_ids)
 {
   /* Create the new curves without any points and evaluate the final count directly
@@ -267,13 +275,21 @@ static CurvesGeometry resample_to_uniform(const CurvesGeometry &src_curves,
 
   VArray<bool> curves_cyclic = src_curves.cyclic();
   VArray<int8_t> curve_types = src_curves.curve_types();
-  Span<float3> evaluated_positions = src_curves.evaluated_positions();
+  Vector<float3> evaluated_positions_buffer;
+  Span<float3> evaluated_positions = src_curves.evaluated_positions(evaluated_positions_buffer);
   MutableSpan<float3> dst_positions = dst_curves.positions_for_write();
 
   AttributesForInterpolation attributes;
   gather_point_attributes_to_interpolate(src_curves, dst_curves, attributes, output_ids);
 
-  src_curves.ensure_evaluated_lengths();
+  Vector<float> evaluated_lengths_buffer;
+  Span<float> evaluated_lengths;
+  if (use_precise_lengths) {
+    src_curves.ensure_evaluated_lengths_precise();
+  }
+  else {
+    evaluated_lengths = src_curves.evaluated_lengths(evaluated_lengths_buffer);
+  }
 
   /* Sampling arbitrary attributes works by first interpolating them to the curve's standard
    * "evaluated points" and then interpolating that result with the uniform samples. This is
@@ -295,7 +311,11 @@ static CurvesGeometry resample_to_uniform(const CurvesGeometry &src_curves,
     for (const int i_curve : sliced_selection) {
       const bool cyclic = curves_cyclic[i_curve];
       const IndexRange dst_points = dst_curves.points_for_curve(i_curve);
-      const Span<float> lengths = src_curves.evaluated_lengths_for_curve(i_curve, cyclic);
+      const Span<float> lengths = use_precise_lengths ?
+                                      src_curves.evaluated_lengths_precise_for_curve(i_curve,
+                                                                                     cyclic) :
+                                      evaluated_lengths.slice(
+                                          src_curves.lengths_range_for_curve(i_curve, cyclic));
       if (lengths.is_empty()) {
         /* Handle curves with only one evaluated point. */
         sample_indices.as_mutable_span().slice(dst_points).fill(0);
@@ -387,19 +407,28 @@ static CurvesGeometry resample_to_uniform(const CurvesGeometry &src_curves,
 CurvesGeometry resample_to_count(const CurvesGeometry &src_curves,
                                  const fn::Field<bool> &selection_field,
                                  const fn::Field<int> &count_field,
+                                 const bool use_precise_lengths,
                                  const ResampleCurvesOutputAttributeIDs &output_ids)
 {
-  return resample_to_uniform(
-      src_curves, selection_field, get_count_input_max_one(count_field), output_ids);
+  return resample_to_uniform(src_curves,
+                             selection_field,
+                             get_count_input_max_one(count_field),
+                             use_precise_lengths,
+                             output_ids);
 }
 
 CurvesGeometry resample_to_length(const CurvesGeometry &src_curves,
                                   const fn::Field<bool> &selection_field,
                                   const fn::Field<float> &segment_length_field,
+                                  const bool use_precise_lengths,
                                   const ResampleCurvesOutputAttributeIDs &output_ids)
 {
   return resample_to_uniform(
-      src_curves, selection_field, get_count_input_from_length(segment_length_field), output_ids);
+      src_curves,
+      selection_field,
+      get_count_input_from_length(segment_length_field, use_precise_lengths),
+      use_precise_lengths,
+      output_ids);
 }
 
 CurvesGeometry resample_to_evaluated(const CurvesGeometry &src_curves,
@@ -440,7 +469,9 @@ CurvesGeometry resample_to_evaluated(const CurvesGeometry &src_curves,
   dst_curves.resize(dst_offsets.last(), dst_curves.curves_num());
 
   /* Create the correct number of uniform-length samples for every selected curve. */
-  const Span<float3> evaluated_positions = src_curves.evaluated_positions();
+  Vector<float3> evaluated_positions_buffer;
+  const Span<float3> evaluated_positions = src_curves.evaluated_positions(
+      evaluated_positions_buffer);
   MutableSpan<float3> dst_positions = dst_curves.positions_for_write();
 
   AttributesForInterpolation attributes;
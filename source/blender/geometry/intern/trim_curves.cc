@@ -176,7 +176,8 @@ static bke::curves::CurvePoint lookup_bezier_point(const Span<int> bezier_offset
 Array<bke::curves::CurvePoint, 12> lookup_curve_points(const bke::CurvesGeometry &curves,
                                                        const Span<float> lengths,
                                                        const Span<int64_t> curve_indices,
-                                                       const bool normalized_factors)
+                                                       const bool normalized_factors,
+                                                       const bool use_precise_lengths)
 {
   BLI_assert(lengths.size() == curve_indices.size());
   BLI_assert(*std::max_element(curve_indices.begin(), curve_indices.end()) < curves.curves_num());
@@ -186,8 +187,16 @@ Array<bke::curves::CurvePoint, 12> lookup_curve_points(const bke::CurvesGeometry
   const VArray<int8_t> curve_types = curves.curve_types();
 
   /* Compute curve lengths! */
-  curves.ensure_evaluated_lengths();
+  Vector<float> evaluated_lengths_buffer;
+  Span<float> evaluated_lengths;
+  if (use_precise_lengths) {
+    curves.ensure_evaluated_lengths_precise();
+  }
+  else {
+    evaluated_lengths = curves.evaluated_lengths(evaluated_lengths_buffer);
+  }
   curves.ensure_evaluated_offsets();
+  const VArray<int> evaluated_resolution = curves.evaluated_resolution();
 
   /* Find the curve points referenced by the input! */
   Array<bke::curves::CurvePoint, 12> lookups(curve_indices.size());
@@ -201,8 +210,10 @@ Array<bke::curves::CurvePoint, 12> lookup_curve_points(const bke::CurvesGeometry
         continue;
       }
 
-      const Span<float> accumulated_lengths = curves.evaluated_lengths_for_curve(curve_i,
-                                                                                 cyclic[curve_i]);
+      const Span<float> accumulated_lengths =
+          use_precise_lengths ?
+              curves.evaluated_lengths_precise_for_curve(curve_i, cyclic[curve_i]) :
+              evaluated_lengths.slice(curves.lengths_range_for_curve(curve_i, cyclic[curve_i]));
       BLI_assert(accumulated_lengths.size() > 0);
 
       const float sample_length = normalized_factors ?
@@ -235,7 +246,7 @@ Array<bke::curves::CurvePoint, 12> lookup_curve_points(const bke::CurvesGeometry
           lookups[lookup_index] = lookup_curve_point(accumulated_lengths,
                                                      sample_length,
                                                      cyclic[curve_i],
-                                                     resolution[curve_i],
+                                                     evaluated_resolution[curve_i],
                                                      point_count);
           break;
         }
@@ -902,7 +913,9 @@ static void convert_point_evaluated_curves(
     const Span<bke::curves::CurvePoint> evaluated_sample_points,
     MutableSpan<bke::AttributeTransferData> transfer_attributes)
 {
-  const Span<float3> src_eval_positions = src_curves.evaluated_positions();
+  Vector<float3> src_eval_positions_buffer;
+  const Span<float3> src_eval_positions = src_curves.evaluated_positions(
+      src_eval_positions_buffer);
   MutableSpan<float3> dst_positions = dst_curves.positions_for_write();
 
   threading::parallel_for(selection.index_range(), 4096, [&](const IndexRange range) {
@@ -1108,7 +1121,9 @@ static void trim_evaluated_curves(const bke::CurvesGeometry &src_curves,
                                   const Span<bke::curves::CurvePoint> end_points,
                                   MutableSpan<bke::AttributeTransferData> transfer_attributes)
 {
-  const Span<float3> src_eval_positions = src_curves.evaluated_positions();
+  Vector<float3> src_eval_positions_buffer;
+  const Span<float3> src_eval_positions = src_curves.evaluated_positions(
+      src_eval_positions_buffer);
   MutableSpan<float3> dst_positions = dst_curves.positions_for_write();
 
   threading::parallel_for(selection.index_range(), 512, [&](const IndexRange range) {
@@ -1227,9 +1242,8 @@ bke::CurvesGeometry trim_curves(const bke::CurvesGeometry &src_curves,
         src_curves, dst_curves, selection, start_points, end_points, transfer_attributes);
   };
   auto trim_evaluated = [&](IndexMask selection) {
-    /* Ensure evaluated positions are available. */
+    /* Ensure evaluated offsets are available. */
     src_curves.ensure_evaluated_offsets();
-    src_curves.evaluated_positions();
     trim_evaluated_curves(
         src_curves, dst_curves, selection, start_points, end_points, transfer_attributes);
   };
@@ -17,6 +17,15 @@ extern "C" {
 
 struct AnonymousAttributeID;
 
+#ifdef __cplusplus
+namespace blender {
+class ImplicitSharingInfo;
+}  // namespace blender
+using ImplicitSharingInfoHandle = blender::ImplicitSharingInfo;
+#else
+typedef struct ImplicitSharingInfoHandle ImplicitSharingInfoHandle;
+#endif
+
 /** Descriptor and storage for a custom data layer. */
 typedef struct CustomDataLayer {
   /** Type of data in layer. */
@@ -46,6 +55,11 @@ typedef struct CustomDataLayer {
    * automatically.
    */
   const struct AnonymousAttributeID *anonymous_id;
+  /**
+   * Run-time data that allows sharing the layer data with other layers. Only set when the data
+   * has been shared with another layer at some point, in that case it owns the data.
+   */
+  const ImplicitSharingInfoHandle *sharing_info;
 } CustomDataLayer;
 
 #define MAX_CUSTOMDATA_LAYER_NAME 64
@@ -82,10 +82,6 @@ typedef struct Mesh_Runtime {
   struct Mesh *mesh_eval;
   void *eval_mutex;
 
-  /* A separate mutex is needed for normal calculation, because sometimes
-   * the normals are needed while #eval_mutex is already locked. */
-  void *normals_mutex;
-
   /** Needed to ensure some thread-safety during render data pre-processing. */
   void *render_mutex;
 
@@ -144,10 +140,12 @@ typedef struct Mesh_Runtime {
    * Caches for lazily computed vertex and polygon normals. These are stored here rather than in
    * #CustomData because they can be calculated on a const mesh, and adding custom data layers on a
    * const mesh is not thread-safe.
+   *
+   * The #blender::CacheMutex for each array keeps track of whether it is dirty. They are separate
+   * from #eval_mutex, because sometimes the normals are needed while it is already locked.
    */
-  char _pad2[6];
-  char vert_normals_dirty;
-  char poly_normals_dirty;
+  void *vert_normals_cache_mutex;
+  void *poly_normals_cache_mutex;
   float (*vert_normals)[3];
   float (*poly_normals)[3];
 
@@ -156,6 +154,7 @@ typedef struct Mesh_Runtime {
    * subdivision surface modifier and used by drawing code instead of polygon center face dots.
    */
   uint32_t *subsurf_face_dot_tags;
+  void *_pad2;
 } Mesh_Runtime;
 
 typedef struct Mesh {
@@ -560,7 +560,12 @@
   }
 
 #define _DNA_DEFAULT_NodesModifierData \
-  { 0 }
+  { \
+    .flag = 0, \
+    .cache_memory_limit = 1024, \
+    .bake_directory = "", \
+    .bake_mode = NODES_MODIFIER_BAKE_NONE, \
+  }
 
 #define _DNA_DEFAULT_SkinModifierData \
   { \
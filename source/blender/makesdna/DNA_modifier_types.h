@@ -2295,9 +2295,33 @@ typedef struct NodesModifierData {
    * This can be used to help the user to debug a node tree.
    */
   void *runtime_eval_log;
-  void *_pad1;
+  /** Results of nodes that are reused in later evaluations, see #NODES_MODIFIER_USE_CACHE. */
+  void *runtime_cache;
+  /** #NodesModifierFlag. */
+  int flag;
+  /** Memory limit for the cached results in megabytes. */
+  int cache_memory_limit;
+  /** Directory that contains a bake file for every frame. 1024 = FILE_MAX. */
+  char bake_directory[1024];
+  /** #NodesModifierBakeMode. */
+  int bake_mode;
+  char _pad[4];
 } NodesModifierData;
 
+/** #NodesModifierData.flag */
+typedef enum NodesModifierFlag {
+  NODES_MODIFIER_USE_CACHE = (1 << 0),
+} NodesModifierFlag;
+
+/** #NodesModifierData.bake_mode */
+typedef enum NodesModifierBakeMode {
+  NODES_MODIFIER_BAKE_NONE = 0,
+  /** Write the result of every evaluated frame to the bake directory. */
+  NODES_MODIFIER_BAKE_WRITE = 1,
+  /** Load the result from the bake directory instead of evaluating the node group. */
+  NODES_MODIFIER_BAKE_READ = 2,
+} NodesModifierBakeMode;
+
 typedef struct MeshToVolumeModifierData {
   ModifierData modifier;
 
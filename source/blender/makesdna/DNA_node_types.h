@@ -1480,6 +1480,8 @@ typedef struct NodeGeometryCurvePrimitiveQuad {
 typedef struct NodeGeometryCurveResample {
   /* GeometryNodeCurveResampleMode. */
   uint8_t mode;
+  /* GeometryNodeCurveLengthFlag. */
+  uint8_t flag;
 } NodeGeometryCurveResample;
 
 typedef struct NodeGeometryCurveFillet {
@@ -1490,16 +1492,22 @@ typedef struct NodeGeometryCurveFillet {
 typedef struct NodeGeometryCurveTrim {
   /* GeometryNodeCurveSampleMode. */
   uint8_t mode;
+  /* GeometryNodeCurveLengthFlag. */
+  uint8_t flag;
 } NodeGeometryCurveTrim;
 
 typedef struct NodeGeometryCurveToPoints {
   /* GeometryNodeCurveResampleMode. */
   uint8_t mode;
+  /* GeometryNodeCurveLengthFlag. */
+  uint8_t flag;
 } NodeGeometryCurveToPoints;
 
 typedef struct NodeGeometryCurveSample {
   /* GeometryNodeCurveSampleMode. */
   uint8_t mode;
+  /* GeometryNodeCurveLengthFlag. */
+  uint8_t flag;
 } NodeGeometryCurveSample;
 
 typedef struct NodeGeometryTransferAttribute {
@@ -2291,6 +2299,11 @@ typedef enum GeometryNodeCurveSampleMode {
   GEO_NODE_CURVE_SAMPLE_LENGTH = 1,
 } GeometryNodeCurveSampleMode;
 
+typedef enum GeometryNodeCurveLengthFlag {
+  /** Measure lengths along the exact curve instead of along its evaluated points. */
+  GEO_NODE_CURVE_LENGTH_PRECISE = (1 << 0),
+} GeometryNodeCurveLengthFlag;
+
 typedef enum GeometryNodeCurveFilletMode {
   GEO_NODE_CURVE_FILLET_BEZIER = 0,
   GEO_NODE_CURVE_FILLET_POLY = 1,
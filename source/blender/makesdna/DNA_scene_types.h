@@ -790,6 +790,7 @@ typedef struct RenderData {
 /** #RenderData.quality_flag */
 typedef enum eQualityOption {
   SCE_PERF_HQ_NORMALS = (1 << 0),
+  SCE_PERF_COMPACT_CURVES_CACHES = (1 << 1),
 } eQualityOption;
 
 /** #RenderData.hair_type */
@@ -6994,6 +6994,21 @@ static void rna_def_modifier_nodes(BlenderRNA *brna)
   StructRNA *srna;
   PropertyRNA *prop;
 
+  static const EnumPropertyItem bake_mode_items[] = {
+      {NODES_MODIFIER_BAKE_NONE, "NONE", 0, "Disabled", "Always evaluate the node group"},
+      {NODES_MODIFIER_BAKE_WRITE,
+       "WRITE",
+       0,
+       "Write",
+       "Write the geometry of every evaluated frame to the bake directory"},
+      {NODES_MODIFIER_BAKE_READ,
+       "READ",
+       0,
+       "Read",
+       "Load the geometry from the bake directory, frames that are not baked are evaluated"},
+      {0, NULL, 0, NULL, NULL},
+  };
+
   srna = RNA_def_struct(brna, "NodesModifier", "Modifier");
   RNA_def_struct_ui_text(srna, "Nodes Modifier", "");
   RNA_def_struct_sdna(srna, "NodesModifierData");
@@ -7008,6 +7023,31 @@ static void rna_def_modifier_nodes(BlenderRNA *brna)
   RNA_def_property_flag(prop, PROP_EDITABLE);
   RNA_def_property_update(prop, 0, "rna_NodesModifier_node_group_update");
 
+  prop = RNA_def_property(srna, "use_cache", PROP_BOOLEAN, PROP_NONE);
+  RNA_def_property_boolean_sdna(prop, NULL, "flag", NODES_MODIFIER_USE_CACHE);
+  RNA_def_property_ui_text(prop,
+                           "Use Cache",
+                           "Keep the results of expensive nodes and reuse them in later "
+                           "evaluations when their inputs did not change");
+  RNA_def_property_update(prop, 0, "rna_Modifier_update");
+
+  prop = RNA_def_property(srna, "cache_memory_limit", PROP_INT, PROP_NONE);
+  RNA_def_property_range(prop, 1, INT_MAX);
+  RNA_def_property_ui_range(prop, 1, 65536, 64, -1);
+  RNA_def_property_ui_text(
+      prop, "Cache Memory Limit", "Maximum memory used by the cached results in megabytes");
+  RNA_def_property_update(prop, 0, "rna_Modifier_update");
+
+  prop = RNA_def_property(srna, "bake_mode", PROP_ENUM, PROP_NONE);
+  RNA_def_property_enum_items(prop, bake_mode_items);
+  RNA_def_property_ui_text(prop, "Bake Mode", "How the bake directory is used");
+  RNA_def_property_update(prop, 0, "rna_Modifier_update");
+
+  prop = RNA_def_property(srna, "bake_directory", PROP_STRING, PROP_DIRPATH);
+  RNA_def_property_ui_text(
+      prop, "Bake Directory", "Directory that contains the baked geometry of every frame");
+  RNA_def_property_update(prop, 0, "rna_Modifier_update");
+
   RNA_define_lib_overridable(false);
 }
 
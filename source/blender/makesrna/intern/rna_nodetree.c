@@ -9427,6 +9427,19 @@ static void def_geo_curve_primitive_bezier_segment(StructRNA *srna)
   RNA_def_property_update(prop, NC_NODE | NA_EDITED, "rna_Node_socket_update");
 }
 
+/* Must be called after #RNA_def_struct_sdna_from for a storage struct with a "flag" member. */
+static void def_geo_curve_precise_length(StructRNA *srna)
+{
+  PropertyRNA *prop = RNA_def_property(srna, "use_precise_length", PROP_BOOLEAN, PROP_NONE);
+  RNA_def_property_boolean_sdna(prop, NULL, "flag", GEO_NODE_CURVE_LENGTH_PRECISE);
+  RNA_def_property_ui_text(prop,
+                           "Precise Length",
+                           "Measure lengths along the exact curve instead of along its evaluated "
+                           "points, so that the result doesn't depend on the resolution of Bezier "
+                           "and NURBS curves");
+  RNA_def_property_update(prop, NC_NODE | NA_EDITED, "rna_Node_update");
+}
+
 static void def_geo_curve_sample(StructRNA *srna)
 {
   static EnumPropertyItem mode_items[] = {
@@ -9449,6 +9462,8 @@ static void def_geo_curve_sample(StructRNA *srna)
   RNA_def_property_enum_items(prop, mode_items);
   RNA_def_property_ui_text(prop, "Mode", "Method for sampling input");
   RNA_def_property_update(prop, NC_NODE | NA_EDITED, "rna_Node_socket_update");
+
+  def_geo_curve_precise_length(srna);
 }
 
 static void def_geo_triangulate(StructRNA *srna)
@@ -10301,6 +10316,8 @@ static void def_geo_curve_resample(StructRNA *srna)
   RNA_def_property_enum_items(prop, mode_items);
   RNA_def_property_ui_text(prop, "Mode", "How to specify the amount of samples");
   RNA_def_property_update(prop, NC_NODE | NA_EDITED, "rna_Node_socket_update");
+
+  def_geo_curve_precise_length(srna);
 }
 
 static void def_geo_curve_fillet(StructRNA *srna)
@@ -10359,6 +10376,8 @@ static void def_geo_curve_to_points(StructRNA *srna)
   RNA_def_property_enum_items(prop, mode_items);
   RNA_def_property_ui_text(prop, "Mode", "How to generate points from the input curve");
   RNA_def_property_update(prop, NC_NODE | NA_EDITED, "rna_Node_socket_update");
+
+  def_geo_curve_precise_length(srna);
 }
 
 static void def_geo_mesh_to_points(StructRNA *srna)
@@ -10421,6 +10440,8 @@ static void def_geo_curve_trim(StructRNA *srna)
   RNA_def_property_enum_items(prop, mode_items);
   RNA_def_property_ui_text(prop, "Mode", "How to find endpoint positions for the trimmed spline");
   RNA_def_property_update(prop, NC_NODE | NA_EDITED, "rna_Node_socket_update");
+
+  def_geo_curve_precise_length(srna);
 }
 
 static void def_geo_transfer_attribute(StructRNA *srna)
@@ -1711,6 +1711,22 @@ static void rna_Scene_mesh_quality_update(Main *bmain, Scene *UNUSED(scene), Poi
   rna_Scene_render_update(bmain, scene, ptr);
 }
 
+static void rna_Scene_curves_cache_quality_update(Main *bmain,
+                                                  Scene *UNUSED(scene),
+                                                  PointerRNA *ptr)
+{
+  Scene *scene = (Scene *)ptr->owner_id;
+
+  FOREACH_SCENE_OBJECT_BEGIN (scene, ob) {
+    if (ob->type == OB_CURVES) {
+      DEG_id_tag_update(&ob->id, ID_RECALC_GEOMETRY);
+    }
+  }
+  FOREACH_SCENE_OBJECT_END;
+
+  rna_Scene_render_update(bmain, scene, ptr);
+}
+
 void rna_Scene_freestyle_update(Main *UNUSED(bmain), Scene *UNUSED(scene), PointerRNA *ptr)
 {
   Scene *scene = (Scene *)ptr->owner_id;
@@ -1929,6 +1945,11 @@ static void object_simplify_update(Object *ob)
     }
   }
 
+  if (ob->type == OB_CURVES) {
+    /* Compacting the evaluated caches depends on simplify. */
+    DEG_id_tag_update(&ob->id, ID_RECALC_GEOMETRY);
+  }
+
   for (psys = ob->particlesystem.first; psys; psys = psys->next) {
     psys->recalc |= ID_RECALC_PSYS_CHILD;
   }
@@ -6433,6 +6454,16 @@ static void rna_def_scene_render_data(BlenderRNA *brna)
                            "Use high quality tangent space at the cost of lower performance");
   RNA_def_property_update(prop, NC_SCENE | ND_RENDER_OPTIONS, "rna_Scene_mesh_quality_update");
 
+  prop = RNA_def_property(srna, "use_compact_curves_caches", PROP_BOOLEAN, PROP_NONE);
+  RNA_def_property_boolean_sdna(prop, NULL, "perf_flag", SCE_PERF_COMPACT_CURVES_CACHES);
+  RNA_def_property_ui_text(prop,
+                           "Compact Curves Caches",
+                           "Store the evaluated positions, tangents, normals and lengths of "
+                           "curves objects with lower precision in the viewport when simplify "
+                           "is enabled, to use less memory");
+  RNA_def_property_update(
+      prop, NC_SCENE | ND_RENDER_OPTIONS, "rna_Scene_curves_cache_quality_update");
+
   /* border */
   prop = RNA_def_property(srna, "use_border", PROP_BOOLEAN, PROP_NONE);
   RNA_def_property_boolean_sdna(prop, NULL, "mode", R_BORDER);
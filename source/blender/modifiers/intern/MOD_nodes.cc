@@ -7,6 +7,9 @@
 
 #include <cstring>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
 
 #include "MEM_guardedalloc.h"
@@ -15,6 +18,7 @@
 #include "BLI_listbase.h"
 #include "BLI_math_vec_types.hh"
 #include "BLI_multi_value_map.hh"
+#include "BLI_path_util.h"
 #include "BLI_set.hh"
 #include "BLI_string.h"
 #include "BLI_string_search.h"
@@ -38,6 +42,7 @@
 #include "BKE_attribute_math.hh"
 #include "BKE_compute_contexts.hh"
 #include "BKE_customdata.h"
+#include "BKE_geometry_bake.hh"
 #include "BKE_geometry_fields.hh"
 #include "BKE_geometry_set_instances.hh"
 #include "BKE_global.h"
@@ -82,6 +87,7 @@
 #include "ED_undo.h"
 
 #include "NOD_geometry.h"
+#include "NOD_geometry_nodes_cache.hh"
 #include "NOD_geometry_nodes_lazy_function.hh"
 #include "NOD_node_declaration.hh"
 
@@ -122,6 +128,7 @@ using blender::fn::ValueOrField;
 using blender::fn::ValueOrFieldCPPType;
 using blender::nodes::FieldInferencingInterface;
 using blender::nodes::GeoNodeExecParams;
+using blender::nodes::GeometryNodesCache;
 using blender::nodes::InputSocketFieldType;
 using blender::nodes::geo_eval_log::GeoModifierLog;
 using blender::threading::EnumerableThreadSpecific;
@@ -953,12 +960,89 @@ static void find_side_effect_nodes(
   }
 }
 
+/**
+ * The cache is stored on the original modifier, so that it is kept when the evaluated copy is
+ * recreated, e.g. when a modifier input changes. It is shared with every running evaluation,
+ * because the same original modifier can be evaluated by multiple depsgraphs at the same time.
+ * The pointer stored in the modifier is protected by this mutex.
+ */
+static std::mutex runtime_cache_mutex;
+
+using GeometryNodesCachePtr = std::shared_ptr<GeometryNodesCache>;
+
 static void clear_runtime_data(NodesModifierData *nmd)
 {
   if (nmd->runtime_eval_log != nullptr) {
     delete static_cast<GeoModifierLog *>(nmd->runtime_eval_log);
     nmd->runtime_eval_log = nullptr;
   }
+  std::lock_guard lock{runtime_cache_mutex};
+  if (nmd->runtime_cache != nullptr) {
+    /* Evaluations that still use the cache keep it alive until they are done. */
+    delete static_cast<GeometryNodesCachePtr *>(nmd->runtime_cache);
+    nmd->runtime_cache = nullptr;
+  }
+}
+
+/** Returns null when caching is disabled. */
+static GeometryNodesCachePtr ensure_cache(const NodesModifierData &nmd,
+                                          const ModifierEvalContext &ctx)
+{
+  NodesModifierData *nmd_orig = reinterpret_cast<NodesModifierData *>(
+      BKE_modifier_get_original(ctx.object, const_cast<ModifierData *>(&nmd.modifier)));
+  const int64_t memory_limit = int64_t(nmd.cache_memory_limit) * 1024 * 1024;
+
+  std::lock_guard lock{runtime_cache_mutex};
+  GeometryNodesCachePtr *cache = static_cast<GeometryNodesCachePtr *>(nmd_orig->runtime_cache);
+  if (!(nmd.flag & NODES_MODIFIER_USE_CACHE)) {
+    if (cache != nullptr) {
+      /* Release the kept results, the cache itself is only freed with the modifier. */
+      (*cache)->set_memory_limit(0);
+    }
+    return nullptr;
+  }
+  if (cache == nullptr) {
+    cache = new GeometryNodesCachePtr(std::make_shared<GeometryNodesCache>(memory_limit));
+    nmd_orig->runtime_cache = cache;
+  }
+  else {
+    (*cache)->set_memory_limit(memory_limit);
+  }
+  return *cache;
+}
+
+/**
+ * Every frame is baked to a separate file in the bake directory. Subframes, e.g. for motion blur,
+ * get their own files too, with the subframe in ten-thousandths after the frame number. Returns
+ * none when no bake directory is set.
+ */
+static std::optional<std::string> get_bake_filepath(const NodesModifierData &nmd,
+                                                    const ModifierEvalContext &ctx)
+{
+  if (nmd.bake_directory[0] == '\0') {
+    return std::nullopt;
+  }
+  char directory[FILE_MAX];
+  STRNCPY(directory, nmd.bake_directory);
+  BLI_path_abs(directory, BKE_modifier_path_relbase_from_global(ctx.object));
+
+  const int64_t subframes_per_frame = 10000;
+  const double ctime = DEG_get_ctime(ctx.depsgraph);
+  const int64_t time = int64_t(llround(ctime * subframes_per_frame));
+  /* Round down for negative frames as well, so that the subframe is never negative. */
+  const int64_t frame = (time >= 0 ? time : time - subframes_per_frame + 1) / subframes_per_frame;
+  const int64_t subframe = time - frame * subframes_per_frame;
+  char filename[64];
+  if (subframe == 0) {
+    BLI_snprintf(filename, sizeof(filename), "frame_%06d.geobake", int(frame));
+  }
+  else {
+    BLI_snprintf(filename, sizeof(filename), "frame_%06d.%04d.geobake", int(frame), int(subframe));
+  }
+
+  char filepath[FILE_MAX];
+  BLI_path_join(filepath, sizeof(filepath), directory, filename, nullptr);
+  return std::string(filepath);
 }
 
 struct OutputAttributeInfo {
@@ -1147,20 +1231,41 @@ static GeometrySet compute_geometry(
 
   blender::nodes::GeometryNodesLazyFunctionLogger lf_logger(lf_graph_info);
   blender::nodes::GeometryNodesLazyFunctionSideEffectProvider lf_side_effect_provider;
+  blender::nodes::GeometryNodesLazyFunctionNodeCostProvider lf_node_cost_provider(lf_graph_info);
 
-  lf::GraphExecutor graph_executor{
-      lf_graph_info.graph, graph_inputs, graph_outputs, &lf_logger, &lf_side_effect_provider};
+  lf::GraphExecutor graph_executor{lf_graph_info.graph,
+                                   graph_inputs,
+                                   graph_outputs,
+                                   &lf_logger,
+                                   &lf_side_effect_provider,
+                                   &lf_node_cost_provider};
 
   blender::nodes::GeoNodesModifierData geo_nodes_modifier_data;
   geo_nodes_modifier_data.depsgraph = ctx->depsgraph;
   geo_nodes_modifier_data.self_object = ctx->object;
   auto eval_log = std::make_unique<GeoModifierLog>();
+  Map<blender::ComputeContextHash, std::chrono::nanoseconds> node_run_times;
   if (logging_enabled(ctx)) {
     geo_nodes_modifier_data.eval_log = eval_log.get();
+    /* Use the run times of the previous evaluation to schedule expensive nodes first. */
+    NodesModifierData *nmd_orig = reinterpret_cast<NodesModifierData *>(
+        BKE_modifier_get_original(ctx->object, &nmd->modifier));
+    if (nmd_orig->runtime_eval_log != nullptr) {
+      node_run_times =
+          static_cast<GeoModifierLog *>(nmd_orig->runtime_eval_log)->get_node_run_times();
+      geo_nodes_modifier_data.node_run_times = &node_run_times;
+    }
   }
   MultiValueMap<blender::ComputeContextHash, const lf::FunctionNode *> r_side_effect_nodes;
   find_side_effect_nodes(*nmd, *ctx, btree, r_side_effect_nodes);
   geo_nodes_modifier_data.side_effect_nodes = &r_side_effect_nodes;
+  const GeometryNodesCachePtr cache = ensure_cache(*nmd, *ctx);
+  GeometryNodesCache::Evaluation cache_evaluation;
+  if (cache) {
+    cache->begin_evaluation(cache_evaluation, input_geometry_set);
+  }
+  geo_nodes_modifier_data.cache = cache.get();
+  geo_nodes_modifier_data.cache_evaluation = &cache_evaluation;
   blender::nodes::GeoNodesLFUserData user_data;
   user_data.modifier_data = &geo_nodes_modifier_data;
   blender::bke::ModifierComputeContext modifier_compute_context{nullptr, nmd->modifier.name};
@@ -1203,6 +1308,10 @@ static GeometrySet compute_geometry(
   graph_executor.execute(lf_params, lf_context);
   graph_executor.destruct_storage(lf_context.storage);
 
+  if (cache) {
+    cache->end_evaluation(cache_evaluation);
+  }
+
   for (GMutablePointer &ptr : inputs_to_destruct) {
     ptr.destruct();
   }
@@ -1322,8 +1431,25 @@ static void modifyGeometry(ModifierData *md,
     use_orig_index_polys = CustomData_has_layer(&mesh.pdata, CD_ORIGINDEX);
   }
 
-  geometry_set = compute_geometry(
-      tree, *lf_graph_info, *output_node, std::move(geometry_set), nmd, ctx);
+  const std::optional<std::string> bake_filepath = get_bake_filepath(*nmd, *ctx);
+  std::optional<GeometrySet> baked_geometry;
+  if (nmd->bake_mode == NODES_MODIFIER_BAKE_READ && bake_filepath) {
+    /* Frames that were not baked are evaluated as usual. */
+    baked_geometry = blender::bke::geometry_bake_read(bake_filepath->c_str());
+  }
+
+  if (baked_geometry) {
+    geometry_set = std::move(*baked_geometry);
+  }
+  else {
+    geometry_set = compute_geometry(
+        tree, *lf_graph_info, *output_node, std::move(geometry_set), nmd, ctx);
+    if (nmd->bake_mode == NODES_MODIFIER_BAKE_WRITE && bake_filepath) {
+      if (!blender::bke::geometry_bake_write(geometry_set, bake_filepath->c_str())) {
+        BKE_modifier_set_error(ctx->object, md, "Could not write bake file");
+      }
+    }
+  }
 
   if (geometry_set.has_mesh()) {
     /* Add #CD_ORIGINDEX layers if they don't exist already. This is required because the
@@ -1822,6 +1948,59 @@ static void internal_dependencies_panel_draw(const bContext *UNUSED(C), Panel *p
   }
 }
 
+static void cache_panel_header_draw(const bContext *UNUSED(C), Panel *panel)
+{
+  uiLayout *layout = panel->layout;
+
+  PointerRNA *ptr = modifier_panel_get_property_pointers(panel, nullptr);
+
+  uiItemR(layout, ptr, "use_cache", 0, IFACE_("Cache"), ICON_NONE);
+}
+
+static void cache_panel_draw(const bContext *UNUSED(C), Panel *panel)
+{
+  uiLayout *layout = panel->layout;
+
+  PointerRNA *ptr = modifier_panel_get_property_pointers(panel, nullptr);
+  NodesModifierData *nmd = static_cast<NodesModifierData *>(ptr->data);
+
+  uiLayoutSetPropSep(layout, true);
+
+  uiLayout *col = uiLayoutColumn(layout, false);
+  uiLayoutSetActive(col, RNA_boolean_get(ptr, "use_cache"));
+  uiItemR(col, ptr, "cache_memory_limit", 0, IFACE_("Memory Limit"), ICON_NONE);
+
+  /* The UI shows the original modifier, which owns the cache. */
+  std::optional<int64_t> memory_usage;
+  {
+    std::lock_guard lock{runtime_cache_mutex};
+    if (const GeometryNodesCachePtr *cache = static_cast<const GeometryNodesCachePtr *>(
+            nmd->runtime_cache)) {
+      memory_usage = (*cache)->memory_usage();
+    }
+  }
+  if (memory_usage) {
+    char memory_str[15];
+    BLI_str_format_byte_unit(memory_str, *memory_usage, false);
+    const std::string label = std::string(IFACE_("Memory Usage: ")) + memory_str;
+    uiItemL(col, label.c_str(), ICON_NONE);
+  }
+}
+
+static void bake_panel_draw(const bContext *UNUSED(C), Panel *panel)
+{
+  uiLayout *layout = panel->layout;
+
+  PointerRNA *ptr = modifier_panel_get_property_pointers(panel, nullptr);
+
+  uiLayoutSetPropSep(layout, true);
+
+  uiItemR(layout, ptr, "bake_mode", 0, IFACE_("Mode"), ICON_NONE);
+  uiLayout *col = uiLayoutColumn(layout, false);
+  uiLayoutSetActive(col, RNA_enum_get(ptr, "bake_mode") != NODES_MODIFIER_BAKE_NONE);
+  uiItemR(col, ptr, "bake_directory", 0, IFACE_("Directory"), ICON_NONE);
+}
+
 static void panelRegister(ARegionType *region_type)
 {
   PanelType *panel_type = modifier_panel_register(region_type, eModifierType_Nodes, panel_draw);
@@ -1837,6 +2016,10 @@ static void panelRegister(ARegionType *region_type)
                              nullptr,
                              internal_dependencies_panel_draw,
                              panel_type);
+  modifier_subpanel_register(
+      region_type, "cache", "", cache_panel_header_draw, cache_panel_draw, panel_type);
+  modifier_subpanel_register(
+      region_type, "bake", N_("Bake"), nullptr, bake_panel_draw, panel_type);
 }
 
 static void blendWrite(BlendWriter *writer, const ID *UNUSED(id_owner), const ModifierData *md)
@@ -1863,6 +2046,7 @@ static void blendRead(BlendDataReader *reader, ModifierData *md)
     IDP_BlendDataRead(reader, &nmd->settings.properties);
   }
   nmd->runtime_eval_log = nullptr;
+  nmd->runtime_cache = nullptr;
 }
 
 static void copyData(const ModifierData *md, ModifierData *target, const int flag)
@@ -1873,6 +2057,7 @@ static void copyData(const ModifierData *md, ModifierData *target, const int fla
   BKE_modifier_copydata_generic(md, target, flag);
 
   tnmd->runtime_eval_log = nullptr;
+  tnmd->runtime_cache = nullptr;
 
   if (nmd->settings.properties != nullptr) {
     tnmd->settings.properties = IDP_CopyProperty_ex(nmd->settings.properties, flag);
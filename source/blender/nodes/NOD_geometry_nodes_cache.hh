@@ -0,0 +1,134 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#pragma once
+
+/**
+ * Geometry nodes can keep the results of nodes between evaluations of the same modifier. That
+ * way, scrubbing the timeline or changing nodes further downstream does not have to recompute
+ * expensive operations like boolean or distribute when their inputs did not change.
+ *
+ * A result is identified by a hash of the node, its compute context and all of its input values.
+ * Simple values like numbers are hashed directly. Geometries and fields don't have a cheap content
+ * hash, so they are identified by the data they reference instead. Every geometry component and
+ * field node in a result computed from identified inputs gets a version hash that is derived from
+ * the hash of that result. The geometry passed into the modifier gets a version based on a hash of
+ * its content. Inputs that can't be identified, like objects or fields built by nodes that were
+ * not cached, make the node uncacheable for that evaluation.
+ *
+ * Identifying data by its pointer is only valid as long as the data can't be changed or freed. The
+ * cache therefore keeps a reference to all data it has a version for. Shared geometry components
+ * are immutable, so any node that wants to modify them has to make a copy first.
+ *
+ * The same modifier can be evaluated by multiple dependency graphs at the same time, e.g. for the
+ * viewport and a final render. Data that is only referenced during an evaluation is therefore
+ * tracked separately for every #GeometryNodesCache::Evaluation.
+ */
+
+#include <mutex>
+
+#include "BLI_compute_context.hh"
+#include "BLI_generic_pointer.hh"
+#include "BLI_linear_allocator.hh"
+#include "BLI_map.hh"
+#include "BLI_utility_mixins.hh"
+#include "BLI_vector.hh"
+
+#include "BKE_geometry_set.hh"
+
+namespace blender::nodes {
+
+class GeometryNodesCache : NonCopyable, NonMovable {
+ public:
+  /** The same kind of hash that is used to identify compute contexts. */
+  using Hash = ComputeContextHash;
+
+ private:
+  struct Entry {
+    LinearAllocator<> allocator;
+    Vector<GMutablePointer> values;
+    int64_t size_in_bytes = 0;
+    /** Used to find the least recently used entry when the memory limit is exceeded. */
+    uint64_t last_used = 0;
+
+    ~Entry();
+  };
+
+  struct Version {
+    Hash hash;
+    /** The number of entries that keep the data alive. */
+    int users;
+  };
+
+  mutable std::mutex mutex_;
+  /** Results that are kept after the evaluation that computed them. */
+  Map<Hash, std::unique_ptr<Entry>> entries_;
+  /**
+   * Versions of the geometry components and field nodes referenced by all entries, including the
+   * entries of evaluations that are still running.
+   */
+  Map<const void *, Version> versions_;
+  int64_t memory_limit_;
+  int64_t memory_usage_ = 0;
+  uint64_t use_counter_ = 0;
+
+ public:
+  /**
+   * Values that are only referenced until the end of one evaluation of the modifier. Results of
+   * nodes that are cheap to compute are only kept here, so that nodes further downstream can
+   * still be identified.
+   */
+  class Evaluation : NonCopyable, NonMovable {
+   private:
+    friend GeometryNodesCache;
+    Vector<std::unique_ptr<Entry>> entries_;
+
+   public:
+    ~Evaluation()
+    {
+      /* #GeometryNodesCache::end_evaluation has to release the versions of the entries. */
+      BLI_assert(entries_.is_empty());
+    }
+  };
+
+  /** Results of nodes that take less time than this are not kept after an evaluation. */
+  static constexpr double min_execution_seconds = 0.001;
+
+  GeometryNodesCache(int64_t memory_limit);
+  ~GeometryNodesCache();
+
+  void set_memory_limit(int64_t memory_limit);
+  int64_t memory_usage() const;
+
+  /**
+   * Compute a hash that identifies the value, or return none if that is not possible.
+   */
+  std::optional<Hash> hash_value(GPointer value) const;
+
+  /**
+   * Copy the values of the result with the given key into the uninitialized buffers.
+   * \return False if there is no such result.
+   */
+  bool lookup(const Hash &key, Span<void *> r_values);
+
+  /**
+   * Add a result that was computed for the given key. The values are copied.
+   * \param keep: Keep the result after the evaluation, otherwise it is only referenced by it.
+   */
+  void add(const Hash &key, Span<GPointer> values, bool keep, Evaluation &evaluation);
+
+  /**
+   * Give the geometry that is passed into the modifier a version based on its content. Nothing is
+   * done if the content can't be hashed.
+   */
+  void begin_evaluation(Evaluation &evaluation, const GeometrySet &input_geometry);
+  /** Release the data that was only referenced during the evaluation. */
+  void end_evaluation(Evaluation &evaluation);
+
+ private:
+  void add_versions(const Entry &entry, const Hash &hash);
+  void remove_versions(const Entry &entry);
+  void remove_least_recently_used();
+  void free_memory_to_limit();
+};
+
+}  // namespace blender::nodes
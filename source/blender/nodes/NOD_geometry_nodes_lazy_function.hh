@@ -21,6 +21,7 @@
 #include "FN_lazy_function_graph.hh"
 #include "FN_lazy_function_graph_executor.hh"
 
+#include "NOD_geometry_nodes_cache.hh"
 #include "NOD_geometry_nodes_log.hh"
 #include "NOD_multi_function.hh"
 
@@ -49,6 +50,15 @@ struct GeoNodesModifierData {
    * the node groups they are contained in).
    */
   const MultiValueMap<ComputeContextHash, const lf::FunctionNode *> *side_effect_nodes;
+  /** Optional cache for results of nodes that is kept between evaluations. */
+  GeometryNodesCache *cache = nullptr;
+  /** Data referenced by the cache during this evaluation, set when #cache is. */
+  GeometryNodesCache::Evaluation *cache_evaluation = nullptr;
+  /**
+   * Optional run times of the nodes in the previous evaluation, which are used to schedule the
+   * most expensive nodes first. See #GeoModifierLog::get_node_run_times.
+   */
+  const Map<ComputeContextHash, std::chrono::nanoseconds> *node_run_times = nullptr;
 };
 
 /**
@@ -90,6 +100,11 @@ struct GeometryNodeLazyFunctionGraphMapping {
    */
   Map<const bNode *, const lf::FunctionNode *> group_node_map;
   Map<const bNode *, const lf::FunctionNode *> viewer_node_map;
+  /**
+   * Geometry and group nodes, whose run time is logged. This is used to find the run time of a
+   * node in a previous evaluation.
+   */
+  Map<const lf::FunctionNode *, const bNode *> bnode_by_timed_lf_node;
 };
 
 /**
@@ -170,6 +185,24 @@ class GeometryNodesLazyFunctionSideEffectProvider
       const lf::Context &context) const override;
 };
 
+/**
+ * Estimates how long nodes take to execute based on their run times in the previous evaluation of
+ * the modifier, so that the lazy-function graph executor can evaluate the expensive parts of the
+ * node tree first.
+ */
+class GeometryNodesLazyFunctionNodeCostProvider
+    : public fn::lazy_function::GraphExecutor::NodeCostProvider {
+ private:
+  const GeometryNodesLazyFunctionGraphInfo &lf_graph_info_;
+
+ public:
+  GeometryNodesLazyFunctionNodeCostProvider(
+      const GeometryNodesLazyFunctionGraphInfo &lf_graph_info);
+
+  std::chrono::nanoseconds get_node_cost(const lf::FunctionNode &node,
+                                         const lf::Context &context) const override;
+};
+
 /**
  * Main function that converts a #bNodeTree into a lazy-function graph. If the graph has been
  * generated already, nothing is done. Under some circumstances a valid graph cannot be created. In
@@ -329,6 +329,15 @@ class GeoModifierLog {
    */
   GeoTreeLog &get_tree_log(const ComputeContextHash &compute_context_hash);
 
+  /**
+   * Get the run time of every node in every compute context, with keys created by
+   * #node_run_time_key. Like in #GeoNodeLog, the run time of a group node is the sum of the run
+   * times of the nodes inside.
+   */
+  Map<ComputeContextHash, std::chrono::nanoseconds> get_node_run_times();
+  static ComputeContextHash node_run_time_key(const ComputeContextHash &compute_context_hash,
+                                              StringRef node_name);
+
   /**
    * Utility accessor to logged data.
    */
@@ -145,6 +145,7 @@ static Mesh *compute_hull(const GeometrySet &geometry_set)
   int total_num = 0;
 
   Span<float3> positions_span;
+  Vector<float3> curve_positions_buffer;
 
   if (const MeshComponent *component = geometry_set.get_component_for_read<MeshComponent>()) {
     count++;
@@ -175,7 +176,7 @@ static Mesh *compute_hull(const GeometrySet &geometry_set)
     count++;
     span_count++;
     const bke::CurvesGeometry &curves = bke::CurvesGeometry::wrap(curves_id->geometry);
-    positions_span = curves.evaluated_positions();
+    positions_span = curves.evaluated_positions(curve_positions_buffer);
     total_num += positions_span.size();
   }
 
@@ -211,7 +212,7 @@ static Mesh *compute_hull(const GeometrySet &geometry_set)
 
   if (const Curves *curves_id = geometry_set.get_curves_for_read()) {
     const bke::CurvesGeometry &curves = bke::CurvesGeometry::wrap(curves_id->geometry);
-    Span<float3> array = curves.evaluated_positions();
+    Span<float3> array = curves.evaluated_positions(curve_positions_buffer);
     positions.as_mutable_span().slice(offset, array.size()).copy_from(array);
     offset += array.size();
   }
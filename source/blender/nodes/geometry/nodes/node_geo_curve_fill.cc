@@ -48,7 +48,8 @@ static meshintersect::CDT_result<double> do_cdt(const bke::CurvesGeometry &curve
   input.vert.reinitialize(curves.evaluated_points_num());
   input.face.reinitialize(curves.curves_num());
 
-  Span<float3> positions = curves.evaluated_positions();
+  Vector<float3> positions_buffer;
+  Span<float3> positions = curves.evaluated_positions(positions_buffer);
 
   for (const int i_curve : curves.curves_range()) {
     const IndexRange points = curves.evaluated_points_for_curve(i_curve);
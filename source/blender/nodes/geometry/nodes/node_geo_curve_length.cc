@@ -24,11 +24,15 @@ static void node_geo_exec(GeoNodeExecParams params)
   const bke::CurvesGeometry &curves = bke::CurvesGeometry::wrap(curves_id.geometry);
   const VArray<bool> cyclic = curves.cyclic();
 
-  curves.ensure_evaluated_lengths();
+  Vector<float> evaluated_lengths_buffer;
+  const Span<float> evaluated_lengths = curves.evaluated_lengths(evaluated_lengths_buffer);
 
   float length = 0.0f;
   for (const int i : curves.curves_range()) {
-    length += curves.evaluated_length_total_for_curve(i, cyclic[i]);
+    const IndexRange lengths_range = curves.lengths_range_for_curve(i, cyclic[i]);
+    if (!lengths_range.is_empty()) {
+      length += evaluated_lengths[lengths_range.last()];
+    }
   }
 
   params.set_output("Length", length);
@@ -29,6 +29,9 @@ static void node_declare(NodeDeclarationBuilder &b)
 static void node_layout(uiLayout *layout, bContext *UNUSED(C), PointerRNA *ptr)
 {
   uiItemR(layout, ptr, "mode", 0, "", ICON_NONE);
+  if (RNA_enum_get(ptr, "mode") != GEO_NODE_CURVE_RESAMPLE_EVALUATED) {
+    uiItemR(layout, ptr, "use_precise_length", 0, nullptr, ICON_NONE);
+  }
 }
 
 static void node_init(bNodeTree *UNUSED(tree), bNode *node)
@@ -57,6 +60,7 @@ static void node_geo_exec(GeoNodeExecParams params)
 
   const NodeGeometryCurveResample &storage = node_storage(params.node());
   const GeometryNodeCurveResampleMode mode = (GeometryNodeCurveResampleMode)storage.mode;
+  const bool use_precise_lengths = storage.flag & GEO_NODE_CURVE_LENGTH_PRECISE;
 
   const Field<bool> selection = params.extract_input<Field<bool>>("Selection");
 
@@ -70,7 +74,7 @@ static void node_geo_exec(GeoNodeExecParams params)
           const bke::CurvesGeometry &src_curves = bke::CurvesGeometry::wrap(
               src_curves_id->geometry);
           bke::CurvesGeometry dst_curves = geometry::resample_to_count(
-              src_curves, selection, count);
+              src_curves, selection, count, use_precise_lengths);
           Curves *dst_curves_id = bke::curves_new_nomain(std::move(dst_curves));
           bke::curves_copy_parameters(*src_curves_id, *dst_curves_id);
           geometry.replace_curves(dst_curves_id);
@@ -85,7 +89,7 @@ static void node_geo_exec(GeoNodeExecParams params)
           const bke::CurvesGeometry &src_curves = bke::CurvesGeometry::wrap(
               src_curves_id->geometry);
           bke::CurvesGeometry dst_curves = geometry::resample_to_length(
-              src_curves, selection, length);
+              src_curves, selection, length, use_precise_lengths);
           Curves *dst_curves_id = bke::curves_new_nomain(std::move(dst_curves));
           bke::curves_copy_parameters(*src_curves_id, *dst_curves_id);
           geometry.replace_curves(dst_curves_id);
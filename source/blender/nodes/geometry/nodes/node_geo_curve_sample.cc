@@ -38,6 +38,7 @@ static void node_declare(NodeDeclarationBuilder &b)
 static void node_layout(uiLayout *layout, bContext *UNUSED(C), PointerRNA *ptr)
 {
   uiItemR(layout, ptr, "mode", UI_ITEM_R_EXPAND, nullptr, ICON_NONE);
+  uiItemR(layout, ptr, "use_precise_length", 0, nullptr, ICON_NONE);
 }
 
 static void node_type_init(bNodeTree *UNUSED(tree), bNode *node)
@@ -153,9 +154,11 @@ class SampleCurveFunction : public fn::MultiFunction {
    * that the curve is not freed before the function can execute.
    */
   GeometrySet geometry_set_;
+  bool use_precise_lengths_;
 
  public:
-  SampleCurveFunction(GeometrySet geometry_set) : geometry_set_(std::move(geometry_set))
+  SampleCurveFunction(GeometrySet geometry_set, const bool use_precise_lengths)
+      : geometry_set_(std::move(geometry_set)), use_precise_lengths_(use_precise_lengths)
   {
     static fn::MFSignature signature = create_signature();
     this->set_signature(&signature);
@@ -202,14 +205,22 @@ class SampleCurveFunction : public fn::MultiFunction {
     if (curves.points_num() == 0) {
       return return_default();
     }
-    Span<float3> evaluated_positions = curves.evaluated_positions();
+    Vector<float3> evaluated_positions_buffer;
+    Vector<float3> evaluated_tangents_buffer;
+    Vector<float3> evaluated_normals_buffer;
+    Vector<float> evaluated_lengths_buffer;
+    Span<float3> evaluated_positions = curves.evaluated_positions(evaluated_positions_buffer);
     Span<float3> evaluated_tangents;
     Span<float3> evaluated_normals;
     if (!sampled_tangents.is_empty()) {
-      evaluated_tangents = curves.evaluated_tangents();
+      evaluated_tangents = curves.evaluated_tangents(evaluated_tangents_buffer);
     }
     if (!sampled_normals.is_empty()) {
-      evaluated_normals = curves.evaluated_normals();
+      evaluated_normals = curves.evaluated_normals(evaluated_normals_buffer);
+    }
+    Span<float> evaluated_lengths;
+    if (!use_precise_lengths_) {
+      evaluated_lengths = curves.evaluated_lengths(evaluated_lengths_buffer);
     }
 
     const VArray<int> curve_indices = params.readonly_single_input<int>(0, "Curve Index");
@@ -225,7 +236,9 @@ class SampleCurveFunction : public fn::MultiFunction {
       indices.reinitialize(mask.size());
       factors.reinitialize(mask.size());
       sample_indices_and_factors_to_compressed(
-          curves.evaluated_lengths_for_curve(curve_i, cyclic[curve_i]),
+          use_precise_lengths_ ?
+              curves.evaluated_lengths_precise_for_curve(curve_i, cyclic[curve_i]) :
+              evaluated_lengths.slice(curves.lengths_range_for_curve(curve_i, cyclic[curve_i])),
           lengths,
           mask,
           indices,
@@ -299,15 +312,31 @@ static Field<float> get_length_input_field(GeoNodeExecParams params,
   return Field<float>(FieldOperation::Create(std::move(clamp_fn), {std::move(factor_field)}), 0);
 }
 
-static Array<float> curve_accumulated_lengths(const bke::CurvesGeometry &curves)
+static Array<float> curve_accumulated_lengths(const bke::CurvesGeometry &curves,
+                                              const bool use_precise_lengths)
 {
-  curves.ensure_evaluated_lengths();
+  Vector<float> evaluated_lengths_buffer;
+  Span<float> evaluated_lengths;
+  if (use_precise_lengths) {
+    curves.ensure_evaluated_lengths_precise();
+  }
+  else {
+    evaluated_lengths = curves.evaluated_lengths(evaluated_lengths_buffer);
+  }
 
   Array<float> curve_lengths(curves.curves_num());
   const VArray<bool> cyclic = curves.cyclic();
   float length = 0.0f;
   for (const int i : curves.curves_range()) {
-    length += curves.evaluated_length_total_for_curve(i, cyclic[i]);
+    if (use_precise_lengths) {
+      length += curves.evaluated_length_precise_total_for_curve(i, cyclic[i]);
+    }
+    else {
+      const IndexRange lengths_range = curves.lengths_range_for_curve(i, cyclic[i]);
+      if (!lengths_range.is_empty()) {
+        length += evaluated_lengths[lengths_range.last()];
+      }
+    }
     curve_lengths[i] = length;
   }
   return curve_lengths;
@@ -328,18 +357,21 @@ static void node_geo_exec(GeoNodeExecParams params)
     return;
   }
 
-  Array<float> curve_lengths = curve_accumulated_lengths(curves);
+  const NodeGeometryCurveSample &storage = node_storage(params.node());
+  const GeometryNodeCurveSampleMode mode = (GeometryNodeCurveSampleMode)storage.mode;
+  const bool use_precise_lengths = storage.flag & GEO_NODE_CURVE_LENGTH_PRECISE;
+
+  Array<float> curve_lengths = curve_accumulated_lengths(curves, use_precise_lengths);
   const float total_length = curve_lengths.last();
   if (total_length == 0.0f) {
     params.set_default_remaining_outputs();
     return;
   }
 
-  const NodeGeometryCurveSample &storage = node_storage(params.node());
-  const GeometryNodeCurveSampleMode mode = (GeometryNodeCurveSampleMode)storage.mode;
   Field<float> length_field = get_length_input_field(params, mode, total_length);
 
-  auto sample_fn = std::make_unique<SampleCurveFunction>(std::move(geometry_set));
+  auto sample_fn = std::make_unique<SampleCurveFunction>(std::move(geometry_set),
+                                                         use_precise_lengths);
 
   std::shared_ptr<FieldOperation> sample_op;
   if (curves.curves_num() == 1) {
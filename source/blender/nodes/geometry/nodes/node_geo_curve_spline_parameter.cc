@@ -25,21 +25,29 @@ static void node_declare(NodeDeclarationBuilder &b)
       .description(N_("Each control point's index on its spline"));
 }
 
+static float length_total_for_curve(const bke::CurvesGeometry &curves,
+                                    const Span<float> evaluated_lengths,
+                                    const int curve_index,
+                                    const bool cyclic)
+{
+  const IndexRange lengths_range = curves.lengths_range_for_curve(curve_index, cyclic);
+  return lengths_range.is_empty() ? 0.0f : evaluated_lengths[lengths_range.last()];
+}
+
 /**
  * For lengths on the curve domain, a basic interpolation from the point domain would be useless,
  * since the average parameter for each curve would just be 0.5, or close to it. Instead, the
  * value for each curve is defined as the portion of the total length of all curves at its start.
  */
-static Array<float> accumulated_lengths_curve_domain(const bke::CurvesGeometry &curves)
+static Array<float> accumulated_lengths_curve_domain(const bke::CurvesGeometry &curves,
+                                                     const Span<float> evaluated_lengths)
 {
-  curves.ensure_evaluated_lengths();
-
   Array<float> lengths(curves.curves_num());
   VArray<bool> cyclic = curves.cyclic();
   float length = 0.0f;
   for (const int i : curves.curves_range()) {
     lengths[i] = length;
-    length += curves.evaluated_length_total_for_curve(i, cyclic[i]);
+    length += length_total_for_curve(curves, evaluated_lengths, i, cyclic[i]);
   }
 
   return lengths;
@@ -55,11 +63,11 @@ static Array<float> accumulated_lengths_curve_domain(const bke::CurvesGeometry &
  *  - NURBS Curves: Treat the control points as if they were a poly curve, because there
  *    is no obvious mapping from each control point to a specific evaluated point.
  */
-static Array<float> curve_length_point_domain(const bke::CurvesGeometry &curves)
+static Array<float> curve_length_point_domain(const bke::CurvesGeometry &curves,
+                                              const Span<float> all_evaluated_lengths)
 {
-  curves.ensure_evaluated_lengths();
   const VArray<int8_t> types = curves.curve_types();
-  const VArray<int> resolutions = curves.resolution();
+  const VArray<int> resolutions = curves.evaluated_resolution();
   const VArray<bool> cyclic = curves.cyclic();
 
   Array<float> result(curves.points_num());
@@ -67,8 +75,8 @@ static Array<float> curve_length_point_domain(const bke::CurvesGeometry &curves)
   threading::parallel_for(curves.curves_range(), 128, [&](IndexRange range) {
     for (const int i_curve : range) {
       const IndexRange points = curves.points_for_curve(i_curve);
-      const Span<float> evaluated_lengths = curves.evaluated_lengths_for_curve(i_curve,
-                                                                               cyclic[i_curve]);
+      const Span<float> evaluated_lengths = all_evaluated_lengths.slice(
+          curves.lengths_range_for_curve(i_curve, cyclic[i_curve]));
       MutableSpan<float> lengths = result.as_mutable_span().slice(points);
       lengths.first() = 0.0f;
       switch (types[i_curve]) {
@@ -110,15 +118,17 @@ static VArray<float> construct_curve_parameter_varray(const bke::CurvesGeometry
                                                       const eAttrDomain domain)
 {
   VArray<bool> cyclic = curves.cyclic();
+  Vector<float> evaluated_lengths_buffer;
+  const Span<float> evaluated_lengths = curves.evaluated_lengths(evaluated_lengths_buffer);
 
   if (domain == ATTR_DOMAIN_POINT) {
-    Array<float> result = curve_length_point_domain(curves);
+    Array<float> result = curve_length_point_domain(curves, evaluated_lengths);
     MutableSpan<float> lengths = result.as_mutable_span();
 
     threading::parallel_for(curves.curves_range(), 1024, [&](IndexRange range) {
       for (const int i_curve : range) {
-        const float total_length = curves.evaluated_length_total_for_curve(i_curve,
-                                                                           cyclic[i_curve]);
+        const float total_length = length_total_for_curve(
+            curves, evaluated_lengths, i_curve, cyclic[i_curve]);
         MutableSpan<float> curve_lengths = lengths.slice(curves.points_for_curve(i_curve));
         if (total_length > 0.0f) {
           const float factor = 1.0f / total_length;
@@ -140,11 +150,13 @@ static VArray<float> construct_curve_parameter_varray(const bke::CurvesGeometry
   }
 
   if (domain == ATTR_DOMAIN_CURVE) {
-    Array<float> lengths = accumulated_lengths_curve_domain(curves);
+    Array<float> lengths = accumulated_lengths_curve_domain(curves, evaluated_lengths);
 
     const int last_index = curves.curves_num() - 1;
-    const float total_length = lengths.last() + curves.evaluated_length_total_for_curve(
-                                                    last_index, cyclic[last_index]);
+    const float total_length = lengths.last() + length_total_for_curve(curves,
+                                                                        evaluated_lengths,
+                                                                        last_index,
+                                                                        cyclic[last_index]);
     if (total_length > 0.0f) {
       const float factor = 1.0f / total_length;
       for (float &value : lengths) {
@@ -168,15 +180,16 @@ static VArray<float> construct_curve_length_parameter_varray(const bke::CurvesGe
                                                              const IndexMask UNUSED(mask),
                                                              const eAttrDomain domain)
 {
-  curves.ensure_evaluated_lengths();
+  Vector<float> evaluated_lengths_buffer;
+  const Span<float> evaluated_lengths = curves.evaluated_lengths(evaluated_lengths_buffer);
 
   if (domain == ATTR_DOMAIN_POINT) {
-    Array<float> lengths = curve_length_point_domain(curves);
+    Array<float> lengths = curve_length_point_domain(curves, evaluated_lengths);
     return VArray<float>::ForContainer(std::move(lengths));
   }
 
   if (domain == ATTR_DOMAIN_CURVE) {
-    Array<float> lengths = accumulated_lengths_curve_domain(curves);
+    Array<float> lengths = accumulated_lengths_curve_domain(curves, evaluated_lengths);
     return VArray<float>::ForContainer(std::move(lengths));
   }
 
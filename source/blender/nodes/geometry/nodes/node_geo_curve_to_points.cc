@@ -43,6 +43,9 @@ static void node_declare(NodeDeclarationBuilder &b)
 static void node_layout(uiLayout *layout, bContext *UNUSED(C), PointerRNA *ptr)
 {
   uiItemR(layout, ptr, "mode", 0, "", ICON_NONE);
+  if (RNA_enum_get(ptr, "mode") != GEO_NODE_CURVE_RESAMPLE_EVALUATED) {
+    uiItemR(layout, ptr, "use_precise_length", 0, nullptr, ICON_NONE);
+  }
 }
 
 static void node_init(bNodeTree *UNUSED(tree), bNode *node)
@@ -107,6 +110,7 @@ static void node_geo_exec(GeoNodeExecParams params)
 {
   const NodeGeometryCurveToPoints &storage = node_storage(params.node());
   const GeometryNodeCurveResampleMode mode = (GeometryNodeCurveResampleMode)storage.mode;
+  const bool use_precise_lengths = storage.flag & GEO_NODE_CURVE_LENGTH_PRECISE;
   GeometrySet geometry_set = params.extract_input<GeometrySet>("Curve");
 
   GeometryComponentEditData::remember_deformed_curve_positions_if_necessary(geometry_set);
@@ -137,7 +141,11 @@ static void node_geo_exec(GeoNodeExecParams params)
           const bke::CurvesGeometry &src_curves = bke::CurvesGeometry::wrap(
               src_curves_id->geometry);
           bke::CurvesGeometry dst_curves = geometry::resample_to_count(
-              src_curves, fn::make_constant_field<bool>(true), count, resample_attributes);
+              src_curves,
+              fn::make_constant_field<bool>(true),
+              count,
+              use_precise_lengths,
+              resample_attributes);
           PointCloud *pointcloud = pointcloud_from_curves(std::move(dst_curves),
                                                           resample_attributes.tangent_id,
                                                           resample_attributes.normal_id,
@@ -155,7 +163,11 @@ static void node_geo_exec(GeoNodeExecParams params)
           const bke::CurvesGeometry &src_curves = bke::CurvesGeometry::wrap(
               src_curves_id->geometry);
           bke::CurvesGeometry dst_curves = geometry::resample_to_length(
-              src_curves, fn::make_constant_field<bool>(true), length, resample_attributes);
+              src_curves,
+              fn::make_constant_field<bool>(true),
+              length,
+              use_precise_lengths,
+              resample_attributes);
           PointCloud *pointcloud = pointcloud_from_curves(std::move(dst_curves),
                                                           resample_attributes.tangent_id,
                                                           resample_attributes.normal_id,
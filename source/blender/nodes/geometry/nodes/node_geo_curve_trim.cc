@@ -49,6 +49,7 @@ static void node_declare(NodeDeclarationBuilder &b)
 static void node_layout(uiLayout *layout, bContext *UNUSED(C), PointerRNA *ptr)
 {
   uiItemR(layout, ptr, "mode", UI_ITEM_R_EXPAND, nullptr, ICON_NONE);
+  uiItemR(layout, ptr, "use_precise_length", 0, nullptr, ICON_NONE);
 }
 
 static void node_init(bNodeTree *UNUSED(tree), bNode *node)
@@ -109,6 +110,7 @@ static void node_gather_link_searches(GatherLinkSearchOpParams &params)
 
 static void geometry_set_curve_trim(GeometrySet &geometry_set,
                                     const GeometryNodeCurveSampleMode mode,
+                                    const bool use_precise_lengths,
                                     Field<float> &start_field,
                                     Field<float> &end_field)
 {
@@ -150,7 +152,7 @@ static void geometry_set_curve_trim(GeometrySet &geometry_set,
 
   /* Create curve trim lookup table. */
   Array<bke::curves::CurvePoint, 12> point_lookups = geometry::lookup_curve_points(
-      src_curves, length_factors, lookup_indices, normalized_length_lookup);
+      src_curves, length_factors, lookup_indices, normalized_length_lookup, use_precise_lengths);
 
   bke::CurvesGeometry dst_curves = geometry::trim_curves(
       src_curves,
@@ -167,6 +169,7 @@ static void node_geo_exec(GeoNodeExecParams params)
 {
   const NodeGeometryCurveTrim &storage = node_storage(params.node());
   const GeometryNodeCurveSampleMode mode = (GeometryNodeCurveSampleMode)storage.mode;
+  const bool use_precise_lengths = storage.flag & GEO_NODE_CURVE_LENGTH_PRECISE;
 
   GeometrySet geometry_set = params.extract_input<GeometrySet>("Curve");
   GeometryComponentEditData::remember_deformed_curve_positions_if_necessary(geometry_set);
@@ -175,14 +178,14 @@ static void node_geo_exec(GeoNodeExecParams params)
     Field<float> start_field = params.extract_input<Field<float>>("Start");
     Field<float> end_field = params.extract_input<Field<float>>("End");
     geometry_set.modify_geometry_sets([&](GeometrySet &geometry_set) {
-      geometry_set_curve_trim(geometry_set, mode, start_field, end_field);
+      geometry_set_curve_trim(geometry_set, mode, use_precise_lengths, start_field, end_field);
     });
   }
   else if (mode == GEO_NODE_CURVE_SAMPLE_LENGTH) {
     Field<float> start_field = params.extract_input<Field<float>>("Start_001");
     Field<float> end_field = params.extract_input<Field<float>>("End_001");
     geometry_set.modify_geometry_sets([&](GeometrySet &geometry_set) {
-      geometry_set_curve_trim(geometry_set, mode, start_field, end_field);
+      geometry_set_curve_trim(geometry_set, mode, use_precise_lengths, start_field, end_field);
     });
   }
 
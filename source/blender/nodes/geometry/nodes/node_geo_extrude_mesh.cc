@@ -139,8 +139,10 @@ static MutableSpan<int> get_orig_index_layer(Mesh &mesh, const eAttrDomain domai
 {
   const bke::AttributeAccessor attributes = mesh.attributes();
   CustomData &custom_data = get_customdata(mesh, domain);
-  if (int *orig_indices = static_cast<int *>(CustomData_get_layer(&custom_data, CD_ORIGINDEX))) {
-    return {orig_indices, attributes.domain_size(domain)};
+  const int domain_size = attributes.domain_size(domain);
+  if (int *orig_indices = static_cast<int *>(
+          CustomData_duplicate_referenced_layer(&custom_data, CD_ORIGINDEX, domain_size))) {
+    return {orig_indices, domain_size};
   }
   return {};
 }
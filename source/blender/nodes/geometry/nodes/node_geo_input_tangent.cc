@@ -16,11 +16,12 @@ static void node_declare(NodeDeclarationBuilder &b)
 static Array<float3> curve_tangent_point_domain(const bke::CurvesGeometry &curves)
 {
   const VArray<int8_t> types = curves.curve_types();
-  const VArray<int> resolutions = curves.resolution();
+  const VArray<int> resolutions = curves.evaluated_resolution();
   const VArray<bool> cyclic = curves.cyclic();
   const Span<float3> positions = curves.positions();
 
-  const Span<float3> evaluated_tangents = curves.evaluated_tangents();
+  Vector<float3> evaluated_tangents_buffer;
+  const Span<float3> evaluated_tangents = curves.evaluated_tangents(evaluated_tangents_buffer);
 
   Array<float3> results(curves.points_num());
 
@@ -68,8 +69,14 @@ static VArray<float3> construct_curve_tangent_gvarray(const bke::CurvesGeometry
 {
   const VArray<int8_t> types = curves.curve_types();
   if (curves.is_single_type(CURVE_TYPE_POLY)) {
+    Vector<float3> tangents_buffer;
+    const Span<float3> tangents = curves.evaluated_tangents(tangents_buffer);
+    if (tangents_buffer.is_empty()) {
+      return curves.adapt_domain<float3>(
+          VArray<float3>::ForSpan(tangents), ATTR_DOMAIN_POINT, domain);
+    }
     return curves.adapt_domain<float3>(
-        VArray<float3>::ForSpan(curves.evaluated_tangents()), ATTR_DOMAIN_POINT, domain);
+        VArray<float3>::ForContainer(std::move(tangents_buffer)), ATTR_DOMAIN_POINT, domain);
   }
 
   Array<float3> tangents = curve_tangent_point_domain(curves);
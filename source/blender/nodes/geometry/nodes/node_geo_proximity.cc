@@ -6,6 +6,8 @@
 #include "DNA_mesh_types.h"
 
 #include "BKE_bvhutils.h"
+#include "BKE_curves.hh"
+#include "BKE_curves_bvh.hh"
 #include "BKE_geometry_set.hh"
 
 #include "UI_interface.h"
@@ -21,7 +23,8 @@ static void node_declare(NodeDeclarationBuilder &b)
 {
   b.add_input<decl::Geometry>(N_("Target"))
       .only_realized_data()
-      .supported_type({GEO_COMPONENT_TYPE_MESH, GEO_COMPONENT_TYPE_POINT_CLOUD});
+      .supported_type(
+          {GEO_COMPONENT_TYPE_MESH, GEO_COMPONENT_TYPE_POINT_CLOUD, GEO_COMPONENT_TYPE_CURVE});
   b.add_input<decl::Vector>(N_("Source Position")).implicit_field();
   b.add_output<decl::Vector>(N_("Position")).dependent_field();
   b.add_output<decl::Float>(N_("Distance")).dependent_field();
@@ -39,6 +42,46 @@ static void geo_proximity_init(bNodeTree *UNUSED(ntree), bNode *node)
   node->storage = node_storage;
 }
 
+/**
+ * Find the nearest elements in the tree for all positions at once, which is much faster than
+ * separate queries. Only locations closer than the given distances are found, so that the closest
+ * location can be found in multiple trees.
+ */
+static void find_nearest_batch(BVHTree &tree,
+                               BVHTree_NearestPointCallback callback,
+                               void *userdata,
+                               const VArray<float3> &positions,
+                               const IndexMask mask,
+                               const MutableSpan<float> r_distances,
+                               const MutableSpan<float3> r_locations)
+{
+  Array<float3> batch_positions(mask.size());
+  Array<BVHTreeNearest> nearest(mask.size());
+  threading::parallel_for(mask.index_range(), 4096, [&](const IndexRange range) {
+    for (const int i : range) {
+      const int index = mask[i];
+      batch_positions[i] = positions[index];
+      nearest[i].index = -1;
+      nearest[i].dist_sq = r_distances[index];
+    }
+  });
+
+  BLI_bvhtree_find_nearest_batch_cpp(tree, batch_positions, nearest, callback, userdata);
+
+  threading::parallel_for(mask.index_range(), 4096, [&](const IndexRange range) {
+    for (const int i : range) {
+      if (nearest[i].index == -1) {
+        continue;
+      }
+      const int index = mask[i];
+      r_distances[index] = nearest[i].dist_sq;
+      if (!r_locations.is_empty()) {
+        r_locations[index] = nearest[i].co;
+      }
+    }
+  });
+}
+
 static bool calculate_mesh_proximity(const VArray<float3> &positions,
                                      const IndexMask mask,
                                      const Mesh &mesh,
@@ -63,27 +106,13 @@ static bool calculate_mesh_proximity(const VArray<float3> &positions,
     return false;
   }
 
-  threading::parallel_for(mask.index_range(), 512, [&](IndexRange range) {
-    BVHTreeNearest nearest;
-    copy_v3_fl(nearest.co, FLT_MAX);
-    nearest.index = -1;
-
-    for (int i : range) {
-      const int index = mask[i];
-      /* Use the distance to the last found point as upper bound to speedup the bvh lookup. */
-      nearest.dist_sq = math::distance_squared(float3(nearest.co), positions[index]);
-
-      BLI_bvhtree_find_nearest(
-          bvh_data.tree, positions[index], &nearest, bvh_data.nearest_callback, &bvh_data);
-
-      if (nearest.dist_sq < r_distances[index]) {
-        r_distances[index] = nearest.dist_sq;
-        if (!r_locations.is_empty()) {
-          r_locations[index] = nearest.co;
-        }
-      }
-    }
-  });
+  find_nearest_batch(*bvh_data.tree,
+                     bvh_data.nearest_callback,
+                     &bvh_data,
+                     positions,
+                     mask,
+                     r_distances,
+                     r_locations);
 
   free_bvhtree_from_mesh(&bvh_data);
   return true;
@@ -101,31 +130,44 @@ static bool calculate_pointcloud_proximity(const VArray<float3> &positions,
     return false;
   }
 
-  threading::parallel_for(mask.index_range(), 512, [&](IndexRange range) {
-    BVHTreeNearest nearest;
-    copy_v3_fl(nearest.co, FLT_MAX);
-    nearest.index = -1;
+  /* Only find locations closer than the mesh, which makes the queries faster. */
+  find_nearest_batch(*bvh_data.tree,
+                     bvh_data.nearest_callback,
+                     &bvh_data,
+                     positions,
+                     mask,
+                     r_distances,
+                     r_locations);
 
-    for (int i : range) {
-      const int index = mask[i];
-      /* Use the distance to the closest point in the mesh to speedup the pointcloud bvh lookup.
-       * This is ok because we only need to find the closest point in the pointcloud if it's
-       * closer than the mesh. */
-      nearest.dist_sq = r_distances[index];
+  free_bvhtree_from_pointcloud(&bvh_data);
+  return true;
+}
 
-      BLI_bvhtree_find_nearest(
-          bvh_data.tree, positions[index], &nearest, bvh_data.nearest_callback, &bvh_data);
+static bool calculate_curves_proximity(const VArray<float3> &positions,
+                                       const IndexMask mask,
+                                       const bke::CurvesGeometry &curves,
+                                       MutableSpan<float> r_distances,
+                                       MutableSpan<float3> r_locations)
+{
+  if (curves.evaluated_segments_bvh() == nullptr) {
+    return false;
+  }
 
-      if (nearest.dist_sq < r_distances[index]) {
-        r_distances[index] = nearest.dist_sq;
+  threading::parallel_for(mask.index_range(), 512, [&](IndexRange range) {
+    for (int i : range) {
+      const int index = mask[i];
+      /* Only find locations closer than the other components, as for point clouds. */
+      bke::curves::CurvesNearest nearest;
+      if (bke::curves::find_nearest(
+              curves, positions[index], r_distances[index], false, nearest)) {
+        r_distances[index] = nearest.distance_sq;
         if (!r_locations.is_empty()) {
-          r_locations[index] = nearest.co;
+          r_locations[index] = nearest.position;
         }
       }
     }
   });
 
-  free_bvhtree_from_pointcloud(&bvh_data);
   return true;
 }
 
@@ -176,6 +218,15 @@ class ProximityFunction : public fn::MultiFunction {
           src_positions, mask, *target_.get_pointcloud_for_read(), distances, positions);
     }
 
+    if (target_.has_curves() && type_ == GEO_NODE_PROX_TARGET_EDGES) {
+      const Curves &curves_id = *target_.get_curves_for_read();
+      success |= calculate_curves_proximity(src_positions,
+                                            mask,
+                                            bke::CurvesGeometry::wrap(curves_id.geometry),
+                                            distances,
+                                            positions);
+    }
+
     if (!success) {
       if (!positions.is_empty()) {
         positions.fill_indices(mask, float3(0));
@@ -202,7 +253,8 @@ static void node_geo_exec(GeoNodeExecParams params)
   GeometrySet geometry_set_target = params.extract_input<GeometrySet>("Target");
   geometry_set_target.ensure_owns_direct_data();
 
-  if (!geometry_set_target.has_mesh() && !geometry_set_target.has_pointcloud()) {
+  if (!geometry_set_target.has_mesh() && !geometry_set_target.has_pointcloud() &&
+      !geometry_set_target.has_curves()) {
     params.set_default_remaining_outputs();
     return;
   }
@@ -11,12 +11,22 @@ static void node_declare(NodeDeclarationBuilder &b)
   b.add_input<decl::Geometry>(N_("Geometry")).supported_type(GEO_COMPONENT_TYPE_CURVE);
   b.add_input<decl::Bool>(N_("Selection")).default_value(true).hide_value().supports_field();
   b.add_input<decl::Int>(N_("Resolution")).min(1).default_value(12).supports_field();
+  b.add_input<decl::Float>(N_("Tolerance"))
+      .min(0.0f)
+      .default_value(0.0f)
+      .subtype(PROP_DISTANCE)
+      .supports_field()
+      .description(
+          N_("Use fewer evaluated points than the resolution where the curve is flat enough to "
+             "stay within this distance from the exact curve. Zero disables the adaptive "
+             "resolution"));
   b.add_output<decl::Geometry>(N_("Geometry"));
 }
 
 static void set_resolution(bke::CurvesGeometry &curves,
                            const Field<bool> &selection_field,
-                           const Field<int> &resolution_field)
+                           const Field<int> &resolution_field,
+                           const Field<float> &tolerance_field)
 {
   if (curves.curves_num() == 0) {
     return;
@@ -25,13 +35,30 @@ static void set_resolution(bke::CurvesGeometry &curves,
   AttributeWriter<int> resolutions = attributes.lookup_or_add_for_write<int>("resolution",
                                                                              ATTR_DOMAIN_CURVE);
 
+  /* Avoid adding the tolerance attribute when it isn't used, since it makes the evaluated curve
+   * depend on the positions, which means more caches have to be recomputed when they change. */
+  const bool use_tolerance = tolerance_field.node().depends_on_input() ||
+                             fn::evaluate_constant_field(tolerance_field) != 0.0f ||
+                             attributes.contains("resolution_tolerance");
+  AttributeWriter<float> tolerances;
+  if (use_tolerance) {
+    tolerances = attributes.lookup_or_add_for_write<float>("resolution_tolerance",
+                                                           ATTR_DOMAIN_CURVE);
+  }
+
   bke::CurvesFieldContext field_context{curves, ATTR_DOMAIN_CURVE};
   fn::FieldEvaluator evaluator{field_context, curves.curves_num()};
   evaluator.set_selection(selection_field);
   evaluator.add_with_destination(resolution_field, resolutions.varray);
+  if (use_tolerance) {
+    evaluator.add_with_destination(tolerance_field, tolerances.varray);
+  }
   evaluator.evaluate();
 
   resolutions.finish();
+  if (use_tolerance) {
+    tolerances.finish();
+  }
 }
 
 static void node_geo_exec(GeoNodeExecParams params)
@@ -39,10 +66,12 @@ static void node_geo_exec(GeoNodeExecParams params)
   GeometrySet geometry_set = params.extract_input<GeometrySet>("Geometry");
   Field<bool> selection = params.extract_input<Field<bool>>("Selection");
   Field<int> resolution = params.extract_input<Field<int>>("Resolution");
+  Field<float> tolerance = params.extract_input<Field<float>>("Tolerance");
 
   geometry_set.modify_geometry_sets([&](GeometrySet &geometry_set) {
     if (Curves *curves_id = geometry_set.get_curves_for_write()) {
-      set_resolution(bke::CurvesGeometry::wrap(curves_id->geometry), selection, resolution);
+      set_resolution(
+          bke::CurvesGeometry::wrap(curves_id->geometry), selection, resolution, tolerance);
     }
   });
 
@@ -0,0 +1,496 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#include "NOD_geometry_nodes_cache.hh"
+
+#include "BLI_hash_mm2a.h"
+#include "BLI_listbase.h"
+
+#include "DNA_curves_types.h"
+#include "DNA_mesh_types.h"
+#include "DNA_meshdata_types.h"
+#include "DNA_object_types.h"
+#include "DNA_pointcloud_types.h"
+
+#include "BKE_customdata.h"
+
+#include "FN_field_cpp_type.hh"
+
+struct Collection;
+struct Image;
+struct Material;
+struct Object;
+struct Tex;
+
+namespace blender::nodes {
+
+using fn::GField;
+using fn::ValueOrField;
+using fn::ValueOrFieldCPPType;
+using Hash = GeometryNodesCache::Hash;
+
+template<typename T> static void mix_in_value(Hash &hash, const T &value)
+{
+  hash.mix_in(&value, sizeof(T));
+}
+
+/**
+ * Mixing in data uses MD5, which is too slow for large arrays. Hash those with a faster function
+ * first. Two different seeds give a 64 bit hash, which makes accidental collisions unlikely
+ * enough.
+ */
+static void mix_in_array(Hash &hash, const void *data, const int64_t size)
+{
+  const uint64_t array_hash[2] = {
+      BLI_hash_mm2(static_cast<const uchar *>(data), size_t(size), 0),
+      BLI_hash_mm2(static_cast<const uchar *>(data), size_t(size), 0x9e3779b9)};
+  mix_in_value(hash, array_hash);
+  mix_in_value(hash, size);
+}
+
+/* -------------------------------------------------------------------- */
+/** \name Value Hashing
+ * \{ */
+
+/** Finds the version of a geometry component or field node. */
+using VersionFn = FunctionRef<std::optional<Hash>(const void *data)>;
+
+static bool mix_in_geometry(Hash &hash,
+                            const VersionFn get_version,
+                            const GeometrySet &geometry)
+{
+  for (const GeometryComponent *component : geometry.get_components_for_read()) {
+    mix_in_value(hash, component->type());
+    if (component->is_empty()) {
+      continue;
+    }
+    const std::optional<Hash> version = get_version(component);
+    if (!version) {
+      return false;
+    }
+    mix_in_value(hash, *version);
+  }
+  return true;
+}
+
+static bool mix_in_value_or_field(Hash &hash,
+                                  const VersionFn get_version,
+                                  const ValueOrFieldCPPType &type,
+                                  const void *value)
+{
+  if (type.is_field(value)) {
+    const GField &field = *type.get_field_ptr(value);
+    const std::optional<Hash> version = get_version(&field.node());
+    if (!version) {
+      return false;
+    }
+    mix_in_value(hash, *version);
+    mix_in_value(hash, field.node_output_index());
+    return true;
+  }
+  const CPPType &base_type = type.base_type();
+  const void *base_value = type.get_value_ptr(value);
+  if (base_type.is<std::string>()) {
+    const std::string &str = *static_cast<const std::string *>(base_value);
+    hash.mix_in(str.data(), int64_t(str.size()));
+    return true;
+  }
+  if (base_type.is_trivial()) {
+    hash.mix_in(base_value, base_type.size());
+    return true;
+  }
+  return false;
+}
+
+static std::optional<Hash> hash_value_impl(const GPointer value, const VersionFn get_version)
+{
+  const CPPType &type = *value.type();
+  Hash hash;
+  if (type.is<GeometrySet>()) {
+    if (!mix_in_geometry(hash, get_version, *value.get<GeometrySet>())) {
+      return std::nullopt;
+    }
+    return hash;
+  }
+  if (type.is<Vector<GeometrySet>>()) {
+    for (const GeometrySet &geometry : *value.get<Vector<GeometrySet>>()) {
+      if (!mix_in_geometry(hash, get_version, geometry)) {
+        return std::nullopt;
+      }
+    }
+    return hash;
+  }
+  if (type.is<Vector<ValueOrField<std::string>>>()) {
+    const ValueOrFieldCPPType &item_type = *dynamic_cast<const ValueOrFieldCPPType *>(
+        &CPPType::get<ValueOrField<std::string>>());
+    for (const ValueOrField<std::string> &item : *value.get<Vector<ValueOrField<std::string>>>()) {
+      if (!mix_in_value_or_field(hash, get_version, item_type, &item)) {
+        return std::nullopt;
+      }
+    }
+    return hash;
+  }
+  if (const ValueOrFieldCPPType *value_or_field_type = dynamic_cast<const ValueOrFieldCPPType *>(
+          &type)) {
+    if (!mix_in_value_or_field(hash, get_version, *value_or_field_type, value.get())) {
+      return std::nullopt;
+    }
+    return hash;
+  }
+  /* Data-blocks can change without the pointer changing. */
+  if (type.is<Object *>() || type.is<Collection *>() || type.is<Tex *>() ||
+      type.is<Image *>() || type.is<Material *>()) {
+    return std::nullopt;
+  }
+  if (type.is_trivial()) {
+    hash.mix_in(value.get(), type.size());
+    return hash;
+  }
+  return std::nullopt;
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Geometry Content Hashing
+ * \{ */
+
+static bool mix_in_custom_data(Hash &hash, const CustomData &data, const int64_t size)
+{
+  mix_in_value(hash, size);
+  for (const CustomDataLayer &layer : Span(data.layers, data.totlayer)) {
+    mix_in_value(hash, layer.type);
+    hash.mix_in(layer.name, int64_t(strlen(layer.name)));
+    if (layer.data == nullptr) {
+      continue;
+    }
+    if (layer.type == CD_MDEFORMVERT) {
+      /* The weights are stored in separate arrays. */
+      for (const MDeformVert &dvert : Span(static_cast<const MDeformVert *>(layer.data), size)) {
+        mix_in_array(hash, dvert.dw, int64_t(dvert.totweight) * int64_t(sizeof(MDeformWeight)));
+      }
+      continue;
+    }
+    if (ELEM(layer.type, CD_MDISPS, CD_GRID_PAINT_MASK)) {
+      /* Other layers with pointers are not used by geometry nodes. */
+      return false;
+    }
+    mix_in_array(hash, layer.data, CustomData_sizeof(layer.type) * size);
+  }
+  return true;
+}
+
+static void mix_in_materials(Hash &hash, const Span<const Material *> materials)
+{
+  mix_in_array(hash, materials.data(), materials.size_in_bytes());
+}
+
+static bool mix_in_mesh(Hash &hash, const Mesh &mesh)
+{
+  mix_in_value(hash, mesh.flag);
+  mix_in_value(hash, mesh.smoothresh);
+  LISTBASE_FOREACH (const bDeformGroup *, group, &mesh.vertex_group_names) {
+    hash.mix_in(group->name, int64_t(strlen(group->name)));
+  }
+  mix_in_materials(hash, {mesh.mat, mesh.totcol});
+  return mix_in_custom_data(hash, mesh.vdata, mesh.totvert) &&
+         mix_in_custom_data(hash, mesh.edata, mesh.totedge) &&
+         mix_in_custom_data(hash, mesh.pdata, mesh.totpoly) &&
+         mix_in_custom_data(hash, mesh.ldata, mesh.totloop);
+}
+
+static bool mix_in_curves(Hash &hash, const Curves &curves_id)
+{
+  const CurvesGeometry &curves = curves_id.geometry;
+  mix_in_value(hash, curves_id.surface);
+  if (curves_id.surface_uv_map) {
+    hash.mix_in(curves_id.surface_uv_map, int64_t(strlen(curves_id.surface_uv_map)));
+  }
+  mix_in_materials(hash, {curves_id.mat, curves_id.totcol});
+  if (curves.curve_offsets) {
+    mix_in_array(hash, curves.curve_offsets, int64_t(curves.curve_num + 1) * sizeof(int));
+  }
+  return mix_in_custom_data(hash, curves.point_data, curves.point_num) &&
+         mix_in_custom_data(hash, curves.curve_data, curves.curve_num);
+}
+
+static bool mix_in_pointcloud(Hash &hash, const PointCloud &pointcloud)
+{
+  mix_in_materials(hash, {pointcloud.mat, pointcloud.totcol});
+  return mix_in_custom_data(hash, pointcloud.pdata, pointcloud.totpoint);
+}
+
+/**
+ * Hash the content of the geometry. Only meshes, curves and point clouds are supported, because
+ * other types may reference data that can change independently.
+ */
+static std::optional<Hash> hash_geometry_content(const GeometrySet &geometry)
+{
+  Hash hash;
+  for (const GeometryComponent *component : geometry.get_components_for_read()) {
+    mix_in_value(hash, component->type());
+    if (component->is_empty()) {
+      continue;
+    }
+    bool success = false;
+    switch (component->type()) {
+      case GEO_COMPONENT_TYPE_MESH:
+        success = mix_in_mesh(hash,
+                              *static_cast<const MeshComponent *>(component)->get_for_read());
+        break;
+      case GEO_COMPONENT_TYPE_CURVE:
+        success = mix_in_curves(hash,
+                                *static_cast<const CurveComponent *>(component)->get_for_read());
+        break;
+      case GEO_COMPONENT_TYPE_POINT_CLOUD:
+        success = mix_in_pointcloud(
+            hash, *static_cast<const PointCloudComponent *>(component)->get_for_read());
+        break;
+      default:
+        break;
+    }
+    if (!success) {
+      return std::nullopt;
+    }
+  }
+  return hash;
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Memory Usage
+ * \{ */
+
+static int64_t custom_data_size_in_bytes(const CustomData &data, const int64_t size)
+{
+  int64_t bytes = 0;
+  for (const CustomDataLayer &layer : Span(data.layers, data.totlayer)) {
+    bytes += CustomData_sizeof(layer.type) * size;
+  }
+  return bytes;
+}
+
+static int64_t geometry_size_in_bytes(const GeometrySet &geometry)
+{
+  int64_t bytes = sizeof(GeometrySet);
+  if (const Mesh *mesh = geometry.get_mesh_for_read()) {
+    bytes += custom_data_size_in_bytes(mesh->vdata, mesh->totvert) +
+             custom_data_size_in_bytes(mesh->edata, mesh->totedge) +
+             custom_data_size_in_bytes(mesh->pdata, mesh->totpoly) +
+             custom_data_size_in_bytes(mesh->ldata, mesh->totloop);
+  }
+  if (const Curves *curves_id = geometry.get_curves_for_read()) {
+    const CurvesGeometry &curves = curves_id->geometry;
+    bytes += custom_data_size_in_bytes(curves.point_data, curves.point_num) +
+             custom_data_size_in_bytes(curves.curve_data, curves.curve_num) +
+             int64_t(curves.curve_num + 1) * sizeof(int);
+  }
+  if (const PointCloud *pointcloud = geometry.get_pointcloud_for_read()) {
+    bytes += custom_data_size_in_bytes(pointcloud->pdata, pointcloud->totpoint);
+  }
+  if (const InstancesComponent *instances =
+          geometry.get_component_for_read<InstancesComponent>()) {
+    bytes += int64_t(instances->instances_num()) * int64_t(sizeof(float4x4) + sizeof(int));
+  }
+  return bytes;
+}
+
+static int64_t value_size_in_bytes(const GPointer value)
+{
+  if (value.type()->is<GeometrySet>()) {
+    return geometry_size_in_bytes(*value.get<GeometrySet>());
+  }
+  return value.type()->size();
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Cache
+ * \{ */
+
+/**
+ * Call the function for every geometry component and field node referenced by the values. The
+ * second argument identifies the data within its value.
+ */
+static void foreach_versioned_data(
+    const Span<GMutablePointer> values,
+    const FunctionRef<void(int64_t value_index, int sub_index, const void *data)> fn)
+{
+  for (const int64_t i : values.index_range()) {
+    const CPPType &type = *values[i].type();
+    if (type.is<GeometrySet>()) {
+      const GeometrySet &geometry = *values[i].get<GeometrySet>();
+      for (const GeometryComponent *component : geometry.get_components_for_read()) {
+        if (!component->is_empty()) {
+          fn(i, int(component->type()), component);
+        }
+      }
+    }
+    else if (const ValueOrFieldCPPType *value_or_field_type =
+                 dynamic_cast<const ValueOrFieldCPPType *>(&type)) {
+      if (value_or_field_type->is_field(values[i].get())) {
+        fn(i, -1, &value_or_field_type->get_field_ptr(values[i].get())->node());
+      }
+    }
+  }
+}
+
+GeometryNodesCache::Entry::~Entry()
+{
+  for (GMutablePointer &value : values) {
+    value.destruct();
+  }
+}
+
+GeometryNodesCache::GeometryNodesCache(const int64_t memory_limit) : memory_limit_(memory_limit)
+{
+}
+
+GeometryNodesCache::~GeometryNodesCache() = default;
+
+void GeometryNodesCache::set_memory_limit(const int64_t memory_limit)
+{
+  std::lock_guard lock{mutex_};
+  memory_limit_ = memory_limit;
+  this->free_memory_to_limit();
+}
+
+int64_t GeometryNodesCache::memory_usage() const
+{
+  std::lock_guard lock{mutex_};
+  return memory_usage_;
+}
+
+std::optional<Hash> GeometryNodesCache::hash_value(const GPointer value) const
+{
+  std::lock_guard lock{mutex_};
+  return hash_value_impl(value, [&](const void *data) -> std::optional<Hash> {
+    if (const Version *version = versions_.lookup_ptr(data)) {
+      return version->hash;
+    }
+    return std::nullopt;
+  });
+}
+
+bool GeometryNodesCache::lookup(const Hash &key, const Span<void *> r_values)
+{
+  std::lock_guard lock{mutex_};
+  std::unique_ptr<Entry> *entry = entries_.lookup_ptr(key);
+  if (entry == nullptr) {
+    return false;
+  }
+  BLI_assert((*entry)->values.size() == r_values.size());
+  (*entry)->last_used = ++use_counter_;
+  for (const int i : r_values.index_range()) {
+    const GMutablePointer value = (*entry)->values[i];
+    value.type()->copy_construct(value.get(), r_values[i]);
+  }
+  return true;
+}
+
+void GeometryNodesCache::add(const Hash &key,
+                             const Span<GPointer> values,
+                             const bool keep,
+                             Evaluation &evaluation)
+{
+  std::lock_guard lock{mutex_};
+  if (entries_.contains(key)) {
+    return;
+  }
+  auto entry = std::make_unique<Entry>();
+  for (const GPointer value : values) {
+    const CPPType &type = *value.type();
+    void *buffer = entry->allocator.allocate(type.size(), type.alignment());
+    type.copy_construct(value.get(), buffer);
+    entry->values.append({type, buffer});
+    entry->size_in_bytes += value_size_in_bytes(value);
+  }
+  this->add_versions(*entry, key);
+
+  if (!keep || entry->size_in_bytes > memory_limit_) {
+    evaluation.entries_.append(std::move(entry));
+    return;
+  }
+  entry->last_used = ++use_counter_;
+  memory_usage_ += entry->size_in_bytes;
+  entries_.add_new(key, std::move(entry));
+  this->free_memory_to_limit();
+}
+
+void GeometryNodesCache::begin_evaluation(Evaluation &evaluation,
+                                          const GeometrySet &input_geometry)
+{
+  const std::optional<Hash> hash = hash_geometry_content(input_geometry);
+  if (!hash) {
+    return;
+  }
+  std::lock_guard lock{mutex_};
+  auto entry = std::make_unique<Entry>();
+  GeometrySet *geometry = entry->allocator.construct<GeometrySet>(input_geometry).release();
+  entry->values.append(geometry);
+  this->add_versions(*entry, *hash);
+  evaluation.entries_.append(std::move(entry));
+}
+
+void GeometryNodesCache::end_evaluation(Evaluation &evaluation)
+{
+  std::lock_guard lock{mutex_};
+  for (const std::unique_ptr<Entry> &entry : evaluation.entries_) {
+    this->remove_versions(*entry);
+  }
+  evaluation.entries_.clear();
+}
+
+void GeometryNodesCache::add_versions(const Entry &entry, const Hash &hash)
+{
+  foreach_versioned_data(
+      entry.values, [&](const int64_t value_index, const int sub_index, const void *data) {
+        Hash version = hash;
+        mix_in_value(version, value_index);
+        mix_in_value(version, sub_index);
+        /* Data that is referenced already keeps its version, both describe the same content. */
+        Version &item = versions_.lookup_or_add(data, {version, 0});
+        item.users++;
+      });
+}
+
+void GeometryNodesCache::remove_versions(const Entry &entry)
+{
+  foreach_versioned_data(
+      entry.values, [&](const int64_t /*value_index*/, const int /*sub_index*/, const void *data) {
+        Version &item = versions_.lookup(data);
+        item.users--;
+        if (item.users == 0) {
+          versions_.remove_contained(data);
+        }
+      });
+}
+
+void GeometryNodesCache::remove_least_recently_used()
+{
+  const Hash *oldest_key = nullptr;
+  uint64_t oldest_use = UINT64_MAX;
+  for (auto item : entries_.items()) {
+    if (item.value->last_used < oldest_use) {
+      oldest_use = item.value->last_used;
+      oldest_key = &item.key;
+    }
+  }
+  BLI_assert(oldest_key != nullptr);
+  const Hash key = *oldest_key;
+  std::unique_ptr<Entry> entry = entries_.pop(key);
+  this->remove_versions(*entry);
+  memory_usage_ -= entry->size_in_bytes;
+}
+
+void GeometryNodesCache::free_memory_to_limit()
+{
+  while (memory_usage_ > memory_limit_ && !entries_.is_empty()) {
+    this->remove_least_recently_used();
+  }
+}
+
+/** \} */
+
+}  // namespace blender::nodes
@@ -12,6 +12,7 @@
  */
 
 #include "NOD_geometry_exec.hh"
+#include "NOD_geometry_nodes_cache.hh"
 #include "NOD_geometry_nodes_lazy_function.hh"
 #include "NOD_multi_function.hh"
 #include "NOD_node_declaration.hh"
@@ -21,6 +22,8 @@
 
 #include "DNA_ID.h"
 
+#include "MEM_guardedalloc.h"
+
 #include "BKE_compute_contexts.hh"
 #include "BKE_geometry_set.hh"
 #include "BKE_type_conversions.hh"
@@ -103,12 +106,132 @@ static void lazy_function_interface_from_node(const bNode &node,
   }
 }
 
+/**
+ * Forwards everything to the params of the caller, except that outputs are only marked as set
+ * on the caller when #forward_set_outputs is called. That way they can still be accessed after the
+ * node is executed.
+ */
+class ParamsWithDelayedOutputs : public lf::Params {
+ private:
+  lf::Params &params_;
+  Span<void *> output_ptrs_;
+  MutableSpan<bool> set_outputs_;
+
+ public:
+  ParamsWithDelayedOutputs(const LazyFunction &fn,
+                           lf::Params &params,
+                           Span<void *> output_ptrs,
+                           MutableSpan<bool> set_outputs)
+      : lf::Params(fn, true), params_(params), output_ptrs_(output_ptrs), set_outputs_(set_outputs)
+  {
+  }
+
+  void forward_set_outputs()
+  {
+    for (const int i : set_outputs_.index_range()) {
+      if (set_outputs_[i]) {
+        params_.output_set(i);
+      }
+    }
+  }
+
+ private:
+  void *try_get_input_data_ptr_impl(const int index) const override
+  {
+    return params_.try_get_input_data_ptr(index);
+  }
+
+  void *try_get_input_data_ptr_or_request_impl(const int index) override
+  {
+    return params_.try_get_input_data_ptr_or_request(index);
+  }
+
+  void *get_output_data_ptr_impl(const int index) override
+  {
+    return output_ptrs_[index];
+  }
+
+  void output_set_impl(const int index) override
+  {
+    set_outputs_[index] = true;
+  }
+
+  bool output_was_set_impl(const int index) const override
+  {
+    return set_outputs_[index];
+  }
+
+  lf::ValueUsage get_output_usage_impl(const int index) const override
+  {
+    return params_.get_output_usage(index);
+  }
+
+  void set_input_unused_impl(const int index) override
+  {
+    params_.set_input_unused(index);
+  }
+
+  bool try_enable_multi_threading_impl() override
+  {
+    return params_.try_enable_multi_threading();
+  }
+};
+
+/**
+ * Nodes whose results only depend on their inputs and settings, and which are expensive enough
+ * to be worth caching. Other nodes may read data that is not passed in as an input, like the
+ * Deform Curves on Surface node, which uses the evaluated surface of the self object.
+ */
+static bool node_is_cacheable(const bNode &node)
+{
+  switch (node.type) {
+    case GEO_NODE_CONVEX_HULL:
+    case GEO_NODE_CURVE_TO_MESH:
+    case GEO_NODE_CURVE_TO_POINTS:
+    case GEO_NODE_DELETE_GEOMETRY:
+    case GEO_NODE_DISTRIBUTE_POINTS_IN_VOLUME:
+    case GEO_NODE_DISTRIBUTE_POINTS_ON_FACES:
+    case GEO_NODE_DUAL_MESH:
+    case GEO_NODE_DUPLICATE_ELEMENTS:
+    case GEO_NODE_EDGE_PATHS_TO_CURVES:
+    case GEO_NODE_EXTRUDE_MESH:
+    case GEO_NODE_FILL_CURVE:
+    case GEO_NODE_FILLET_CURVE:
+    case GEO_NODE_INSTANCE_ON_POINTS:
+    case GEO_NODE_MERGE_BY_DISTANCE:
+    case GEO_NODE_MESH_BOOLEAN:
+    case GEO_NODE_MESH_TO_CURVE:
+    case GEO_NODE_MESH_TO_POINTS:
+    case GEO_NODE_MESH_TO_VOLUME:
+    case GEO_NODE_POINTS_TO_VOLUME:
+    case GEO_NODE_REALIZE_INSTANCES:
+    case GEO_NODE_RESAMPLE_CURVE:
+    case GEO_NODE_SCALE_ELEMENTS:
+    case GEO_NODE_SEPARATE_GEOMETRY:
+    case GEO_NODE_SET_POSITION:
+    case GEO_NODE_SPLIT_EDGES:
+    case GEO_NODE_STORE_NAMED_ATTRIBUTE:
+    case GEO_NODE_SUBDIVIDE_CURVE:
+    case GEO_NODE_SUBDIVIDE_MESH:
+    case GEO_NODE_SUBDIVISION_SURFACE:
+    case GEO_NODE_TRANSFORM:
+    case GEO_NODE_TRIANGULATE:
+    case GEO_NODE_TRIM_CURVE:
+    case GEO_NODE_VOLUME_TO_MESH:
+      return true;
+    default:
+      return false;
+  }
+}
+
 /**
  * Used for most normal geometry nodes like Subdivision Surface and Set Position.
  */
 class LazyFunctionForGeometryNode : public LazyFunction {
  private:
   const bNode &node_;
+  /** Results of the node can be reused from the #GeometryNodesCache, see #node_is_cacheable. */
+  bool is_cacheable_ = false;
 
  public:
   LazyFunctionForGeometryNode(const bNode &node,
@@ -119,6 +242,10 @@ class LazyFunctionForGeometryNode : public LazyFunction {
     BLI_assert(node.typeinfo->geometry_node_execute != nullptr);
     debug_name_ = node.name;
     lazy_function_interface_from_node(node, r_used_inputs, r_used_outputs, inputs_, outputs_);
+
+    is_cacheable_ = node_is_cacheable(node) &&
+                    !node.typeinfo->geometry_node_execute_supports_laziness &&
+                    node.id == nullptr && !outputs_.is_empty();
   }
 
   void execute_impl(lf::Params &params, const lf::Context &context) const override
@@ -126,6 +253,25 @@ class LazyFunctionForGeometryNode : public LazyFunction {
     GeoNodesLFUserData *user_data = dynamic_cast<GeoNodesLFUserData *>(context.user_data);
     BLI_assert(user_data != nullptr);
 
+    if (GeometryNodesCache *cache = user_data->modifier_data->cache) {
+      if (is_cacheable_) {
+        if (const std::optional<GeometryNodesCache::Hash> key = this->compute_cache_key(
+                *cache, params, *user_data->compute_context)) {
+          this->execute_cached(
+              params, context, *cache, *user_data->modifier_data->cache_evaluation, *key);
+          return;
+        }
+      }
+    }
+    this->execute_node(params, context);
+  }
+
+ private:
+  /** \return The time it took to execute the node. */
+  geo_eval_log::Clock::duration execute_node(lf::Params &params, const lf::Context &context) const
+  {
+    GeoNodesLFUserData *user_data = static_cast<GeoNodesLFUserData *>(context.user_data);
+
     GeoNodeExecParams geo_params{node_, params, context};
 
     geo_eval_log::TimePoint start_time = geo_eval_log::Clock::now();
@@ -138,6 +284,79 @@ class LazyFunctionForGeometryNode : public LazyFunction {
       tree_logger.node_execution_times.append(
           {tree_logger.allocator->copy_string(node_.name), start_time, end_time});
     }
+    return end_time - start_time;
+  }
+
+  /**
+   * Identify the result of the node based on the node, its settings, the input values and which
+   * outputs are required. All inputs are available, because the node does not support laziness.
+   */
+  std::optional<GeometryNodesCache::Hash> compute_cache_key(
+      const GeometryNodesCache &cache,
+      const lf::Params &params,
+      const ComputeContext &compute_context) const
+  {
+    GeometryNodesCache::Hash key = compute_context.hash();
+    key.mix_in(node_.name, strlen(node_.name));
+    key.mix_in(node_.idname, strlen(node_.idname));
+    key.mix_in(&node_.custom1, sizeof(node_.custom1));
+    key.mix_in(&node_.custom2, sizeof(node_.custom2));
+    key.mix_in(&node_.custom3, sizeof(node_.custom3));
+    key.mix_in(&node_.custom4, sizeof(node_.custom4));
+    if (node_.storage != nullptr) {
+      key.mix_in(node_.storage, MEM_allocN_len(node_.storage));
+    }
+    for (const int i : inputs_.index_range()) {
+      const void *value = params.try_get_input_data_ptr(i);
+      BLI_assert(value != nullptr);
+      const std::optional<GeometryNodesCache::Hash> value_hash = cache.hash_value(
+          {inputs_[i].type, value});
+      if (!value_hash) {
+        return std::nullopt;
+      }
+      key.mix_in(&*value_hash, sizeof(*value_hash));
+    }
+    /* Some nodes only create outputs like anonymous attributes when they are required. */
+    for (const int i : outputs_.index_range()) {
+      const bool is_required = params.get_output_usage(i) != lf::ValueUsage::Unused;
+      key.mix_in(&is_required, sizeof(is_required));
+    }
+    return key;
+  }
+
+  void execute_cached(lf::Params &params,
+                      const lf::Context &context,
+                      GeometryNodesCache &cache,
+                      GeometryNodesCache::Evaluation &evaluation,
+                      const GeometryNodesCache::Hash &key) const
+  {
+    Array<void *> output_ptrs(outputs_.size());
+    for (const int i : outputs_.index_range()) {
+      output_ptrs[i] = params.get_output_data_ptr(i);
+    }
+    if (cache.lookup(key, output_ptrs)) {
+      for (const int i : outputs_.index_range()) {
+        params.output_set(i);
+      }
+      return;
+    }
+
+    /* Execute the node while the outputs are still accessible, so that they can be copied into
+     * the cache. */
+    Array<bool> set_outputs(outputs_.size(), false);
+    ParamsWithDelayedOutputs delayed_params{*this, params, output_ptrs, set_outputs};
+    const geo_eval_log::Clock::duration duration = this->execute_node(delayed_params, context);
+
+    if (!set_outputs.as_span().contains(false)) {
+      Array<GPointer> values(outputs_.size());
+      for (const int i : outputs_.index_range()) {
+        values[i] = {outputs_[i].type, output_ptrs[i]};
+      }
+      const bool keep = std::chrono::duration<double>(duration).count() >=
+                        GeometryNodesCache::min_execution_seconds;
+      cache.add(key, values, keep, evaluation);
+    }
+    delayed_params.forward_set_outputs();
   }
 };
 
@@ -563,6 +782,7 @@ class LazyFunctionForGroupNode : public LazyFunction {
   bool has_many_nodes_ = false;
   std::optional<GeometryNodesLazyFunctionLogger> lf_logger_;
   std::optional<GeometryNodesLazyFunctionSideEffectProvider> lf_side_effect_provider_;
+  std::optional<GeometryNodesLazyFunctionNodeCostProvider> lf_node_cost_provider_;
   std::optional<lf::GraphExecutor> graph_executor_;
 
  public:
@@ -600,11 +820,13 @@ class LazyFunctionForGroupNode : public LazyFunction {
 
     lf_logger_.emplace(lf_graph_info);
     lf_side_effect_provider_.emplace();
+    lf_node_cost_provider_.emplace(lf_graph_info);
     graph_executor_.emplace(lf_graph_info.graph,
                             std::move(graph_inputs),
                             std::move(graph_outputs),
                             &*lf_logger_,
-                            &*lf_side_effect_provider_);
+                            &*lf_side_effect_provider_,
+                            &*lf_node_cost_provider_);
   }
 
   void execute_impl(lf::Params &params, const lf::Context &context) const override
@@ -926,6 +1148,7 @@ struct GeometryNodesLazyFunctionGraphBuilder {
       mapping_->bsockets_by_lf_socket_map.add(&lf_socket, &bsocket);
     }
     mapping_->group_node_map.add(&bnode, &lf_node);
+    mapping_->bnode_by_timed_lf_node.add(&lf_node, &bnode);
     lf_graph_info_->num_inline_nodes_approximate +=
         group_lf_graph_info->num_inline_nodes_approximate;
   }
@@ -936,8 +1159,9 @@ struct GeometryNodesLazyFunctionGraphBuilder {
     Vector<const bNodeSocket *> used_outputs;
     auto lazy_function = std::make_unique<LazyFunctionForGeometryNode>(
         bnode, used_inputs, used_outputs);
-    lf::Node &lf_node = lf_graph_->add_function(*lazy_function);
+    lf::FunctionNode &lf_node = lf_graph_->add_function(*lazy_function);
     lf_graph_info_->functions.append(std::move(lazy_function));
+    mapping_->bnode_by_timed_lf_node.add(&lf_node, &bnode);
 
     for (const int i : used_inputs.index_range()) {
       const bNodeSocket &bsocket = *used_inputs[i];
@@ -1363,6 +1587,33 @@ Vector<const lf::FunctionNode *> GeometryNodesLazyFunctionSideEffectProvider::
   return modifier_data.side_effect_nodes->lookup(context_hash);
 }
 
+GeometryNodesLazyFunctionNodeCostProvider::GeometryNodesLazyFunctionNodeCostProvider(
+    const GeometryNodesLazyFunctionGraphInfo &lf_graph_info)
+    : lf_graph_info_(lf_graph_info)
+{
+}
+
+std::chrono::nanoseconds GeometryNodesLazyFunctionNodeCostProvider::get_node_cost(
+    const lf::FunctionNode &node, const lf::Context &context) const
+{
+  GeoNodesLFUserData *user_data = dynamic_cast<GeoNodesLFUserData *>(context.user_data);
+  BLI_assert(user_data != nullptr);
+  const Map<ComputeContextHash, std::chrono::nanoseconds> *node_run_times =
+      user_data->modifier_data->node_run_times;
+  if (node_run_times == nullptr) {
+    return std::chrono::nanoseconds(0);
+  }
+  const bNode *bnode = lf_graph_info_.mapping.bnode_by_timed_lf_node.lookup_default(&node,
+                                                                                    nullptr);
+  if (bnode == nullptr) {
+    return std::chrono::nanoseconds(0);
+  }
+  return node_run_times->lookup_default(
+      geo_eval_log::GeoModifierLog::node_run_time_key(user_data->compute_context->hash(),
+                                                      bnode->name),
+      std::chrono::nanoseconds(0));
+}
+
 GeometryNodesLazyFunctionGraphInfo::GeometryNodesLazyFunctionGraphInfo() = default;
 GeometryNodesLazyFunctionGraphInfo::~GeometryNodesLazyFunctionGraphInfo()
 {
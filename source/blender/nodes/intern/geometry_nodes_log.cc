@@ -459,6 +459,47 @@ GeoTreeLogger &GeoModifierLog::get_local_tree_logger(const ComputeContext &compu
   return tree_logger;
 }
 
+Map<ComputeContextHash, std::chrono::nanoseconds> GeoModifierLog::get_node_run_times()
+{
+  Map<ComputeContextHash, const GeoTreeLogger *> tree_logger_by_context;
+  for (LocalData &local_data : data_per_thread_) {
+    for (const auto item : local_data.tree_logger_by_context.items()) {
+      tree_logger_by_context.add(item.key, item.value.get());
+    }
+  }
+
+  Map<ComputeContextHash, std::chrono::nanoseconds> run_times;
+  for (LocalData &local_data : data_per_thread_) {
+    for (const auto item : local_data.tree_logger_by_context.items()) {
+      const GeoTreeLogger &tree_logger = *item.value;
+      std::chrono::nanoseconds run_time_sum{0};
+      for (const GeoTreeLogger::NodeExecutionTime &timings : tree_logger.node_execution_times) {
+        const std::chrono::nanoseconds duration = timings.end - timings.start;
+        run_times.lookup_or_add(node_run_time_key(item.key, timings.node_name),
+                                std::chrono::nanoseconds(0)) += duration;
+        run_time_sum += duration;
+      }
+      /* Add the run time to all the group nodes that (indirectly) contain the nodes. */
+      const GeoTreeLogger *logger = &tree_logger;
+      while (logger != nullptr && logger->parent_hash.has_value() &&
+             logger->group_node_name.has_value()) {
+        run_times.lookup_or_add(node_run_time_key(*logger->parent_hash, *logger->group_node_name),
+                                std::chrono::nanoseconds(0)) += run_time_sum;
+        logger = tree_logger_by_context.lookup_default(*logger->parent_hash, nullptr);
+      }
+    }
+  }
+  return run_times;
+}
+
+ComputeContextHash GeoModifierLog::node_run_time_key(
+    const ComputeContextHash &compute_context_hash, const StringRef node_name)
+{
+  ComputeContextHash key = compute_context_hash;
+  key.mix_in(node_name.data(), node_name.size());
+  return key;
+}
+
 GeoTreeLog &GeoModifierLog::get_tree_log(const ComputeContextHash &compute_context_hash)
 {
   GeoTreeLog &reduced_tree_log = *tree_logs_.lookup_or_add_cb(compute_context_hash, [&]() {
@@ -164,6 +164,21 @@ class ClampWrapperFunction : public fn::MultiFunction {
       CLAMP(value, 0.0f, 1.0f);
     }
   }
+
+  bool is_element_wise() const override
+  {
+    return fn_.is_element_wise();
+  }
+
+  void call_element_wise(const int64_t size, const Span<void *> params) const override
+  {
+    fn_.call_element_wise(size, params);
+
+    MutableSpan<float> results{static_cast<float *>(params.last()), size};
+    for (float &value : results) {
+      CLAMP(value, 0.0f, 1.0f);
+    }
+  }
 };
 
 static void sh_node_math_build_multi_function(NodeMultiFunctionBuilder &builder)
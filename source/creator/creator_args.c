@@ -27,10 +27,12 @@
 #  include "BLI_string_utf8.h"
 #  include "BLI_system.h"
 #  include "BLI_threads.h"
+#  include "BLI_tracing.h"
 #  include "BLI_utildefines.h"
 
 #  include "BLO_readfile.h" /* only for BLO_has_bfile_extension */
 
+#  include "BKE_blender.h"
 #  include "BKE_blender_version.h"
 #  include "BKE_context.h"
 
@@ -579,6 +581,7 @@ static int arg_handle_print_help(int UNUSED(argc), const char **UNUSED(argv), vo
   BLI_args_print_arg_doc(ba, "--debug-wintab");
   BLI_args_print_arg_doc(ba, "--debug-gpu");
   BLI_args_print_arg_doc(ba, "--debug-gpu-force-workarounds");
+  BLI_args_print_arg_doc(ba, "--debug-trace-file");
   BLI_args_print_arg_doc(ba, "--debug-wm");
 #  ifdef WITH_XR_OPENXR
   BLI_args_print_arg_doc(ba, "--debug-xr");
@@ -1101,6 +1104,32 @@ static int arg_handle_debug_gpu_set(int UNUSED(argc),
   return 0;
 }
 
+static void callback_tracing_end(void *UNUSED(user_data))
+{
+  if (!BLI_tracing_end()) {
+    printf("Error: failed to write the trace file.\n");
+  }
+}
+
+static const char arg_handle_debug_trace_file_set_doc[] =
+    "<filepath>\n"
+    "\tRecord a timeline of the work done on every thread, for example the execution of geometry\n"
+    "\tnodes, and write it to <filepath> on exit.\n"
+    "\tThe file uses the Chrome trace event format, which can be opened in Perfetto.";
+static int arg_handle_debug_trace_file_set(int argc, const char **argv, void *UNUSED(data))
+{
+  const char *arg_id = "--debug-trace-file";
+  if (argc > 1) {
+    if (!BLI_tracing_is_enabled()) {
+      BKE_blender_atexit_register(callback_tracing_end, NULL);
+    }
+    BLI_tracing_begin(argv[1]);
+    return 1;
+  }
+  printf("\nError: '%s' no args given.\n", arg_id);
+  return 0;
+}
+
 static const char arg_handle_debug_fpe_set_doc[] =
     "\n\t"
     "Enable floating-point exceptions.";
@@ -2165,6 +2194,7 @@ void main_args_setup(bContext *C, bArgs *ba)
                CB_EX(arg_handle_debug_mode_generic_set, jobs),
                (void *)G_DEBUG_JOBS);
   BLI_args_add(ba, NULL, "--debug-gpu", CB(arg_handle_debug_gpu_set), NULL);
+  BLI_args_add(ba, NULL, "--debug-trace-file", CB(arg_handle_debug_trace_file_set), NULL);
 
   BLI_args_add(ba,
                NULL,